@@ -0,0 +1,66 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef BANDWIDTH_HPP
+#define BANDWIDTH_HPP
+
+#include <cstdint>
+
+#include "ClientHandle.hpp"
+
+namespace GameInABox { namespace Network {
+
+// Per client bandwidth cap, bytesPerSecond == 0 means unlimited.
+// burstInBytes should be at least as big as your usual snapshot, otherwise
+// snapshots will only get sent when the bucket is full.
+struct BandwidthLimit
+{
+    uint32_t bytesPerSecond;
+    uint32_t burstInBytes;
+};
+
+// Spreads the send work and packets over time instead of one burst per tick.
+// Clients are split into sendGroups groups and each SendState() only sends
+// snapshots to one group, so call SendState() sendGroups times per snapshot
+// period. Large snapshots only send fragmentsPerSend fragments per
+// SendState(), the rest go in the following calls and the client doesn't
+// get a new snapshot until they're all sent. 0 means no limit.
+// {1, 0} is the old behaviour, everything at once.
+struct SendPacing
+{
+    uint8_t sendGroups;
+    uint8_t fragmentsPerSend;
+};
+
+struct BandwidthUtilisation
+{
+    ClientHandle client;
+    uint64_t bytesSent;
+    uint64_t snapshotsSent;
+    uint64_t snapshotsDropped;
+
+    // bytesSent / bytes allowed by the limit since the client connected.
+    // Always 0 if there is no limit.
+    float utilisation0to1;
+};
+
+}} // namespace
+
+#endif // BANDWIDTH_HPP
@@ -0,0 +1,61 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef CONGESTION_HPP
+#define CONGESTION_HPP
+
+#include <cstdint>
+#include <chrono>
+
+#include "ClientHandle.hpp"
+
+namespace GameInABox { namespace Network {
+
+// Per client snapshot rate control. A client is sent a snapshot every
+// interval ticks, where interval is kept between intervalMinimum and
+// intervalMaximum. Set both to 1 to send every tick regardless, which is
+// the default. {1, 8, 0.25f, 0.05f} is a reasonable adaptive setup.
+struct CongestionSettings
+{
+    uint8_t intervalMinimum;
+    uint8_t intervalMaximum;
+
+    // Back off when the loss estimate goes over lossBackOff0to1,
+    // speed up again once it drops under lossRecover0to1.
+    float lossBackOff0to1;
+    float lossRecover0to1;
+};
+
+struct CongestionState
+{
+    ClientHandle client;
+
+    // Snapshots sent but never acked. Includes snapshots that the client
+    // skipped because a newer one arrived first, which is just as wasteful.
+    float loss0to1;
+    std::chrono::milliseconds roundTripTime;
+    std::chrono::milliseconds roundTripTimeMinimum;
+
+    uint8_t interval;
+};
+
+}} // namespace
+
+#endif // CONGESTION_HPP
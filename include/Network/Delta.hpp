@@ -21,6 +21,9 @@
 #ifndef DELTA_HPP
 #define DELTA_HPP
 
+#include <cstdint>
+#include <vector>
+
 #include "Sequence.hpp"
 
 namespace GameInABox { namespace Network {
@@ -34,12 +37,25 @@ struct Delta
     Delta(Sequence newBase, Sequence newTo, std::vector<uint8_t> newPayload)
         : base(newBase)
         , to(newTo)
-        , deltaPayload(newPayload)
+        , deltaPayload(std::move(newPayload))
     {
     }
 
     Delta() = default;
     Delta(const Delta&) = default;
+    Delta(Delta&&) = default;
+    Delta& operator=(const Delta&) = default;
+    Delta& operator=(Delta&&) = default;
+};
+
+// A Delta that doesn't own its payload. Only valid while the buffer it
+// points into is alive and unchanged.
+struct DeltaView
+{
+    Sequence base;
+    Sequence to;
+    const uint8_t* payload;
+    std::size_t size;
 };
 
 }} // namespace
@@ -34,6 +34,32 @@
 
 namespace GameInABox { namespace Network {
 
+// See IStateManager::DeltaCreateAll(), result is filled in.
+struct DeltaRequest
+{
+    ClientHandle client;
+    boost::optional<Sequence> lastAcked;
+    DeltaView result;
+};
+
+// See IStateManager::DeltaParseAll(), acked is filled in.
+struct DeltaReceived
+{
+    ClientHandle client;
+    DeltaView payload;
+    Sequence acked;
+};
+
+// See IStateManager::Traffic(). !client is handshaking.
+struct TrafficTotal
+{
+    boost::optional<ClientHandle> client;
+    uint64_t packetsReceived;
+    uint64_t bytesReceived;
+    uint64_t packetsSent;
+    uint64_t bytesSent;
+};
+
 // All methods are assumed to be multithreading and reentrance UNSAFE, unless told otherwise.
 class IStateManager : NoCopyMoveNorAssign
 {
@@ -49,8 +75,12 @@ public:
     bool IsConnected(ClientHandle client) const;
 
     // Called for each datagram received or to be sent, to be used by the state
-    // manager for metrics and to control throttling. Return true to process the datagram further, false otherwise.
+    // manager for metrics and to control throttling (unless AccountPerTick() says otherwise).
+    // Return true to process the datagram further, false otherwise.
     // If !client it is for handshaking.
+    // Snapshots are asked about once with the total size of all their fragments,
+    // as a partly sent snapshot is useless. For a plain bandwidth cap use
+    // NetworkManagerServer::SetBandwidthLimit() instead.
     bool CanReceive(boost::optional<ClientHandle> client, std::size_t bytes);
     bool CanSend(boost::optional<ClientHandle> client, std::size_t bytes);
 
@@ -67,6 +97,41 @@ public:
             ClientHandle client,
             const Delta& payload);
 
+    // Same as above, but without allocating a Delta per client per tick.
+    // buffer belongs to the network and is reused, write the payload into
+    // it (it's passed in empty, with its old capacity). The result points
+    // into buffer. Override PrivateDeltaCreateInto() to get the benefit,
+    // by default it calls PrivateDeltaCreate() and takes its vector.
+    DeltaView DeltaCreate(
+            ClientHandle client,
+            boost::optional<Sequence> lastAcked,
+            std::vector<uint8_t>& buffer) const;
+
+    // payload points into a network owned buffer, only valid during the call.
+    // By default builds a Delta and calls PrivateDeltaParse().
+    Sequence DeltaParse(
+            ClientHandle client,
+            const DeltaView& payload);
+
+    // The server calls these once per tick with every client that is due a
+    // snapshot, and every delta received, rather than once per client.
+    // Override them to share work between clients (build the snapshot once,
+    // compare everyone against it). By default they just loop.
+    // buffers has at least requests.size() entries, the first requests.size()
+    // are cleared, requests[i] goes into buffers[i]. It never shrinks, so the
+    // spare buffers keep their capacity for later ticks.
+    void DeltaCreateAll(
+            std::vector<DeltaRequest>& requests,
+            std::vector<std::vector<uint8_t>>& buffers) const;
+
+    void DeltaParseAll(std::vector<DeltaReceived>& received);
+
+    // Return true and the server won't call CanReceive() or CanSend() per
+    // packet, everything is allowed and the totals come once per tick via
+    // Traffic() instead. Asked once per tick. Defaults to false.
+    bool AccountPerTick() const;
+    void Traffic(const std::vector<TrafficTotal>& totals);
+
 protected:
     // Don't allow deletion or creation of the interface.
     IStateManager()  = default;
@@ -94,6 +159,24 @@ private:
     virtual Sequence PrivateDeltaParse(
             ClientHandle client,
             const Delta& payload) = 0;
+
+    virtual DeltaView PrivateDeltaCreateInto(
+            ClientHandle client,
+            boost::optional<Sequence> lastAcked,
+            std::vector<uint8_t>& buffer) const;
+
+    virtual Sequence PrivateDeltaParseView(
+            ClientHandle client,
+            const DeltaView& payload);
+
+    virtual void PrivateDeltaCreateAll(
+            std::vector<DeltaRequest>& requests,
+            std::vector<std::vector<uint8_t>>& buffers) const;
+
+    virtual void PrivateDeltaParseAll(std::vector<DeltaReceived>& received);
+
+    virtual bool PrivateAccountPerTick() const;
+    virtual void PrivateTraffic(const std::vector<TrafficTotal>& totals);
 };
 
 }} // namespace
@@ -22,8 +22,13 @@
 #define NETWORKMANAGERSERVER_H
 
 #include <memory>
+#include <vector>
 
 #include "INetworkManager.hpp"
+#include "Bandwidth.hpp"
+#include "Congestion.hpp"
+#include "ReceiveBudget.hpp"
+#include "ServerMetrics.hpp"
 
 namespace GameInABox { namespace Network {
 class IStateManager;
@@ -42,6 +47,25 @@ public:
 
     virtual ~NetworkManagerServer();
 
+    // Per client limit, applies to existing and new connections.
+    void SetBandwidthLimit(BandwidthLimit limit);
+    std::vector<BandwidthUtilisation> Utilisation() const;
+
+    // Spread sends over several SendState() calls, see SendPacing.
+    void SetSendPacing(SendPacing pacing);
+
+    // Limit the work per ProcessIncomming(), see ReceiveBudget.
+    void SetReceiveBudget(ReceiveBudget budget);
+    ReceiveShedding Shedding() const;
+
+    // Snapshot rate control, only applies to new connections. Off (every
+    // tick) unless set.
+    void SetCongestionSettings(CongestionSettings settings);
+    std::vector<CongestionState> Congestion() const;
+
+    DeltaCacheMetrics DeltaCache() const;
+    PipelineLatencySummary ReceiveLatency() const;
+
 private:
     std::unique_ptr<Implementation::NetworkManagerServerGuts> myGuts;
 
@@ -0,0 +1,80 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef NETWORKMANAGERSERVERSHARDED_H
+#define NETWORKMANAGERSERVERSHARDED_H
+
+#include <memory>
+#include <vector>
+#include <boost/asio/ip/udp.hpp>
+
+#include "INetworkManager.hpp"
+#include "Bandwidth.hpp"
+#include "Congestion.hpp"
+#include "ReceiveBudget.hpp"
+
+namespace GameInABox { namespace Network {
+class IStateManager;
+
+namespace Implementation {
+class NetworkManagerServerShardedGuts;
+}
+
+// A server that uses shardCount sockets and threads on the same port
+// (SO_REUSEPORT), for when one thread can't keep up with the packets.
+// Owns its own sockets, so unlike NetworkManagerServer it takes an address
+// instead of an INetworkProvider. stateManager calls are serialised so it
+// doesn't need to be thread safe.
+class NetworkManagerServerSharded : public INetworkManager
+{
+public:
+    NetworkManagerServerSharded(
+            boost::asio::ip::udp::endpoint bindAddress,
+            std::size_t shardCount,
+            IStateManager& stateManager);
+
+    virtual ~NetworkManagerServerSharded();
+
+    // Per client limit, applies to existing and new connections.
+    void SetBandwidthLimit(BandwidthLimit limit);
+    std::vector<BandwidthUtilisation> Utilisation() const;
+
+    // Spread sends over several SendState() calls, see SendPacing.
+    void SetSendPacing(SendPacing pacing);
+
+    // Limit the work per ProcessIncomming(), see ReceiveBudget.
+    void SetReceiveBudget(ReceiveBudget budget);
+    ReceiveShedding Shedding() const;
+
+    // Snapshot rate control, only applies to new connections. Off (every
+    // tick) unless set.
+    void SetCongestionSettings(CongestionSettings settings);
+    std::vector<CongestionState> Congestion() const;
+
+private:
+    std::unique_ptr<Implementation::NetworkManagerServerShardedGuts> myGuts;
+
+    void PrivateProcessIncomming() override;
+    void PrivateSendState() override;
+};
+
+}} // namespace
+
+#endif // NETWORKMANAGERSERVERSHARDED_H
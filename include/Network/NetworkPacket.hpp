@@ -24,6 +24,7 @@
 #include <cstdint>
 #include <vector>
 #include <memory>
+#include <chrono>
 #include <boost/asio/ip/udp.hpp>
 
 namespace GameInABox { namespace Network {
@@ -34,22 +35,31 @@ public:
     std::vector<uint8_t>                data;
     boost::asio::ip::udp::endpoint      address;
 
+    // When it arrived, from the kernel if the provider can get it.
+    // Default constructed (the epoch) if unknown, or for packets to send.
+    std::chrono::steady_clock::time_point received;
+
     NetworkPacket()
         : data()
         , address()
+        , received()
     {
     }
 
     NetworkPacket(
             std::vector<uint8_t> dataToUse,
-            boost::asio::ip::udp::endpoint addressToUse)
+            boost::asio::ip::udp::endpoint addressToUse,
+            std::chrono::steady_clock::time_point receivedAt = {})
         : data(dataToUse)
         , address(addressToUse)
+        , received(receivedAt)
     {
     }
 
     NetworkPacket(const NetworkPacket&) = default;
+    NetworkPacket(NetworkPacket&&) = default;
     NetworkPacket& operator= ( NetworkPacket const &) = default;
+    NetworkPacket& operator= ( NetworkPacket&&) = default;
 };
 
 }} // namespace
@@ -0,0 +1,62 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef RECEIVEBUDGET_HPP
+#define RECEIVEBUDGET_HPP
+
+#include <cstdint>
+#include <chrono>
+
+namespace GameInABox { namespace Network {
+
+// Caps the work one ProcessIncomming() does, so a burst or flood can't
+// stretch a tick far past its period. packets and time are per call,
+// 0 means no limit. {0, 0, 0} is the old behaviour, everything received is
+// processed in the order it arrived.
+//
+// With a limit, packets from connected clients go before handshake traffic,
+// which goes before deltas from unknown addresses (a client whose port
+// changed, or a spoofed flood). Whatever is over budget waits for the next
+// call, keeping up to backlogPackets of each kind (0 keeps none). Past that the oldest are
+// dropped first, as newer deltas and acks supersede them anyway.
+struct ReceiveBudget
+{
+    uint32_t packets;
+    std::chrono::microseconds time;
+    uint32_t backlogPackets;
+};
+
+// Totals since the server started, apart from backlog.
+struct ReceiveShedding
+{
+    uint64_t connectedDropped;
+    uint64_t handshakeDropped;
+    uint64_t unknownDropped;
+
+    // Over budget, but kept for the next call. A packet can be deferred more than once.
+    uint64_t deferred;
+
+    // Waiting now.
+    uint64_t backlog;
+};
+
+}} // namespace
+
+#endif // RECEIVEBUDGET_HPP
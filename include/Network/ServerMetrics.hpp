@@ -0,0 +1,78 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef SERVERMETRICS_HPP
+#define SERVERMETRICS_HPP
+
+#include <cstdint>
+#include <chrono>
+
+namespace GameInABox { namespace Network {
+
+// Clients that are in sync share the Huffman encoding of the same delta
+// within a tick. Totals since the server started.
+struct DeltaCacheMetrics
+{
+    uint64_t hits;
+    uint64_t misses;
+
+    // Time spent encoding misses, and the time we would have spent
+    // encoding the hits if there was no cache.
+    std::chrono::nanoseconds timeEncoding;
+    std::chrono::nanoseconds timeSaved;
+};
+
+// A latency histogram boiled down. Percentiles are the upper bound of a
+// power of two bucket, so can be up to 2x high.
+struct LatencySummary
+{
+    uint64_t count;
+    std::chrono::microseconds median;
+    std::chrono::microseconds percentile99;
+    std::chrono::microseconds maximum;
+};
+
+// Where a received packet's time goes, from the kernel to DeltaParse().
+// Totals since the server started. Only packets from providers that stamp
+// NetworkPacket::received count towards queued and endToEnd.
+struct PipelineLatencySummary
+{
+    // Kernel timestamp to Receive() returning, i.e. sat in the socket buffer.
+    LatencySummary queued;
+
+    // Each INetworkProvider::Receive() call.
+    LatencySummary provider;
+
+    // Each Connection::Process() call.
+    LatencySummary process;
+
+    // Xor and Huffman decode of each delta.
+    LatencySummary decode;
+
+    // Each delta's share of IStateManager::DeltaParseAll().
+    LatencySummary parse;
+
+    // Kernel timestamp of the connection's latest packet to the parse finishing.
+    LatencySummary endToEnd;
+};
+
+}} // namespace
+
+#endif // SERVERMETRICS_HPP
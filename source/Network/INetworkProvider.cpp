@@ -19,6 +19,7 @@
 */
 
 #ifndef USING_PRECOMPILED_HEADERS
+#include <utility>
 #else
 #include "Common/PrecompiledHeaders.hpp"
 #endif
@@ -35,7 +36,7 @@ std::vector<NetworkPacket> INetworkProvider::Receive()
 
 void INetworkProvider::Send(std::vector<NetworkPacket> packets)
 {
-    PrivateSend(packets);
+    PrivateSend(std::move(packets));
 }
 
 void INetworkProvider::Reset()
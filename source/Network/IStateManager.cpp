@@ -77,3 +77,107 @@ Sequence IStateManager::DeltaParse(
 {
     return PrivateDeltaParse(client, payload);
 }
+
+DeltaView IStateManager::DeltaCreate(
+        ClientHandle client,
+        boost::optional<Sequence> lastAcked,
+        std::vector<uint8_t>& buffer) const
+{
+    buffer.clear();
+
+    return PrivateDeltaCreateInto(client, lastAcked, buffer);
+}
+
+Sequence IStateManager::DeltaParse(
+        ClientHandle client,
+        const DeltaView& payload)
+{
+    return PrivateDeltaParseView(client, payload);
+}
+
+DeltaView IStateManager::PrivateDeltaCreateInto(
+        ClientHandle client,
+        boost::optional<Sequence> lastAcked,
+        std::vector<uint8_t>& buffer) const
+{
+    auto delta = PrivateDeltaCreate(client, lastAcked);
+
+    // No copy, but the buffer's old allocation goes.
+    buffer.swap(delta.deltaPayload);
+
+    return {delta.base, delta.to, buffer.data(), buffer.size()};
+}
+
+Sequence IStateManager::PrivateDeltaParseView(
+        ClientHandle client,
+        const DeltaView& payload)
+{
+    return PrivateDeltaParse(
+            client,
+            Delta{
+                payload.base,
+                payload.to,
+                std::vector<uint8_t>(payload.payload, payload.payload + payload.size)});
+}
+
+void IStateManager::DeltaCreateAll(
+        std::vector<DeltaRequest>& requests,
+        std::vector<std::vector<uint8_t>>& buffers) const
+{
+    if (buffers.size() < requests.size())
+    {
+        buffers.resize(requests.size());
+    }
+
+    for (std::size_t i = 0; i < requests.size(); ++i)
+    {
+        buffers[i].clear();
+    }
+
+    PrivateDeltaCreateAll(requests, buffers);
+}
+
+void IStateManager::DeltaParseAll(std::vector<DeltaReceived>& received)
+{
+    PrivateDeltaParseAll(received);
+}
+
+bool IStateManager::AccountPerTick() const
+{
+    return PrivateAccountPerTick();
+}
+
+void IStateManager::Traffic(const std::vector<TrafficTotal>& totals)
+{
+    PrivateTraffic(totals);
+}
+
+void IStateManager::PrivateDeltaCreateAll(
+        std::vector<DeltaRequest>& requests,
+        std::vector<std::vector<uint8_t>>& buffers) const
+{
+    for (std::size_t i = 0; i < requests.size(); ++i)
+    {
+        requests[i].result = PrivateDeltaCreateInto(
+                requests[i].client,
+                requests[i].lastAcked,
+                buffers[i]);
+    }
+}
+
+void IStateManager::PrivateDeltaParseAll(std::vector<DeltaReceived>& received)
+{
+    for (auto& delta : received)
+    {
+        delta.acked = PrivateDeltaParseView(delta.client, delta.payload);
+    }
+}
+
+bool IStateManager::PrivateAccountPerTick() const
+{
+    return false;
+}
+
+void IStateManager::PrivateTraffic(const std::vector<TrafficTotal>&)
+{
+}
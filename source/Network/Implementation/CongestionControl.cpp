@@ -0,0 +1,184 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <algorithm>
+#else
+#include "Common/PrecompiledHeaders.hpp"
+#endif
+
+#include "PacketDelta.hpp"
+#include "CongestionControl.hpp"
+
+using namespace std::chrono;
+using namespace GameInABox::Network::Implementation;
+
+CongestionControl::CongestionControl(CongestionSettings settings)
+    : mySettings(settings)
+    , mySent()
+    , myLastSent()
+    , myLastAcked()
+    , myLoss(0)
+    , myRoundTripTime(0)
+    , myRoundTripTimeMinimum(0)
+    , myInterval(1)
+    , myTicksSinceSend(0)
+    , myTicksSinceAdjust(0)
+{
+    // validate.
+    mySettings.intervalMinimum = std::max(mySettings.intervalMinimum, uint8_t{1});
+    mySettings.intervalMaximum = std::max(mySettings.intervalMaximum, mySettings.intervalMinimum);
+
+    myInterval = mySettings.intervalMinimum;
+
+    for (auto& sent : mySent)
+    {
+        sent.valid = false;
+    }
+}
+
+bool CongestionControl::ShouldSend()
+{
+    if (++myTicksSinceAdjust >= AdjustPeriodInTicks)
+    {
+        myTicksSinceAdjust = 0;
+        Adjust();
+    }
+
+    bool result = (myTicksSinceSend == 0);
+
+    if (++myTicksSinceSend >= myInterval)
+    {
+        myTicksSinceSend = 0;
+    }
+
+    return result;
+}
+
+void CongestionControl::Sent(Sequence sent, OClock now)
+{
+    auto& entry = mySent[sent.Value() % HistorySize];
+
+    if (entry.valid)
+    {
+        // Same state resent (the game hasn't ticked), keep the original time
+        // as a round trip sample from a resend is ambiguous.
+        if (entry.sequence == sent)
+        {
+            return;
+        }
+
+        // Fell out of the history without an ack.
+        AddLossSample(true);
+    }
+
+    entry = SentSnapshot{true, sent, now};
+    myLastSent = sent;
+}
+
+void CongestionControl::Acked(Sequence ack, OClock now)
+{
+    if (myLastAcked)
+    {
+        if (!(ack > *myLastAcked))
+        {
+            // Old or repeated ack.
+            return;
+        }
+
+        // Everything sent between the last ack and this one
+        // was either lost or never used by the client.
+        auto sequence = Sequence(myLastAcked->Value() + 1);
+        std::size_t checked = 0;
+
+        while ((sequence != ack) && (checked < HistorySize))
+        {
+            auto& entry = mySent[sequence.Value() % HistorySize];
+
+            if (entry.valid && (entry.sequence == sequence))
+            {
+                AddLossSample(true);
+                entry.valid = false;
+            }
+
+            sequence = Sequence(sequence.Value() + 1);
+            ++checked;
+        }
+    }
+
+    auto& entry = mySent[ack.Value() % HistorySize];
+
+    if (entry.valid && (entry.sequence == ack))
+    {
+        AddLossSample(false);
+        entry.valid = false;
+
+        // Smoothed as per RFC 6298.
+        auto sample = duration_cast<Milliseconds>(now - entry.timeSent);
+
+        if (myRoundTripTime.count() == 0)
+        {
+            myRoundTripTime = sample;
+        }
+        else
+        {
+            myRoundTripTime = (myRoundTripTime * 7 + sample) / 8;
+        }
+
+        if ((myRoundTripTimeMinimum.count() == 0) || (sample < myRoundTripTimeMinimum))
+        {
+            myRoundTripTimeMinimum = sample;
+        }
+    }
+
+    myLastAcked = ack;
+}
+
+void CongestionControl::AddLossSample(bool lost)
+{
+    // Exponential moving average, roughly the last 16 snapshots.
+    myLoss += ((lost ? 1.0f : 0.0f) - myLoss) / 16.0f;
+}
+
+void CongestionControl::Adjust()
+{
+    bool congested = (myLoss > mySettings.lossBackOff0to1);
+
+    // Getting close to a delta we cannot encode, back off before we get there.
+    if (myLastSent && myLastAcked)
+    {
+        if ((*myLastSent - *myLastAcked) > (PacketDelta::MaximumDeltaDistance() / 2))
+        {
+            congested = true;
+        }
+    }
+
+    if (congested)
+    {
+        myInterval = static_cast<uint8_t>(std::min(myInterval * 2, int{mySettings.intervalMaximum}));
+    }
+    else
+    {
+        if ((myLoss < mySettings.lossRecover0to1) && (myInterval > mySettings.intervalMinimum))
+        {
+            --myInterval;
+        }
+    }
+}
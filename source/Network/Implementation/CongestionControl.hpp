@@ -0,0 +1,101 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef CONGESTIONCONTROL_HPP
+#define CONGESTIONCONTROL_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <array>
+#include <boost/optional.hpp>
+#endif
+
+#include "Units.hpp"
+#include "Sequence.hpp"
+#include "Congestion.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+// Estimates snapshot loss and round trip time from the acks the client
+// sends back, and uses that to choose how often to send the client a snapshot.
+// Backs off multiplicatively, recovers additively.
+class CongestionControl
+{
+public:
+    // Every tick, like before there was congestion control. Games opt in
+    // with a bigger intervalMaximum, AdaptiveSettings() is a good start.
+    static CongestionSettings DefaultSettings()
+    {
+        return {1, 1, 0.25f, 0.05f};
+    }
+
+    static CongestionSettings AdaptiveSettings()
+    {
+        return {1, 8, 0.25f, 0.05f};
+    }
+
+    CongestionControl() : CongestionControl(DefaultSettings()) {}
+    explicit CongestionControl(CongestionSettings settings);
+
+    // Call once per tick, returns true if a snapshot should be sent this tick.
+    bool ShouldSend();
+
+    void Sent(Sequence sent, OClock now);
+    void Acked(Sequence ack, OClock now);
+
+    float Loss() const { return myLoss; }
+    Milliseconds RoundTripTime() const { return myRoundTripTime; }
+    Milliseconds RoundTripTimeMinimum() const { return myRoundTripTimeMinimum; }
+    uint8_t Interval() const { return myInterval; }
+
+private:
+    // Don't adjust more often than this, otherwise one lossy burst
+    // will max out the interval before the acks have caught up.
+    static const unsigned AdjustPeriodInTicks = 16;
+    static const std::size_t HistorySize = 64;
+
+    struct SentSnapshot
+    {
+        bool valid;
+        Sequence sequence;
+        OClock timeSent;
+    };
+
+    CongestionSettings mySettings;
+
+    std::array<SentSnapshot, HistorySize> mySent;
+    boost::optional<Sequence> myLastSent;
+    boost::optional<Sequence> myLastAcked;
+
+    float myLoss;
+    Milliseconds myRoundTripTime;
+    Milliseconds myRoundTripTimeMinimum;
+
+    uint8_t myInterval;
+    uint8_t myTicksSinceSend;
+    unsigned myTicksSinceAdjust;
+
+    void AddLossSample(bool lost);
+    void Adjust();
+};
+
+}}} // namespace
+
+#endif // CONGESTIONCONTROL_HPP
@@ -61,6 +61,7 @@ Connection::Connection(
     , myKey(GetNetworkKeyNil())
     , myPacketCount(0)
     , myLastTimestamp(Timepoint::min())
+    , myLastRecieved(Timepoint::min())
     , myLastSequenceAck()
     , myStateHandle()
     , myIdConnection()
@@ -83,15 +84,21 @@ void Connection::Start(Mode mode)
     if (mode == Mode::Server)
     {
         myKey = GetNetworkKeyRandom();
-        Reset(State::Listening);
+        Reset(State::Listening, myTimeNow());
     }
     else
     {
         myKey = GetNetworkKeyNil();
-        Reset(State::Challenging);
+        Reset(State::Challenging, myTimeNow());
     }
 }
 
+void Connection::Listen(NetworkKey key)
+{
+    Start(Mode::Server);
+    myKey = key;
+}
+
 void Connection::Disconnect(std::string failReason)
 {
     if (myStateHandle)
@@ -105,13 +112,16 @@ void Connection::Disconnect(std::string failReason)
     }
 
     myFailReason = failReason;
-    Reset(State::Disconnecting);
+    Reset(State::Disconnecting, myTimeNow());
 }
 
 std::vector<uint8_t> Connection::Process(std::vector<uint8_t> packet)
 {
     std::vector<uint8_t> result{};
 
+    // Only sample the clock once.
+    auto now = myTimeNow();
+
     // NOTE:
     // pure things:
     // State, NetworkPacket, packetCount, timeLastPacket, timeCurrent, failReason
@@ -164,6 +174,7 @@ std::vector<uint8_t> Connection::Process(std::vector<uint8_t> packet)
                 myLastDelta = delta;
                 myLastSequenceRecieved = delta.GetSequence();
                 myLastSequenceAck = delta.GetSequenceAck();
+                myLastRecieved = now;
             }
 
             break;
@@ -183,6 +194,7 @@ std::vector<uint8_t> Connection::Process(std::vector<uint8_t> packet)
                     myLastDelta = delta;
                     myLastSequenceRecieved = delta.GetSequence();
                     myLastSequenceAck = delta.GetSequenceAck();
+                    myLastRecieved = now;
                 }
             }
 
@@ -202,7 +214,7 @@ std::vector<uint8_t> Connection::Process(std::vector<uint8_t> packet)
                         if (response.Version() == Version)
                         {
                             myKey = response.Key();
-                            Reset(State::Connecting);
+                            Reset(State::Connecting, now);
                         }
                         else
                         {
@@ -245,7 +257,7 @@ std::vector<uint8_t> Connection::Process(std::vector<uint8_t> packet)
                         else
                         {
                             myStateHandle = handle;
-                            Reset(State::ConnectedToServer);
+                            Reset(State::ConnectedToServer, now);
                         }
                     }
                 }
@@ -273,7 +285,7 @@ std::vector<uint8_t> Connection::Process(std::vector<uint8_t> packet)
                         if (challenge.IsValid())
                         {
                             result = std::move(PacketChallengeResponse(Version, myKey).data);
-                            myLastTimestamp = myTimeNow();
+                            myLastTimestamp = now;
                             ++myPacketCount;
                         }
 
@@ -294,7 +306,7 @@ std::vector<uint8_t> Connection::Process(std::vector<uint8_t> packet)
                                 // NOTE: Packet will be UDP fragmented if too big.
                                 // But I'm not going to do anything about that.
                                 result = std::move(packet.data);
-                                myLastTimestamp = myTimeNow();
+                                myLastTimestamp = now;
                                 ++myPacketCount;
                             }
                         }
@@ -334,7 +346,7 @@ std::vector<uint8_t> Connection::Process(std::vector<uint8_t> packet)
                                     auto response = PacketConnectResponse::WithBuffer(infoData);
 
                                     result = std::move(response.data);
-                                    myLastTimestamp = myTimeNow();
+                                    myLastTimestamp = now;
                                     ++myPacketCount;
                                 }
                             }
@@ -363,7 +375,7 @@ std::vector<uint8_t> Connection::Process(std::vector<uint8_t> packet)
                                 {
                                     myIdConnection = idConnection;
 
-                                    Reset(State::ConnectedToClient);
+                                    Reset(State::ConnectedToClient, now);
                                     myLastDelta = delta;
                                     myLastSequenceRecieved = delta.GetSequence();
                                     myLastSequenceAck = delta.GetSequenceAck();
@@ -397,10 +409,21 @@ std::vector<uint8_t> Connection::Process(std::vector<uint8_t> packet)
         // ///////////////////
         case State::Idle:
         case State::FailedConnection:
+        {
+            // Nothing, ignore everything
+            break;
+        }
+
         case State::ConnectedToServer:
         case State::ConnectedToClient:
         {
-            // Nothing, ignore everything
+            if (duration_cast<milliseconds>(now - myLastRecieved) > IdleTimeout())
+            {
+                Disconnect("Timeout: Idle.");
+                result = std::move(PacketDisconnect(myKey, myFailReason).data);
+                Fail(myFailReason);
+            }
+
             break;
         }
 
@@ -430,7 +453,7 @@ std::vector<uint8_t> Connection::Process(std::vector<uint8_t> packet)
             }
             else
             {
-                auto sinceLastPacket = myTimeNow() - myLastTimestamp;
+                auto sinceLastPacket = now - myLastTimestamp;
 
                 if (duration_cast<milliseconds>(sinceLastPacket) > HandshakeRetryPeriod())
                 {
@@ -446,7 +469,7 @@ std::vector<uint8_t> Connection::Process(std::vector<uint8_t> packet)
                         result = std::move(PacketConnect(myKey, info).data);
                     }
 
-                    myLastTimestamp = myTimeNow();
+                    myLastTimestamp = now;
                     ++myPacketCount;
                 }
 
@@ -460,7 +483,7 @@ std::vector<uint8_t> Connection::Process(std::vector<uint8_t> packet)
         // ///////////////////
         case State::Listening:
         {
-            auto sinceLastPacket = myTimeNow() - myLastTimestamp;
+            auto sinceLastPacket = now - myLastTimestamp;
 
             // int{HandshakeRetries} because for some reason te compiler needs
             // the address of HandshakeRetries if I just do * HandshakeRetries.
@@ -501,6 +524,49 @@ bool Connection::HasFailed() const
     return myState == State::FailedConnection;
 }
 
+OClock Connection::NextTimeout() const
+{
+    // Mirrors the timing checks in Process(), which use '>' on
+    // whole milliseconds, hence the + 1ms.
+    switch (myState)
+    {
+        case State::Idle:
+        case State::FailedConnection:
+        {
+            return OClock::max();
+        }
+
+        case State::Disconnecting:
+        {
+            return OClock::min();
+        }
+
+        case State::ConnectedToServer:
+        case State::ConnectedToClient:
+        {
+            return myLastRecieved + IdleTimeout() + milliseconds{1};
+        }
+
+        case State::Challenging:
+        case State::Connecting:
+        {
+            if (myPacketCount > HandshakeRetries)
+            {
+                return OClock::min();
+            }
+
+            return myLastTimestamp + HandshakeRetryPeriod() + milliseconds{1};
+        }
+
+        case State::Listening:
+        {
+            return myLastTimestamp + (HandshakeRetryPeriod() * int{HandshakeRetries}) + milliseconds{1};
+        }
+    }
+
+    return OClock::min();
+}
+
 boost::optional<ClientHandle> Connection::IdClient() const
 {
     return myStateHandle;
@@ -516,14 +582,15 @@ NetworkKey Connection::Key() const
     return myKey;
 }
 
-void Connection::Reset(State resetState)
+void Connection::Reset(State resetState, OClock now)
 {
     myState         = resetState;
     myPacketCount   = 0;
+    myLastRecieved  = now;
 
     // If I use Timepoint::min(), I end up with -ve durations.
     // This breaks the timestamping mechanism. bah.
-    myLastTimestamp = myTimeNow() - (HandshakeRetryPeriod() * 2);
+    myLastTimestamp = now - (HandshakeRetryPeriod() * 2);
 }
 
 void Connection::Fail(std::string failReason)
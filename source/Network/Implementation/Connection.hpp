@@ -66,6 +66,11 @@ public:
     ~Connection() = default;
 
     void Start(Mode mode);
+
+    // Server mode, but the client already has its key as the challenge
+    // was answered without a connection (see HandshakeCookie).
+    void Listen(NetworkKey key);
+
     void Disconnect(std::string failReason);
 
     // Input, packets to process, output, packets to send.
@@ -81,6 +86,10 @@ public:
     bool IsConnected() const;
     bool HasFailed() const;
 
+    // When Process({}) next needs to be called to handle retries and
+    // timeouts. OClock::max() if never, OClock::min() if as soon as possible.
+    OClock NextTimeout() const;
+
     boost::optional<ClientHandle> IdClient() const;
     boost::optional<uint16_t> IdConnection() const;
     NetworkKey Key() const;
@@ -90,10 +99,11 @@ public:
         return myFailReason;
     }
 
+    static const uint8_t Version = 1;
+
 private:
     static const int HandshakeRetries = 5;
     static const int FloodTrigger = 1 + HandshakeRetries * 2;
-    static const uint8_t Version = 1;
 
     IStateManager*                          myStateManager;
     State                                   myState;
@@ -101,6 +111,7 @@ private:
     NetworkKey                              myKey;
     int                                     myPacketCount;
     OClock                                  myLastTimestamp;
+    OClock                                  myLastRecieved;
     boost::optional<Sequence>               myLastSequenceAck;
     boost::optional<ClientHandle>           myStateHandle;
     boost::optional<uint16_t>               myIdConnection;
@@ -114,7 +125,12 @@ private:
         return std::chrono::milliseconds{1000};
     }
 
-    void Reset(State resetState);
+    static constexpr std::chrono::milliseconds IdleTimeout()
+    {
+        return std::chrono::milliseconds{30000};
+    }
+
+    void Reset(State resetState, OClock now);
     void Fail(std::string failReason);
     bool IsValidDeltaTestDisconnectIfNot(const PacketDelta& delta);
     bool Disconnected(const std::vector<uint8_t>& packet);
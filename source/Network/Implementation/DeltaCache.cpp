@@ -0,0 +1,119 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef USING_PRECOMPILED_HEADERS
+#else
+#include "Common/PrecompiledHeaders.hpp"
+#endif
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <algorithm>
+#endif
+
+#include "Huffman.hpp"
+#include "DeltaCache.hpp"
+
+using namespace GameInABox::Network::Implementation;
+
+namespace
+{
+// FNV-1a, 64 bit. Doesn't need to be secure, just quick.
+// http://www.isthe.com/chongo/tech/comp/fnv/
+uint64_t HashPayload(const uint8_t* payload, std::size_t size)
+{
+    uint64_t result{14695981039346656037ull};
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        result ^= payload[i];
+        result *= 1099511628211ull;
+    }
+
+    return result;
+}
+}
+
+std::size_t DeltaCache::KeyHash::operator()(const Key& key) const
+{
+    return static_cast<std::size_t>(key.hash ^ (uint64_t(key.base) << 16) ^ key.to);
+}
+
+bool DeltaCache::KeyEqual::operator()(const Key& leftHandSide, const Key& rightHandSide) const
+{
+    return
+        (leftHandSide.base == rightHandSide.base) &&
+        (leftHandSide.to == rightHandSide.to) &&
+        (leftHandSide.hash == rightHandSide.hash);
+}
+
+DeltaCache::DeltaCache(const Huffman& compressor)
+    : myCompressor(&compressor)
+    , myCache()
+    , myMetrics{0, 0, Clock::duration::zero(), Clock::duration::zero()}
+{
+}
+
+const std::vector<uint8_t>& DeltaCache::Encode(const Delta& delta)
+{
+    return Encode(DeltaView{delta.base, delta.to, delta.deltaPayload.data(), delta.deltaPayload.size()});
+}
+
+const std::vector<uint8_t>& DeltaCache::Encode(const DeltaView& delta)
+{
+    auto key = Key{delta.base.Value(), delta.to.Value(), HashPayload(delta.payload, delta.size)};
+    auto found = myCache.find(key);
+
+    if (found != end(myCache))
+    {
+        auto& cached = found->second.payload;
+
+        if  (
+                (cached.size() == delta.size) &&
+                (std::equal(begin(cached), end(cached), delta.payload))
+            )
+        {
+            ++myMetrics.hits;
+            myMetrics.timeSaved += found->second.timeEncoding;
+
+            return found->second.compressed;
+        }
+
+        // Hash collision, newest wins.
+        myCache.erase(found);
+    }
+
+    auto start = Clock::now();
+    auto compressed = myCompressor->Encode(delta.payload, delta.size);
+    auto took = Clock::now() - start;
+
+    ++myMetrics.misses;
+    myMetrics.timeEncoding += took;
+
+    auto inserted = myCache.emplace(
+                key,
+                Entry{std::vector<uint8_t>(delta.payload, delta.payload + delta.size), std::move(compressed), took});
+
+    return inserted.first->second.compressed;
+}
+
+void DeltaCache::Clear()
+{
+    myCache.clear();
+}
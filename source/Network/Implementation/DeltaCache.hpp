@@ -0,0 +1,100 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef DELTACACHE_HPP
+#define DELTACACHE_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#endif
+
+#include "Units.hpp"
+#include "Delta.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+class Huffman;
+
+// Clients that are in sync tend to ask for the same (base, to) delta
+// in the same tick. Rather than Huffman encoding the same bytes for each
+// of them, encode it once and hand out copies until Clear() is called.
+// Only the compression is cached, the per connection xor and packet header
+// still need to be done by the caller.
+class DeltaCache
+{
+public:
+    struct Metrics
+    {
+        uint64_t hits;
+        uint64_t misses;
+
+        // Time spent encoding misses, and the time we would have spent
+        // encoding the hits if there was no cache.
+        Clock::duration timeEncoding;
+        Clock::duration timeSaved;
+    };
+
+    explicit DeltaCache(const Huffman& compressor);
+
+    // Returns the Huffman encoded deltaPayload. Only valid until the next
+    // call to Encode() or Clear().
+    const std::vector<uint8_t>& Encode(const Delta& delta);
+    const std::vector<uint8_t>& Encode(const DeltaView& delta);
+
+    // Call once per tick.
+    void Clear();
+
+    Metrics GetMetrics() const { return myMetrics; }
+
+private:
+    struct Key
+    {
+        uint16_t base;
+        uint16_t to;
+        uint64_t hash;
+    };
+
+    struct KeyHash
+    {
+        std::size_t operator()(const Key& key) const;
+    };
+
+    struct KeyEqual
+    {
+        bool operator()(const Key& leftHandSide, const Key& rightHandSide) const;
+    };
+
+    struct Entry
+    {
+        // Keep the source so a hash collision doesn't send the wrong delta.
+        std::vector<uint8_t> payload;
+        std::vector<uint8_t> compressed;
+        Clock::duration timeEncoding;
+    };
+
+    const Huffman* myCompressor;
+    std::unordered_map<Key, Entry, KeyHash, KeyEqual> myCache;
+    Metrics myMetrics;
+};
+
+}}} // namespace
+
+#endif // DELTACACHE_HPP
@@ -0,0 +1,78 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <cstddef>
+#else
+#include "Common/PrecompiledHeaders.hpp"
+#endif
+
+// Not in the precompiled headers, as it's x86 only.
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "DeltaFieldCoder.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+void ChangedBytesScalar(
+        const uint8_t* base,
+        const uint8_t* current,
+        std::size_t size,
+        uint64_t* changed)
+{
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        changed[i / 64] |= uint64_t(base[i] != current[i]) << (i % 64);
+    }
+}
+
+void ChangedBytes(
+        const uint8_t* base,
+        const uint8_t* current,
+        std::size_t size,
+        uint64_t* changed)
+{
+    std::size_t done = 0;
+
+#ifdef __SSE2__
+    // 16 bytes at a time, 16 divides 64 so a chunk never straddles words.
+    // Every x86_64 has SSE2. AVX2 would only help structs over 32 bytes,
+    // and needs a runtime check, so not bothering until something says so.
+    for (; (done + 16) <= size; done += 16)
+    {
+        auto left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(base + done));
+        auto right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current + done));
+        auto same = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(left, right)));
+
+        changed[done / 64] |= uint64_t(~same & 0xFFFF) << (done % 64);
+    }
+#endif
+
+    // Whatever's left (or everything, without SSE2).
+    for (; done < size; ++done)
+    {
+        changed[done / 64] |= uint64_t(base[done] != current[done]) << (done % 64);
+    }
+}
+
+}}} // namespace
@@ -0,0 +1,509 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef DELTAFIELDCODER_HPP
+#define DELTAFIELDCODER_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <type_traits>
+#endif
+
+#include "BitStream.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+// Delta codes a struct field by field, like Unused/DeltaCoder, except the
+// field layout is part of the type:
+//
+//  typedef DeltaFieldCoder<
+//      Player,
+//      DELTA_FIELD(Player, health),
+//      DELTA_FIELD_BITS(Player, flags, 12),
+//      DELTA_FIELD(Player, x)> PlayerCoder;
+//
+// Fields are reached through member pointers, so there are no unaligned
+// casts and no name strings, and encode/decode are a fixed sequence of
+// inline calls the compiler can flatten.
+//
+// Wire format per field, in declaration order:
+//  1 bit:  1 == same as base.
+//  N bits: the new value (only if changed).
+// Unsigned fields can be sent with fewer bits than their type, the top bits
+// are lost. Signed and floating point fields are always sent in full.
+//
+// DeltaEncodeMasked() is the same size on the wire but puts all the
+// "changed" bits first as one block (1 == changed this time), followed by
+// only the changed values. The mask comes from comparing the whole struct
+// at once (see ChangedBytes()), which is a lot quicker when most fields of
+// most entities don't change.
+
+// How a field's type maps to raw bits.
+template<typename TYPE, typename ENABLE = void>
+struct FieldBits
+{
+    // Not a supported field type (bool, enum, struct...).
+    static_assert(sizeof(TYPE) == 0, "DeltaFieldCoder: unsupported field type.");
+};
+
+template<typename TYPE>
+struct FieldBits<TYPE, typename std::enable_if<
+        std::is_integral<TYPE>::value &&
+        !std::is_same<TYPE, bool>::value>::type>
+{
+    typedef typename std::conditional<(sizeof(TYPE) > 4), uint64_t, uint32_t>::type Storage;
+    typedef typename std::make_unsigned<TYPE>::type Unsigned;
+
+    static const unsigned Width = sizeof(TYPE) * 8;
+    static const bool Truncatable = std::is_unsigned<TYPE>::value;
+
+    static Storage To(TYPE value)
+    {
+        return static_cast<Storage>(static_cast<Unsigned>(value));
+    }
+
+    static TYPE From(Storage bits)
+    {
+        return static_cast<TYPE>(static_cast<Unsigned>(bits));
+    }
+};
+
+template<typename TYPE>
+struct FieldBits<TYPE, typename std::enable_if<std::is_floating_point<TYPE>::value>::type>
+{
+    static_assert((sizeof(TYPE) == 4) || (sizeof(TYPE) == 8), "DeltaFieldCoder: only float and double.");
+
+    typedef typename std::conditional<(sizeof(TYPE) > 4), uint64_t, uint32_t>::type Storage;
+
+    static const unsigned Width = sizeof(TYPE) * 8;
+    static const bool Truncatable = false;
+
+    // Bit pattern, so -0.0 and NaN survive and compare properly.
+    static Storage To(TYPE value)
+    {
+        Storage result;
+        std::memcpy(&result, &value, sizeof(result));
+        return result;
+    }
+
+    static TYPE From(Storage bits)
+    {
+        TYPE result;
+        std::memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+};
+
+inline void PushFieldBits(BitStream& out, uint32_t bits, unsigned count)
+{
+    out.Push(bits, static_cast<uint8_t>(count));
+}
+
+inline void PushFieldBits(BitStream& out, uint64_t bits, unsigned count)
+{
+    // BitStream only goes up to 32 bits, top half first.
+    if (count > 32)
+    {
+        out.Push(static_cast<uint32_t>(bits >> 32), static_cast<uint8_t>(count - 32));
+        out.Push(static_cast<uint32_t>(bits), 32);
+    }
+    else
+    {
+        out.Push(static_cast<uint32_t>(bits), static_cast<uint8_t>(count));
+    }
+}
+
+inline void PullFieldBits(BitStreamReadOnly& in, uint32_t& bits, unsigned count)
+{
+    bits = in.PullU32(static_cast<uint8_t>(count));
+}
+
+inline void PullFieldBits(BitStreamReadOnly& in, uint64_t& bits, unsigned count)
+{
+    if (count > 32)
+    {
+        bits = static_cast<uint64_t>(in.PullU32(static_cast<uint8_t>(count - 32))) << 32;
+        bits |= in.PullU32(32);
+    }
+    else
+    {
+        bits = in.PullU32(static_cast<uint8_t>(count));
+    }
+}
+
+// Sets bit i of changed if base[i] != current[i]. changed needs to be
+// zeroed, and have (size + 63) / 64 words. SSE2 when the compiler has it.
+void ChangedBytes(
+        const uint8_t* base,
+        const uint8_t* current,
+        std::size_t size,
+        uint64_t* changed);
+
+// Same, always a byte at a time. For testing ChangedBytes().
+void ChangedBytesScalar(
+        const uint8_t* base,
+        const uint8_t* current,
+        std::size_t size,
+        uint64_t* changed);
+
+// Where a field lives in the ChangedBytes() bitmap. Fields are at most
+// 64 bytes (MemberBytes() checks), so they touch at most two words.
+struct FieldBytes
+{
+    std::size_t word;
+    uint64_t low;
+    uint64_t high;
+};
+
+inline FieldBytes FieldBytesFor(std::size_t offset, std::size_t size)
+{
+    uint64_t bits = (size >= 64) ? ~uint64_t(0) : ((uint64_t(1) << size) - 1);
+    std::size_t shift = offset % 64;
+
+    return FieldBytes{
+        offset / 64,
+        bits << shift,
+        ((shift + size) > 64) ? (bits >> (64 - shift)) : 0};
+}
+
+// What every field encoding has in common. FIELD provides:
+//  static constexpr unsigned SentBits();   worst case, not counting the changed bit.
+//  static bool Same(base, current);        would the receiver see the same value?
+//  static void Push(base, current, out);
+//  static void Pull(base, result, in);
+//  static void Copy(base, result);
+//  static FieldBytes Bytes(object);
+template<typename FIELD, typename OBJECT>
+struct DeltaFieldEncoding
+{
+    static constexpr unsigned MaximumBits()
+    {
+        return FIELD::SentBits() + 1;
+    }
+
+    // Returns true if unchanged.
+    static bool Encode(const OBJECT& base, const OBJECT& current, BitStream& out)
+    {
+        if (FIELD::Same(base, current))
+        {
+            out.Push(true);
+            return true;
+        }
+
+        out.Push(false);
+        FIELD::Push(base, current, out);
+
+        return false;
+    }
+
+    static void Decode(const OBJECT& base, OBJECT& result, BitStreamReadOnly& in)
+    {
+        if (in.Pull1Bit())
+        {
+            FIELD::Copy(base, result);
+        }
+        else
+        {
+            FIELD::Pull(base, result, in);
+        }
+    }
+};
+
+// Byte offset and size of a member.
+template<typename OBJECT, typename TYPE>
+FieldBytes MemberBytes(const OBJECT& object, const TYPE OBJECT::*member)
+{
+    static_assert(sizeof(TYPE) <= 64, "DeltaFieldCoder: fields can't be bigger than 64 bytes.");
+
+    auto start = reinterpret_cast<const uint8_t*>(&object);
+    auto field = reinterpret_cast<const uint8_t*>(&(object.*member));
+
+    return FieldBytesFor(static_cast<std::size_t>(field - start), sizeof(TYPE));
+}
+
+// One field. Use DELTA_FIELD() or DELTA_FIELD_BITS() rather than spelling it out.
+template<
+        typename OBJECT,
+        typename TYPE,
+        TYPE OBJECT::*MEMBER,
+        unsigned BITS = FieldBits<TYPE>::Width>
+struct DeltaField : DeltaFieldEncoding<DeltaField<OBJECT, TYPE, MEMBER, BITS>, OBJECT>
+{
+    typedef FieldBits<TYPE> Bits;
+    typedef typename Bits::Storage Storage;
+
+    static_assert(BITS > 0, "DeltaFieldCoder: a field needs at least one bit.");
+    static_assert(BITS <= Bits::Width, "DeltaFieldCoder: more bits than the field has.");
+    static_assert(
+            Bits::Truncatable || (BITS == Bits::Width),
+            "DeltaFieldCoder: only unsigned fields can be sent with fewer bits.");
+
+    static constexpr unsigned SentBits()
+    {
+        return BITS;
+    }
+
+    static bool Same(const OBJECT& base, const OBJECT& current)
+    {
+        return Bits::To(base.*MEMBER) == Bits::To(current.*MEMBER);
+    }
+
+    static void Copy(const OBJECT& base, OBJECT& result)
+    {
+        result.*MEMBER = base.*MEMBER;
+    }
+
+    static void Push(const OBJECT&, const OBJECT& current, BitStream& out)
+    {
+        PushFieldBits(out, Bits::To(current.*MEMBER), BITS);
+    }
+
+    static void Pull(const OBJECT&, OBJECT& result, BitStreamReadOnly& in)
+    {
+        Storage bits;
+        PullFieldBits(in, bits, BITS);
+        result.*MEMBER = Bits::From(bits);
+    }
+
+    static FieldBytes Bytes(const OBJECT& object)
+    {
+        return MemberBytes(object, MEMBER);
+    }
+};
+
+#define DELTA_FIELD(CLASS_TYPE, CLASS_MEMBER) \
+    ::GameInABox::Network::Implementation::DeltaField< \
+        CLASS_TYPE, decltype(CLASS_TYPE::CLASS_MEMBER), &CLASS_TYPE::CLASS_MEMBER>
+
+#define DELTA_FIELD_BITS(CLASS_TYPE, CLASS_MEMBER, NUMBER_OFBITS) \
+    ::GameInABox::Network::Implementation::DeltaField< \
+        CLASS_TYPE, decltype(CLASS_TYPE::CLASS_MEMBER), &CLASS_TYPE::CLASS_MEMBER, NUMBER_OFBITS>
+
+// Walks the field list at compile time.
+template<typename OBJECT, typename... FIELDS>
+struct DeltaFields;
+
+template<typename OBJECT>
+struct DeltaFields<OBJECT>
+{
+    static constexpr unsigned MaximumBits() { return 0; }
+
+    static bool Encode(const OBJECT&, const OBJECT&, BitStream&) { return true; }
+    static void Decode(const OBJECT&, OBJECT&, BitStreamReadOnly&) {}
+
+    static void Layout(const OBJECT&, FieldBytes*) {}
+    static void EncodeChanged(const OBJECT&, const OBJECT&, uint64_t, BitStream&) {}
+    static void DecodeChanged(const OBJECT&, OBJECT&, uint64_t, BitStreamReadOnly&) {}
+};
+
+template<typename OBJECT, typename FIELD, typename... REST>
+struct DeltaFields<OBJECT, FIELD, REST...>
+{
+    static constexpr unsigned MaximumBits()
+    {
+        return FIELD::MaximumBits() + DeltaFields<OBJECT, REST...>::MaximumBits();
+    }
+
+    static bool Encode(const OBJECT& base, const OBJECT& current, BitStream& out)
+    {
+        // Field order matters, so don't let && short circuit.
+        bool same = FIELD::Encode(base, current, out);
+        bool restSame = DeltaFields<OBJECT, REST...>::Encode(base, current, out);
+
+        return same && restSame;
+    }
+
+    static void Decode(const OBJECT& base, OBJECT& result, BitStreamReadOnly& in)
+    {
+        FIELD::Decode(base, result, in);
+        DeltaFields<OBJECT, REST...>::Decode(base, result, in);
+    }
+
+    static void Layout(const OBJECT& object, FieldBytes* fields)
+    {
+        *fields = FIELD::Bytes(object);
+        DeltaFields<OBJECT, REST...>::Layout(object, fields + 1);
+    }
+
+    // Bit 0 of changed is this field.
+    static void EncodeChanged(
+            const OBJECT& base,
+            const OBJECT& current,
+            uint64_t changed,
+            BitStream& out)
+    {
+        if (changed & 1)
+        {
+            FIELD::Push(base, current, out);
+        }
+
+        DeltaFields<OBJECT, REST...>::EncodeChanged(base, current, changed >> 1, out);
+    }
+
+    static void DecodeChanged(
+            const OBJECT& base,
+            OBJECT& result,
+            uint64_t changed,
+            BitStreamReadOnly& in)
+    {
+        if (changed & 1)
+        {
+            FIELD::Pull(base, result, in);
+        }
+        else
+        {
+            FIELD::Copy(base, result);
+        }
+
+        DeltaFields<OBJECT, REST...>::DecodeChanged(base, result, changed >> 1, in);
+    }
+};
+
+template<typename OBJECT, typename... FIELDS>
+class DeltaFieldCoder
+{
+public:
+    static_assert(
+            std::is_standard_layout<OBJECT>::value,
+            "DeltaFieldCoder: OBJECT has to be a plain struct.");
+
+    explicit DeltaFieldCoder(OBJECT identity)
+        : myIdentity(identity)
+        , myFields()
+    {
+        DeltaFields<OBJECT, FIELDS...>::Layout(myIdentity, myFields.data());
+    }
+
+    static constexpr std::size_t FieldCount()
+    {
+        return sizeof...(FIELDS);
+    }
+
+    // Worst case, every field changed.
+    static constexpr unsigned MaximumBits()
+    {
+        return DeltaFields<OBJECT, FIELDS...>::MaximumBits();
+    }
+
+    // if base == nullptr use the identity
+    // Returns true if base == toDelta, otherwise false.
+    bool DeltaEncode(
+            const OBJECT* base,
+            const OBJECT& toDelta,
+            BitStream& dataOut) const
+    {
+        return DeltaFields<OBJECT, FIELDS...>::Encode(
+                base ? *base : myIdentity,
+                toDelta,
+                dataOut);
+    }
+
+    // if base == nullptr use the identity
+    void DeltaDecode(
+            const OBJECT* base,
+            OBJECT& result,
+            BitStreamReadOnly& dataIn) const
+    {
+        DeltaFields<OBJECT, FIELDS...>::Decode(
+                base ? *base : myIdentity,
+                result,
+                dataIn);
+    }
+
+    // Bit i set if field i differs.
+    uint64_t ChangedFields(const OBJECT& base, const OBJECT& current) const
+    {
+        static_assert(sizeof...(FIELDS) <= 64, "DeltaFieldCoder: masks only go up to 64 fields.");
+
+        // One spare word so a field in the last word can always look at the next.
+        std::array<uint64_t, ((sizeof(OBJECT) + 63) / 64) + 1> bytes{};
+
+        ChangedBytes(
+                reinterpret_cast<const uint8_t*>(&base),
+                reinterpret_cast<const uint8_t*>(&current),
+                sizeof(OBJECT),
+                bytes.data());
+
+        uint64_t any = 0;
+
+        for (auto word : bytes)
+        {
+            any |= word;
+        }
+
+        // The usual case, nothing moved.
+        if (!any)
+        {
+            return 0;
+        }
+
+        uint64_t result = 0;
+
+        for (std::size_t i = 0; i < myFields.size(); ++i)
+        {
+            const auto& field = myFields[i];
+            auto touched = (bytes[field.word] & field.low) | (bytes[field.word + 1] & field.high);
+
+            result |= uint64_t(touched != 0) << i;
+        }
+
+        return result;
+    }
+
+    // See the comment at the top. Returns true if base == toDelta.
+    bool DeltaEncodeMasked(
+            const OBJECT* base,
+            const OBJECT& toDelta,
+            BitStream& dataOut) const
+    {
+        const auto& from = base ? *base : myIdentity;
+        auto changed = ChangedFields(from, toDelta);
+
+        PushFieldBits(dataOut, changed, FieldCount());
+        DeltaFields<OBJECT, FIELDS...>::EncodeChanged(from, toDelta, changed, dataOut);
+
+        return changed == 0;
+    }
+
+    void DeltaDecodeMasked(
+            const OBJECT* base,
+            OBJECT& result,
+            BitStreamReadOnly& dataIn) const
+    {
+        uint64_t changed;
+
+        PullFieldBits(dataIn, changed, FieldCount());
+        DeltaFields<OBJECT, FIELDS...>::DecodeChanged(
+                base ? *base : myIdentity,
+                result,
+                changed,
+                dataIn);
+    }
+
+private:
+    OBJECT myIdentity;
+    std::array<FieldBytes, sizeof...(FIELDS)> myFields;
+};
+
+}}} // namespace
+
+#endif // DELTAFIELDCODER_HPP
@@ -0,0 +1,202 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cmath>
+#include <algorithm>
+#else
+#include "Common/PrecompiledHeaders.hpp"
+#endif
+
+#include "DeltaFieldQuantised.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+namespace
+{
+const float SquareRootHalf = 0.70710678118654752f;
+
+uint32_t MaximumFor(unsigned bits)
+{
+    return (uint32_t(1) << bits) - 1;
+}
+
+// [-1, 1] -> [0, 2^bits - 1]
+uint32_t QuantiseUnit(float value, unsigned bits)
+{
+    auto maximum = MaximumFor(bits);
+    auto scaled = std::lround(((std::max(-1.0f, std::min(1.0f, value)) + 1.0f) * 0.5f) * maximum);
+
+    return static_cast<uint32_t>(std::max(0L, std::min(static_cast<long>(maximum), scaled)));
+}
+
+float DequantiseUnit(uint32_t value, unsigned bits)
+{
+    return ((float(value) / MaximumFor(bits)) * 2.0f) - 1.0f;
+}
+
+float SignNotZero(float value)
+{
+    return (value < 0.0f) ? -1.0f : 1.0f;
+}
+}
+
+uint64_t QuantiseQuaternion(const float* quaternion, unsigned bits)
+{
+    float q[4] = {quaternion[0], quaternion[1], quaternion[2], quaternion[3]};
+    float length = std::sqrt((q[0] * q[0]) + (q[1] * q[1]) + (q[2] * q[2]) + (q[3] * q[3]));
+
+    if (!(length > 0.0f) || std::isinf(length))
+    {
+        q[0] = q[1] = q[2] = 0.0f;
+        q[3] = 1.0f;
+        length = 1.0f;
+    }
+
+    unsigned largest = 0;
+
+    for (unsigned i = 1; i < 4; ++i)
+    {
+        if (std::fabs(q[i]) > std::fabs(q[largest]))
+        {
+            largest = i;
+        }
+    }
+
+    // q and -q are the same rotation, so make the one we drop positive.
+    float scale = SignNotZero(q[largest]) / length;
+    uint64_t result = largest;
+
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        if (i != largest)
+        {
+            // The rest are at most 1/sqrt(2).
+            result = (result << bits) | QuantiseUnit((q[i] * scale) / SquareRootHalf, bits);
+        }
+    }
+
+    return result;
+}
+
+void DequantiseQuaternion(uint64_t packed, unsigned bits, float* quaternion)
+{
+    unsigned largest = static_cast<unsigned>(packed >> (3 * bits)) & 3;
+    float sum = 0.0f;
+
+    for (int i = 3; i >= 0; --i)
+    {
+        if (static_cast<unsigned>(i) != largest)
+        {
+            auto value = DequantiseUnit(static_cast<uint32_t>(packed & MaximumFor(bits)), bits) * SquareRootHalf;
+
+            quaternion[i] = value;
+            sum += value * value;
+            packed >>= bits;
+        }
+    }
+
+    quaternion[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+}
+
+uint64_t QuantiseNormal(const float* normal, unsigned bits)
+{
+    float x = normal[0];
+    float y = normal[1];
+    float z = normal[2];
+    float length = std::fabs(x) + std::fabs(y) + std::fabs(z);
+
+    if (!(length > 0.0f) || std::isinf(length))
+    {
+        x = y = 0.0f;
+        z = 1.0f;
+        length = 1.0f;
+    }
+
+    // Onto the octahedron, then fold the bottom half over the top.
+    x /= length;
+    y /= length;
+
+    if (z < 0.0f)
+    {
+        float foldedX = (1.0f - std::fabs(y)) * SignNotZero(x);
+        float foldedY = (1.0f - std::fabs(x)) * SignNotZero(y);
+
+        x = foldedX;
+        y = foldedY;
+    }
+
+    return (uint64_t(QuantiseUnit(x, bits)) << bits) | QuantiseUnit(y, bits);
+}
+
+void DequantiseNormal(uint64_t packed, unsigned bits, float* normal)
+{
+    float x = DequantiseUnit(static_cast<uint32_t>(packed >> bits) & MaximumFor(bits), bits);
+    float y = DequantiseUnit(static_cast<uint32_t>(packed) & MaximumFor(bits), bits);
+    float z = 1.0f - std::fabs(x) - std::fabs(y);
+
+    if (z < 0.0f)
+    {
+        float unfoldedX = (1.0f - std::fabs(y)) * SignNotZero(x);
+        float unfoldedY = (1.0f - std::fabs(x)) * SignNotZero(y);
+
+        x = unfoldedX;
+        y = unfoldedY;
+    }
+
+    float length = std::sqrt((x * x) + (y * y) + (z * z));
+
+    normal[0] = x / length;
+    normal[1] = y / length;
+    normal[2] = z / length;
+}
+
+void PushVarint(BitStream& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.Push(static_cast<uint8_t>((value & 0x7F) | 0x80), 8);
+        value >>= 7;
+    }
+
+    out.Push(static_cast<uint8_t>(value), 8);
+}
+
+uint64_t PullVarint(BitStreamReadOnly& in)
+{
+    uint64_t result = 0;
+
+    // At most 10 bytes, ignore anything past that.
+    for (unsigned shift = 0; shift < 70; shift += 7)
+    {
+        auto byte = in.PullU8(8);
+
+        result |= uint64_t(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80))
+        {
+            break;
+        }
+    }
+
+    return result;
+}
+
+}}} // namespace
@@ -0,0 +1,308 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef DELTAFIELDQUANTISED_HPP
+#define DELTAFIELDQUANTISED_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <cmath>
+#include <type_traits>
+#endif
+
+#include "DeltaFieldCoder.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+// Field encodings for DeltaFieldCoder that don't send the raw bits:
+//
+//  DELTA_FIELD_FIXED(Class, x, -4096, 4096, 8)
+//      float, fixed point between -4096 and 4096 to 1/8th of a unit (17 bits).
+//  DELTA_FIELD_QUATERNION(Class, rotation, 10)
+//      float[4] (x, y, z, w), smallest three, 10 bits a component (32 bits).
+//  DELTA_FIELD_NORMAL(Class, facing, 11)
+//      float[3] unit vector, octahedral, 11 bits a component (22 bits).
+//  DELTA_FIELD_VARINT(Class, score)
+//      any integer, the difference from base zig-zagged into a varint.
+//
+// The lossy ones count as unchanged if they'd quantise to the same value,
+// so noise smaller than the precision costs one bit. The receiver ends up
+// with the quantised value. For fixed point, quantising that again gives
+// the same bits. Quaternions and normals can land on a neighbouring value
+// instead, which is still within the precision so doesn't drift.
+
+// Smallest three: which component was largest (2 bits), then the other
+// three in [-1/sqrt(2), 1/sqrt(2)] with bits each. The quaternion doesn't
+// have to be normalised, zero length sends the identity.
+uint64_t QuantiseQuaternion(const float* quaternion, unsigned bits);
+void DequantiseQuaternion(uint64_t packed, unsigned bits, float* quaternion);
+
+// Octahedral, x then y with bits each. Zero length sends +z.
+uint64_t QuantiseNormal(const float* normal, unsigned bits);
+void DequantiseNormal(uint64_t packed, unsigned bits, float* normal);
+
+// 7 bits a byte, low bits first, top bit set if there's more.
+void PushVarint(BitStream& out, uint64_t value);
+uint64_t PullVarint(BitStreamReadOnly& in);
+
+inline uint64_t ZigZag(int64_t value)
+{
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t UnZigZag(uint64_t value)
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+constexpr unsigned BitsToHold(uint64_t value)
+{
+    return value ? (1 + BitsToHold(value >> 1)) : 0;
+}
+
+template<typename OBJECT, float OBJECT::*MEMBER, int MINIMUM, int MAXIMUM, unsigned PER_UNIT>
+struct DeltaFieldFixed : DeltaFieldEncoding<DeltaFieldFixed<OBJECT, MEMBER, MINIMUM, MAXIMUM, PER_UNIT>, OBJECT>
+{
+    static_assert(MAXIMUM > MINIMUM, "DELTA_FIELD_FIXED: maximum has to be more than minimum.");
+    static_assert(PER_UNIT > 0, "DELTA_FIELD_FIXED: needs at least one step per unit.");
+
+    // Keeps the float round trip exact, see the comment at the top.
+    static_assert(
+            ((uint64_t(MAXIMUM > 0 ? MAXIMUM : -MAXIMUM) * PER_UNIT) <= (uint64_t(1) << 22)) &&
+            ((uint64_t(MINIMUM > 0 ? MINIMUM : -MINIMUM) * PER_UNIT) <= (uint64_t(1) << 22)),
+            "DELTA_FIELD_FIXED: too precise for a float.");
+
+    static constexpr uint32_t Steps()
+    {
+        return static_cast<uint32_t>(uint64_t(MAXIMUM - MINIMUM) * PER_UNIT);
+    }
+
+    static constexpr unsigned SentBits()
+    {
+        return BitsToHold(Steps());
+    }
+
+    // Clamped, NaN goes to the minimum.
+    static uint32_t Quantise(float value)
+    {
+        double scaled = (double(value) - MINIMUM) * PER_UNIT;
+
+        if (!(scaled > 0.0))
+        {
+            return 0;
+        }
+
+        if (scaled >= Steps())
+        {
+            return Steps();
+        }
+
+        return static_cast<uint32_t>(std::lround(scaled));
+    }
+
+    static float Dequantise(uint32_t steps)
+    {
+        return static_cast<float>(MINIMUM + (double(steps) / PER_UNIT));
+    }
+
+    static bool Same(const OBJECT& base, const OBJECT& current)
+    {
+        return Quantise(base.*MEMBER) == Quantise(current.*MEMBER);
+    }
+
+    static void Copy(const OBJECT& base, OBJECT& result)
+    {
+        result.*MEMBER = base.*MEMBER;
+    }
+
+    static void Push(const OBJECT&, const OBJECT& current, BitStream& out)
+    {
+        PushFieldBits(out, Quantise(current.*MEMBER), SentBits());
+    }
+
+    static void Pull(const OBJECT&, OBJECT& result, BitStreamReadOnly& in)
+    {
+        uint32_t steps;
+        PullFieldBits(in, steps, SentBits());
+        result.*MEMBER = Dequantise(steps);
+    }
+
+    static FieldBytes Bytes(const OBJECT& object)
+    {
+        return MemberBytes(object, MEMBER);
+    }
+};
+
+template<typename OBJECT, typename TYPE, TYPE OBJECT::*MEMBER, unsigned BITS>
+struct DeltaFieldQuaternion : DeltaFieldEncoding<DeltaFieldQuaternion<OBJECT, TYPE, MEMBER, BITS>, OBJECT>
+{
+    static_assert(
+            std::is_same<TYPE, float[4]>::value,
+            "DELTA_FIELD_QUATERNION: needs a float[4].");
+    static_assert((BITS >= 2) && (BITS <= 20), "DELTA_FIELD_QUATERNION: between 2 and 20 bits.");
+
+    static constexpr unsigned SentBits()
+    {
+        return 2 + (3 * BITS);
+    }
+
+    static bool Same(const OBJECT& base, const OBJECT& current)
+    {
+        return QuantiseQuaternion(base.*MEMBER, BITS) == QuantiseQuaternion(current.*MEMBER, BITS);
+    }
+
+    static void Copy(const OBJECT& base, OBJECT& result)
+    {
+        for (unsigned i = 0; i < 4; ++i)
+        {
+            (result.*MEMBER)[i] = (base.*MEMBER)[i];
+        }
+    }
+
+    static void Push(const OBJECT&, const OBJECT& current, BitStream& out)
+    {
+        PushFieldBits(out, QuantiseQuaternion(current.*MEMBER, BITS), SentBits());
+    }
+
+    static void Pull(const OBJECT&, OBJECT& result, BitStreamReadOnly& in)
+    {
+        uint64_t packed;
+        PullFieldBits(in, packed, SentBits());
+        DequantiseQuaternion(packed, BITS, result.*MEMBER);
+    }
+
+    static FieldBytes Bytes(const OBJECT& object)
+    {
+        return MemberBytes(object, MEMBER);
+    }
+};
+
+template<typename OBJECT, typename TYPE, TYPE OBJECT::*MEMBER, unsigned BITS>
+struct DeltaFieldNormal : DeltaFieldEncoding<DeltaFieldNormal<OBJECT, TYPE, MEMBER, BITS>, OBJECT>
+{
+    static_assert(
+            std::is_same<TYPE, float[3]>::value,
+            "DELTA_FIELD_NORMAL: needs a float[3].");
+    static_assert((BITS >= 2) && (BITS <= 30), "DELTA_FIELD_NORMAL: between 2 and 30 bits.");
+
+    static constexpr unsigned SentBits()
+    {
+        return 2 * BITS;
+    }
+
+    static bool Same(const OBJECT& base, const OBJECT& current)
+    {
+        return QuantiseNormal(base.*MEMBER, BITS) == QuantiseNormal(current.*MEMBER, BITS);
+    }
+
+    static void Copy(const OBJECT& base, OBJECT& result)
+    {
+        for (unsigned i = 0; i < 3; ++i)
+        {
+            (result.*MEMBER)[i] = (base.*MEMBER)[i];
+        }
+    }
+
+    static void Push(const OBJECT&, const OBJECT& current, BitStream& out)
+    {
+        PushFieldBits(out, QuantiseNormal(current.*MEMBER, BITS), SentBits());
+    }
+
+    static void Pull(const OBJECT&, OBJECT& result, BitStreamReadOnly& in)
+    {
+        uint64_t packed;
+        PullFieldBits(in, packed, SentBits());
+        DequantiseNormal(packed, BITS, result.*MEMBER);
+    }
+
+    static FieldBytes Bytes(const OBJECT& object)
+    {
+        return MemberBytes(object, MEMBER);
+    }
+};
+
+template<typename OBJECT, typename TYPE, TYPE OBJECT::*MEMBER>
+struct DeltaFieldVarint : DeltaFieldEncoding<DeltaFieldVarint<OBJECT, TYPE, MEMBER>, OBJECT>
+{
+    static_assert(
+            std::is_integral<TYPE>::value && !std::is_same<TYPE, bool>::value,
+            "DELTA_FIELD_VARINT: needs an integer.");
+
+    typedef typename std::make_unsigned<TYPE>::type Unsigned;
+    typedef typename std::make_signed<TYPE>::type Signed;
+
+    // A zig-zagged difference is no wider than the type.
+    static constexpr unsigned SentBits()
+    {
+        return ((sizeof(TYPE) * 8 + 6) / 7) * 8;
+    }
+
+    static bool Same(const OBJECT& base, const OBJECT& current)
+    {
+        return base.*MEMBER == current.*MEMBER;
+    }
+
+    static void Copy(const OBJECT& base, OBJECT& result)
+    {
+        result.*MEMBER = base.*MEMBER;
+    }
+
+    // Wraps, so the difference always fits in the type.
+    static void Push(const OBJECT& base, const OBJECT& current, BitStream& out)
+    {
+        auto difference = static_cast<Unsigned>(
+                static_cast<Unsigned>(current.*MEMBER) - static_cast<Unsigned>(base.*MEMBER));
+
+        PushVarint(out, ZigZag(static_cast<Signed>(difference)));
+    }
+
+    static void Pull(const OBJECT& base, OBJECT& result, BitStreamReadOnly& in)
+    {
+        auto difference = static_cast<Unsigned>(UnZigZag(PullVarint(in)));
+
+        result.*MEMBER = static_cast<TYPE>(
+                static_cast<Unsigned>(static_cast<Unsigned>(base.*MEMBER) + difference));
+    }
+
+    static FieldBytes Bytes(const OBJECT& object)
+    {
+        return MemberBytes(object, MEMBER);
+    }
+};
+
+#define DELTA_FIELD_FIXED(CLASS_TYPE, CLASS_MEMBER, MINIMUM, MAXIMUM, PER_UNIT) \
+    ::GameInABox::Network::Implementation::DeltaFieldFixed< \
+        CLASS_TYPE, &CLASS_TYPE::CLASS_MEMBER, MINIMUM, MAXIMUM, PER_UNIT>
+
+#define DELTA_FIELD_QUATERNION(CLASS_TYPE, CLASS_MEMBER, NUMBER_OFBITS) \
+    ::GameInABox::Network::Implementation::DeltaFieldQuaternion< \
+        CLASS_TYPE, decltype(CLASS_TYPE::CLASS_MEMBER), &CLASS_TYPE::CLASS_MEMBER, NUMBER_OFBITS>
+
+#define DELTA_FIELD_NORMAL(CLASS_TYPE, CLASS_MEMBER, NUMBER_OFBITS) \
+    ::GameInABox::Network::Implementation::DeltaFieldNormal< \
+        CLASS_TYPE, decltype(CLASS_TYPE::CLASS_MEMBER), &CLASS_TYPE::CLASS_MEMBER, NUMBER_OFBITS>
+
+#define DELTA_FIELD_VARINT(CLASS_TYPE, CLASS_MEMBER) \
+    ::GameInABox::Network::Implementation::DeltaFieldVarint< \
+        CLASS_TYPE, decltype(CLASS_TYPE::CLASS_MEMBER), &CLASS_TYPE::CLASS_MEMBER>
+
+}}} // namespace
+
+#endif // DELTAFIELDQUANTISED_HPP
@@ -0,0 +1,317 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef DELTATABLE_HPP
+#define DELTATABLE_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <vector>
+#include <tuple>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#endif
+
+#include "DeltaFieldCoder.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+// A column of a DeltaTable, BITS works like DELTA_FIELD_BITS().
+template<typename TYPE, unsigned BITS = FieldBits<TYPE>::Width>
+struct DeltaColumn
+{
+    typedef TYPE Type;
+    typedef FieldBits<TYPE> Bits;
+
+    static_assert(BITS > 0, "DeltaTable: a column needs at least one bit.");
+    static_assert(BITS <= Bits::Width, "DeltaTable: more bits than the column has.");
+    static_assert(
+            Bits::Truncatable || (BITS == Bits::Width),
+            "DeltaTable: only unsigned columns can be sent with fewer bits.");
+
+    static constexpr unsigned SentBits()
+    {
+        return BITS;
+    }
+};
+
+// The rows of one DeltaTable column. Values can be changed, but not how
+// many there are, use DeltaTable::Resize() for that.
+template<typename TYPE>
+class DeltaColumnRows
+{
+public:
+    typedef typename std::remove_const<TYPE>::type value_type;
+    typedef TYPE* iterator;
+    typedef const TYPE* const_iterator;
+
+    DeltaColumnRows(TYPE* rows, std::size_t size)
+        : myRows(rows)
+        , mySize(size)
+    {
+    }
+
+    TYPE* data() const { return myRows; }
+    std::size_t size() const { return mySize; }
+
+    TYPE& operator[](std::size_t row) const { return myRows[row]; }
+
+    TYPE* begin() const { return myRows; }
+    TYPE* end() const { return myRows + mySize; }
+
+private:
+    TYPE* myRows;
+    std::size_t mySize;
+};
+
+template<typename TYPE>
+bool operator==(const DeltaColumnRows<TYPE>& leftHandSide, const DeltaColumnRows<TYPE>& rightHandSide)
+{
+    return
+        (leftHandSide.size() == rightHandSide.size()) &&
+        std::equal(leftHandSide.begin(), leftHandSide.end(), rightHandSide.begin());
+}
+
+// Entities stored as structure of arrays, one std::vector per field.
+// Row i of every column is entity i.
+//
+//  typedef DeltaTable<
+//      DeltaColumn<float>,
+//      DeltaColumn<float>,
+//      DeltaColumn<uint32_t, 10>> Positions;
+//
+//  positions.Column<0>()[entity] = x;
+template<typename... COLUMNS>
+class DeltaTable
+{
+public:
+    static_assert(sizeof...(COLUMNS) <= 64, "DeltaTable: masks only go up to 64 columns.");
+
+    typedef std::tuple<std::vector<typename COLUMNS::Type>...> Storage;
+
+    explicit DeltaTable(std::size_t rows = 0)
+        : myRows(0)
+        , myColumns()
+    {
+        Resize(rows);
+    }
+
+    static constexpr std::size_t ColumnCount()
+    {
+        return sizeof...(COLUMNS);
+    }
+
+    std::size_t Rows() const { return myRows; }
+
+    // New rows are zero.
+    void Resize(std::size_t rows)
+    {
+        myRows = rows;
+        ResizeColumns<0>(std::integral_constant<bool, (0 < sizeof...(COLUMNS))>());
+    }
+
+    template<std::size_t COLUMN>
+    using ColumnType = typename std::tuple_element<COLUMN, Storage>::type::value_type;
+
+    // Always Rows() long.
+    template<std::size_t COLUMN>
+    DeltaColumnRows<ColumnType<COLUMN>> Column()
+    {
+        return {std::get<COLUMN>(myColumns).data(), myRows};
+    }
+
+    template<std::size_t COLUMN>
+    DeltaColumnRows<const ColumnType<COLUMN>> Column() const
+    {
+        return {std::get<COLUMN>(myColumns).data(), myRows};
+    }
+
+private:
+    std::size_t myRows;
+    Storage myColumns;
+
+    template<std::size_t COLUMN>
+    void ResizeColumns(std::true_type)
+    {
+        std::get<COLUMN>(myColumns).resize(myRows);
+        ResizeColumns<COLUMN + 1>(std::integral_constant<bool, ((COLUMN + 1) < sizeof...(COLUMNS))>());
+    }
+
+    template<std::size_t COLUMN>
+    void ResizeColumns(std::false_type)
+    {
+    }
+};
+
+// Walks the columns of a table at compile time. Each step is a flat loop
+// over one column, so the compares are branch free, vectorise and only
+// touch the memory they need. Push() and Pull() still test each row's mask.
+template<std::size_t COLUMN, std::size_t COUNT, typename TABLE, typename... COLUMNS>
+struct DeltaTableColumns
+{
+    typedef typename std::tuple_element<COLUMN, std::tuple<COLUMNS...>>::type Column;
+    typedef typename Column::Bits Bits;
+    typedef DeltaTableColumns<COLUMN + 1, COUNT, TABLE, COLUMNS...> Next;
+
+    static void Changed(const TABLE& base, const TABLE& current, uint64_t* masks)
+    {
+        const auto* was = base.template Column<COLUMN>().data();
+        const auto* now = current.template Column<COLUMN>().data();
+        auto rows = current.Rows();
+
+        for (std::size_t i = 0; i < rows; ++i)
+        {
+            masks[i] |= uint64_t(Bits::To(was[i]) != Bits::To(now[i])) << COLUMN;
+        }
+
+        Next::Changed(base, current, masks);
+    }
+
+    static void Push(const TABLE& current, const uint64_t* masks, BitStream& out)
+    {
+        const auto* now = current.template Column<COLUMN>().data();
+        auto rows = current.Rows();
+
+        for (std::size_t i = 0; i < rows; ++i)
+        {
+            if ((masks[i] >> COLUMN) & 1)
+            {
+                PushFieldBits(out, Bits::To(now[i]), Column::SentBits());
+            }
+        }
+
+        Next::Push(current, masks, out);
+    }
+
+    static void Pull(const TABLE& base, TABLE& result, const uint64_t* masks, BitStreamReadOnly& in)
+    {
+        const auto* was = base.template Column<COLUMN>().data();
+        auto* now = result.template Column<COLUMN>().data();
+        auto rows = result.Rows();
+
+        for (std::size_t i = 0; i < rows; ++i)
+        {
+            if ((masks[i] >> COLUMN) & 1)
+            {
+                typename Bits::Storage bits;
+                PullFieldBits(in, bits, Column::SentBits());
+                now[i] = Bits::From(bits);
+            }
+            else
+            {
+                now[i] = was[i];
+            }
+        }
+
+        Next::Pull(base, result, masks, in);
+    }
+};
+
+template<std::size_t COUNT, typename TABLE, typename... COLUMNS>
+struct DeltaTableColumns<COUNT, COUNT, TABLE, COLUMNS...>
+{
+    static void Changed(const TABLE&, const TABLE&, uint64_t*) {}
+    static void Push(const TABLE&, const uint64_t*, BitStream&) {}
+    static void Pull(const TABLE&, TABLE&, const uint64_t*, BitStreamReadOnly&) {}
+};
+
+// Delta codes a whole DeltaTable against a baseline in one go.
+// Wire format:
+//  For each entity: 1 bit, 1 == changed, followed by its column mask
+//                   (ColumnCount() bits, 1 == changed) if it did.
+//  Then column by column, the new values of the entities that changed.
+// Static entities cost one bit. Both tables need the same number of rows,
+// entities coming and going are up to the caller.
+template<typename... COLUMNS>
+class DeltaTableCoder
+{
+public:
+    typedef DeltaTable<COLUMNS...> Table;
+
+    DeltaTableCoder()
+        : myMasks()
+    {
+    }
+
+    // Bit c of mask i is set if column c of entity i changed.
+    // Valid until the next Encode() or Decode().
+    const std::vector<uint64_t>& ChangedMasks(const Table& base, const Table& current)
+    {
+        if (base.Rows() != current.Rows())
+        {
+            throw std::logic_error("DeltaTableCoder: base and current have different row counts.");
+        }
+
+        myMasks.assign(current.Rows(), 0);
+        Columns::Changed(base, current, myMasks.data());
+
+        return myMasks;
+    }
+
+    // Returns how many entities changed.
+    std::size_t Encode(const Table& base, const Table& current, BitStream& out)
+    {
+        ChangedMasks(base, current);
+
+        std::size_t changed = 0;
+
+        for (auto mask : myMasks)
+        {
+            out.Push(mask != 0);
+
+            if (mask)
+            {
+                PushFieldBits(out, mask, Table::ColumnCount());
+                ++changed;
+            }
+        }
+
+        Columns::Push(current, myMasks.data(), out);
+
+        return changed;
+    }
+
+    // result ends up the same size as base.
+    void Decode(const Table& base, Table& result, BitStreamReadOnly& in)
+    {
+        result.Resize(base.Rows());
+        myMasks.assign(base.Rows(), 0);
+
+        for (auto& mask : myMasks)
+        {
+            if (in.Pull1Bit())
+            {
+                PullFieldBits(in, mask, Table::ColumnCount());
+            }
+        }
+
+        Columns::Pull(base, result, myMasks.data(), in);
+    }
+
+private:
+    typedef DeltaTableColumns<0, sizeof...(COLUMNS), Table, COLUMNS...> Columns;
+
+    std::vector<uint64_t> myMasks;
+};
+
+}}} // namespace
+
+#endif // DELTATABLE_HPP
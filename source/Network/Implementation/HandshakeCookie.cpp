@@ -0,0 +1,315 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#else
+#include "Common/PrecompiledHeaders.hpp"
+#endif
+
+#include "HandshakeCookie.hpp"
+
+using namespace std::chrono;
+using namespace GameInABox::Network::Implementation;
+
+namespace
+{
+// FIPS 180-4. Only used for the cookies, so it only needs to be correct,
+// not quick.
+class Sha1
+{
+public:
+    Sha1()
+        : myState{{0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0}}
+        , myBlock()
+        , myUsed(0)
+        , myLength(0)
+    {
+    }
+
+    void Add(const uint8_t* data, std::size_t size)
+    {
+        myLength += size;
+
+        while (size > 0)
+        {
+            auto count = std::min(size, myBlock.size() - myUsed);
+
+            std::memcpy(myBlock.data() + myUsed, data, count);
+            myUsed += count;
+            data += count;
+            size -= count;
+
+            if (myUsed == myBlock.size())
+            {
+                Compress();
+            }
+        }
+    }
+
+    std::array<uint8_t, 20> Finish()
+    {
+        uint64_t bits = myLength * 8;
+        uint8_t one = 0x80;
+        uint8_t zero = 0;
+
+        Add(&one, 1);
+
+        while (myUsed != 56)
+        {
+            Add(&zero, 1);
+        }
+
+        uint8_t length[8];
+
+        for (int i = 0; i < 8; ++i)
+        {
+            length[i] = static_cast<uint8_t>(bits >> (56 - (i * 8)));
+        }
+
+        Add(length, 8);
+
+        std::array<uint8_t, 20> result;
+
+        for (std::size_t i = 0; i < result.size(); ++i)
+        {
+            result[i] = static_cast<uint8_t>(myState[i / 4] >> (24 - ((i % 4) * 8)));
+        }
+
+        return result;
+    }
+
+private:
+    std::array<uint32_t, 5> myState;
+    std::array<uint8_t, 64> myBlock;
+    std::size_t myUsed;
+    uint64_t myLength;
+
+    static uint32_t Rotate(uint32_t value, unsigned bits)
+    {
+        return (value << bits) | (value >> (32 - bits));
+    }
+
+    void Compress()
+    {
+        uint32_t words[80];
+
+        for (int i = 0; i < 16; ++i)
+        {
+            words[i] =
+                (uint32_t(myBlock[i * 4]) << 24) |
+                (uint32_t(myBlock[(i * 4) + 1]) << 16) |
+                (uint32_t(myBlock[(i * 4) + 2]) << 8) |
+                uint32_t(myBlock[(i * 4) + 3]);
+        }
+
+        for (int i = 16; i < 80; ++i)
+        {
+            words[i] = Rotate(words[i - 3] ^ words[i - 8] ^ words[i - 14] ^ words[i - 16], 1);
+        }
+
+        auto a = myState[0];
+        auto b = myState[1];
+        auto c = myState[2];
+        auto d = myState[3];
+        auto e = myState[4];
+
+        for (int i = 0; i < 80; ++i)
+        {
+            uint32_t f;
+            uint32_t k;
+
+            if (i < 20)
+            {
+                f = (b & c) | ((~b) & d);
+                k = 0x5A827999;
+            }
+            else if (i < 40)
+            {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            }
+            else if (i < 60)
+            {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            }
+            else
+            {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+
+            auto temp = Rotate(a, 5) + f + e + k + words[i];
+
+            e = d;
+            d = c;
+            c = Rotate(b, 30);
+            b = a;
+            a = temp;
+        }
+
+        myState[0] += a;
+        myState[1] += b;
+        myState[2] += c;
+        myState[3] += d;
+        myState[4] += e;
+
+        myUsed = 0;
+    }
+};
+
+std::array<uint8_t, 20> HmacSha1Padded(
+        const std::array<uint8_t, 64>& innerPad,
+        const std::array<uint8_t, 64>& outerPad,
+        const uint8_t* message,
+        std::size_t messageSize)
+{
+    Sha1 inner;
+    inner.Add(innerPad.data(), innerPad.size());
+    inner.Add(message, messageSize);
+
+    auto digest = inner.Finish();
+
+    Sha1 outer;
+    outer.Add(outerPad.data(), outerPad.size());
+    outer.Add(digest.data(), digest.size());
+
+    return outer.Finish();
+}
+
+void MakePads(
+        const uint8_t* key,
+        std::size_t keySize,
+        std::array<uint8_t, 64>& innerPad,
+        std::array<uint8_t, 64>& outerPad)
+{
+    std::array<uint8_t, 20> hashed;
+
+    // Keys longer than the block size are hashed first.
+    if (keySize > innerPad.size())
+    {
+        Sha1 shorter;
+        shorter.Add(key, keySize);
+        hashed = shorter.Finish();
+
+        key = hashed.data();
+        keySize = hashed.size();
+    }
+
+    innerPad.fill(0x36);
+    outerPad.fill(0x5c);
+
+    for (std::size_t i = 0; i < keySize; ++i)
+    {
+        innerPad[i] ^= key[i];
+        outerPad[i] ^= key[i];
+    }
+}
+
+uint64_t Slot(OClock now)
+{
+    return static_cast<uint64_t>(
+            duration_cast<milliseconds>(now.time_since_epoch()).count() /
+            HandshakeCookie::Period().count());
+}
+}
+
+std::array<uint8_t, 20> GameInABox::Network::Implementation::HmacSha1(
+        const uint8_t* key,
+        std::size_t keySize,
+        const uint8_t* message,
+        std::size_t messageSize)
+{
+    std::array<uint8_t, 64> innerPad;
+    std::array<uint8_t, 64> outerPad;
+
+    MakePads(key, keySize, innerPad, outerPad);
+
+    return HmacSha1Padded(innerPad, outerPad, message, messageSize);
+}
+
+HandshakeCookie::HandshakeCookie()
+    : HandshakeCookie(GetNetworkKeyRandom())
+{
+}
+
+HandshakeCookie::HandshakeCookie(const NetworkKey& secret)
+    : myInnerPad()
+    , myOuterPad()
+{
+    MakePads(secret.data, sizeof(secret.data), myInnerPad, myOuterPad);
+}
+
+NetworkKey HandshakeCookie::Create(const boost::asio::ip::udp::endpoint& address, OClock now) const
+{
+    return Create(address, Slot(now));
+}
+
+bool HandshakeCookie::IsValid(
+        const NetworkKey& key,
+        const boost::asio::ip::udp::endpoint& address,
+        OClock now) const
+{
+    auto slot = Slot(now);
+
+    if (key == Create(address, slot))
+    {
+        return true;
+    }
+
+    return ((slot > 0) && (key == Create(address, slot - 1)));
+}
+
+NetworkKey HandshakeCookie::Create(const boost::asio::ip::udp::endpoint& address, uint64_t slot) const
+{
+    // message == slot | address | port
+    std::vector<uint8_t> message{};
+
+    for (int i = 0; i < 8; ++i)
+    {
+        message.push_back(static_cast<uint8_t>(slot >> (56 - (i * 8))));
+    }
+
+    if (address.address().is_v4())
+    {
+        auto bytes = address.address().to_v4().to_bytes();
+        message.insert(end(message), begin(bytes), end(bytes));
+    }
+    else
+    {
+        auto bytes = address.address().to_v6().to_bytes();
+        message.insert(end(message), begin(bytes), end(bytes));
+    }
+
+    message.push_back(static_cast<uint8_t>(address.port() >> 8));
+    message.push_back(static_cast<uint8_t>(address.port()));
+
+    auto digest = HmacSha1Padded(myInnerPad, myOuterPad, message.data(), message.size());
+
+    // Truncate to the key size.
+    NetworkKey result;
+    static_assert(sizeof(digest) >= sizeof(result.data), "Digest is smaller than the key.");
+    std::memcpy(result.data, digest.data(), sizeof(result.data));
+
+    return result;
+}
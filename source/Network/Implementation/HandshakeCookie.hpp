@@ -0,0 +1,85 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef HANDSHAKECOOKIE_HPP
+#define HANDSHAKECOOKIE_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <boost/asio/ip/udp.hpp>
+#endif
+
+#include "Units.hpp"
+#include "NetworkKey.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+// RFC 2104 HMAC-SHA1.
+std::array<uint8_t, 20> HmacSha1(
+        const uint8_t* key,
+        std::size_t keySize,
+        const uint8_t* message,
+        std::size_t messageSize);
+
+// Stateless challenge keys for the server.
+// Instead of remembering a random key per endpoint that sent a challenge,
+// the key is a HMAC-SHA1 of the endpoint and the current time slot using a
+// server secret, truncated to the key size. When the connect comes back with the key we just
+// recalculate it, so we only need to allocate a connection once a client has
+// proven it can recieve packets at the address it says it's from.
+// Spoofed challenge floods then cost nothing but cpu.
+class HandshakeCookie
+{
+public:
+    // Random secret.
+    HandshakeCookie();
+
+    // Known secret, for testing.
+    explicit HandshakeCookie(const NetworkKey& secret);
+
+    NetworkKey Create(const boost::asio::ip::udp::endpoint& address, OClock now) const;
+
+    // Keys from the current and previous time slot are valid, so a key lasts
+    // at least one period, at most two.
+    bool IsValid(
+            const NetworkKey& key,
+            const boost::asio::ip::udp::endpoint& address,
+            OClock now) const;
+
+    static constexpr std::chrono::milliseconds Period()
+    {
+        // Client gives up after 5 retries 1 second apart.
+        return std::chrono::milliseconds{8000};
+    }
+
+private:
+    static const std::size_t BlockSize = 64;
+
+    std::array<uint8_t, BlockSize> myInnerPad;
+    std::array<uint8_t, BlockSize> myOuterPad;
+
+    NetworkKey Create(const boost::asio::ip::udp::endpoint& address, uint64_t slot) const;
+};
+
+}}} // namespace
+
+#endif // HANDSHAKECOOKIE_HPP
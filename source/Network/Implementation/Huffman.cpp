@@ -338,11 +338,16 @@ void Huffman::GenerateDecodeMap()
 
 std::vector<uint8_t> Huffman::Encode(const std::vector<uint8_t>& data) const
 {
-    BitStream encoded(data.size());
+    return Encode(data.data(), data.size());
+}
+
+std::vector<uint8_t> Huffman::Encode(const uint8_t* data, std::size_t size) const
+{
+    BitStream encoded(size);
 
-    for (uint8_t byte : data)
+    for (std::size_t i = 0; i < size; ++i)
     {
-        encoded.Push(myEncodeMap[byte].value, myEncodeMap[byte].bits);
+        encoded.Push(myEncodeMap[data[i]].value, myEncodeMap[data[i]].bits);
     }
     
     // EOF
@@ -354,6 +359,16 @@ std::vector<uint8_t> Huffman::Encode(const std::vector<uint8_t>& data) const
 std::vector<uint8_t> Huffman::Decode(const std::vector<uint8_t>& data) const
 {
     vector<uint8_t> result{};
+
+    Decode(data, result);
+
+    return std::move(result);
+}
+
+void Huffman::Decode(const std::vector<uint8_t>& data, std::vector<uint8_t>& result) const
+{
+    result.clear();
+
     BitStreamReadOnly inBuffer(data);
     size_t lastPosition = 0;
    
@@ -417,6 +432,4 @@ std::vector<uint8_t> Huffman::Decode(const std::vector<uint8_t>& data) const
             lastPosition = inBuffer.PositionReadBits();
         }
     }
-    
-    return std::move(result);
 }
@@ -41,7 +41,11 @@ public:
     explicit Huffman(const std::array<uint64_t, 256>& frequencies);
     
     std::vector<uint8_t> Encode(const std::vector<uint8_t>& data) const;
+    std::vector<uint8_t> Encode(const uint8_t* data, std::size_t size) const;
     std::vector<uint8_t> Decode(const std::vector<uint8_t>& data) const;
+
+    // Decodes into result, reusing its capacity.
+    void Decode(const std::vector<uint8_t>& data, std::vector<uint8_t>& result) const;
     
 private:
     // Not 0xFFFF as it gives me +1 wraparound bugs
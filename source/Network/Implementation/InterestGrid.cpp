@@ -0,0 +1,322 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#else
+#include "Common/PrecompiledHeaders.hpp"
+#endif
+
+#include "InterestGrid.hpp"
+
+using namespace GameInABox::Network;
+using namespace GameInABox::Network::Implementation;
+
+namespace
+{
+int32_t CellCoordinate(float position, float cellSize)
+{
+    auto cell = std::floor(double(position) / cellSize);
+
+    // NaN ends up in the middle, huge values on the edge.
+    if (!(cell == cell))
+    {
+        return 0;
+    }
+
+    return static_cast<int32_t>(std::max(
+            double(std::numeric_limits<int32_t>::min()),
+            std::min(double(std::numeric_limits<int32_t>::max()), cell)));
+}
+
+uint64_t CellKey(int32_t x, int32_t y)
+{
+    return (uint64_t(uint32_t(x)) << 32) | uint32_t(y);
+}
+}
+
+InterestGrid::InterestGrid(float cellSize, std::size_t history)
+    : myCellSize(cellSize > 0 ? cellSize : 1.0f)
+    , myHistory(history > 0 ? history : 1)
+    , mySpawns(0)
+    , myEntities()
+    , myCells()
+    , myAlwaysRelevant()
+    , myClients()
+    , myRelevant()
+{
+}
+
+uint64_t InterestGrid::CellFor(float x, float y) const
+{
+    return CellKey(CellCoordinate(x, myCellSize), CellCoordinate(y, myCellSize));
+}
+
+void InterestGrid::Unlink(uint32_t entity, const Entity& details)
+{
+    if (details.alwaysRelevant)
+    {
+        myAlwaysRelevant.erase(
+                std::remove(begin(myAlwaysRelevant), end(myAlwaysRelevant), entity),
+                end(myAlwaysRelevant));
+
+        return;
+    }
+
+    auto found = myCells.find(details.cell);
+
+    if (found != end(myCells))
+    {
+        auto& inCell = found->second;
+        auto position = std::find(begin(inCell), end(inCell), entity);
+
+        if (position != end(inCell))
+        {
+            *position = inCell.back();
+            inCell.pop_back();
+        }
+
+        if (inCell.empty())
+        {
+            myCells.erase(found);
+        }
+    }
+}
+
+void InterestGrid::Update(uint32_t entity, float x, float y, bool alwaysRelevant)
+{
+    auto cell = CellFor(x, y);
+    auto found = myEntities.find(entity);
+
+    if (found == end(myEntities))
+    {
+        found = myEntities.emplace(entity, Entity{cell, x, y, alwaysRelevant, ++mySpawns}).first;
+    }
+    else
+    {
+        auto& details = found->second;
+
+        details.x = x;
+        details.y = y;
+
+        if ((details.cell == cell) && (details.alwaysRelevant == alwaysRelevant))
+        {
+            return;
+        }
+
+        Unlink(entity, details);
+
+        details.cell = cell;
+        details.alwaysRelevant = alwaysRelevant;
+    }
+
+    if (alwaysRelevant)
+    {
+        myAlwaysRelevant.push_back(entity);
+    }
+    else
+    {
+        myCells[cell].push_back(entity);
+    }
+}
+
+void InterestGrid::Remove(uint32_t entity)
+{
+    auto found = myEntities.find(entity);
+
+    if (found != end(myEntities))
+    {
+        Unlink(entity, found->second);
+        myEntities.erase(found);
+    }
+}
+
+void InterestGrid::View(ClientHandle client, float x, float y, float radius)
+{
+    auto& view = myClients[client.Value()];
+
+    view.hasView = true;
+    view.x = x;
+    view.y = y;
+    view.radius = std::max(0.0f, radius);
+}
+
+void InterestGrid::Disconnect(ClientHandle client)
+{
+    myClients.erase(client.Value());
+}
+
+void InterestGrid::Relevant(ClientHandle client, std::vector<uint32_t>& result) const
+{
+    result.clear();
+
+    auto found = myClients.find(client.Value());
+
+    if ((found == end(myClients)) || (!found->second.hasView))
+    {
+        return;
+    }
+
+    const auto& view = found->second;
+    auto radiusSquared = view.radius * view.radius;
+
+    result.insert(end(result), begin(myAlwaysRelevant), end(myAlwaysRelevant));
+
+    auto inView = [&](const std::vector<uint32_t>& inCell)
+    {
+        for (auto entity : inCell)
+        {
+            const auto& details = myEntities.find(entity)->second;
+            auto dx = details.x - view.x;
+            auto dy = details.y - view.y;
+
+            if (((dx * dx) + (dy * dy)) <= radiusSquared)
+            {
+                result.push_back(entity);
+            }
+        }
+    };
+
+    auto left = int64_t(CellCoordinate(view.x - view.radius, myCellSize));
+    auto right = int64_t(CellCoordinate(view.x + view.radius, myCellSize));
+    auto bottom = int64_t(CellCoordinate(view.y - view.radius, myCellSize));
+    auto top = int64_t(CellCoordinate(view.y + view.radius, myCellSize));
+
+    // A view bigger than the populated part of the world, quicker to
+    // look at every cell that has something in it. Both sides can be 2^32
+    // cells, so divide rather than multiply to avoid overflowing.
+    auto width = uint64_t(right - left + 1);
+    auto height = uint64_t(top - bottom + 1);
+
+    if (width > (myCells.size() / height))
+    {
+        for (const auto& cell : myCells)
+        {
+            inView(cell.second);
+        }
+    }
+    else
+    {
+        for (auto x = left; x <= right; ++x)
+        {
+            for (auto y = bottom; y <= top; ++y)
+            {
+                auto cell = myCells.find(CellKey(int32_t(x), int32_t(y)));
+
+                if (cell != end(myCells))
+                {
+                    inView(cell->second);
+                }
+            }
+        }
+    }
+
+    std::sort(begin(result), end(result));
+}
+
+void InterestGrid::Changes(
+        ClientHandle client,
+        Sequence sending,
+        boost::optional<Sequence> lastAcked,
+        InterestChanges& result)
+{
+    result.entered.clear();
+    result.updated.clear();
+    result.left.clear();
+    result.full = true;
+
+    Relevant(client, myRelevant);
+
+    auto& state = myClients[client.Value()];
+
+    Sent now{sending, {}};
+    now.seen.reserve(myRelevant.size());
+
+    for (auto entity : myRelevant)
+    {
+        now.seen.push_back(Seen{entity, myEntities.find(entity)->second.spawn});
+    }
+
+    static const std::vector<Seen> nothing;
+    const std::vector<Seen>* base = &nothing;
+
+    if (lastAcked)
+    {
+        for (const auto& sent : state.sent)
+        {
+            if (sent.sequence == *lastAcked)
+            {
+                base = &sent.seen;
+                result.full = false;
+            }
+        }
+    }
+
+    // Both sorted by id, so merge.
+    auto was = begin(*base);
+    auto is = begin(now.seen);
+
+    while ((was != end(*base)) || (is != end(now.seen)))
+    {
+        if ((is == end(now.seen)) || ((was != end(*base)) && (was->entity < is->entity)))
+        {
+            result.left.push_back(was->entity);
+            ++was;
+        }
+        else if ((was == end(*base)) || (is->entity < was->entity))
+        {
+            result.entered.push_back(is->entity);
+            ++is;
+        }
+        else
+        {
+            if (was->spawn == is->spawn)
+            {
+                result.updated.push_back(is->entity);
+            }
+            else
+            {
+                result.left.push_back(was->entity);
+                result.entered.push_back(is->entity);
+            }
+
+            ++was;
+            ++is;
+        }
+    }
+
+    // Remember what this snapshot has, after the comparison as base may
+    // point into the history. Sequences wrap, newest wins.
+    state.sent.erase(
+            std::remove_if(begin(state.sent), end(state.sent), [&sending](const Sent& sent)
+            {
+                return sent.sequence == sending;
+            }),
+            end(state.sent));
+
+    state.sent.push_back(std::move(now));
+
+    while (state.sent.size() > myHistory)
+    {
+        state.sent.pop_front();
+    }
+}
@@ -0,0 +1,154 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef INTERESTGRID_HPP
+#define INTERESTGRID_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <boost/optional.hpp>
+#endif
+
+#include "ClientHandle.hpp"
+#include "Sequence.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+// What changed for a client between its acked snapshot and the one being sent.
+// If an entity id was removed and added again since the base it is in both
+// left and entered, so drop the left ones before creating the entered ones.
+// All sorted by id.
+struct InterestChanges
+{
+    // Not in the base, send everything about them (delta against nothing).
+    std::vector<uint32_t> entered;
+
+    // In the base and still relevant, delta against the base as usual.
+    std::vector<uint32_t> updated;
+
+    // In the base but not relevant anymore (or removed), tell the client to drop them.
+    std::vector<uint32_t> left;
+
+    // No base (first snapshot, or the acked one is too old), so left is empty
+    // and everything is entered. The client doesn't know which of its
+    // entities are still in scope, so it has to drop all of them first.
+    bool full;
+};
+
+// Interest management for state managers, so clients only get the entities
+// near them rather than the whole world every tick.
+//
+// Entities live in a uniform 2D grid (x, y, use whichever two axes the game
+// moves along), each client has a view position and radius. Always relevant
+// entities (the score board, the game clock) go to everyone.
+//
+// Per client, remembers which entities were in scope for each snapshot sent,
+// so Changes() can work out what entered and left scope against the
+// client's acked baseline rather than the last snapshot sent, which may
+// have been lost.
+class InterestGrid
+{
+public:
+    // cellSize should be about the typical view radius. history is how many
+    // snapshots a client can be behind before it gets a full resend, same
+    // as how far back the state manager keeps its own snapshots.
+    explicit InterestGrid(float cellSize, std::size_t history = 32);
+
+    // Adds the entity if it's new.
+    void Update(uint32_t entity, float x, float y, bool alwaysRelevant = false);
+    void Remove(uint32_t entity);
+
+    void View(ClientHandle client, float x, float y, float radius);
+    void Disconnect(ClientHandle client);
+
+    // Sorted ids relevant to the client right now, nothing if the client
+    // has no View().
+    void Relevant(ClientHandle client, std::vector<uint32_t>& result) const;
+
+    // Works out the relevant set, remembers it as what's in snapshot
+    // sending, and compares it to the set remembered for lastAcked. If
+    // there isn't one (!lastAcked, or too old) everything is entered and
+    // result.full is set.
+    void Changes(
+            ClientHandle client,
+            Sequence sending,
+            boost::optional<Sequence> lastAcked,
+            InterestChanges& result);
+
+    std::size_t EntityCount() const { return myEntities.size(); }
+
+private:
+    struct Entity
+    {
+        uint64_t cell;
+        float x;
+        float y;
+        bool alwaysRelevant;
+
+        // Bumped each time an id is added, so a removed and re-added
+        // entity isn't mistaken for the old one.
+        uint32_t spawn;
+    };
+
+    // The entity as it was in a sent snapshot.
+    struct Seen
+    {
+        uint32_t entity;
+        uint32_t spawn;
+    };
+
+    struct Sent
+    {
+        Sequence sequence;
+        std::vector<Seen> seen;
+    };
+
+    struct Client
+    {
+        bool hasView;
+        float x;
+        float y;
+        float radius;
+        std::deque<Sent> sent;
+    };
+
+    float myCellSize;
+    std::size_t myHistory;
+    uint32_t mySpawns;
+
+    std::unordered_map<uint32_t, Entity> myEntities;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> myCells;
+    std::vector<uint32_t> myAlwaysRelevant;
+    std::unordered_map<uint32_t, Client> myClients;
+
+    // Reused by Changes().
+    std::vector<uint32_t> myRelevant;
+
+    uint64_t CellFor(float x, float y) const;
+    void Unlink(uint32_t entity, const Entity& details);
+};
+
+}}} // namespace
+
+#endif // INTERESTGRID_HPP
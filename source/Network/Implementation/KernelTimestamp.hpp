@@ -0,0 +1,87 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef KERNELTIMESTAMP_HPP
+#define KERNELTIMESTAMP_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#endif
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <time.h>
+#endif
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+// The kernel stamps SO_TIMESTAMPNS with CLOCK_REALTIME, everything else
+// uses steady_clock. Sample both clocks once per batch, straight after
+// receiving, and shift the kernel's stamps across.
+class KernelTimestamp
+{
+public:
+    KernelTimestamp()
+        : myReal(std::chrono::system_clock::now())
+        , mySteady(std::chrono::steady_clock::now())
+    {
+    }
+
+    std::chrono::steady_clock::time_point Now() const { return mySteady; }
+
+#ifdef __linux__
+    // Finds the SCM_TIMESTAMPNS control message, or returns Now() if there isn't one.
+    std::chrono::steady_clock::time_point FromMessage(const msghdr& header) const
+    {
+        auto& message = const_cast<msghdr&>(header);
+
+        for (auto control = CMSG_FIRSTHDR(&message); control != nullptr; control = CMSG_NXTHDR(&message, control))
+        {
+            if ((control->cmsg_level == SOL_SOCKET) && (control->cmsg_type == SCM_TIMESTAMPNS))
+            {
+                timespec stamp;
+                std::memcpy(&stamp, CMSG_DATA(control), sizeof(stamp));
+
+                auto kernel =
+                        std::chrono::system_clock::time_point{} +
+                        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                            std::chrono::seconds{stamp.tv_sec} + std::chrono::nanoseconds{stamp.tv_nsec});
+
+                // Clocks can step, never claim it arrived in the future.
+                auto age = std::max(myReal - kernel, std::chrono::system_clock::duration::zero());
+
+                return mySteady - std::chrono::duration_cast<std::chrono::steady_clock::duration>(age);
+            }
+        }
+
+        return mySteady;
+    }
+#endif
+
+private:
+    std::chrono::system_clock::time_point myReal;
+    std::chrono::steady_clock::time_point mySteady;
+};
+
+}}} // namespace
+
+#endif // KERNELTIMESTAMP_HPP
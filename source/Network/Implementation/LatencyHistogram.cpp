@@ -0,0 +1,98 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cmath>
+#else
+#include "Common/PrecompiledHeaders.hpp"
+#endif
+
+#include "LatencyHistogram.hpp"
+
+using namespace std::chrono;
+using namespace GameInABox::Network::Implementation;
+
+LatencyHistogram::LatencyHistogram()
+    : myBuckets()
+    , myCount(0)
+    , myMaximum(Clock::duration::zero())
+{
+    myBuckets.fill(0);
+}
+
+void LatencyHistogram::Add(Clock::duration sample)
+{
+    auto micro = duration_cast<microseconds>(sample).count();
+    std::size_t index{0};
+
+    while ((micro > 0) && (index < (BucketCount - 1)))
+    {
+        micro >>= 1;
+        ++index;
+    }
+
+    ++myBuckets[index];
+    ++myCount;
+
+    if (sample > myMaximum)
+    {
+        myMaximum = sample;
+    }
+}
+
+void LatencyHistogram::Clear()
+{
+    myBuckets.fill(0);
+    myCount = 0;
+    myMaximum = Clock::duration::zero();
+}
+
+Clock::duration LatencyHistogram::Percentile(float percentile0to1) const
+{
+    if (myCount == 0)
+    {
+        return Clock::duration::zero();
+    }
+
+    auto target = static_cast<uint64_t>(std::ceil(percentile0to1 * static_cast<float>(myCount)));
+    uint64_t total{0};
+
+    for (std::size_t i = 0; i < BucketCount; ++i)
+    {
+        total += myBuckets[i];
+
+        if ((total >= target) && (total > 0))
+        {
+            if (i == (BucketCount - 1))
+            {
+                return myMaximum;
+            }
+
+            return BucketUpperBound(i);
+        }
+    }
+
+    return myMaximum;
+}
+
+Clock::duration LatencyHistogram::BucketUpperBound(std::size_t index)
+{
+    return duration_cast<Clock::duration>(microseconds(int64_t{1} << index));
+}
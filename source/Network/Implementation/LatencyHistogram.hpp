@@ -0,0 +1,87 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef LATENCYHISTOGRAM_HPP
+#define LATENCYHISTOGRAM_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <array>
+#endif
+
+#include "Units.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+// Log2 buckets of microseconds, bucket 0 is < 1us, bucket n is
+// [2^(n-1), 2^n) us, the last bucket catches everything >= ~1 second.
+// Cheap enough to record every tick.
+class LatencyHistogram
+{
+public:
+    static const std::size_t BucketCount = 22;
+
+    LatencyHistogram();
+
+    void Add(Clock::duration sample);
+    void Clear();
+
+    uint64_t Count() const { return myCount; }
+    uint64_t Bucket(std::size_t index) const { return myBuckets[index]; }
+    Clock::duration Maximum() const { return myMaximum; }
+
+    // Upper bound of the bucket holding the given percentile,
+    // so it overestimates by at most 2x.
+    Clock::duration Percentile(float percentile0to1) const;
+
+    static Clock::duration BucketUpperBound(std::size_t index);
+
+private:
+    std::array<uint64_t, BucketCount> myBuckets;
+    uint64_t myCount;
+    Clock::duration myMaximum;
+};
+
+// Where a received packet's time goes, from the kernel to DeltaParse().
+// Lets tick jitter be blamed on queueing or on compute.
+struct PipelineLatency
+{
+    // Kernel timestamp to Receive() returning, i.e. sat in the socket buffer.
+    LatencyHistogram queued;
+
+    // Each INetworkProvider::Receive() call.
+    LatencyHistogram provider;
+
+    // Each Connection::Process() call.
+    LatencyHistogram process;
+
+    // Xor and Huffman decode of each delta.
+    LatencyHistogram decode;
+
+    // Each IStateManager::DeltaParse() call.
+    LatencyHistogram parse;
+
+    // Kernel timestamp of the connection's latest packet to DeltaParse() returning.
+    LatencyHistogram endToEnd;
+};
+
+}}} // namespace
+
+#endif // LATENCYHISTOGRAM_HPP
@@ -57,11 +57,14 @@ NetworkManagerClientGuts::NetworkManagerClientGuts(
         TimeFunction timepiece)
     : INetworkManager()
     , myNetwork(network)
-    , myConnection(stateManager, timepiece)
+    , myTimepiece(timepiece ? timepiece : TimeFunction{Clock::now})
+    , myNow(myTimepiece())
+    , myConnection(stateManager, [this] () -> OClock { return myNow; })
     , myStateManager(stateManager)
     , myServerAddress()
     , myClientId(0)
     , myCompressor(stateManager.GetHuffmanFrequencies())
+    , myDeltaBuffer()
     , myLastSequenceProcessed(0)
     , myPacketSentCount(0)
 {
@@ -97,6 +100,8 @@ void NetworkManagerClientGuts::PrivateProcessIncomming()
 {
     // Don't test to see if the network is enabled.
     // As that is a corner case and isn't workth the check.
+    myNow = myTimepiece();
+
     auto packets = myNetwork.Receive();
 
     for (auto& packet : packets)
@@ -120,6 +125,20 @@ void NetworkManagerClientGuts::PrivateProcessIncomming()
         }
     }
 
+    // Idle timeout, only check when it's due.
+    if (myConnection.IsConnected() && (myNow >= myConnection.NextTimeout()))
+    {
+        auto response = myConnection.Process({});
+
+        if (!response.empty())
+        {
+            if (myStateManager.CanSend(myConnection.IdClient(), response.size()))
+            {
+                myNetwork.Send({{response, myServerAddress}});
+            }
+        }
+    }
+
     // Do some work :-)
     if (myConnection.IsConnected())
     {
@@ -136,6 +155,8 @@ void NetworkManagerClientGuts::PrivateProcessIncomming()
 
 void NetworkManagerClientGuts::PrivateSendState()
 {
+    myNow = myTimepiece();
+
     if (myConnection.IsConnected())
     {
         if ((myConnection.IdClient()) && (myStateManager.IsConnected(myConnection.IdClient().get())))
@@ -149,7 +170,8 @@ void NetworkManagerClientGuts::PrivateSendState()
     }
     else
     {
-        if (!myNetwork.IsDisabled())
+        // Handshake retries and timeouts.
+        if ((!myNetwork.IsDisabled()) && (myNow >= myConnection.NextTimeout()))
         {
             auto response = myConnection.Process({});
 
@@ -233,10 +255,11 @@ void NetworkManagerClientGuts::DeltaReceive()
             auto decompressed = move(myCompressor.Decode(payload));
 
             // Pass to gamestate (which will decompress the delta itself).
-            auto deltaData = Delta{
+            auto deltaData = DeltaView{
                     delta.GetSequenceBase(),
                     delta.GetSequence(),
-                    move(decompressed)};
+                    decompressed.data(),
+                    decompressed.size()};
 
            myLastSequenceProcessed = myStateManager.DeltaParse(
                 myConnection.IdClient().get(),
@@ -254,9 +277,10 @@ void NetworkManagerClientGuts::DeltaSend()
     auto id = myConnection.IdClient();
     auto deltaData = myStateManager.DeltaCreate(
                 *id,
-                myConnection.LastSequenceAck());
+                myConnection.LastSequenceAck(),
+                myDeltaBuffer);
 
-    if (deltaData.deltaPayload.size() <= MaxPacketSizeInBytes)
+    if (deltaData.size <= MaxPacketSizeInBytes)
     {
         // ignore if the delta distance is greater than 255, as we
         // store the distance as a byte.
@@ -265,7 +289,7 @@ void NetworkManagerClientGuts::DeltaSend()
         if (distance <= PacketDelta::MaximumDeltaDistance())
         {
             // Compress, encrypt, send
-            auto compressed = move(myCompressor.Encode(deltaData.deltaPayload));
+            auto compressed = move(myCompressor.Encode(deltaData.payload, deltaData.size));
 
             std::array<uint8_t, 4> code;
             Push(begin(code), deltaData.to.Value());
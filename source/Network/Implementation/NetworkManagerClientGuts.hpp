@@ -83,6 +83,11 @@ private:
     }
 
     INetworkProvider& myNetwork;
+
+    // Sampled once per ProcessIncomming() and SendState().
+    TimeFunction myTimepiece;
+    OClock myNow;
+
     Connection myConnection;
     IStateManager& myStateManager;
 
@@ -90,6 +95,7 @@ private:
     uint16_t myClientId;
 
     Huffman myCompressor;
+    std::vector<uint8_t> myDeltaBuffer;
 
     Sequence myLastSequenceProcessed;
 
@@ -28,13 +28,14 @@
 
 #include "INetworkProvider.hpp"
 #include "NetworkPacket.hpp"
-#include "PacketDelta.hpp"
+#include "Packets.hpp"
 #include "PacketFragmentManager.hpp"
 #include "XorCode.hpp"
 #include "BufferSerialisation.hpp"
 
 #include "NetworkManagerServerGuts.hpp"
 
+using namespace GameInABox::Network;
 using namespace GameInABox::Network::Implementation;
 
 NetworkManagerServerGuts::NetworkManagerServerGuts(
@@ -48,12 +49,47 @@ NetworkManagerServerGuts::NetworkManagerServerGuts(
         INetworkProvider& network,
         IStateManager& stateManager,
         TimeFunction timepiece)
+    : NetworkManagerServerGuts(network, stateManager, timepiece, GetNetworkKeyRandom())
+{
+}
+
+NetworkManagerServerGuts::NetworkManagerServerGuts(
+        INetworkProvider& network,
+        IStateManager& stateManager,
+        TimeFunction timepiece,
+        const NetworkKey& cookieSecret)
     : INetworkManager()
     , myNetwork(network)
     , myStateManager(stateManager)
     , myTimepiece(timepiece)
+    , myNow(myTimepiece())
+    , myCachedTime([this] () -> OClock { return myNow; })
+    , myBandwidthLimit{0, 0}
+    , myCongestionSettings(CongestionControl::DefaultSettings())
+    , mySendPacing{1, 0}
+    , myReceiveBudget{0, std::chrono::microseconds{0}, 0}
+    , myShedding{0, 0, 0, 0, 0}
+    , myBacklogConnected()
+    , myBacklogHandshake()
+    , myBacklogUnknown()
+    , mySendPhase(0)
+    , myNextSendGroup(0)
+    , mySendStateLatency()
+    , myReceiveLatency()
     , myAddressToState()
     , myCompressor(stateManager.GetHuffmanFrequencies())
+    , myDeltaCache(myCompressor)
+    , myDeltaRequests()
+    , myDeltaStates()
+    , myDeltaBuffers()
+    , myDeltasReceived()
+    , myReceivedStates()
+    , myDecompressed()
+    , myAccountPerTick(false)
+    , myHandshakeTraffic{{}, 0, 0, 0, 0}
+    , myTraffic()
+    , myCookies(cookieSecret)
+    , myTimers(TimerResolution(), myNow)
 {
 }
 
@@ -77,99 +113,117 @@ void NetworkManagerServerGuts::PrivateProcessIncomming()
     // connection.
     std::vector<NetworkPacket> responses{};
 
+    myNow = myTimepiece();
+    myAccountPerTick = myStateManager.AccountPerTick();
+
+    // Real time, not myTimepiece, as this is for profiling.
+    auto receiveStarted = Clock::now();
     auto packets = myNetwork.Receive();
+    auto receiveDone = Clock::now();
 
-    // process all the packets.
+    myReceiveLatency.provider.Add(receiveDone - receiveStarted);
 
     for (auto& packet: packets)
     {
-        if (myAddressToState.count(packet.address) > 0)
+        if (packet.received != OClock{})
         {
-            auto &connection = myAddressToState.at(packet.address).connection;
+            myReceiveLatency.queued.Add(receiveDone - packet.received);
+        }
+    }
 
-            if (myStateManager.CanReceive(connection.IdClient(), packet.address.size()))
-            {
-                auto response = connection.Process(move(packet.data));
+    auto budgeted =
+            (myReceiveBudget.packets > 0) ||
+            (myReceiveBudget.time.count() > 0);
 
-                if (!response.empty())
-                {
-                    if (myStateManager.CanSend(connection.IdClient(), response.size()))
-                    {
-                        responses.emplace_back(move(response), packet.address);
-                    }
-                }
-            }
-        }
-        else
+    if (!budgeted)
+    {
+        // Left over from when there was a budget.
+        for (auto backlog : {&myBacklogConnected, &myBacklogHandshake, &myBacklogUnknown})
         {
-            // If it's a delta packet, see if it's an existing connection.
-            // So we can update the senders address.
-            // Going to this effort as QW,Q2,Q3 did.
-            if (PacketDelta::IsPacket(packet.data))
+            for (auto& packet: *backlog)
             {
-                auto delta = PacketDelta{packet.data};
-                auto id = IdConnection(delta);
-
-                if (id)
-                {
-                    for (auto &addressToState : myAddressToState)
-                    {
-                        // same address?
-                        if (addressToState.first.address() == packet.address.address())
-                        {
-                            auto &connection = addressToState.second.connection;
-                            auto idConnection = connection.IdConnection();
-
-                            if (idConnection == id)
-                            {
-                                // copy the connection, don't care. Use move if metrics
-                                // say that this is too slow.
-                                myAddressToState.emplace(packet.address, addressToState.second);
-
-                                // remove the last one
-                                myAddressToState.erase(addressToState.first);
+                Incomming(packet, responses);
+            }
 
-                                // Process the data.
-                                if (myStateManager.CanReceive(connection.IdClient(), packet.address.size()))
-                                {
-                                    auto response = connection.Process(move(packet.data));
+            backlog->clear();
+        }
 
-                                    if (!response.empty())
-                                    {
-                                        if (myStateManager.CanSend(connection.IdClient(), response.size()))
-                                        {
-                                            responses.emplace_back(move(response), packet.address);
-                                        }
-                                    }
-                                }
-                                break;
-                            }
-                        }
-                    }
-                }
+        // process all the packets.
+        for (auto& packet: packets)
+        {
+            Incomming(packet, responses);
+        }
+    }
+    else
+    {
+        // Deltas from unknown addresses might be a connected client whose
+        // port changed, but anyone can send them from a spoofed address, so
+        // they go last.
+        for (auto& packet: packets)
+        {
+            if (myAddressToState.count(packet.address) > 0)
+            {
+                myBacklogConnected.emplace_back(std::move(packet));
+            }
+            else if (PacketDelta::IsPacket(packet.data))
+            {
+                myBacklogUnknown.emplace_back(std::move(packet));
             }
             else
             {
-                if (myStateManager.CanReceive({}, packet.data.size()))
-                {
-                    myAddressToState.emplace(packet.address, State{Connection{myStateManager, myTimepiece}, {}});
+                myBacklogHandshake.emplace_back(std::move(packet));
+            }
+        }
 
-                    auto &connection = myAddressToState.at(packet.address).connection;
+        // No point keeping what can't be processed this call or kept for the next.
+        if (myReceiveBudget.packets > 0)
+        {
+            std::size_t limit = myReceiveBudget.packets + myReceiveBudget.backlogPackets;
 
-                    connection.Start(Connection::Mode::Server);
+            myShedding.connectedDropped += Trim(myBacklogConnected, limit);
+            myShedding.handshakeDropped += Trim(myBacklogHandshake, limit);
+            myShedding.unknownDropped += Trim(myBacklogUnknown, limit);
+        }
 
-                    auto response = connection.Process(move(packet.data));
+        std::size_t processed = 0;
+        auto started = myTimepiece();
+        auto inBudget = [this, &processed, started] () -> bool
+        {
+            if ((myReceiveBudget.packets > 0) && (processed >= myReceiveBudget.packets))
+            {
+                return false;
+            }
 
-                    if (!response.empty())
-                    {
-                        if (myStateManager.CanSend(connection.IdClient(), response.size()))
-                        {
-                            responses.emplace_back(move(response), packet.address);
-                        }
-                    }
-                }
+            // Always do at least one, or a tiny budget would never make progress.
+            if  (
+                    (myReceiveBudget.time.count() > 0) &&
+                    (processed > 0) &&
+                    ((myTimepiece() - started) >= myReceiveBudget.time)
+                )
+            {
+                return false;
+            }
+
+            return true;
+        };
+
+        for (auto backlog : {&myBacklogConnected, &myBacklogHandshake, &myBacklogUnknown})
+        {
+            while ((!backlog->empty()) && inBudget())
+            {
+                Incomming(backlog->front(), responses);
+                backlog->pop_front();
+                ++processed;
             }
         }
+
+        myShedding.connectedDropped += Trim(myBacklogConnected, myReceiveBudget.backlogPackets);
+        myShedding.handshakeDropped += Trim(myBacklogHandshake, myReceiveBudget.backlogPackets);
+        myShedding.unknownDropped += Trim(myBacklogUnknown, myReceiveBudget.backlogPackets);
+        myShedding.deferred +=
+                myBacklogConnected.size() +
+                myBacklogHandshake.size() +
+                myBacklogUnknown.size();
     }
 
     if (!responses.empty())
@@ -177,7 +231,10 @@ void NetworkManagerServerGuts::PrivateProcessIncomming()
         myNetwork.Send(responses);
     }
 
-    // Drop any disconnects, parse any deltas.
+    // Drop any disconnects, decode any deltas, then parse them all in one go.
+    myDeltasReceived.clear();
+    myReceivedStates.clear();
+
     // Disconnections are handled in privatesendstate by testing myStateManager.IsConnected().
     // NOTE: Using while instead of range_for as calling erase inside the loop
     // results in wacky stuff.
@@ -197,8 +254,18 @@ void NetworkManagerServerGuts::PrivateProcessIncomming()
                 " failed due to: ",
                 connection.FailReason().c_str());
 
+            // Don't lose what it did this tick.
+            auto& traffic = addressToState->second.traffic;
+
+            if ((traffic.packetsReceived > 0) || (traffic.packetsSent > 0))
+            {
+                traffic.client = connection.IdClient();
+                myTraffic.push_back(traffic);
+            }
+
             // post increment on purpose so that the old addressToState is removed, not the new one.
             // Secondly, if I remove the current iterator, then weird things happen.
+            myTimers.Cancel(addressToState->first);
             myAddressToState.erase(addressToState++);
         }
         else
@@ -215,6 +282,7 @@ void NetworkManagerServerGuts::PrivateProcessIncomming()
                     if (client)
                     {
                         // decrypt, decompress, parse.
+                        auto decodeStarted = Clock::now();
                         std::vector<uint8_t> payload(GetPayloadBuffer(delta));
 
                         std::array<uint8_t, 4> code;
@@ -225,15 +293,34 @@ void NetworkManagerServerGuts::PrivateProcessIncomming()
                         XorCode(begin(code), end(code), connection.Key().data);
                         XorCode(begin(payload), end(payload), code);
 
-                        auto decompressed = move(myCompressor.Decode(payload));
+                        auto index = myDeltasReceived.size();
+
+                        if (myDecompressed.size() <= index)
+                        {
+                            myDecompressed.resize(index + 1);
+                        }
+
+                        myCompressor.Decode(payload, myDecompressed[index]);
 
                         // Pass to gamestate (which will decompress the delta itself).
-                        auto deltaData = Delta{
-                                delta.GetSequenceBase(),
-                                delta.GetSequence(),
-                                move(decompressed)};
+                        // Only a view, the state manager copies what it wants to keep.
+                        myDeltasReceived.push_back(DeltaReceived{
+                                *client,
+                                DeltaView{
+                                    delta.GetSequenceBase(),
+                                    delta.GetSequence(),
+                                    myDecompressed[index].data(),
+                                    myDecompressed[index].size()},
+                                Sequence{}});
+
+                        myReceivedStates.push_back(&addressToState->second);
+
+                        myReceiveLatency.decode.Add(Clock::now() - decodeStarted);
 
-                        addressToState->second.lastAcked = myStateManager.DeltaParse(*client, deltaData);
+                        if (ack)
+                        {
+                            addressToState->second.congestion.Acked(*ack, myNow);
+                        }
                     }
                 }
             }
@@ -241,74 +328,233 @@ void NetworkManagerServerGuts::PrivateProcessIncomming()
             ++addressToState;
         }
     }
+
+    if (!myDeltasReceived.empty())
+    {
+        auto parseStarted = Clock::now();
+
+        myStateManager.DeltaParseAll(myDeltasReceived);
+
+        auto parseDone = Clock::now();
+
+        // Each delta gets its share of the batch.
+        auto parseEach = (parseDone - parseStarted) / myDeltasReceived.size();
+
+        for (std::size_t i = 0; i < myDeltasReceived.size(); ++i)
+        {
+            auto& state = *myReceivedStates[i];
+
+            state.lastAcked = myDeltasReceived[i].acked;
+            myReceiveLatency.parse.Add(parseEach);
+
+            if (state.lastReceived != OClock{})
+            {
+                myReceiveLatency.endToEnd.Add(parseDone - state.lastReceived);
+            }
+        }
+    }
 }
 
-void NetworkManagerServerGuts::PrivateSendState()
+void NetworkManagerServerGuts::Incomming(NetworkPacket& packet, std::vector<NetworkPacket>& responses)
 {
-    std::vector<NetworkPacket> responses{};
-
-    for (auto& addressToState : myAddressToState)
+    if (myAddressToState.count(packet.address) > 0)
     {
-        auto& connection = addressToState.second.connection;
+        auto& state = myAddressToState.at(packet.address);
+        auto& connection = state.connection;
 
-        if (connection.IsConnected())
+        if (CanReceive(&state, packet.data.size()))
         {
-            auto client = connection.IdClient();
+            auto response = Process(state, packet);
 
-            if (client)
+            myTimers.Schedule(packet.address, connection.NextTimeout());
+
+            if (!response.empty())
             {
-                if (myStateManager.IsConnected(*client))
+                if (CanSend(&state, response.size(), 1))
                 {
-                    // get the packet, and fragment it, then send it.
-                    auto deltaData = myStateManager.DeltaCreate(*client, connection.LastSequenceAck());
+                    responses.emplace_back(move(response), packet.address);
+                }
+            }
+        }
+    }
+    else
+    {
+        // If it's a delta packet, see if it's an existing connection.
+        // So we can update the senders address.
+        // Going to this effort as QW,Q2,Q3 did.
+        if (PacketDelta::IsPacket(packet.data))
+        {
+            auto delta = PacketDelta{packet.data};
+            auto id = IdConnection(delta);
 
-                    auto distance = deltaData.to - deltaData.base;
-                    if (distance <= PacketDelta::MaximumDeltaDistance())
+            if (id)
+            {
+                for (auto &addressToState : myAddressToState)
+                {
+                    // same address?
+                    if (addressToState.first.address() == packet.address.address())
                     {
-                        // Compress, encrypt, send
-                        auto compressed = move(myCompressor.Encode(deltaData.deltaPayload));
-
-                        std::array<uint8_t, 4> code;
-                        Push(begin(code), deltaData.to.Value());
-                        Push(begin(code) + 2, addressToState.second.lastAcked.Value());
-                        XorCode(begin(code), end(code), connection.Key().data);
-                        XorCode(begin(compressed), end(compressed), code);
+                        auto idConnection = addressToState.second.connection.IdConnection();
 
-                        auto deltaPacket = PacketDelta{
-                                deltaData.to,
-                                addressToState.second.lastAcked,
-                                static_cast<uint8_t>(distance),
-                                move(compressed)};
-
-                        if (deltaPacket.data.size() <= MaxPacketSizeInBytes)
+                        if (idConnection == id)
                         {
-                            auto fragments = PacketFragmentManager::FragmentPacket(deltaPacket);
-
-                            for (auto& fragment: fragments)
+                            // copy the connection, don't care. Use move if metrics
+                            // say that this is too slow.
+                            auto oldAddress = addressToState.first;
+                            auto moved = myAddressToState.emplace(packet.address, addressToState.second);
+                            auto& state = moved.first->second;
+                            auto& connection = state.connection;
+
+                            // remove the last one
+                            myTimers.Cancel(oldAddress);
+                            myAddressToState.erase(oldAddress);
+
+                            // Process the data.
+                            if (CanReceive(&state, packet.data.size()))
                             {
-                                if (!fragment.empty())
+                                auto response = Process(state, packet);
+
+                                myTimers.Schedule(packet.address, connection.NextTimeout());
+
+                                if (!response.empty())
                                 {
-                                    if (myStateManager.CanSend(*client, fragment.size()))
+                                    if (CanSend(&state, response.size(), 1))
                                     {
-                                        responses.emplace_back(move(fragment), addressToState.first);
+                                        responses.emplace_back(move(response), packet.address);
                                     }
                                 }
                             }
-                        }
-                        else
-                        {
-                            Log(LogLevel::Informational, "Packetsize is > MaxPacketSizeInBytes. Not sending.");
+                            break;
                         }
                     }
-                    else
+                }
+            }
+        }
+        else
+        {
+            if (CanReceive(nullptr, packet.data.size()))
+            {
+                auto response = Handshake(packet);
+
+                if (!response.empty())
+                {
+                    State* state = nullptr;
+                    auto found = myAddressToState.find(packet.address);
+
+                    if (found != end(myAddressToState))
+                    {
+                        state = &found->second;
+                    }
+
+                    if (CanSend(state, response.size(), 1))
+                    {
+                        responses.emplace_back(move(response), packet.address);
+                    }
+                }
+            }
+        }
+    }
+}
+
+uint64_t NetworkManagerServerGuts::Trim(std::deque<NetworkPacket>& backlog, std::size_t limit)
+{
+    uint64_t result = 0;
+
+    while (backlog.size() > limit)
+    {
+        backlog.pop_front();
+        ++result;
+    }
+
+    return result;
+}
+
+void NetworkManagerServerGuts::PrivateSendState()
+{
+    std::vector<NetworkPacket> responses{};
+
+    // Real time, not myTimepiece, as this is for profiling.
+    auto started = Clock::now();
+
+    myNow = myTimepiece();
+    myAccountPerTick = myStateManager.AccountPerTick();
+    auto now = myNow;
+
+    auto phase = mySendPhase;
+    mySendPhase = (mySendPhase + 1) % mySendPacing.sendGroups;
+
+    // Encoded deltas are only shared between clients within the same tick.
+    myDeltaCache.Clear();
+
+    // Handshake retries, handshake timeouts and idle connections.
+    // Connections that have nothing to do don't cost anything here.
+    for (const auto& address : myTimers.Advance(now))
+    {
+        auto found = myAddressToState.find(address);
+
+        if (found != end(myAddressToState))
+        {
+            auto& connection = found->second.connection;
+
+            // Timers can fire early, see TimerWheel.
+            if (connection.NextTimeout() <= now)
+            {
+                auto response = connection.Process({});
+
+                if (!response.empty())
+                {
+                    if (CanSend(&found->second, response.size(), 1))
                     {
-                        // Delta distance to too far. fail.
-                        Log(LogLevel::Informational, "Delta distance > 255.");
+                        responses.emplace_back(move(response), address);
+                    }
+                }
+            }
+
+            myTimers.Schedule(address, connection.NextTimeout());
+        }
+    }
+
+    // Work out who gets a snapshot, then ask for all of them at once.
+    myDeltaRequests.clear();
+    myDeltaStates.clear();
+
+    for (auto& addressToState : myAddressToState)
+    {
+        auto& connection = addressToState.second.connection;
+
+        if (connection.IsConnected())
+        {
+            auto client = connection.IdClient();
+
+            if (client)
+            {
+                if (myStateManager.IsConnected(*client))
+                {
+                    auto& state = addressToState.second;
+
+                    // Let the last snapshot finish trickling out first,
+                    // otherwise a big snapshot would never get there.
+                    if  (
+                            ((state.sendGroup % mySendPacing.sendGroups) == phase) &&
+                            (state.pending.empty())
+                        )
+                    {
+                        // Congested clients get snapshots less often.
+                        if (state.congestion.ShouldSend())
+                        {
+                            myDeltaRequests.push_back(DeltaRequest{
+                                    *client,
+                                    connection.LastSequenceAck(),
+                                    DeltaView{Sequence{}, Sequence{}, nullptr, 0}});
+
+                            myDeltaStates.push_back(&state);
+                        }
                     }
                 }
                 else
                 {
                     connection.Disconnect("IStateManager: Not Connected.");
+                    myTimers.Schedule(addressToState.first, connection.NextTimeout());
                 }
             }
             else
@@ -316,29 +562,386 @@ void NetworkManagerServerGuts::PrivateSendState()
                 // WTF?
                 // Ah well, clean up anyway.
                 connection.Disconnect("Connection with no ClientId, wtf?");
+                myTimers.Schedule(addressToState.first, connection.NextTimeout());
                 Log(LogLevel::Warning, "Connection with no ClientId, wtf?");
             }
         }
-        else
+    }
+
+    if (!myDeltaRequests.empty())
+    {
+        myStateManager.DeltaCreateAll(myDeltaRequests, myDeltaBuffers);
+
+        for (std::size_t i = 0; i < myDeltaRequests.size(); ++i)
         {
-            auto response = connection.Process({});
+            DeltaSend(*myDeltaStates[i], myDeltaRequests[i], now);
+        }
+    }
 
-            if (!response.empty())
+    // Anyone disconnected above isn't connected any more.
+    for (auto& addressToState : myAddressToState)
+    {
+        if (addressToState.second.connection.IsConnected())
+        {
+            SendPending(addressToState.first, addressToState.second, responses);
+        }
+    }
+
+    if (!responses.empty())
+    {
+        myNetwork.Send(responses);
+    }
+
+    if (myAccountPerTick)
+    {
+        ReportTraffic();
+    }
+
+    mySendStateLatency.Add(Clock::now() - started);
+}
+
+std::vector<uint8_t> NetworkManagerServerGuts::Process(State& state, NetworkPacket& packet)
+{
+    auto started = Clock::now();
+    auto result = state.connection.Process(move(packet.data));
+
+    myReceiveLatency.process.Add(Clock::now() - started);
+    state.lastReceived = packet.received;
+
+    return result;
+}
+
+std::vector<uint8_t> NetworkManagerServerGuts::Handshake(NetworkPacket& packet)
+{
+    // Don't allocate anything until the client has sent back
+    // the key we gave it, otherwise spoofed challenges would
+    // fill memory.
+    auto now = myNow;
+
+    switch (Packet::GetCommand(packet.data))
+    {
+        case Command::Challenge:
+        {
+            auto challenge = PacketChallenge{packet.data};
+
+            if (challenge.IsValid())
+            {
+                auto key = myCookies.Create(packet.address, now);
+
+                return std::move(PacketChallengeResponse(Connection::Version, key).data);
+            }
+
+            break;
+        }
+
+        case Command::Info:
+        {
+            auto info = PacketInfo{packet.data};
+
+            if (info.IsValid())
             {
-                if (myStateManager.CanSend(connection.IdClient(), response.size()))
+                if (myCookies.IsValid(info.Key(), packet.address, now))
                 {
-                    responses.emplace_back(move(response), addressToState.first);
+                    auto infoData = myStateManager.StateInfo({});
+
+                    return std::move(PacketInfoResponse::WithBuffer(infoData).data);
                 }
             }
+
+            break;
+        }
+
+        case Command::Connect:
+        {
+            auto connect = PacketConnect{packet.data};
+
+            if (connect.IsValid())
+            {
+                if (myCookies.IsValid(connect.Key(), packet.address, now))
+                {
+                    myAddressToState.emplace(packet.address, State{
+                            Connection{myStateManager, myCachedTime},
+                            {},
+                            TokenBucket{myBandwidthLimit, now},
+                            0,
+                            0,
+                            CongestionControl{myCongestionSettings},
+                            myNextSendGroup++,
+                            {},
+                            packet.received,
+                            TrafficTotal{{}, 0, 0, 0, 0}});
+
+                    auto &connection = myAddressToState.at(packet.address).connection;
+
+                    connection.Listen(connect.Key());
+
+                    auto response = connection.Process(move(packet.data));
+
+                    myTimers.Schedule(packet.address, connection.NextTimeout());
+
+                    return response;
+                }
+            }
+
+            break;
+        }
+
+        default:
+        {
+            // Ignore everything else.
+            break;
         }
     }
 
-    if (!responses.empty())
+    return {};
+}
+
+void NetworkManagerServerGuts::DeltaSend(
+        State& state,
+        const DeltaRequest& request,
+        OClock now)
+{
+    // fragment it, then send it.
+    // The delta was written into a buffer we reuse between ticks.
+    const auto& deltaData = request.result;
+
+    auto distance = deltaData.to - deltaData.base;
+    if (distance <= PacketDelta::MaximumDeltaDistance())
     {
-        myNetwork.Send(responses);
+        // Compress (shared with other clients), encrypt, send
+        auto compressed = myDeltaCache.Encode(deltaData);
+
+        std::array<uint8_t, 4> code;
+        Push(begin(code), deltaData.to.Value());
+        Push(begin(code) + 2, state.lastAcked.Value());
+        XorCode(begin(code), end(code), state.connection.Key().data);
+        XorCode(begin(compressed), end(compressed), code);
+
+        auto deltaPacket = PacketDelta{
+                deltaData.to,
+                state.lastAcked,
+                static_cast<uint8_t>(distance),
+                move(compressed)};
+
+        if (deltaPacket.data.size() <= MaxPacketSizeInBytes)
+        {
+            auto fragments = PacketFragmentManager::FragmentPacket(deltaPacket);
+            std::size_t snapshotSize{0};
+
+            for (const auto& fragment: fragments)
+            {
+                snapshotSize += fragment.size();
+            }
+
+            // Send all or nothing, half a snapshot is just wasted bandwidth.
+            if  (
+                    (snapshotSize > 0) &&
+                    (state.bandwidth.CanTake(snapshotSize, now)) &&
+                    (CanSend(&state, snapshotSize, fragments.size()))
+                )
+            {
+                state.bandwidth.Take(snapshotSize);
+                state.congestion.Sent(deltaData.to, now);
+                ++state.snapshotsSent;
+
+                for (auto& fragment: fragments)
+                {
+                    if (!fragment.empty())
+                    {
+                        state.pending.push_back(move(fragment));
+                    }
+                }
+            }
+            else
+            {
+                ++state.snapshotsDropped;
+            }
+        }
+        else
+        {
+            Log(LogLevel::Informational, "Packetsize is > MaxPacketSizeInBytes. Not sending.");
+        }
+    }
+    else
+    {
+        // Delta distance to too far. fail.
+        Log(LogLevel::Informational, "Delta distance > 255.");
+    }
+}
+
+bool NetworkManagerServerGuts::CanReceive(State* state, std::size_t bytes)
+{
+    auto client = state ? state->connection.IdClient() : boost::optional<ClientHandle>{};
+
+    if (!myAccountPerTick)
+    {
+        return myStateManager.CanReceive(client, bytes);
+    }
+
+    auto& traffic = client ? state->traffic : myHandshakeTraffic;
+
+    ++traffic.packetsReceived;
+    traffic.bytesReceived += bytes;
+
+    return true;
+}
+
+bool NetworkManagerServerGuts::CanSend(State* state, std::size_t bytes, std::size_t packets)
+{
+    auto client = state ? state->connection.IdClient() : boost::optional<ClientHandle>{};
+
+    if (!myAccountPerTick)
+    {
+        return myStateManager.CanSend(client, bytes);
+    }
+
+    auto& traffic = client ? state->traffic : myHandshakeTraffic;
+
+    traffic.packetsSent += packets;
+    traffic.bytesSent += bytes;
+
+    return true;
+}
+
+void NetworkManagerServerGuts::ReportTraffic()
+{
+    for (auto& addressToState : myAddressToState)
+    {
+        auto& traffic = addressToState.second.traffic;
+
+        if ((traffic.packetsReceived > 0) || (traffic.packetsSent > 0))
+        {
+            traffic.client = addressToState.second.connection.IdClient();
+            myTraffic.push_back(traffic);
+            traffic = TrafficTotal{{}, 0, 0, 0, 0};
+        }
+    }
+
+    if ((myHandshakeTraffic.packetsReceived > 0) || (myHandshakeTraffic.packetsSent > 0))
+    {
+        myTraffic.push_back(myHandshakeTraffic);
+        myHandshakeTraffic = TrafficTotal{{}, 0, 0, 0, 0};
+    }
+
+    if (!myTraffic.empty())
+    {
+        myStateManager.Traffic(myTraffic);
+        myTraffic.clear();
+    }
+}
+
+void NetworkManagerServerGuts::SendPending(
+        const boost::asio::ip::udp::endpoint& address,
+        State& state,
+        std::vector<NetworkPacket>& responses)
+{
+    std::size_t sent{0};
+
+    while (!state.pending.empty())
+    {
+        if ((mySendPacing.fragmentsPerSend > 0) && (sent >= mySendPacing.fragmentsPerSend))
+        {
+            break;
+        }
+
+        responses.emplace_back(move(state.pending.front()), address);
+        state.pending.pop_front();
+        ++sent;
     }
 }
 
+void NetworkManagerServerGuts::SetBandwidthLimit(BandwidthLimit limit)
+{
+    auto now = myTimepiece();
+
+    myBandwidthLimit = limit;
+
+    for (auto& addressToState : myAddressToState)
+    {
+        addressToState.second.bandwidth = TokenBucket{limit, now};
+    }
+}
+
+std::vector<BandwidthUtilisation> NetworkManagerServerGuts::Utilisation() const
+{
+    std::vector<BandwidthUtilisation> result{};
+    auto now = myTimepiece();
+
+    for (const auto& addressToState : myAddressToState)
+    {
+        const auto& state = addressToState.second;
+        auto client = state.connection.IdClient();
+
+        if (state.connection.IsConnected() && client)
+        {
+            result.push_back({
+                    *client,
+                    state.bandwidth.BytesTaken(),
+                    state.snapshotsSent,
+                    state.snapshotsDropped,
+                    state.bandwidth.Utilisation(now)});
+        }
+    }
+
+    return result;
+}
+
+void NetworkManagerServerGuts::SetSendPacing(SendPacing pacing)
+{
+    if (pacing.sendGroups == 0)
+    {
+        pacing.sendGroups = 1;
+    }
+
+    mySendPacing = pacing;
+    mySendPhase = 0;
+}
+
+void NetworkManagerServerGuts::SetReceiveBudget(ReceiveBudget budget)
+{
+    myReceiveBudget = budget;
+}
+
+ReceiveShedding NetworkManagerServerGuts::Shedding() const
+{
+    auto result = myShedding;
+
+    result.backlog =
+            myBacklogConnected.size() +
+            myBacklogHandshake.size() +
+            myBacklogUnknown.size();
+
+    return result;
+}
+
+void NetworkManagerServerGuts::SetCongestionSettings(CongestionSettings settings)
+{
+    myCongestionSettings = settings;
+}
+
+std::vector<CongestionState> NetworkManagerServerGuts::Congestion() const
+{
+    std::vector<CongestionState> result{};
+
+    for (const auto& addressToState : myAddressToState)
+    {
+        const auto& state = addressToState.second;
+        auto client = state.connection.IdClient();
+
+        if (state.connection.IsConnected() && client)
+        {
+            result.push_back({
+                    *client,
+                    state.congestion.Loss(),
+                    state.congestion.RoundTripTime(),
+                    state.congestion.RoundTripTimeMinimum(),
+                    state.congestion.Interval()});
+        }
+    }
+
+    return result;
+}
+
 void NetworkManagerServerGuts::Disconnect()
 {
     // Disconnect all clients, send their last packet,
@@ -348,6 +951,7 @@ void NetworkManagerServerGuts::Disconnect()
         if (connection.second.connection.IsConnected())
         {
             connection.second.connection.Disconnect("Server shutdown.");
+            myTimers.Schedule(connection.first, connection.second.connection.NextTimeout());
         }
     }
 
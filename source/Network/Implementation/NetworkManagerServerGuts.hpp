@@ -24,19 +24,29 @@
 #ifndef USING_PRECOMPILED_HEADERS
 #include <cstdint>
 #include <vector>
+#include <deque>
 #include <unordered_map>
 #include <boost/optional.hpp>
 #include <boost/asio/ip/udp.hpp>
 #endif
 
 #include "Sequence.hpp"
+#include "IStateManager.hpp"
+#include "Bandwidth.hpp"
+#include "Congestion.hpp"
+#include "ReceiveBudget.hpp"
 #include "Huffman.hpp"
 #include "Hash.hpp"
 #include "INetworkManager.hpp"
 #include "Connection.hpp"
+#include "DeltaCache.hpp"
+#include "TokenBucket.hpp"
+#include "HandshakeCookie.hpp"
+#include "TimerWheel.hpp"
+#include "LatencyHistogram.hpp"
+#include "CongestionControl.hpp"
 
 namespace GameInABox { namespace Network {
-class IStateManager;
 class INetworkProvider;
 
 namespace Implementation {
@@ -53,28 +63,150 @@ public:
             INetworkProvider& network,
             IStateManager& stateManager);
 
+    // Servers sharing a port need the same cookie secret, otherwise a
+    // connect that lands on a different server to its challenge is refused.
+    NetworkManagerServerGuts(
+            INetworkProvider& network,
+            IStateManager& stateManager,
+            TimeFunction timepiece,
+            const NetworkKey& cookieSecret);
+
     virtual ~NetworkManagerServerGuts();
 
+    DeltaCache::Metrics DeltaCacheMetrics() const { return myDeltaCache.GetMetrics(); }
+
+    // Addresses with a Connection, connected or still handshaking.
+    std::size_t ConnectionCount() const { return myAddressToState.size(); }
+
+    // Applies to existing and new connections.
+    void SetBandwidthLimit(BandwidthLimit limit);
+    std::vector<BandwidthUtilisation> Utilisation() const;
+
+    // Only applies to new connections.
+    void SetCongestionSettings(CongestionSettings settings);
+    std::vector<CongestionState> Congestion() const;
+
+    void SetSendPacing(SendPacing pacing);
+
+    // Shrinking backlogPackets only takes effect on the next ProcessIncomming().
+    void SetReceiveBudget(ReceiveBudget budget);
+    ReceiveShedding Shedding() const;
+
+    const LatencyHistogram& SendStateLatency() const { return mySendStateLatency; }
+
+    // Only packets from providers that stamp NetworkPacket::received count
+    // towards queued and endToEnd.
+    const PipelineLatency& ReceiveLatency() const { return myReceiveLatency; }
+
 private:
     static const uint64_t MaxPacketSizeInBytes{65535};
 
+    static constexpr Milliseconds TimerResolution()
+    {
+        return Milliseconds{10};
+    }
+
     struct State
     {
         Connection connection;
         Sequence lastAcked;
+        TokenBucket bandwidth;
+        uint64_t snapshotsSent;
+        uint64_t snapshotsDropped;
+        CongestionControl congestion;
+        unsigned sendGroup;
+
+        // Fragments waiting to be paced out.
+        std::deque<std::vector<uint8_t>> pending;
+
+        // NetworkPacket::received of the last packet processed.
+        OClock lastReceived;
+
+        // Since the last IStateManager::Traffic(), if it wants that.
+        TrafficTotal traffic;
     };
 
     INetworkProvider& myNetwork;
     IStateManager& myStateManager;
     TimeFunction myTimepiece;
 
+    // Sampled once per ProcessIncomming() and SendState(), connections use
+    // myCachedTime so they don't hit the real clock for every packet.
+    OClock myNow;
+    TimeFunction myCachedTime; // Captures this, every Connection has a copy.
+
+    BandwidthLimit myBandwidthLimit;
+    CongestionSettings myCongestionSettings;
+    SendPacing mySendPacing;
+    ReceiveBudget myReceiveBudget;
+    ReceiveShedding myShedding;
+
+    // Only used with a ReceiveBudget, oldest at the front.
+    std::deque<NetworkPacket> myBacklogConnected;
+    std::deque<NetworkPacket> myBacklogHandshake;
+    std::deque<NetworkPacket> myBacklogUnknown;
+
+    unsigned mySendPhase;
+    unsigned myNextSendGroup;
+    LatencyHistogram mySendStateLatency;
+    PipelineLatency myReceiveLatency;
+
     std::unordered_map<boost::asio::ip::udp::endpoint, State> myAddressToState;
 
     Huffman myCompressor;
+    DeltaCache myDeltaCache;
+
+    // Reused every tick for the IStateManager batch calls. The states
+    // line up with the requests / received.
+    std::vector<DeltaRequest> myDeltaRequests;
+    std::vector<State*> myDeltaStates;
+    std::vector<std::vector<uint8_t>> myDeltaBuffers;
+    std::vector<DeltaReceived> myDeltasReceived;
+    std::vector<State*> myReceivedStates;
+    std::vector<std::vector<uint8_t>> myDecompressed;
+
+    // IStateManager::AccountPerTick(), asked every ProcessIncomming() and SendState().
+    bool myAccountPerTick;
+    TrafficTotal myHandshakeTraffic;
+    std::vector<TrafficTotal> myTraffic;
+
+    HandshakeCookie myCookies;
+    TimerWheel<boost::asio::ip::udp::endpoint> myTimers;
 
     void PrivateProcessIncomming() override;
     void PrivateSendState() override;
 
+    // Everything ProcessIncomming() does for one received packet.
+    void Incomming(NetworkPacket& packet, std::vector<NetworkPacket>& responses);
+
+    // Drops the oldest so there's at most limit left, returns how many went.
+    static uint64_t Trim(std::deque<NetworkPacket>& backlog, std::size_t limit);
+
+    // Connection::Process(), timed.
+    std::vector<uint8_t> Process(State& state, NetworkPacket& packet);
+
+    // Challenge/Info/Connect from an unknown address.
+    std::vector<uint8_t> Handshake(NetworkPacket& packet);
+
+    // Queues the snapshot's fragments in state.pending.
+    void DeltaSend(
+            State& state,
+            const DeltaRequest& request,
+            OClock now);
+
+    // IStateManager::CanReceive() and CanSend(), or just counting if
+    // myAccountPerTick. No state (or one without a client) is handshaking.
+    bool CanReceive(State* state, std::size_t bytes);
+    bool CanSend(State* state, std::size_t bytes, std::size_t packets);
+
+    // Hands the counts to IStateManager::Traffic() and zeros them.
+    void ReportTraffic();
+
+    void SendPending(
+            const boost::asio::ip::udp::endpoint& address,
+            State& state,
+            std::vector<NetworkPacket>& responses);
+
     void Disconnect();
 };
 
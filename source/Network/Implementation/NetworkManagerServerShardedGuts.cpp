@@ -0,0 +1,306 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <algorithm>
+#else
+#include "Common/PrecompiledHeaders.hpp"
+#endif
+
+#include "MakeUnique.hpp"
+#include "Logging.hpp"
+#include "NetworkKey.hpp"
+#include "NetworkProviderSynchronous.hpp"
+#include "NetworkManagerServerGuts.hpp"
+#include "NetworkManagerServerShardedGuts.hpp"
+
+using boost::asio::ip::udp;
+using namespace GameInABox::Network;
+using namespace GameInABox::Network::Implementation;
+
+NetworkManagerServerShardedGuts::NetworkManagerServerShardedGuts(
+        boost::asio::ip::udp::endpoint bindAddress,
+        std::size_t shardCount,
+        IStateManager& stateManager)
+    : NetworkManagerServerShardedGuts(bindAddress, shardCount, stateManager, Clock::now)
+{
+}
+
+NetworkManagerServerShardedGuts::NetworkManagerServerShardedGuts(
+        boost::asio::ip::udp::endpoint bindAddress,
+        std::size_t shardCount,
+        IStateManager& stateManager,
+        TimeFunction timepiece)
+    : INetworkManager()
+    , myState(stateManager)
+    , myShards()
+    , myThreads()
+    , myLock()
+    , myWorkReady()
+    , myWorkDone()
+    , myJob(Job::ProcessIncomming)
+    , myGeneration(0)
+    , myRunning(0)
+    , myFailure()
+{
+    shardCount = std::max(shardCount, std::size_t{1});
+
+    // The kernel picks the shard, so a client's challenge and connect
+    // could arrive at different ones.
+    auto cookieSecret = GetNetworkKeyRandom();
+
+    for (std::size_t i = 0; i < shardCount; ++i)
+    {
+        auto network = make_unique<NetworkProviderSynchronous>(
+                bindAddress,
+                NetworkProviderSynchronous::Bind::SharePort);
+
+        // If we asked for any port, the rest need to share the one we got.
+        if (i == 0)
+        {
+            bindAddress = network->LocalAddress();
+        }
+
+        auto guts = make_unique<NetworkManagerServerGuts>(*network, myState, timepiece, cookieSecret);
+
+        myShards.push_back(Shard{std::move(network), std::move(guts)});
+    }
+
+    // Starting a thread can throw too. The destructor won't run if it
+    // does, so stop the ones already going before letting it out.
+    try
+    {
+        for (std::size_t i = 0; i < myShards.size(); ++i)
+        {
+            myThreads.emplace_back(&NetworkManagerServerShardedGuts::Worker, this, i);
+        }
+    }
+    catch (...)
+    {
+        StopThreads();
+        throw;
+    }
+}
+
+NetworkManagerServerShardedGuts::~NetworkManagerServerShardedGuts()
+{
+    StopThreads();
+
+    // Shards disconnect their clients when destroyed,
+    // make sure that happens before the providers go.
+    for (auto& shard : myShards)
+    {
+        shard.guts.reset();
+    }
+}
+
+boost::asio::ip::udp::endpoint NetworkManagerServerShardedGuts::LocalAddress() const
+{
+    return myShards.front().network->LocalAddress();
+}
+
+void NetworkManagerServerShardedGuts::SetBandwidthLimit(BandwidthLimit limit)
+{
+    for (auto& shard : myShards)
+    {
+        shard.guts->SetBandwidthLimit(limit);
+    }
+}
+
+void NetworkManagerServerShardedGuts::SetCongestionSettings(CongestionSettings settings)
+{
+    for (auto& shard : myShards)
+    {
+        shard.guts->SetCongestionSettings(settings);
+    }
+}
+
+void NetworkManagerServerShardedGuts::SetSendPacing(SendPacing pacing)
+{
+    for (auto& shard : myShards)
+    {
+        shard.guts->SetSendPacing(pacing);
+    }
+}
+
+void NetworkManagerServerShardedGuts::SetReceiveBudget(ReceiveBudget budget)
+{
+    for (auto& shard : myShards)
+    {
+        shard.guts->SetReceiveBudget(budget);
+    }
+}
+
+ReceiveShedding NetworkManagerServerShardedGuts::Shedding() const
+{
+    ReceiveShedding result{0, 0, 0, 0, 0};
+
+    for (const auto& shard : myShards)
+    {
+        auto shardResult = shard.guts->Shedding();
+
+        result.connectedDropped += shardResult.connectedDropped;
+        result.handshakeDropped += shardResult.handshakeDropped;
+        result.unknownDropped += shardResult.unknownDropped;
+        result.deferred += shardResult.deferred;
+        result.backlog += shardResult.backlog;
+    }
+
+    return result;
+}
+
+std::vector<BandwidthUtilisation> NetworkManagerServerShardedGuts::Utilisation() const
+{
+    std::vector<BandwidthUtilisation> result{};
+
+    for (const auto& shard : myShards)
+    {
+        auto shardResult = shard.guts->Utilisation();
+        result.insert(end(result), begin(shardResult), end(shardResult));
+    }
+
+    return result;
+}
+
+std::vector<CongestionState> NetworkManagerServerShardedGuts::Congestion() const
+{
+    std::vector<CongestionState> result{};
+
+    for (const auto& shard : myShards)
+    {
+        auto shardResult = shard.guts->Congestion();
+        result.insert(end(result), begin(shardResult), end(shardResult));
+    }
+
+    return result;
+}
+
+void NetworkManagerServerShardedGuts::PrivateProcessIncomming()
+{
+    Run(Job::ProcessIncomming);
+}
+
+void NetworkManagerServerShardedGuts::PrivateSendState()
+{
+    Run(Job::SendState);
+}
+
+void NetworkManagerServerShardedGuts::Run(Job job)
+{
+    std::unique_lock<std::mutex> lock(myLock);
+
+    myJob = job;
+    myRunning = myThreads.size();
+    ++myGeneration;
+
+    myWorkReady.notify_all();
+    myWorkDone.wait(lock, [this] () { return myRunning == 0; });
+
+    if (myFailure)
+    {
+        auto failure = myFailure;
+        myFailure = nullptr;
+
+        std::rethrow_exception(failure);
+    }
+}
+
+void NetworkManagerServerShardedGuts::StopThreads()
+{
+    {
+        std::lock_guard<std::mutex> lock(myLock);
+
+        myJob = Job::Quit;
+        ++myGeneration;
+    }
+
+    myWorkReady.notify_all();
+
+    for (auto& thread : myThreads)
+    {
+        thread.join();
+    }
+
+    myThreads.clear();
+}
+
+void NetworkManagerServerShardedGuts::Worker(std::size_t index)
+{
+    auto& guts = *(myShards[index].guts);
+    uint64_t seen{0};
+
+    while (true)
+    {
+        Job job;
+
+        {
+            std::unique_lock<std::mutex> lock(myLock);
+
+            myWorkReady.wait(lock, [this, &seen] () { return myGeneration != seen; });
+
+            seen = myGeneration;
+            job = myJob;
+        }
+
+        if (job == Job::Quit)
+        {
+            return;
+        }
+
+        // Escaping the thread would terminate, so hand it back to Run().
+        std::exception_ptr failure{};
+
+        try
+        {
+            if (job == Job::ProcessIncomming)
+            {
+                guts.ProcessIncomming();
+            }
+            else
+            {
+                guts.SendState();
+            }
+        }
+        catch (std::exception& error)
+        {
+            Log(LogLevel::Error, "Shard ", index, " failed: ", error.what());
+            failure = std::current_exception();
+        }
+        catch (...)
+        {
+            Log(LogLevel::Error, "Shard ", index, " failed.");
+            failure = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(myLock);
+
+            if (failure && !myFailure)
+            {
+                myFailure = failure;
+            }
+
+            if (--myRunning == 0)
+            {
+                myWorkDone.notify_one();
+            }
+        }
+    }
+}
@@ -0,0 +1,124 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef NETWORKMANAGERSERVERSHARDEDGUTS_HPP
+#define NETWORKMANAGERSERVERSHARDEDGUTS_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <boost/asio/ip/udp.hpp>
+#endif
+
+#include "Units.hpp"
+#include "Bandwidth.hpp"
+#include "Congestion.hpp"
+#include "ReceiveBudget.hpp"
+#include "INetworkManager.hpp"
+#include "StateManagerLocked.hpp"
+
+namespace GameInABox { namespace Network {
+class IStateManager;
+
+namespace Implementation {
+class NetworkProviderSynchronous;
+class NetworkManagerServerGuts;
+
+// One socket, server and thread per shard, all bound to the same port with
+// SO_REUSEPORT so the kernel spreads the clients between them.
+// ProcessIncomming() and SendState() run every shard at once on its own
+// thread and return once they are all done, so the game loop doesn't change.
+// The game state is shared through a StateManagerLocked, and every shard
+// uses the same cookie secret.
+//
+// If a shard throws, the exception is logged and rethrown from the
+// ProcessIncomming() or SendState() call that ran it.
+class NetworkManagerServerShardedGuts : public INetworkManager
+{
+public:
+    NetworkManagerServerShardedGuts(
+            boost::asio::ip::udp::endpoint bindAddress,
+            std::size_t shardCount,
+            IStateManager& stateManager,
+            TimeFunction timepiece);
+
+    NetworkManagerServerShardedGuts(
+            boost::asio::ip::udp::endpoint bindAddress,
+            std::size_t shardCount,
+            IStateManager& stateManager);
+
+    virtual ~NetworkManagerServerShardedGuts();
+
+    std::size_t ShardCount() const { return myShards.size(); }
+    boost::asio::ip::udp::endpoint LocalAddress() const;
+
+    // Same as NetworkManagerServerGuts, applied to every shard.
+    void SetBandwidthLimit(BandwidthLimit limit);
+    void SetCongestionSettings(CongestionSettings settings);
+    void SetSendPacing(SendPacing pacing);
+    void SetReceiveBudget(ReceiveBudget budget);
+    ReceiveShedding Shedding() const;
+    std::vector<BandwidthUtilisation> Utilisation() const;
+    std::vector<CongestionState> Congestion() const;
+
+private:
+    enum class Job
+    {
+        ProcessIncomming,
+        SendState,
+        Quit
+    };
+
+    struct Shard
+    {
+        std::unique_ptr<NetworkProviderSynchronous> network;
+        std::unique_ptr<NetworkManagerServerGuts> guts;
+    };
+
+    StateManagerLocked myState;
+    std::vector<Shard> myShards;
+    std::vector<std::thread> myThreads;
+
+    std::mutex myLock;
+    std::condition_variable myWorkReady;
+    std::condition_variable myWorkDone;
+    Job myJob;
+    uint64_t myGeneration;
+    std::size_t myRunning;
+
+    // The first exception a shard threw this job.
+    std::exception_ptr myFailure;
+
+    void PrivateProcessIncomming() override;
+    void PrivateSendState() override;
+
+    void Run(Job job);
+    void StopThreads();
+    void Worker(std::size_t index);
+};
+
+}}} // namespace
+
+#endif // NETWORKMANAGERSERVERSHARDEDGUTS_HPP
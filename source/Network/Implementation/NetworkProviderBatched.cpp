@@ -0,0 +1,499 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cerrno>
+#include <cstring>
+#include <array>
+#include <algorithm>
+#ifdef __linux__
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#endif
+#else
+#include "Common/PrecompiledHeaders.hpp"
+#endif
+
+#include "MakeUnique.hpp"
+#include "Logging.hpp"
+#include "NetworkPacket.hpp"
+#include "KernelTimestamp.hpp"
+#include "NetworkProviderBatched.hpp"
+
+using boost::asio::ip::udp;
+using namespace GameInABox::Network;
+using namespace GameInABox::Network::Implementation;
+
+const std::size_t NetworkProviderBatched::BatchSize;
+const std::size_t NetworkProviderBatched::MaxDatagramSize;
+const std::size_t NetworkProviderBatched::MaxSegments;
+const std::size_t NetworkProviderBatched::MaxOffloadSize;
+
+#if defined(__linux__) && defined(UDP_SEGMENT) && defined(UDP_GRO)
+#define HAS_UDP_OFFLOAD
+#endif
+
+namespace
+{
+// A GRO datagram can be up to 64k, 16 of them is plenty per system call.
+const std::size_t GroSlots{16};
+const std::size_t GroSlotSize{65535};
+}
+
+NetworkProviderBatched::NetworkProviderBatched(boost::asio::ip::udp::endpoint bindAddress, Offload offload)
+    : INetworkProvider()
+    , myBindAddress(bindAddress)
+    , myIoService()
+    , mySocket(make_unique<udp::socket>(myIoService, myBindAddress))
+    , myAddressIsIpv4(myBindAddress.address().is_v4())
+    , myOffload(offload)
+    , myGso(false)
+    , myGro(false)
+    , mySlots(BatchSize)
+    , mySlotSize(MaxDatagramSize)
+    , myReceiveBuffer()
+    , myReceiveAddresses()
+{
+    SetupSocket();
+}
+
+void NetworkProviderBatched::SetupSocket()
+{
+    myGso = false;
+    myGro = false;
+
+#ifdef __linux__
+    if (mySocket->is_open())
+    {
+        int on{1};
+        setsockopt(mySocket->native_handle(), SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+    }
+#endif
+
+#ifdef HAS_UDP_OFFLOAD
+    if ((myOffload == Offload::Automatic) && (mySocket->is_open()))
+    {
+        auto socket = mySocket->native_handle();
+
+        // Reading the option only works if the kernel knows about it.
+        int segment{0};
+        socklen_t segmentSize{sizeof(segment)};
+        myGso = (getsockopt(socket, SOL_UDP, UDP_SEGMENT, &segment, &segmentSize) == 0);
+
+        int on{1};
+        myGro = (setsockopt(socket, SOL_UDP, UDP_GRO, &on, sizeof(on)) == 0);
+    }
+#endif
+
+    mySlots = myGro ? GroSlots : BatchSize;
+    mySlotSize = myGro ? GroSlotSize : MaxDatagramSize;
+    myReceiveBuffer.resize(mySlots * mySlotSize);
+    myReceiveAddresses.resize(mySlots);
+}
+
+boost::asio::ip::udp::endpoint NetworkProviderBatched::LocalAddress() const
+{
+    boost::system::error_code error;
+
+    auto result = mySocket->local_endpoint(error);
+
+    if (error)
+    {
+        return myBindAddress;
+    }
+
+    return result;
+}
+
+std::vector<NetworkPacket> NetworkProviderBatched::PrivateReceive()
+{
+    std::vector<NetworkPacket> result;
+
+    if (mySocket->is_open())
+    {
+        // A short batch means the socket is empty.
+        while (ReceiveBatch(result) == mySlots)
+        {
+        }
+    }
+
+    return result;
+}
+
+void NetworkProviderBatched::PrivateSend(std::vector<NetworkPacket> packets)
+{
+    if (mySocket->is_open() && !packets.empty())
+    {
+        // Drop the ones we can't send, send the rest in batches.
+        std::vector<const NetworkPacket*> toSend{};
+        toSend.reserve(packets.size());
+
+        for (const auto& packet : packets)
+        {
+            if  (
+                    (!packet.data.empty()) &&
+                    (packet.address.address().is_v4() == myAddressIsIpv4)
+                )
+            {
+                toSend.push_back(&packet);
+            }
+        }
+
+        std::size_t sent{0};
+
+        while (sent < toSend.size())
+        {
+            auto gso = myGso;
+            auto sentThisBatch = SendBatch(toSend.data() + sent, std::min(BatchSize, toSend.size() - sent));
+
+            if (sentThisBatch == 0)
+            {
+                // Try again if it was GSO that failed, otherwise it's
+                // already logged, give up like NetworkProviderSynchronous does.
+                if (gso != myGso)
+                {
+                    continue;
+                }
+
+                break;
+            }
+
+            sent += sentThisBatch;
+        }
+    }
+}
+
+void NetworkProviderBatched::PrivateReset()
+{
+    PrivateDisable();
+
+    try
+    {
+        using std::swap;
+
+        auto tempSocket = make_unique<udp::socket>(myIoService, myBindAddress);
+        swap(mySocket, tempSocket);
+
+        SetupSocket();
+    }
+    catch (boost::system::system_error& socketError)
+    {
+        // is_open() will return false if this didn't work, so just report why to debug.
+        Log(
+            LogLevel::Warning,
+            "Reset Failed: (",
+            socketError.code().value(),
+            ") ",
+            socketError.what());
+    }
+}
+
+void NetworkProviderBatched::PrivateFlush()
+{
+    // Sends are blocking, nothing to flush.
+}
+
+void NetworkProviderBatched::PrivateDisable()
+{
+    mySocket->close();
+}
+
+bool NetworkProviderBatched::PrivateIsDisabled() const
+{
+    return !(mySocket->is_open());
+}
+
+#ifdef __linux__
+
+std::size_t NetworkProviderBatched::ReceiveBatch(std::vector<NetworkPacket>& result)
+{
+    std::array<mmsghdr, BatchSize> headers;
+    std::array<iovec, BatchSize> buffers;
+
+    // Kernel timestamp, and the segment size for GRO.
+    alignas(cmsghdr) char control[BatchSize][CMSG_SPACE(sizeof(timespec)) + CMSG_SPACE(sizeof(int))];
+
+    for (std::size_t i = 0; i < mySlots; ++i)
+    {
+        buffers[i].iov_base = myReceiveBuffer.data() + (i * mySlotSize);
+        buffers[i].iov_len = mySlotSize;
+
+        std::memset(&headers[i], 0, sizeof(mmsghdr));
+        headers[i].msg_hdr.msg_name = myReceiveAddresses[i].data();
+        headers[i].msg_hdr.msg_namelen = static_cast<socklen_t>(myReceiveAddresses[i].capacity());
+        headers[i].msg_hdr.msg_iov = &buffers[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+
+        headers[i].msg_hdr.msg_control = control[i];
+        headers[i].msg_hdr.msg_controllen = sizeof(control[i]);
+    }
+
+    auto received = recvmmsg(
+            mySocket->native_handle(),
+            headers.data(),
+            static_cast<unsigned>(mySlots),
+            MSG_DONTWAIT,
+            nullptr);
+
+    if (received < 0)
+    {
+        if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+        {
+            Log(LogLevel::Informational, "Received Failed: (", errno, ") ", std::strerror(errno));
+        }
+
+        return 0;
+    }
+
+    auto clock = KernelTimestamp{};
+
+    for (int i = 0; i < received; ++i)
+    {
+        const auto& header = headers[i].msg_hdr;
+
+        if (header.msg_flags & MSG_TRUNC)
+        {
+            Log(LogLevel::Informational, "Datagram bigger than MaxDatagramSize, dropped.");
+            continue;
+        }
+
+        std::size_t size{headers[i].msg_len};
+        std::size_t segment{size};
+
+#ifdef HAS_UDP_OFFLOAD
+        if (myGro)
+        {
+            for (auto message = CMSG_FIRSTHDR(&header); message != nullptr; message = CMSG_NXTHDR(const_cast<msghdr*>(&header), message))
+            {
+                if ((message->cmsg_level == SOL_UDP) && (message->cmsg_type == UDP_GRO))
+                {
+                    int groSize{0};
+                    std::memcpy(&groSize, CMSG_DATA(message), sizeof(groSize));
+
+                    if (groSize > 0)
+                    {
+                        segment = static_cast<std::size_t>(groSize);
+                    }
+                }
+            }
+        }
+#endif
+
+        auto start = begin(myReceiveBuffer) + (i * mySlotSize);
+        auto stamp = clock.FromMessage(header);
+
+        myReceiveAddresses[i].resize(header.msg_namelen);
+
+        // A coalesced train is split back up, the last one can be short.
+        std::size_t offset{0};
+
+        do
+        {
+            auto length = std::min(segment, size - offset);
+
+            result.emplace_back(
+                    std::vector<uint8_t>(start + offset, start + offset + length),
+                    myReceiveAddresses[i],
+                    stamp);
+
+            offset += length;
+        }
+        while (offset < size);
+    }
+
+    return static_cast<std::size_t>(received);
+}
+
+std::size_t NetworkProviderBatched::SendBatch(const NetworkPacket* const* packets, std::size_t count)
+{
+    std::array<mmsghdr, BatchSize> headers;
+    std::array<iovec, BatchSize> buffers;
+    std::array<std::size_t, BatchSize> packetsInMessage;
+    alignas(cmsghdr) char control[BatchSize][CMSG_SPACE(sizeof(uint16_t))];
+
+    std::size_t messages{0};
+    bool offloaded{false};
+
+    // No copies, point straight at the packets. With GSO a message can have
+    // one iovec per packet, the kernel splits it on the segment size.
+    for (std::size_t i = 0; i < count;)
+    {
+        auto first = i;
+        auto segment = packets[first]->data.size();
+        auto total = segment;
+
+        buffers[i].iov_base = const_cast<uint8_t*>(packets[i]->data.data());
+        buffers[i].iov_len = packets[i]->data.size();
+        ++i;
+
+        if (myGso)
+        {
+            // Everything but the last has to be exactly segment sized.
+            while   (
+                        (i < count) &&
+                        ((i - first) < MaxSegments) &&
+                        (packets[i - 1]->data.size() == segment) &&
+                        (packets[i]->data.size() <= segment) &&
+                        ((total + packets[i]->data.size()) <= MaxOffloadSize) &&
+                        (packets[i]->address == packets[first]->address)
+                    )
+            {
+                buffers[i].iov_base = const_cast<uint8_t*>(packets[i]->data.data());
+                buffers[i].iov_len = packets[i]->data.size();
+                total += packets[i]->data.size();
+                ++i;
+            }
+        }
+
+        auto& header = headers[messages].msg_hdr;
+
+        std::memset(&headers[messages], 0, sizeof(mmsghdr));
+        header.msg_name = const_cast<void*>(static_cast<const void*>(packets[first]->address.data()));
+        header.msg_namelen = static_cast<socklen_t>(packets[first]->address.size());
+        header.msg_iov = &buffers[first];
+        header.msg_iovlen = i - first;
+
+#ifdef HAS_UDP_OFFLOAD
+        if ((i - first) > 1)
+        {
+            header.msg_control = control[messages];
+            header.msg_controllen = sizeof(control[messages]);
+
+            auto message = CMSG_FIRSTHDR(&header);
+            auto segmentSize = static_cast<uint16_t>(segment);
+
+            message->cmsg_level = SOL_UDP;
+            message->cmsg_type = UDP_SEGMENT;
+            message->cmsg_len = CMSG_LEN(sizeof(segmentSize));
+            std::memcpy(CMSG_DATA(message), &segmentSize, sizeof(segmentSize));
+
+            offloaded = true;
+        }
+#else
+        (void) control;
+#endif
+
+        packetsInMessage[messages] = i - first;
+        ++messages;
+    }
+
+    auto sent = sendmmsg(
+            mySocket->native_handle(),
+            headers.data(),
+            static_cast<unsigned>(messages),
+            0);
+
+    if (sent < 0)
+    {
+        auto error = errno;
+
+        // Some devices can't checksum offload, so GSO fails with EIO. Older
+        // kernels and some drivers reject the segment size with EINVAL.
+        // Either way the caller retries the batch without it.
+        if (offloaded && ((error == EIO) || (error == EINVAL)))
+        {
+            Log(LogLevel::Warning, "UDP GSO failed: (", error, ") ", std::strerror(error), ", turning it off.");
+            myGso = false;
+        }
+        else
+        {
+            Log(LogLevel::Informational, "Send Failed: (", error, ") ", std::strerror(error));
+        }
+
+        return 0;
+    }
+
+    if (sent == 0)
+    {
+        // Not an error, so errno means nothing.
+        Log(LogLevel::Informational, "Send Failed: nothing was sent.");
+
+        return 0;
+    }
+
+    std::size_t result{0};
+
+    for (int i = 0; i < sent; ++i)
+    {
+        result += packetsInMessage[i];
+    }
+
+    return result;
+}
+
+#else
+
+// One datagram per system call, same as NetworkProviderSynchronous.
+std::size_t NetworkProviderBatched::ReceiveBatch(std::vector<NetworkPacket>& result)
+{
+    boost::system::error_code error;
+    std::size_t received{0};
+
+    while ((received < mySlots) && (mySocket->available(error) > 0) && (!error))
+    {
+        auto size = mySocket->receive_from(
+                boost::asio::buffer(myReceiveBuffer.data(), mySlotSize),
+                myReceiveAddresses[0],
+                0,
+                error);
+
+        if (error)
+        {
+            break;
+        }
+
+        result.emplace_back(
+                std::vector<uint8_t>(begin(myReceiveBuffer), begin(myReceiveBuffer) + size),
+                myReceiveAddresses[0],
+                std::chrono::steady_clock::now());
+
+        ++received;
+    }
+
+    if (error)
+    {
+        Log(LogLevel::Informational, "Received Failed: (", error.value(), ") ", error.message().c_str());
+    }
+
+    return received;
+}
+
+std::size_t NetworkProviderBatched::SendBatch(const NetworkPacket* const* packets, std::size_t count)
+{
+    boost::system::error_code error;
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        mySocket->send_to(boost::asio::buffer(packets[i]->data), packets[i]->address, 0, error);
+
+        if (error)
+        {
+            Log(LogLevel::Informational, "Send Failed: (", error.value(), ") ", error.message().c_str());
+
+            return i;
+        }
+    }
+
+    return count;
+}
+
+#endif
@@ -0,0 +1,117 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef NETWORKPROVIDERBATCHED_HPP
+#define NETWORKPROVIDERBATCHED_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <boost/asio.hpp>
+#endif
+
+#include "INetworkProvider.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+// Like NetworkProviderSynchronous, but moves up to BatchSize datagrams per
+// system call using recvmmsg()/sendmmsg() on linux. Received datagrams go
+// into buffers allocated once at construction. Other platforms fall back to
+// one recvfrom()/sendto() per datagram.
+// Datagrams bigger than MaxDatagramSize are dropped on receive.
+//
+// If the kernel supports UDP segmentation offload, runs of equally sized
+// packets to the same address (like the fragments of a big snapshot) are
+// handed over as one datagram with UDP_SEGMENT and split up by the kernel.
+// UDP_GRO does the reverse on receive, the coalesced datagrams are split
+// back into packets here.
+//
+// Received packets are stamped with the kernel's SO_TIMESTAMPNS time.
+class NetworkProviderBatched final: public INetworkProvider
+{
+public:
+    enum class Offload
+    {
+        // Use GSO/GRO if the kernel supports them.
+        Automatic,
+        None
+    };
+
+    static const std::size_t BatchSize = 64;
+    static const std::size_t MaxDatagramSize = 9216;
+
+    // Kernel limits (UDP_MAX_SEGMENTS, and the biggest IPv4 UDP payload).
+    static const std::size_t MaxSegments = 64;
+    static const std::size_t MaxOffloadSize = 65507;
+
+    explicit NetworkProviderBatched(boost::asio::ip::udp::endpoint bindAddress)
+        : NetworkProviderBatched(bindAddress, Offload::Automatic)
+    {
+    }
+
+    NetworkProviderBatched(boost::asio::ip::udp::endpoint bindAddress, Offload offload);
+    NetworkProviderBatched()
+        : NetworkProviderBatched(boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), 0))
+    {
+    }
+
+    boost::asio::ip::udp::endpoint LocalAddress() const;
+
+    bool UsingSegmentationOffload() const { return myGso; }
+    bool UsingReceiveOffload() const { return myGro; }
+
+private:
+    boost::asio::ip::udp::endpoint myBindAddress;
+    boost::asio::io_service myIoService;
+    std::unique_ptr<boost::asio::ip::udp::socket> mySocket;
+    bool myAddressIsIpv4;
+    Offload myOffload;
+    bool myGso;
+    bool myGro;
+
+    // With GRO a slot can hold a whole coalesced train, so there are fewer, bigger slots.
+    std::size_t mySlots;
+    std::size_t mySlotSize;
+    std::vector<uint8_t> myReceiveBuffer;
+    std::vector<boost::asio::ip::udp::endpoint> myReceiveAddresses;
+
+    std::vector<NetworkPacket> PrivateReceive() override;
+    void PrivateSend(std::vector<NetworkPacket> packets) override;
+    void PrivateReset() override;
+    void PrivateFlush() override;
+    void PrivateDisable() override;
+    bool PrivateIsDisabled() const override;
+
+    // Turns on kernel timestamps and what offloads the socket supports,
+    // then sizes the receive buffers to match.
+    void SetupSocket();
+
+    // Appends to result, returns how many datagrams were read from the
+    // socket (including dropped ones), 0 if none or on error.
+    std::size_t ReceiveBatch(std::vector<NetworkPacket>& result);
+
+    // Returns how many of the packets were sent, 0 on error.
+    std::size_t SendBatch(const NetworkPacket* const* packets, std::size_t count);
+};
+
+}}} // namespace
+
+#endif // NETWORKPROVIDERBATCHED_HPP
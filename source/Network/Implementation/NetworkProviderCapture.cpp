@@ -0,0 +1,538 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#else
+#include "Common/PrecompiledHeaders.hpp"
+#endif
+
+#include "NetworkPacket.hpp"
+#include "NetworkProviderCapture.hpp"
+
+using boost::asio::ip::udp;
+using boost::asio::ip::address_v4;
+using boost::asio::ip::address_v6;
+using namespace GameInABox::Network;
+using namespace GameInABox::Network::Implementation;
+
+namespace
+{
+// https://wiki.wireshark.org/Development/LibpcapFileFormat
+const uint32_t MagicMicroseconds = 0xA1B2C3D4;
+const uint32_t MagicNanoseconds = 0xA1B23C4D;
+const uint32_t LinkTypeRaw = 101;
+const uint32_t SnapLength = 65535;
+
+// libpcap's own limit, anything claiming more is corrupt.
+const uint32_t MaximumSnapLength = 262144;
+const std::size_t FileHeaderSize = 24;
+const std::size_t RecordHeaderSize = 16;
+const std::size_t Ip4HeaderSize = 20;
+const std::size_t Ip6HeaderSize = 40;
+const std::size_t UdpHeaderSize = 8;
+const uint8_t ProtocolUdp = 17;
+
+uint32_t ReadNative32(const uint8_t* source, bool swapped)
+{
+    uint32_t result;
+
+    std::memcpy(&result, source, sizeof(result));
+
+    if (swapped)
+    {
+        result =
+            ((result & 0x000000FF) << 24) |
+            ((result & 0x0000FF00) << 8) |
+            ((result & 0x00FF0000) >> 8) |
+            ((result & 0xFF000000) >> 24);
+    }
+
+    return result;
+}
+
+void PushBig16(std::vector<uint8_t>& buffer, uint16_t value)
+{
+    buffer.push_back(static_cast<uint8_t>(value >> 8));
+    buffer.push_back(static_cast<uint8_t>(value));
+}
+
+uint16_t ReadBig16(const uint8_t* source)
+{
+    return static_cast<uint16_t>((source[0] << 8) | source[1]);
+}
+
+// RFC 1071 one's complement sum, not folded or inverted yet.
+uint32_t Sum(const uint8_t* data, std::size_t size, uint32_t sum = 0)
+{
+    for (std::size_t i = 0; i + 1 < size; i += 2)
+    {
+        sum += ReadBig16(data + i);
+    }
+
+    if (size & 1)
+    {
+        sum += static_cast<uint32_t>(data[size - 1]) << 8;
+    }
+
+    return sum;
+}
+
+uint16_t Fold(uint32_t sum)
+{
+    while (sum >> 16)
+    {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+
+    return static_cast<uint16_t>(~sum);
+}
+
+// The made up local end has to be the same family as the far end.
+udp::endpoint LocalFor(const udp::endpoint& local, const udp::endpoint& remote)
+{
+    auto address = local.address();
+
+    if (address.is_v4() && remote.address().is_v6())
+    {
+        return {address_v6::v4_mapped(address.to_v4()), local.port()};
+    }
+
+    if (address.is_v6() && remote.address().is_v4())
+    {
+        auto v6 = address.to_v6();
+
+        if (v6.is_v4_mapped())
+        {
+            return {v6.to_v4(), local.port()};
+        }
+
+        return {address_v4::any(), local.port()};
+    }
+
+    return local;
+}
+
+void PushAddress(std::vector<uint8_t>& buffer, const udp::endpoint& endpoint)
+{
+    if (endpoint.address().is_v4())
+    {
+        auto bytes = endpoint.address().to_v4().to_bytes();
+        buffer.insert(end(buffer), begin(bytes), end(bytes));
+    }
+    else
+    {
+        auto bytes = endpoint.address().to_v6().to_bytes();
+        buffer.insert(end(buffer), begin(bytes), end(bytes));
+    }
+}
+
+// IP + UDP header + payload. False, and buffer is untouched, if the
+// datagram wouldn't fit in a record. For IPv4 that's the 16 bit total
+// length, IPv6 has no such field but still has to fit the snap length.
+bool BuildDatagram(
+        std::vector<uint8_t>& buffer,
+        const udp::endpoint& source,
+        const udp::endpoint& destination,
+        const std::vector<uint8_t>& payload)
+{
+    auto isV4 = source.address().is_v4();
+    auto largest = SnapLength - UdpHeaderSize - (isV4 ? Ip4HeaderSize : Ip6HeaderSize);
+
+    if (payload.size() > largest)
+    {
+        return false;
+    }
+
+    auto udpSize = static_cast<uint16_t>(UdpHeaderSize + payload.size());
+
+    buffer.clear();
+
+    if (isV4)
+    {
+        buffer.push_back(0x45);
+        buffer.push_back(0);
+        PushBig16(buffer, static_cast<uint16_t>(Ip4HeaderSize + udpSize));
+        PushBig16(buffer, 0);
+        // Don't fragment.
+        PushBig16(buffer, 0x4000);
+        buffer.push_back(64);
+        buffer.push_back(ProtocolUdp);
+        PushBig16(buffer, 0);
+        PushAddress(buffer, source);
+        PushAddress(buffer, destination);
+
+        auto checksum = Fold(Sum(buffer.data(), Ip4HeaderSize));
+
+        buffer[10] = static_cast<uint8_t>(checksum >> 8);
+        buffer[11] = static_cast<uint8_t>(checksum);
+    }
+    else
+    {
+        buffer.push_back(0x60);
+        buffer.push_back(0);
+        PushBig16(buffer, 0);
+        PushBig16(buffer, udpSize);
+        buffer.push_back(ProtocolUdp);
+        buffer.push_back(64);
+        PushAddress(buffer, source);
+        PushAddress(buffer, destination);
+    }
+
+    auto udpStart = buffer.size();
+
+    PushBig16(buffer, source.port());
+    PushBig16(buffer, destination.port());
+    PushBig16(buffer, udpSize);
+    PushBig16(buffer, 0);
+    buffer.insert(end(buffer), begin(payload), end(payload));
+
+    // Pseudo header is the addresses, protocol and length.
+    auto addressStart = isV4 ? 12 : 8;
+    auto addressSize = isV4 ? 8 : 32;
+    auto sum = Sum(buffer.data() + addressStart, addressSize, ProtocolUdp + udpSize);
+    auto checksum = Fold(Sum(buffer.data() + udpStart, udpSize, sum));
+
+    // 0 means no checksum, so send all ones instead.
+    if (checksum == 0)
+    {
+        checksum = 0xFFFF;
+    }
+
+    buffer[udpStart + 6] = static_cast<uint8_t>(checksum >> 8);
+    buffer[udpStart + 7] = static_cast<uint8_t>(checksum);
+
+    return true;
+}
+
+bool ReadBytes(std::istream& input, uint8_t* destination, std::size_t size)
+{
+    input.read(reinterpret_cast<char*>(destination), static_cast<std::streamsize>(size));
+
+    return static_cast<std::size_t>(input.gcount()) == size;
+}
+}
+
+NetworkProviderCapture::NetworkProviderCapture(
+        INetworkProvider& wrapped,
+        std::ostream& output,
+        boost::asio::ip::udp::endpoint localAddress,
+        TimeFunction timepiece)
+    : INetworkProvider()
+    , myWrapped(&wrapped)
+    , myOutput(&output)
+    , myLocalAddress(localAddress)
+    , myTimeNow(timepiece)
+    , myStartSteady(myTimeNow())
+    , myStartNanoseconds(static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::system_clock::now().time_since_epoch()).count()))
+    , myRecordsWritten(0)
+    , myRecordsSkipped(0)
+    , myBuffer()
+{
+    // pcap headers are in the writer's byte order. Version 2.4, then
+    // thiszone and sigfigs which are always 0.
+    const uint32_t header[FileHeaderSize / 4] =
+    {
+        MagicNanoseconds,
+        0x00040002,
+        0,
+        0,
+        SnapLength,
+        LinkTypeRaw
+    };
+
+    myOutput->write(reinterpret_cast<const char*>(header), sizeof(header));
+}
+
+void NetworkProviderCapture::Write(OClock time, bool incoming, const NetworkPacket& packet)
+{
+    auto local = LocalFor(myLocalAddress, packet.address);
+
+    auto built = incoming ?
+            BuildDatagram(myBuffer, packet.address, local, packet.data) :
+            BuildDatagram(myBuffer, local, packet.address, packet.data);
+
+    if (!built)
+    {
+        ++myRecordsSkipped;
+        return;
+    }
+
+    auto since = std::chrono::duration_cast<std::chrono::nanoseconds>(time - myStartSteady).count();
+    auto nanoseconds = myStartNanoseconds + static_cast<uint64_t>(std::max<decltype(since)>(since, 0));
+    auto size = static_cast<uint32_t>(myBuffer.size());
+
+    const uint32_t header[RecordHeaderSize / 4] =
+    {
+        static_cast<uint32_t>(nanoseconds / 1000000000ull),
+        static_cast<uint32_t>(nanoseconds % 1000000000ull),
+        size,
+        size
+    };
+
+    myOutput->write(reinterpret_cast<const char*>(header), sizeof(header));
+    myOutput->write(reinterpret_cast<const char*>(myBuffer.data()), static_cast<std::streamsize>(myBuffer.size()));
+
+    ++myRecordsWritten;
+}
+
+std::vector<NetworkPacket> NetworkProviderCapture::PrivateReceive()
+{
+    auto result = myWrapped->Receive();
+    auto now = myTimeNow();
+
+    // Prefer the provider's (maybe kernel) stamp, if it made one.
+    for (const auto& packet : result)
+    {
+        Write((packet.received != OClock{}) ? packet.received : now, true, packet);
+    }
+
+    return result;
+}
+
+void NetworkProviderCapture::PrivateSend(std::vector<NetworkPacket> packets)
+{
+    auto now = myTimeNow();
+
+    for (const auto& packet : packets)
+    {
+        Write(now, false, packet);
+    }
+
+    myWrapped->Send(std::move(packets));
+}
+
+void NetworkProviderCapture::PrivateReset()
+{
+    myWrapped->Reset();
+}
+
+void NetworkProviderCapture::PrivateFlush()
+{
+    myWrapped->Flush();
+    myOutput->flush();
+}
+
+void NetworkProviderCapture::PrivateDisable()
+{
+    myWrapped->Disable();
+}
+
+bool NetworkProviderCapture::PrivateIsDisabled() const
+{
+    return myWrapped->IsDisabled();
+}
+
+std::vector<NetworkProviderCapture::Record> NetworkProviderCapture::Load(
+        std::istream& input,
+        boost::asio::ip::udp::endpoint localAddress)
+{
+    uint8_t header[FileHeaderSize];
+
+    if (!ReadBytes(input, header, FileHeaderSize))
+    {
+        throw std::logic_error("Capture is too short for a pcap header.");
+    }
+
+    auto swapped = false;
+    auto nanosecondStamps = false;
+    auto magic = ReadNative32(header, false);
+
+    if ((magic == MagicNanoseconds) || (magic == MagicMicroseconds))
+    {
+        nanosecondStamps = (magic == MagicNanoseconds);
+    }
+    else
+    {
+        magic = ReadNative32(header, true);
+
+        if ((magic != MagicNanoseconds) && (magic != MagicMicroseconds))
+        {
+            throw std::logic_error("Capture isn't a pcap file.");
+        }
+
+        swapped = true;
+        nanosecondStamps = (magic == MagicNanoseconds);
+    }
+
+    if (ReadNative32(header + 20, swapped) != LinkTypeRaw)
+    {
+        throw std::logic_error("Capture isn't raw IP, only link type 101 is supported.");
+    }
+
+    auto snapLength = ReadNative32(header + 16, swapped);
+
+    if ((snapLength == 0) || (snapLength > MaximumSnapLength))
+    {
+        snapLength = MaximumSnapLength;
+    }
+
+    // If we can tell how much is left, a record can't be bigger than that.
+    auto bytesLeft = std::numeric_limits<uint64_t>::max();
+    auto start = input.tellg();
+
+    if (start != std::istream::pos_type(-1))
+    {
+        input.seekg(0, std::ios::end);
+
+        auto finish = input.tellg();
+
+        input.seekg(start);
+
+        if ((finish != std::istream::pos_type(-1)) && (finish >= start))
+        {
+            bytesLeft = static_cast<uint64_t>(finish - start);
+        }
+    }
+
+    std::vector<Record> result;
+    std::vector<uint8_t> datagram;
+
+    for (;;)
+    {
+        uint8_t recordHeader[RecordHeaderSize];
+
+        if (!ReadBytes(input, recordHeader, RecordHeaderSize))
+        {
+            break;
+        }
+
+        bytesLeft -= std::min<uint64_t>(bytesLeft, RecordHeaderSize);
+
+        auto seconds = ReadNative32(recordHeader, swapped);
+        auto fraction = ReadNative32(recordHeader + 4, swapped);
+        auto size = ReadNative32(recordHeader + 8, swapped);
+
+        if (size > snapLength)
+        {
+            throw std::logic_error("Capture has a record bigger than its snap length.");
+        }
+
+        // Truncated.
+        if (size > bytesLeft)
+        {
+            break;
+        }
+
+        datagram.resize(size);
+
+        if (!ReadBytes(input, datagram.data(), size))
+        {
+            break;
+        }
+
+        bytesLeft -= size;
+
+        // Skip anything that isn't a whole UDP datagram.
+        if (size < 1)
+        {
+            continue;
+        }
+
+        udp::endpoint source;
+        udp::endpoint destination;
+        std::size_t udpStart = 0;
+
+        if ((datagram[0] >> 4) == 4)
+        {
+            std::size_t headerSize = (datagram[0] & 0x0F) * 4u;
+
+            if  (
+                    (headerSize < Ip4HeaderSize) ||
+                    (size < headerSize + UdpHeaderSize) ||
+                    (datagram[9] != ProtocolUdp)
+                )
+            {
+                continue;
+            }
+
+            // Fragments, more to come or offset.
+            if (ReadBig16(&datagram[6]) & 0x3FFF)
+            {
+                continue;
+            }
+
+            address_v4::bytes_type from;
+            address_v4::bytes_type to;
+
+            std::copy(&datagram[12], &datagram[16], begin(from));
+            std::copy(&datagram[16], &datagram[20], begin(to));
+
+            source.address(address_v4(from));
+            destination.address(address_v4(to));
+            udpStart = headerSize;
+        }
+        else if ((datagram[0] >> 4) == 6)
+        {
+            // No extension header support.
+            if ((size < Ip6HeaderSize + UdpHeaderSize) || (datagram[6] != ProtocolUdp))
+            {
+                continue;
+            }
+
+            address_v6::bytes_type from;
+            address_v6::bytes_type to;
+
+            std::copy(&datagram[8], &datagram[24], begin(from));
+            std::copy(&datagram[24], &datagram[40], begin(to));
+
+            source.address(address_v6(from));
+            destination.address(address_v6(to));
+            udpStart = Ip6HeaderSize;
+        }
+        else
+        {
+            continue;
+        }
+
+        source.port(ReadBig16(&datagram[udpStart]));
+        destination.port(ReadBig16(&datagram[udpStart + 2]));
+
+        auto udpSize = std::min<std::size_t>(ReadBig16(&datagram[udpStart + 4]), size - udpStart);
+
+        if (udpSize < UdpHeaderSize)
+        {
+            continue;
+        }
+
+        auto payloadStart = begin(datagram) + static_cast<std::ptrdiff_t>(udpStart + UdpHeaderSize);
+        auto payloadEnd = begin(datagram) + static_cast<std::ptrdiff_t>(udpStart + udpSize);
+        auto incoming = (destination == LocalFor(localAddress, source));
+        auto nanoseconds =
+                (uint64_t(seconds) * 1000000000ull) +
+                (nanosecondStamps ? fraction : (uint64_t(fraction) * 1000));
+
+        result.push_back(Record{
+                nanoseconds,
+                incoming,
+                NetworkPacket{
+                    std::vector<uint8_t>(payloadStart, payloadEnd),
+                    incoming ? source : destination}});
+    }
+
+    return result;
+}
@@ -0,0 +1,107 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef NETWORKPROVIDERCAPTURE_HPP
+#define NETWORKPROVIDERCAPTURE_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <vector>
+#include <iosfwd>
+#include <boost/asio/ip/udp.hpp>
+#endif
+
+#include "Units.hpp"
+#include "INetworkProvider.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+// Wraps another provider and writes every datagram it sends or receives to
+// output as a pcap file (nanosecond timestamps, raw IP link type), so it
+// opens in wireshark or tcpdump as well as NetworkProviderReplay.
+//
+// Providers don't know their own address, so each packet gets a made up
+// IP/UDP header using localAddress as the other end. Sent packets come
+// from localAddress, received ones go to it. Replay needs the same
+// localAddress to tell them apart, the default (0.0.0.0:0) is fine for both.
+//
+// output must outlive this. Flush() flushes it too.
+class NetworkProviderCapture final : public INetworkProvider
+{
+public:
+    struct Record
+    {
+        // Since the unix epoch, as written in the capture.
+        uint64_t nanoseconds;
+        bool incoming;
+
+        // address is the far end.
+        NetworkPacket packet;
+    };
+
+    NetworkProviderCapture(
+            INetworkProvider& wrapped,
+            std::ostream& output,
+            boost::asio::ip::udp::endpoint localAddress = {},
+            TimeFunction timepiece = Clock::now);
+
+    uint64_t RecordsWritten() const { return myRecordsWritten; }
+
+    // Packets too big to fit in an IP datagram, they aren't written.
+    uint64_t RecordsSkipped() const { return myRecordsSkipped; }
+
+    // Reads a whole capture. Throws std::logic_error if it isn't a raw IP
+    // pcap, or a record is bigger than the snap length. A truncated last
+    // record (crash mid write) is ignored, as are records that aren't a
+    // whole UDP datagram.
+    static std::vector<Record> Load(
+            std::istream& input,
+            boost::asio::ip::udp::endpoint localAddress = {});
+
+private:
+    INetworkProvider* myWrapped;
+    std::ostream* myOutput;
+    boost::asio::ip::udp::endpoint myLocalAddress;
+    TimeFunction myTimeNow;
+
+    // Timestamps are steady time offset from the wall clock at construction.
+    OClock myStartSteady;
+    uint64_t myStartNanoseconds;
+
+    uint64_t myRecordsWritten;
+    uint64_t myRecordsSkipped;
+
+    // Scratch space, kept to save allocating each packet.
+    std::vector<uint8_t> myBuffer;
+
+    void Write(OClock time, bool incoming, const NetworkPacket& packet);
+
+    // INetworkProvider Methods.
+    std::vector<NetworkPacket> PrivateReceive() override;
+    void PrivateSend(std::vector<NetworkPacket> packets) override;
+    void PrivateReset() override;
+    void PrivateFlush() override;
+    void PrivateDisable() override;
+    bool PrivateIsDisabled() const override;
+};
+
+}}} // namespace
+
+#endif // NETWORKPROVIDERCAPTURE_HPP
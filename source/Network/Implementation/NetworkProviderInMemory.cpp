@@ -18,6 +18,13 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>
 */
 
+#ifndef USING_PRECOMPILED_HEADERS
+#include <algorithm>
+#include <cmath>
+#else
+#include "Common/PrecompiledHeaders.hpp"
+#endif
+
 #include "NetworkPacket.hpp"
 #include "NetworkProviderInMemory.hpp"
 
@@ -28,12 +35,16 @@ NetworkProviderInMemory::NetworkProviderInMemory(
         TimeFunction timepiece)
     : INetworkProvider()
     , myAddressToPackets()
+    , myLinks()
     , myCurrentSource()
     , myNetworkIsDisabled(false)
     , myTimeNow(timepiece)
     , myDefaultSettings(defaultSettings)
     , mySettings({{}, {}, Milliseconds{0},0,0,0})
     , losingPackets(false)
+    , myNextOrder(0)
+    , myDue()
+    , myQueues()
 {
 
 }
@@ -63,28 +74,75 @@ void NetworkProviderInMemory::RunAs(boost::asio::ip::udp::endpoint clientAddress
     mySettings =  settings;
 }
 
+void NetworkProviderInMemory::SetLink(
+        boost::asio::ip::udp::endpoint address,
+        LinkSettings up,
+        LinkSettings down)
+{
+    // Different seeds for each direction, otherwise a symmetric link would
+    // drop and duplicate the same packets both ways.
+    myLinks[address] = Link{
+            Direction{up, std::minstd_rand{up.seed}, {}},
+            Direction{down, std::minstd_rand{down.seed ^ 0x9E3779B9u}, {}},
+            LinkCounters{0, 0, 0, 0, 0, 0}};
+}
+
+NetworkProviderInMemory::LinkCounters NetworkProviderInMemory::Counters(
+        const boost::asio::ip::udp::endpoint& address) const
+{
+    auto found = myLinks.find(address);
+
+    if (found != end(myLinks))
+    {
+        return found->second.counters;
+    }
+
+    return LinkCounters{0, 0, 0, 0, 0, 0};
+}
+
 std::vector<NetworkPacket> NetworkProviderInMemory::PrivateReceive()
 {
-    if (myAddressToPackets.count(myCurrentSource) > 0)
+    auto found = myAddressToPackets.find(myCurrentSource);
+
+    if (found != end(myAddressToPackets))
     {
-        std::vector<NetworkPacket> result;
-        std::vector<TimePacket> keep;
+        auto& heap = found->second.heap;
         auto now = myTimeNow();
 
-        for (auto& timePacket : myAddressToPackets.at(myCurrentSource))
+        myDue.clear();
+
+        while ((!heap.empty()) && (heap.front().timeToRelease <= now))
         {
-            if (timePacket.timeToRelease <= now)
-            {
-                result.emplace_back(std::move(timePacket.data));
-            }
-            else
+            std::pop_heap(begin(heap), end(heap), ReleasedLater);
+            myDue.emplace_back(std::move(heap.back()));
+            heap.pop_back();
+        }
+
+        std::sort(begin(myDue), end(myDue), [] (const TimePacket& left, const TimePacket& right)
+        {
+            return left.order < right.order;
+        });
+
+        std::vector<NetworkPacket> result;
+        result.reserve(myDue.size());
+
+        for (auto& timePacket : myDue)
+        {
+            result.emplace_back(std::move(timePacket.data));
+        }
+
+        auto link = myLinks.find(myCurrentSource);
+
+        if (link != end(myLinks))
+        {
+            link->second.counters.packetsReceived += result.size();
+
+            for (const auto& packet : result)
             {
-                keep.emplace_back(std::move(timePacket));
+                link->second.counters.bytesReceived += packet.data.size();
             }
         }
 
-        swap(keep, myAddressToPackets.at(myCurrentSource));
-
         return result;
     }
 
@@ -93,27 +151,41 @@ std::vector<NetworkPacket> NetworkProviderInMemory::PrivateReceive()
 
 void NetworkProviderInMemory::PrivateSend(std::vector<NetworkPacket> packets)
 {
-    OClock timeToRelease{};
+    auto now = myTimeNow();
+    auto lag = Clock::duration::zero();
 
     // latency
     if (mySettings.latencyMinimum.count() > 0)
     {
-        auto lag = std::max(
+        lag = std::max(
                     Milliseconds{static_cast<MillisecondStorageType>(mySettings.latency())},
                     mySettings.latencyMinimum);
+    }
+
+    auto timeToRelease = now + lag;
 
-        timeToRelease = myTimeNow() + lag;
+    Link* upLink = nullptr;
+    auto foundUp = myLinks.find(myCurrentSource);
+
+    if (foundUp != end(myLinks))
+    {
+        upLink = &foundUp->second;
     }
-    else
+
+    // unordered_map references are stable, so only look each one up once.
+    myQueues.clear();
+
+    for (std::size_t i = 0; i < packets.size(); ++i)
     {
-        timeToRelease = myTimeNow();
+        auto& queue = myAddressToPackets[packets[i].address];
+
+        queue.lastInSend = i;
+        myQueues.push_back(&queue);
     }
 
-    for (auto packet : packets)
+    for (std::size_t i = 0; i < packets.size(); ++i)
     {
-        auto timepacket = TimePacket{timeToRelease, NetworkPacket{std::move(packet.data), myCurrentSource}};
-        auto& vector = myAddressToPackets[packet.address];
-        vector.emplace_back(std::move(timepacket));
+        auto& packet = packets[i];
 
         // packet drop
         if (mySettings.packetLossChancePerPacket0to1 > 0)
@@ -129,37 +201,187 @@ void NetworkProviderInMemory::PrivateSend(std::vector<NetworkPacket> packets)
                 lostIt = (mySettings.random0To1() <= mySettings.packetLossChancePerPacket0to1);
             }
 
+            losingPackets = lostIt;
+
             if (lostIt)
             {
-                vector.erase(end(vector) - 1);
-                losingPackets = true;
-            }
-            else
-            {
-                losingPackets = false;
+                continue;
             }
         }
-    }
 
-    // packet swap.
-    if (mySettings.packetOutOfOrderChance0to1 > 0)
-    {
-        if (mySettings.random0To1() <= mySettings.packetOutOfOrderChance0to1)
+        auto release = timeToRelease;
+        bool duplicate = false;
+
+        if (!myLinks.empty())
         {
-            for (auto& addressPackets : myAddressToPackets)
+            auto bytes = packet.data.size();
+            auto offTheLink = now;
+            auto jitter = Clock::duration::zero();
+
+            if (upLink != nullptr)
             {
-                auto& packets = addressPackets.second;
+                offTheLink = Admit(upLink->up, offTheLink, bytes);
 
-                if (packets.size() > 1)
+                if (offTheLink == OClock::max())
                 {
-                    using namespace std;
+                    ++upLink->counters.packetsDropped;
+                    continue;
+                }
+
+                ++upLink->counters.packetsSent;
+                upLink->counters.bytesSent += bytes;
+
+                jitter += JitterFor(upLink->up);
 
-                    // just swap the first and last packets.
-                    swap(packets.back(), packets.front());
+                if (Duplicate(upLink->up))
+                {
+                    ++upLink->counters.packetsDuplicated;
+                    duplicate = true;
                 }
             }
+
+            auto foundDown = myLinks.find(packet.address);
+
+            if (foundDown != end(myLinks))
+            {
+                auto& downLink = foundDown->second;
+
+                offTheLink = Admit(downLink.down, offTheLink, bytes);
+
+                if (offTheLink == OClock::max())
+                {
+                    ++downLink.counters.packetsDropped;
+                    continue;
+                }
+
+                jitter += JitterFor(downLink.down);
+
+                if (Duplicate(downLink.down))
+                {
+                    ++downLink.counters.packetsDuplicated;
+                    duplicate = true;
+                }
+            }
+
+            release = offTheLink + lag + jitter;
+        }
+
+        auto timePacket = TimePacket{release, myNextOrder++, NetworkPacket{std::move(packet.data), myCurrentSource}};
+        auto& heap = myQueues[i]->heap;
+
+        if (duplicate)
+        {
+            // Copy made before any reordering, so it's the packet that was sent.
+            heap.emplace_back(TimePacket{release, myNextOrder++, timePacket.data});
+            std::push_heap(begin(heap), end(heap), ReleasedLater);
+        }
+
+        // packet swap, the last packet to each destination can jump the queue.
+        if ((mySettings.packetOutOfOrderChance0to1 > 0) && (myQueues[i]->lastInSend == i) && (!heap.empty()))
+        {
+            if (mySettings.random0To1() <= mySettings.packetOutOfOrderChance0to1)
+            {
+                using std::swap;
+
+                // Swap the contents of the next packet out with this one,
+                // leaving the release times and order alone keeps the heap valid.
+                swap(heap.front().data, timePacket.data);
+            }
         }
+
+        heap.emplace_back(std::move(timePacket));
+        std::push_heap(begin(heap), end(heap), ReleasedLater);
+    }
+}
+
+bool NetworkProviderInMemory::ReleasedLater(const TimePacket& left, const TimePacket& right)
+{
+    if (left.timeToRelease == right.timeToRelease)
+    {
+        return left.order > right.order;
+    }
+
+    return left.timeToRelease > right.timeToRelease;
+}
+
+OClock NetworkProviderInMemory::Admit(Direction& direction, OClock arrival, std::size_t bytes)
+{
+    if (direction.settings.bytesPerSecond == 0)
+    {
+        return arrival;
+    }
+
+    auto& onTheWire = direction.onTheWire;
+
+    while ((!onTheWire.empty()) && (onTheWire.front() <= arrival))
+    {
+        onTheWire.pop_front();
+    }
+
+    if ((direction.settings.queueLimit > 0) && (onTheWire.size() >= direction.settings.queueLimit))
+    {
+        return OClock::max();
     }
+
+    auto start = onTheWire.empty() ? arrival : std::max(arrival, onTheWire.back());
+    auto serialise = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::nanoseconds{(bytes * 1000000000ull) / direction.settings.bytesPerSecond});
+
+    onTheWire.push_back(start + serialise);
+
+    return onTheWire.back();
+}
+
+Clock::duration NetworkProviderInMemory::JitterFor(Direction& direction)
+{
+    using FloatMilliseconds = std::chrono::duration<float, std::milli>;
+
+    auto scale = static_cast<float>(direction.settings.jitterScale.count());
+
+    if (scale <= 0)
+    {
+        return Clock::duration::zero();
+    }
+
+    auto jitter = 0.0f;
+
+    switch (direction.settings.jitter)
+    {
+        case LinkSettings::Jitter::None:
+        {
+            break;
+        }
+
+        case LinkSettings::Jitter::Uniform:
+        {
+            jitter = std::uniform_real_distribution<float>{0, scale}(direction.random);
+            break;
+        }
+
+        case LinkSettings::Jitter::Normal:
+        {
+            jitter = std::fabs(std::normal_distribution<float>{0, scale}(direction.random));
+            break;
+        }
+
+        case LinkSettings::Jitter::Exponential:
+        {
+            jitter = std::exponential_distribution<float>{1.0f / scale}(direction.random);
+            break;
+        }
+    }
+
+    return std::chrono::duration_cast<Clock::duration>(FloatMilliseconds{jitter});
+}
+
+bool NetworkProviderInMemory::Duplicate(Direction& direction)
+{
+    if (direction.settings.duplicateChance0to1 <= 0)
+    {
+        return false;
+    }
+
+    return std::uniform_real_distribution<float>{0, 1}(direction.random) < direction.settings.duplicateChance0to1;
 }
 
 void NetworkProviderInMemory::PrivateReset()
@@ -167,6 +389,13 @@ void NetworkProviderInMemory::PrivateReset()
     myNetworkIsDisabled = false;
     losingPackets = false;
     myAddressToPackets = {};
+
+    // Links are settings, keep them (and their counters), but empty the queues.
+    for (auto& link : myLinks)
+    {
+        link.second.up.onTheWire.clear();
+        link.second.down.onTheWire.clear();
+    }
 }
 
 void NetworkProviderInMemory::PrivateFlush()
@@ -25,7 +25,10 @@
 #include <memory>
 #include <boost/asio.hpp>
 #include <unordered_map>
+#include <vector>
+#include <deque>
 #include <chrono>
+#include <random>
 #include <functional>
 #endif
 
@@ -55,6 +58,53 @@ public:
         float packetOutOfOrderChance0to1;
     };
 
+    // Per endpoint link model, on top of RandomSettings. Set one for the
+    // upload (packets the endpoint sends) and one for the download (packets
+    // sent to it). Each direction has its own random engine seeded from
+    // seed, so runs are repeatable whatever else uses random numbers.
+    struct LinkSettings
+    {
+        enum class Jitter
+        {
+            None,
+
+            // [0, jitterScale)
+            Uniform,
+
+            // |N(0, jitterScale)|
+            Normal,
+
+            // Exponential with mean jitterScale, long tail like wifi.
+            Exponential
+        };
+
+        // 0 for unlimited. Packets are serialised one after another at this rate.
+        uint64_t bytesPerSecond;
+
+        // Packets waiting for (or on) the wire before tail drop, 0 for unlimited.
+        std::size_t queueLimit;
+
+        float duplicateChance0to1;
+
+        Jitter jitter;
+        Milliseconds jitterScale;
+
+        uint32_t seed;
+    };
+
+    struct LinkCounters
+    {
+        uint64_t packetsSent;
+        uint64_t bytesSent;
+
+        // Tail drops from a full queue, both directions.
+        uint64_t packetsDropped;
+        uint64_t packetsDuplicated;
+
+        uint64_t packetsReceived;
+        uint64_t bytesReceived;
+    };
+
     // defaultSettings are used by RunAs if none are provided.
     NetworkProviderInMemory(
             RandomSettings defaultSettings,
@@ -69,14 +119,52 @@ public:
     void RunAs(boost::asio::ip::udp::endpoint clientAddress);
     void RunAs(boost::asio::ip::udp::endpoint clientAddress, RandomSettings settings);
 
+    // Replaces any existing link (and its counters) for address.
+    void SetLink(boost::asio::ip::udp::endpoint address, LinkSettings up, LinkSettings down);
+
+    // All zero if there's no link for address.
+    LinkCounters Counters(const boost::asio::ip::udp::endpoint& address) const;
+
 private:
     struct TimePacket
     {
         Clock::time_point timeToRelease;
+
+        // Send order, so packets released together come out in the order they were sent.
+        uint64_t order;
+
         NetworkPacket data;
     };
 
-    std::unordered_map<boost::asio::ip::udp::endpoint, std::vector<TimePacket>> myAddressToPackets;
+    struct Queue
+    {
+        // Min heap on timeToRelease, so Receive() only touches the packets
+        // it returns. Never shrunk, so after the first few ticks there's no allocation.
+        std::vector<TimePacket> heap;
+
+        // Index in the current Send() of the last packet to here, reordering
+        // is done once per destination per send.
+        std::size_t lastInSend;
+    };
+
+    struct Direction
+    {
+        LinkSettings settings;
+        std::minstd_rand random;
+
+        // When each packet still queued finishes being sent, oldest first.
+        std::deque<OClock> onTheWire;
+    };
+
+    struct Link
+    {
+        Direction up;
+        Direction down;
+        LinkCounters counters;
+    };
+
+    std::unordered_map<boost::asio::ip::udp::endpoint, Queue> myAddressToPackets;
+    std::unordered_map<boost::asio::ip::udp::endpoint, Link> myLinks;
     boost::asio::ip::udp::endpoint myCurrentSource;
     bool myNetworkIsDisabled;
     TimeFunction myTimeNow;
@@ -86,6 +174,20 @@ private:
     RandomSettings mySettings;
     bool losingPackets;
 
+    uint64_t myNextOrder;
+
+    // Scratch space, kept to save allocating each call.
+    std::vector<TimePacket> myDue;
+    std::vector<Queue*> myQueues;
+
+    // Heap comparison, gives a min heap on (timeToRelease, order).
+    static bool ReleasedLater(const TimePacket& left, const TimePacket& right);
+
+    // Returns when the packet is off the link, or OClock::max() if the queue is full.
+    static OClock Admit(Direction& direction, OClock arrival, std::size_t bytes);
+    static Clock::duration JitterFor(Direction& direction);
+    static bool Duplicate(Direction& direction);
+
     // INetworkProvider Methods.
     std::vector<NetworkPacket> PrivateReceive() override;
     void PrivateSend(std::vector<NetworkPacket> packets) override;
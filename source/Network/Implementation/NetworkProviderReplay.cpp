@@ -0,0 +1,125 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <algorithm>
+#else
+#include "Common/PrecompiledHeaders.hpp"
+#endif
+
+#include "NetworkPacket.hpp"
+#include "NetworkProviderReplay.hpp"
+
+using namespace GameInABox::Network;
+using namespace GameInABox::Network::Implementation;
+
+NetworkProviderReplay::NetworkProviderReplay(
+        std::istream& capture,
+        float speed,
+        boost::asio::ip::udp::endpoint localAddress,
+        TimeFunction timepiece)
+    : INetworkProvider()
+    , myRecords(NetworkProviderCapture::Load(capture, localAddress))
+    , myNext(0)
+    , mySpeed(speed)
+    , myTimeNow(timepiece)
+    , myStarted(false)
+    , myStart()
+    , myPacketsSent(0)
+    , myNetworkIsDisabled(false)
+{
+    myRecords.erase(
+        std::remove_if(begin(myRecords), end(myRecords), [] (const NetworkProviderCapture::Record& record)
+        {
+            return !record.incoming;
+        }),
+        end(myRecords));
+}
+
+std::vector<NetworkPacket> NetworkProviderReplay::PrivateReceive()
+{
+    if (myNetworkIsDisabled || Finished())
+    {
+        return {};
+    }
+
+    auto now = myTimeNow();
+
+    if (!myStarted)
+    {
+        myStarted = true;
+        myStart = now;
+    }
+
+    auto first = myRecords.front().nanoseconds;
+    uint64_t upTo = 0;
+
+    if (mySpeed > 0)
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - myStart).count();
+
+        upTo = first + static_cast<uint64_t>(static_cast<double>(elapsed) * mySpeed);
+    }
+    else
+    {
+        upTo = myRecords[myNext].nanoseconds;
+    }
+
+    std::vector<NetworkPacket> result;
+
+    while ((myNext < myRecords.size()) && (myRecords[myNext].nanoseconds <= upTo))
+    {
+        result.push_back(myRecords[myNext].packet);
+        result.back().received = now;
+        ++myNext;
+    }
+
+    return result;
+}
+
+void NetworkProviderReplay::PrivateSend(std::vector<NetworkPacket> packets)
+{
+    if (!myNetworkIsDisabled)
+    {
+        myPacketsSent += packets.size();
+    }
+}
+
+void NetworkProviderReplay::PrivateReset()
+{
+    myNetworkIsDisabled = false;
+    myNext = 0;
+    myStarted = false;
+}
+
+void NetworkProviderReplay::PrivateFlush()
+{
+    // NADA
+}
+
+void NetworkProviderReplay::PrivateDisable()
+{
+    myNetworkIsDisabled = true;
+}
+
+bool NetworkProviderReplay::PrivateIsDisabled() const
+{
+    return myNetworkIsDisabled;
+}
@@ -0,0 +1,88 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef NETWORKPROVIDERREPLAY_HPP
+#define NETWORKPROVIDERREPLAY_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <vector>
+#include <iosfwd>
+#include <boost/asio/ip/udp.hpp>
+#endif
+
+#include "Units.hpp"
+#include "NetworkProviderCapture.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+// Plays back the received packets from a NetworkProviderCapture (or any raw
+// IP pcap) so decoders and the server can be benchmarked on real traffic
+// without real players. Sent packets are counted and thrown away.
+//
+// speed is how much faster than real time to play it back, 1 for the
+// original timing, 10 for ten times faster. 0 means as fast as possible,
+// each Receive() returns the next group of packets captured with the same
+// timestamp. Providers that stamp NetworkPacket::received give each packet
+// its own time, so that's one packet. For the ones that don't, it's one
+// Receive() of the original provider.
+//
+// The clock starts at the first Receive(), not at construction.
+// Reset() starts again from the beginning.
+class NetworkProviderReplay final : public INetworkProvider
+{
+public:
+    NetworkProviderReplay(
+            std::istream& capture,
+            float speed,
+            boost::asio::ip::udp::endpoint localAddress = {},
+            TimeFunction timepiece = Clock::now);
+
+    // True once every captured packet has been returned.
+    bool Finished() const { return myNext >= myRecords.size(); }
+
+    std::size_t PacketsTotal() const { return myRecords.size(); }
+    uint64_t PacketsSent() const { return myPacketsSent; }
+
+private:
+    // Only the incoming ones, in capture order.
+    std::vector<NetworkProviderCapture::Record> myRecords;
+    std::size_t myNext;
+
+    float mySpeed;
+    TimeFunction myTimeNow;
+    bool myStarted;
+    OClock myStart;
+
+    uint64_t myPacketsSent;
+    bool myNetworkIsDisabled;
+
+    // INetworkProvider Methods.
+    std::vector<NetworkPacket> PrivateReceive() override;
+    void PrivateSend(std::vector<NetworkPacket> packets) override;
+    void PrivateReset() override;
+    void PrivateFlush() override;
+    void PrivateDisable() override;
+    bool PrivateIsDisabled() const override;
+};
+
+}}} // namespace
+
+#endif // NETWORKPROVIDERREPLAY_HPP
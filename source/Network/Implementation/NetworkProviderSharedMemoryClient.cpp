@@ -0,0 +1,159 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <stdexcept>
+#include <boost/interprocess/shared_memory_object.hpp>
+#else
+#include "Common/PrecompiledHeaders.hpp"
+#endif
+
+#include "MakeUnique.hpp"
+#include "NetworkPacket.hpp"
+#include "NetworkProviderSharedMemoryClient.hpp"
+
+using namespace boost::interprocess;
+using namespace GameInABox::Network;
+using namespace GameInABox::Network::Implementation;
+
+using Server = NetworkProviderSharedMemoryServer;
+
+NetworkProviderSharedMemoryClient::NetworkProviderSharedMemoryClient(
+        std::string name,
+        TimeFunction timepiece)
+    : INetworkProvider()
+    , myRegion()
+    , mySlot(nullptr)
+    , mySlotIndex(0)
+    , myTimeNow(timepiece)
+    , myDropped(0)
+    , myNetworkIsDisabled(false)
+    , myBuffer()
+{
+    shared_memory_object segment(open_only, name.c_str(), read_write);
+
+    myRegion = make_unique<mapped_region>(segment, read_write);
+
+    auto base = static_cast<uint8_t*>(myRegion->get_address());
+    auto header = reinterpret_cast<Server::Header*>(base);
+
+    if ((myRegion->get_size() < sizeof(Server::Header)) ||
+        (header->version.load(std::memory_order_acquire) != Server::Version) ||
+        (header->magic != Server::Magic) ||
+        (myRegion->get_size() < Server::SegmentSize(header->slotCount)))
+    {
+        throw std::runtime_error("Shared memory segment '" + name + "' isn't a server, or is a different version.");
+    }
+
+    for (std::size_t i = 0; i < header->slotCount; ++i)
+    {
+        auto slot = reinterpret_cast<Server::Slot*>(base + Server::SlotOffset(i));
+        auto expected = static_cast<uint32_t>(Server::SlotState::Free);
+
+        if (slot->state.compare_exchange_strong(expected, static_cast<uint32_t>(Server::SlotState::Claiming)))
+        {
+            // The server leaves Claiming slots alone, so this is safe.
+            slot->toServer.Reset();
+            slot->toClient.Reset();
+            slot->toClientBell.Reset();
+            slot->state.store(static_cast<uint32_t>(Server::SlotState::Active), std::memory_order_release);
+
+            mySlot = slot;
+            mySlotIndex = i;
+
+            return;
+        }
+    }
+
+    throw std::runtime_error("Shared memory segment '" + name + "' has no free slots.");
+}
+
+NetworkProviderSharedMemoryClient::~NetworkProviderSharedMemoryClient()
+{
+    // Server tidies it up and frees it.
+    mySlot->state.store(static_cast<uint32_t>(Server::SlotState::Closing), std::memory_order_release);
+}
+
+void NetworkProviderSharedMemoryClient::Wait(Milliseconds timeout)
+{
+    auto& ring = mySlot->toClient;
+
+    mySlot->toClientBell.Wait([&ring] { return !ring.Empty(); }, timeout);
+}
+
+std::vector<NetworkPacket> NetworkProviderSharedMemoryClient::PrivateReceive()
+{
+    std::vector<NetworkPacket> result;
+
+    if (myNetworkIsDisabled)
+    {
+        return result;
+    }
+
+    auto now = myTimeNow();
+
+    while (mySlot->toClient.TryPop(myBuffer))
+    {
+        result.emplace_back(myBuffer, Server::ServerAddress(), now);
+    }
+
+    return result;
+}
+
+void NetworkProviderSharedMemoryClient::PrivateSend(std::vector<NetworkPacket> packets)
+{
+    if (myNetworkIsDisabled)
+    {
+        return;
+    }
+
+    for (const auto& packet : packets)
+    {
+        if (!mySlot->toServer.TryPush(packet.data.data(), packet.data.size()))
+        {
+            ++myDropped;
+        }
+    }
+}
+
+void NetworkProviderSharedMemoryClient::PrivateReset()
+{
+    myNetworkIsDisabled = false;
+
+    // Like a new socket, forget anything that's waiting.
+    while (mySlot->toClient.TryPop(myBuffer))
+    {
+    }
+}
+
+void NetworkProviderSharedMemoryClient::PrivateFlush()
+{
+    // NADA, the server has it as soon as Send() returns.
+}
+
+void NetworkProviderSharedMemoryClient::PrivateDisable()
+{
+    myNetworkIsDisabled = true;
+}
+
+bool NetworkProviderSharedMemoryClient::PrivateIsDisabled() const
+{
+    return myNetworkIsDisabled;
+}
@@ -0,0 +1,85 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef NETWORKPROVIDERSHAREDMEMORYCLIENT_HPP
+#define NETWORKPROVIDERSHAREDMEMORYCLIENT_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#endif
+
+#include "Units.hpp"
+#include "INetworkProvider.hpp"
+#include "NetworkProviderSharedMemoryServer.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+// The client end of NetworkProviderSharedMemoryServer. Claims a free slot in
+// the server's segment, then everything sent goes to the server whatever
+// its address, and everything received comes from ServerAddress(). So
+// connect to NetworkProviderSharedMemoryServer::ServerAddress().
+//
+// Throws std::runtime_error if the segment is bad or full, and
+// boost::interprocess::interprocess_exception if there's no server.
+class NetworkProviderSharedMemoryClient final : public INetworkProvider
+{
+public:
+    NetworkProviderSharedMemoryClient(
+            std::string name,
+            TimeFunction timepiece = Clock::now);
+
+    ~NetworkProviderSharedMemoryClient();
+
+    std::size_t SlotIndex() const { return mySlotIndex; }
+
+    // Blocks until there is something to Receive(), or timeout. Sleeps in
+    // the kernel rather than spinning, so bots can sit here between ticks.
+    void Wait(Milliseconds timeout);
+
+    uint64_t Dropped() const { return myDropped; }
+
+private:
+    std::unique_ptr<boost::interprocess::mapped_region> myRegion;
+    NetworkProviderSharedMemoryServer::Slot* mySlot;
+    std::size_t mySlotIndex;
+    TimeFunction myTimeNow;
+    uint64_t myDropped;
+    bool myNetworkIsDisabled;
+
+    // Scratch space, kept to save allocating each call.
+    std::vector<uint8_t> myBuffer;
+
+    // INetworkProvider Methods.
+    std::vector<NetworkPacket> PrivateReceive() override;
+    void PrivateSend(std::vector<NetworkPacket> packets) override;
+    void PrivateReset() override;
+    void PrivateFlush() override;
+    void PrivateDisable() override;
+    bool PrivateIsDisabled() const override;
+};
+
+}}} // namespace
+
+#endif // NETWORKPROVIDERSHAREDMEMORYCLIENT_HPP
@@ -0,0 +1,305 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <new>
+#include <algorithm>
+#include <boost/interprocess/shared_memory_object.hpp>
+#else
+#include "Common/PrecompiledHeaders.hpp"
+#endif
+
+#include "MakeUnique.hpp"
+#include "NetworkPacket.hpp"
+#include "NetworkProviderSharedMemoryServer.hpp"
+
+using boost::asio::ip::udp;
+using boost::asio::ip::address_v6;
+using namespace boost::interprocess;
+using namespace GameInABox::Network;
+using namespace GameInABox::Network::Implementation;
+
+const std::size_t NetworkProviderSharedMemoryServer::DefaultSlots;
+const uint32_t NetworkProviderSharedMemoryServer::Magic;
+const uint32_t NetworkProviderSharedMemoryServer::Version;
+
+namespace
+{
+const address_v6 DiscardPrefix{address_v6::bytes_type{{0x01, 0x00}}};
+
+// The generation lives in the last four bytes, the rest of the interface id is zero.
+const std::size_t PrefixBytes{8};
+const std::size_t GenerationByte{12};
+
+bool InDiscardPrefix(const address_v6& address)
+{
+    auto bytes = address.to_bytes();
+    auto prefix = DiscardPrefix.to_bytes();
+
+    return std::equal(begin(prefix), begin(prefix) + PrefixBytes, begin(bytes));
+}
+
+uint32_t GenerationOf(const address_v6& address)
+{
+    auto bytes = address.to_bytes();
+
+    return
+            (static_cast<uint32_t>(bytes[GenerationByte + 0]) << 24) |
+            (static_cast<uint32_t>(bytes[GenerationByte + 1]) << 16) |
+            (static_cast<uint32_t>(bytes[GenerationByte + 2]) << 8) |
+            (static_cast<uint32_t>(bytes[GenerationByte + 3]));
+}
+}
+
+NetworkProviderSharedMemoryServer::NetworkProviderSharedMemoryServer(
+        INetworkProvider& network,
+        std::string name,
+        std::size_t slots,
+        TimeFunction timepiece)
+    : INetworkProvider()
+    , myNetwork(&network)
+    , myName(name)
+    , myRegion()
+    , mySlots()
+    , myGenerations(slots, 0)
+    , myTimeNow(timepiece)
+    , myDropped(0)
+    , myNetworkIsDisabled(false)
+    , myBuffer()
+{
+    shared_memory_object segment(create_only, myName.c_str(), read_write);
+
+    segment.truncate(static_cast<offset_t>(SegmentSize(slots)));
+    myRegion = make_unique<mapped_region>(segment, read_write);
+
+    auto base = static_cast<uint8_t*>(myRegion->get_address());
+
+    for (std::size_t i = 0; i < slots; ++i)
+    {
+        // truncate() zero fills, which is a valid empty slot already,
+        // but construct them properly anyway.
+        auto slot = new (base + SlotOffset(i)) Slot;
+
+        slot->state.store(static_cast<uint32_t>(SlotState::Free));
+        slot->toServer.Reset();
+        slot->toClient.Reset();
+        slot->toClientBell.Reset();
+
+        mySlots.push_back(slot);
+    }
+
+    // Header last, so a client can't see a half made segment as valid.
+    auto header = new (base) Header;
+
+    header->magic = Magic;
+    header->slotCount = static_cast<uint32_t>(slots);
+    header->version.store(Version, std::memory_order_release);
+}
+
+NetworkProviderSharedMemoryServer::~NetworkProviderSharedMemoryServer()
+{
+    // Clients that still have it mapped keep working until they unmap it,
+    // they just won't get any more packets.
+    shared_memory_object::remove(myName.c_str());
+}
+
+NetworkProviderSharedMemoryServer::Metrics NetworkProviderSharedMemoryServer::GetMetrics() const
+{
+    std::size_t clients = 0;
+
+    for (auto slot : mySlots)
+    {
+        if (slot->state.load() == static_cast<uint32_t>(SlotState::Active))
+        {
+            ++clients;
+        }
+    }
+
+    return {clients, myDropped};
+}
+
+bool NetworkProviderSharedMemoryServer::Remove(const std::string& name)
+{
+    return shared_memory_object::remove(name.c_str());
+}
+
+udp::endpoint NetworkProviderSharedMemoryServer::ServerAddress()
+{
+    return {DiscardPrefix, 0};
+}
+
+udp::endpoint NetworkProviderSharedMemoryServer::AddressFor(std::size_t slot, uint32_t generation)
+{
+    auto bytes = DiscardPrefix.to_bytes();
+
+    bytes[GenerationByte + 0] = static_cast<uint8_t>(generation >> 24);
+    bytes[GenerationByte + 1] = static_cast<uint8_t>(generation >> 16);
+    bytes[GenerationByte + 2] = static_cast<uint8_t>(generation >> 8);
+    bytes[GenerationByte + 3] = static_cast<uint8_t>(generation);
+
+    return {address_v6{bytes}, static_cast<unsigned short>(slot + 1)};
+}
+
+boost::optional<std::size_t> NetworkProviderSharedMemoryServer::SlotFor(const udp::endpoint& address)
+{
+    if  (
+            (address.port() > 0) &&
+            (address.address().is_v6()) &&
+            (InDiscardPrefix(address.address().to_v6()))
+        )
+    {
+        return static_cast<std::size_t>(address.port() - 1);
+    }
+
+    return {};
+}
+
+std::size_t NetworkProviderSharedMemoryServer::SlotOffset(std::size_t slot)
+{
+    auto headerSize = ((sizeof(Header) + alignof(Slot) - 1) / alignof(Slot)) * alignof(Slot);
+
+    return headerSize + (slot * sizeof(Slot));
+}
+
+std::size_t NetworkProviderSharedMemoryServer::SegmentSize(std::size_t slots)
+{
+    return SlotOffset(slots);
+}
+
+std::vector<NetworkPacket> NetworkProviderSharedMemoryServer::PrivateReceive()
+{
+    auto result = myNetwork->Receive();
+
+    if (myNetworkIsDisabled)
+    {
+        return result;
+    }
+
+    auto now = myTimeNow();
+
+    for (std::size_t i = 0; i < mySlots.size(); ++i)
+    {
+        auto& slot = *mySlots[i];
+        auto state = static_cast<SlotState>(slot.state.load(std::memory_order_acquire));
+
+        if (state == SlotState::Closing)
+        {
+            // Client has gone, so we're the only one touching it.
+            slot.toServer.Reset();
+            slot.toClient.Reset();
+            slot.toClientBell.Reset();
+            ++myGenerations[i];
+            slot.state.store(static_cast<uint32_t>(SlotState::Free), std::memory_order_release);
+
+            continue;
+        }
+
+        if (state != SlotState::Active)
+        {
+            continue;
+        }
+
+        while (slot.toServer.TryPop(myBuffer))
+        {
+            result.emplace_back(myBuffer, AddressFor(i, myGenerations[i]), now);
+        }
+    }
+
+    return result;
+}
+
+void NetworkProviderSharedMemoryServer::PrivateSend(std::vector<NetworkPacket> packets)
+{
+    // Packets for the network are moved down to the front, so they can be
+    // passed on without copying.
+    std::size_t toNetwork = 0;
+
+    for (auto& packet : packets)
+    {
+        auto index = SlotFor(packet.address);
+
+        if (!index)
+        {
+            if (&packet != &packets[toNetwork])
+            {
+                packets[toNetwork] = std::move(packet);
+            }
+
+            ++toNetwork;
+            continue;
+        }
+
+        if (myNetworkIsDisabled || (*index >= mySlots.size()))
+        {
+            continue;
+        }
+
+        // For whoever had the slot before.
+        if (GenerationOf(packet.address.address().to_v6()) != myGenerations[*index])
+        {
+            continue;
+        }
+
+        auto& slot = *mySlots[*index];
+
+        if (slot.state.load(std::memory_order_acquire) != static_cast<uint32_t>(SlotState::Active))
+        {
+            continue;
+        }
+
+        if (slot.toClient.TryPush(packet.data.data(), packet.data.size()))
+        {
+            slot.toClientBell.Ring();
+        }
+        else
+        {
+            ++myDropped;
+        }
+    }
+
+    if (toNetwork > 0)
+    {
+        packets.erase(begin(packets) + toNetwork, end(packets));
+        myNetwork->Send(std::move(packets));
+    }
+}
+
+void NetworkProviderSharedMemoryServer::PrivateReset()
+{
+    // Local clients stay connected, there's no socket to reopen.
+    myNetworkIsDisabled = false;
+    myNetwork->Reset();
+}
+
+void NetworkProviderSharedMemoryServer::PrivateFlush()
+{
+    myNetwork->Flush();
+}
+
+void NetworkProviderSharedMemoryServer::PrivateDisable()
+{
+    myNetworkIsDisabled = true;
+    myNetwork->Disable();
+}
+
+bool NetworkProviderSharedMemoryServer::PrivateIsDisabled() const
+{
+    return myNetworkIsDisabled;
+}
@@ -0,0 +1,153 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef NETWORKPROVIDERSHAREDMEMORYSERVER_HPP
+#define NETWORKPROVIDERSHAREDMEMORYSERVER_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/optional.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#endif
+
+#include "Units.hpp"
+#include "INetworkProvider.hpp"
+#include "SharedMemoryRing.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+// Lets clients on the same machine (bots, a listen server's own player)
+// skip the kernel UDP stack. The server creates a named shared memory
+// segment with a fixed number of slots, each a pair of SharedMemoryRings.
+// A NetworkProviderSharedMemoryClient claims a free slot by name.
+//
+// This wraps the server's normal provider, so one server takes both kinds
+// of client. Each slot has a made up address in the IPv6 discard prefix
+// (100::/64, RFC 6666) so it can't clash with a real client. Packets to
+// those addresses go to the ring, everything else goes to network. The
+// address also counts how many times the slot has been reused, so whatever
+// the server still has for a client that's gone never reaches the next
+// client in its slot.
+//
+// Sending and receiving through a slot is a memcpy, no system calls. The
+// only system call is a futex wake, and only if the client is blocked in
+// Wait(). A client that crashes leaves its slot claimed until the server
+// restarts.
+class NetworkProviderSharedMemoryServer final : public INetworkProvider
+{
+public:
+    static const std::size_t DefaultSlots = 8;
+
+    // State of a slot, only the client moves it out of Free and Active,
+    // only the server moves it back to Free.
+    enum class SlotState : uint32_t
+    {
+        Free,
+        Claiming,
+        Active,
+        Closing
+    };
+
+    struct Slot
+    {
+        std::atomic<uint32_t> state;
+        SharedMemoryRing toServer;
+        SharedMemoryRing toClient;
+        SharedMemoryDoorbell toClientBell;
+    };
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t slotCount;
+
+        // Written last, the segment isn't ready until it's Version.
+        std::atomic<uint32_t> version;
+    };
+
+    static const uint32_t Magic = 0x47494142;
+    static const uint32_t Version = 1;
+
+    struct Metrics
+    {
+        std::size_t clients;
+
+        // Full ring, or datagram bigger than SharedMemoryRing::CellSize.
+        uint64_t dropped;
+    };
+
+    // Throws boost::interprocess::interprocess_exception if it can't make
+    // one, including when a segment called name already exists. That's
+    // another server, or one left by a crash, see Remove().
+    NetworkProviderSharedMemoryServer(
+            INetworkProvider& network,
+            std::string name,
+            std::size_t slots = DefaultSlots,
+            TimeFunction timepiece = Clock::now);
+
+    ~NetworkProviderSharedMemoryServer();
+
+    Metrics GetMetrics() const;
+
+    // Removes a segment left behind by a server that crashed.
+    // Don't call it while a server is still using the name.
+    static bool Remove(const std::string& name);
+
+    // What the client sees the server as.
+    static boost::asio::ip::udp::endpoint ServerAddress();
+    static boost::asio::ip::udp::endpoint AddressFor(std::size_t slot, uint32_t generation = 0);
+    static boost::optional<std::size_t> SlotFor(const boost::asio::ip::udp::endpoint& address);
+
+    // Where each slot starts in the segment, and how big the segment is.
+    static std::size_t SlotOffset(std::size_t slot);
+    static std::size_t SegmentSize(std::size_t slots);
+
+private:
+    INetworkProvider* myNetwork;
+    std::string myName;
+    std::unique_ptr<boost::interprocess::mapped_region> myRegion;
+    std::vector<Slot*> mySlots;
+
+    // Bumped every time a slot is freed, see AddressFor().
+    std::vector<uint32_t> myGenerations;
+    TimeFunction myTimeNow;
+    uint64_t myDropped;
+    bool myNetworkIsDisabled;
+
+    // Scratch space, kept to save allocating each call.
+    std::vector<uint8_t> myBuffer;
+
+    // INetworkProvider Methods.
+    std::vector<NetworkPacket> PrivateReceive() override;
+    void PrivateSend(std::vector<NetworkPacket> packets) override;
+    void PrivateReset() override;
+    void PrivateFlush() override;
+    void PrivateDisable() override;
+    bool PrivateIsDisabled() const override;
+};
+
+}}} // namespace
+
+#endif // NETWORKPROVIDERSHAREDMEMORYSERVER_HPP
@@ -19,6 +19,12 @@
 */
 
 #ifndef USING_PRECOMPILED_HEADERS
+#include <cerrno>
+#include <cstring>
+#ifdef __linux__
+#include <sys/types.h>
+#include <sys/socket.h>
+#endif
 #else
 #include "Common/PrecompiledHeaders.hpp"
 #endif
@@ -26,20 +32,150 @@
 #include "MakeUnique.hpp"
 #include "Logging.hpp"
 #include "NetworkPacket.hpp"
+#include "KernelTimestamp.hpp"
 #include "NetworkProviderSynchronous.hpp"
 
 using boost::asio::ip::udp;
+using boost::asio::ip::address_v6;
 using namespace GameInABox::Network;
 using namespace GameInABox::Network::Implementation;
 
-NetworkProviderSynchronous::NetworkProviderSynchronous(boost::asio::ip::udp::endpoint bindAddress)
+namespace
+{
+#ifdef SO_REUSEPORT
+// Boost doesn't have SO_REUSEPORT, so a SettableSocketOption of our own.
+class ReusePort
+{
+public:
+    explicit ReusePort(bool enable) : myValue(enable ? 1 : 0) {}
+
+    template<typename PROTOCOL>
+    int level(const PROTOCOL&) const { return SOL_SOCKET; }
+
+    template<typename PROTOCOL>
+    int name(const PROTOCOL&) const { return SO_REUSEPORT; }
+
+    template<typename PROTOCOL>
+    const int* data(const PROTOCOL&) const { return &myValue; }
+
+    template<typename PROTOCOL>
+    std::size_t size(const PROTOCOL&) const { return sizeof(myValue); }
+
+private:
+    int myValue;
+};
+#endif
+
+// Throws boost::system::system_error like the udp::socket constructor does.
+std::unique_ptr<udp::socket> MakeSocket(
+        boost::asio::io_service& ioService,
+        const udp::endpoint& bindAddress,
+        NetworkProviderSynchronous::Bind bind,
+        NetworkProviderSynchronous::Stack stack)
+{
+    if  (
+            (bind == NetworkProviderSynchronous::Bind::Exclusive) &&
+            (stack == NetworkProviderSynchronous::Stack::Single)
+        )
+    {
+        return make_unique<udp::socket>(ioService, bindAddress);
+    }
+
+    auto result = make_unique<udp::socket>(ioService, bindAddress.protocol());
+
+    if (bind == NetworkProviderSynchronous::Bind::SharePort)
+    {
+#ifdef SO_REUSEPORT
+        result->set_option(ReusePort(true));
+#else
+        Log(LogLevel::Warning, "SO_REUSEPORT not supported, binding exclusively.");
+#endif
+    }
+
+    if (stack == NetworkProviderSynchronous::Stack::DualStack)
+    {
+        result->set_option(boost::asio::ip::v6_only(false));
+    }
+
+    result->bind(bindAddress);
+
+    return result;
+}
+
+// So Receive() can stamp packets with when the kernel got them.
+void EnableTimestamps(udp::socket& socket)
+{
+#ifdef __linux__
+    int on{1};
+    setsockopt(socket.native_handle(), SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+#else
+    (void) socket;
+#endif
+}
+
+// v4 addresses become v4-mapped v6 (any becomes ::), v6 stays the same.
+udp::endpoint ToIpv6(const udp::endpoint& address)
+{
+    if (address.address().is_v4())
+    {
+        auto v4 = address.address().to_v4();
+
+        if (v4 == boost::asio::ip::address_v4::any())
+        {
+            return {address_v6::any(), address.port()};
+        }
+
+        return {address_v6::v4_mapped(v4), address.port()};
+    }
+
+    return address;
+}
+
+// v4-mapped v6 addresses become v4, so a client has one address however it arrived.
+udp::endpoint Normalise(const udp::endpoint& address)
+{
+    if (address.address().is_v6())
+    {
+        auto v6 = address.address().to_v6();
+
+        if (v6.is_v4_mapped())
+        {
+            return {v6.to_v4(), address.port()};
+        }
+    }
+
+    return address;
+}
+}
+
+NetworkProviderSynchronous::NetworkProviderSynchronous(
+        boost::asio::ip::udp::endpoint bindAddress,
+        Bind bind,
+        Stack stack)
     : INetworkProvider()
-    , myBindAddress(bindAddress)
+    , myBindAddress((stack == Stack::DualStack) ? ToIpv6(bindAddress) : bindAddress)
+    , myBind(bind)
+    , myStack(stack)
     , myIoService()
-    , mySocket(make_unique<boost::asio::ip::udp::socket>(myIoService, myBindAddress))
+    , mySocket(MakeSocket(myIoService, myBindAddress, myBind, myStack))
     , myAddressIsIpv4(myBindAddress.address().is_v4())
     , myAddressIsIpv6(myBindAddress.address().is_v6())
 {
+    EnableTimestamps(*mySocket);
+}
+
+boost::asio::ip::udp::endpoint NetworkProviderSynchronous::LocalAddress() const
+{
+    boost::system::error_code error;
+
+    auto result = mySocket->local_endpoint(error);
+
+    if (error)
+    {
+        return myBindAddress;
+    }
+
+    return result;
 }
 
 std::vector<NetworkPacket> NetworkProviderSynchronous::PrivateReceive()
@@ -64,17 +200,56 @@ std::vector<NetworkPacket> NetworkProviderSynchronous::PrivateReceive()
         {
             boost::asio::ip::udp::endpoint addressToUse;
             std::vector<uint8_t> dataToUse(available);
+            std::chrono::steady_clock::time_point received{};
+
+#ifdef __linux__
+            // asio can't give us the kernel's timestamp, so recvmsg ourselves.
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(timespec))];
+            iovec buffer{dataToUse.data(), dataToUse.size()};
+            msghdr header;
+
+            std::memset(&header, 0, sizeof(header));
+            header.msg_name = addressToUse.data();
+            header.msg_namelen = static_cast<socklen_t>(addressToUse.capacity());
+            header.msg_iov = &buffer;
+            header.msg_iovlen = 1;
+            header.msg_control = control;
+            header.msg_controllen = sizeof(control);
+
+            auto size = recvmsg(mySocket->native_handle(), &header, MSG_DONTWAIT);
+
+            if (size < 0)
+            {
+                if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+                {
+                    error = boost::system::error_code(errno, boost::system::system_category());
+                }
+
+                break;
+            }
 
+            addressToUse.resize(header.msg_namelen);
+            dataToUse.resize(static_cast<std::size_t>(size));
+            received = KernelTimestamp{}.FromMessage(header);
+#else
             // blocking (but shouldn't as the data is available).
+            // No kernel timestamp, leave received alone so nobody
+            // mistakes now for when it arrived.
             mySocket->receive_from(
                 boost::asio::buffer(dataToUse),
                 addressToUse,
                 0,
                 error);
+#endif
 
             if (!error)
             {
-                result.emplace_back(dataToUse, addressToUse);
+                if (myStack == Stack::DualStack)
+                {
+                    addressToUse = Normalise(addressToUse);
+                }
+
+                result.emplace_back(std::move(dataToUse), addressToUse, received);
                 available = mySocket->available(error);
             }
         }
@@ -110,6 +285,12 @@ void NetworkProviderSynchronous::PrivateSend(std::vector<NetworkPacket> packets)
             // test to see if they are the same network type (ip4/ip6)
             if (packet.data.size() > 0)
             {
+                if (myStack == Stack::DualStack)
+                {
+                    // v6 socket, so v4 has to go as v4-mapped.
+                    packet.address = ToIpv6(packet.address);
+                }
+
                 if  (
                         (packet.address.address().is_v4() == myAddressIsIpv4) &&
                         (packet.address.address().is_v6() == myAddressIsIpv6)
@@ -151,8 +332,10 @@ void NetworkProviderSynchronous::PrivateReset()
     {
         using std::swap;
 
-        auto tempSocket = make_unique<boost::asio::ip::udp::socket>(myIoService, myBindAddress);
+        auto tempSocket = MakeSocket(myIoService, myBindAddress, myBind, myStack);
         swap(mySocket, tempSocket);
+
+        EnableTimestamps(*mySocket);
     }
     catch (boost::system::system_error& socketError)
     {
@@ -33,7 +33,39 @@ namespace GameInABox { namespace Network { namespace Implementation {
 class NetworkProviderSynchronous final: public INetworkProvider
 {
 public:
-    explicit NetworkProviderSynchronous(boost::asio::ip::udp::endpoint bindAddress);
+    enum class Bind
+    {
+        Exclusive,
+
+        // SO_REUSEPORT, lets several sockets (one per thread) share the port
+        // and the kernel hashes each remote address to one of them.
+        SharePort
+    };
+
+    enum class Stack
+    {
+        // Only the bind address's family, other packets are ignored.
+        Single,
+
+        // One IPv6 socket with IPV6_V6ONLY off, so it serves IPv4 as well.
+        // An IPv4 bind address is changed to the IPv6 equivalent. IPv4
+        // clients are received as plain IPv4 addresses, not v4-mapped
+        // IPv6, so they look the same to the server as on an IPv4 socket.
+        DualStack
+    };
+
+    explicit NetworkProviderSynchronous(boost::asio::ip::udp::endpoint bindAddress)
+        : NetworkProviderSynchronous(bindAddress, Bind::Exclusive)
+    {
+    }
+
+    NetworkProviderSynchronous(
+            boost::asio::ip::udp::endpoint bindAddress,
+            Bind bind,
+            Stack stack = Stack::Single);
+
+    // The address actually bound, useful if you bound to port 0.
+    boost::asio::ip::udp::endpoint LocalAddress() const;
     NetworkProviderSynchronous()
         : NetworkProviderSynchronous(boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), 0))
     {
@@ -41,6 +73,8 @@ public:
 
 private:
     boost::asio::ip::udp::endpoint myBindAddress;
+    Bind myBind;
+    Stack myStack;
     boost::asio::io_service myIoService;
 
     // udp::socket can't be assigned, so I can't use it on the stack.
@@ -0,0 +1,314 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <condition_variable>
+#else
+#include "Common/PrecompiledHeaders.hpp"
+#endif
+
+#include "MakeUnique.hpp"
+#include "Logging.hpp"
+#include "NetworkPacket.hpp"
+#include "NetworkProviderThreaded.hpp"
+
+using boost::asio::ip::udp;
+using namespace GameInABox::Network;
+using namespace GameInABox::Network::Implementation;
+
+const std::size_t NetworkProviderThreaded::DefaultQueueSize;
+const std::size_t NetworkProviderThreaded::MaxDatagramSize;
+
+NetworkProviderThreaded::NetworkProviderThreaded(
+        boost::asio::ip::udp::endpoint bindAddress,
+        std::size_t queueSize)
+    : INetworkProvider()
+    , myBindAddress(bindAddress)
+    , myIoService()
+    , myWork(make_unique<boost::asio::io_service::work>(myIoService))
+    // Bind here so failures throw to the caller like NetworkProviderSynchronous.
+    , mySocket(make_unique<udp::socket>(myIoService, myBindAddress))
+    , myReceiveBuffer(MaxDatagramSize)
+    , myReceiveAddress()
+    , myGeneration(0)
+    , myAddressIsIpv4(myBindAddress.address().is_v4())
+    , myLocalAddressLock()
+    , myLocalAddress(myBindAddress)
+    , myReceived(queueSize)
+    , mySending(queueSize)
+    , myDisabled(false)
+    , myDrainScheduled(false)
+    , myReceiveDropped(0)
+    , mySendDropped(0)
+    , myThread()
+{
+    CacheLocalAddress();
+
+    myIoService.post([this] { StartReceive(); });
+
+    myThread = std::thread([this] { myIoService.run(); });
+}
+
+NetworkProviderThreaded::~NetworkProviderThreaded()
+{
+    myWork.reset();
+    myIoService.stop();
+
+    if (myThread.joinable())
+    {
+        myThread.join();
+    }
+}
+
+boost::asio::ip::udp::endpoint NetworkProviderThreaded::LocalAddress() const
+{
+    std::lock_guard<std::mutex> guard(myLocalAddressLock);
+
+    return myLocalAddress;
+}
+
+NetworkProviderThreaded::Metrics NetworkProviderThreaded::GetMetrics() const
+{
+    return
+    {
+        myReceived.Size(),
+        mySending.Size(),
+        myReceiveDropped.load(),
+        mySendDropped.load()
+    };
+}
+
+std::vector<NetworkPacket> NetworkProviderThreaded::PrivateReceive()
+{
+    std::vector<NetworkPacket> result;
+    NetworkPacket packet;
+
+    result.reserve(myReceived.Size());
+
+    while (myReceived.TryPop(packet))
+    {
+        result.push_back(std::move(packet));
+    }
+
+    return result;
+}
+
+void NetworkProviderThreaded::PrivateSend(std::vector<NetworkPacket> packets)
+{
+    if (myDisabled.load() || packets.empty())
+    {
+        return;
+    }
+
+    bool pushed{false};
+
+    for (auto& packet : packets)
+    {
+        if (packet.address.address().is_v4() == myAddressIsIpv4)
+        {
+            if (mySending.TryPush(std::move(packet)))
+            {
+                pushed = true;
+            }
+            else
+            {
+                ++mySendDropped;
+            }
+        }
+    }
+
+    if (pushed && !myDrainScheduled.exchange(true, std::memory_order_acq_rel))
+    {
+        myIoService.post([this]
+        {
+            // Clear it first, so anything pushed after this posts again.
+            myDrainScheduled.exchange(false, std::memory_order_acq_rel);
+            DrainSends();
+        });
+    }
+}
+
+void NetworkProviderThreaded::PrivateReset()
+{
+    PrivateDisable();
+
+    RunAndWait([this] { Open(); });
+}
+
+void NetworkProviderThreaded::PrivateFlush()
+{
+    RunAndWait([this] { DrainSends(); });
+}
+
+void NetworkProviderThreaded::PrivateDisable()
+{
+    RunAndWait([this] { Close(); });
+
+    // We're the only consumer of this one, so clear it here.
+    NetworkPacket packet;
+    while (myReceived.TryPop(packet))
+    {
+    }
+}
+
+bool NetworkProviderThreaded::PrivateIsDisabled() const
+{
+    return myDisabled.load();
+}
+
+void NetworkProviderThreaded::RunAndWait(std::function<void()> job)
+{
+    std::mutex lock;
+    std::condition_variable doneSignal;
+    bool done{false};
+
+    myIoService.post([&]
+    {
+        job();
+
+        std::lock_guard<std::mutex> guard(lock);
+        done = true;
+        doneSignal.notify_one();
+    });
+
+    std::unique_lock<std::mutex> guard(lock);
+    doneSignal.wait(guard, [&done] { return done; });
+}
+
+void NetworkProviderThreaded::CacheLocalAddress()
+{
+    boost::system::error_code error;
+
+    auto address = mySocket->local_endpoint(error);
+
+    std::lock_guard<std::mutex> guard(myLocalAddressLock);
+
+    myLocalAddress = error ? myBindAddress : address;
+}
+
+void NetworkProviderThreaded::Open()
+{
+    try
+    {
+        using std::swap;
+
+        auto tempSocket = make_unique<udp::socket>(myIoService, myBindAddress);
+        swap(mySocket, tempSocket);
+
+        ++myGeneration;
+        myDisabled = false;
+
+        CacheLocalAddress();
+
+        StartReceive();
+    }
+    catch (boost::system::system_error& socketError)
+    {
+        // is_open() will return false if this didn't work, so just report why to debug.
+        Log(
+            LogLevel::Warning,
+            "Reset Failed: (",
+            socketError.code().value(),
+            ") ",
+            socketError.what());
+    }
+}
+
+void NetworkProviderThreaded::Close()
+{
+    myDisabled = true;
+
+    boost::system::error_code ignored;
+    mySocket->close(ignored);
+
+    // We're the only consumer of this one.
+    NetworkPacket packet;
+    while (mySending.TryPop(packet))
+    {
+    }
+}
+
+void NetworkProviderThreaded::StartReceive()
+{
+    if (!mySocket->is_open())
+    {
+        return;
+    }
+
+    auto generation = myGeneration;
+
+    mySocket->async_receive_from(
+        boost::asio::buffer(myReceiveBuffer),
+        myReceiveAddress,
+        [this, generation] (const boost::system::error_code& error, std::size_t size)
+        {
+            Received(generation, error, size);
+        });
+}
+
+void NetworkProviderThreaded::Received(
+        unsigned generation,
+        const boost::system::error_code& error,
+        std::size_t size)
+{
+    if ((error == boost::asio::error::operation_aborted) || (generation != myGeneration))
+    {
+        return;
+    }
+
+    if (error)
+    {
+        Log(LogLevel::Informational, "Received Failed: (", error.value(), ") ", error.message().c_str());
+    }
+    else
+    {
+        auto packet = NetworkPacket(
+                std::vector<uint8_t>(begin(myReceiveBuffer), begin(myReceiveBuffer) + size),
+                myReceiveAddress,
+                std::chrono::steady_clock::now());
+
+        if (!myReceived.TryPush(std::move(packet)))
+        {
+            ++myReceiveDropped;
+        }
+    }
+
+    StartReceive();
+}
+
+void NetworkProviderThreaded::DrainSends()
+{
+    NetworkPacket packet;
+
+    while (mySending.TryPop(packet))
+    {
+        if (mySocket->is_open())
+        {
+            boost::system::error_code error;
+
+            mySocket->send_to(boost::asio::buffer(packet.data), packet.address, 0, error);
+
+            if (error)
+            {
+                Log(LogLevel::Informational, "Send Failed: (", error.value(), ") ", error.message().c_str());
+            }
+        }
+    }
+}
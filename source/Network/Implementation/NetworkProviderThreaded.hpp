@@ -0,0 +1,133 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef NETWORKPROVIDERTHREADED_HPP
+#define NETWORKPROVIDERTHREADED_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <boost/asio.hpp>
+#endif
+
+#include "INetworkProvider.hpp"
+#include "SpscRing.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+// Keeps socket system calls off the game thread. A dedicated I/O thread runs
+// boost::asio async receives and does the sends. Packets cross between the
+// threads through two bounded SpscRings, so Receive() never takes a lock.
+// Send() only has to wake the I/O thread (an asio post, which does lock) if
+// it isn't already due to drain the send ring.
+//
+// If a ring is full the packet is dropped and counted, same as a full socket
+// buffer would. Flush() blocks until the I/O thread has sent everything
+// queued before it. Reset() and Disable() also wait for the I/O thread.
+//
+// Only one thread (the game thread) may call the INetworkProvider methods.
+class NetworkProviderThreaded final: public INetworkProvider
+{
+public:
+    struct Metrics
+    {
+        std::size_t receiveDepth;
+        std::size_t sendDepth;
+        uint64_t receiveDropped;
+        uint64_t sendDropped;
+    };
+
+    static const std::size_t DefaultQueueSize = 1024;
+    static const std::size_t MaxDatagramSize = 9216;
+
+    explicit NetworkProviderThreaded(
+            boost::asio::ip::udp::endpoint bindAddress,
+            std::size_t queueSize = DefaultQueueSize);
+    NetworkProviderThreaded()
+        : NetworkProviderThreaded(boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), 0))
+    {
+    }
+
+    ~NetworkProviderThreaded();
+
+    // Where the socket was bound, as of the last Reset(). Any thread.
+    boost::asio::ip::udp::endpoint LocalAddress() const;
+
+    Metrics GetMetrics() const;
+
+private:
+    boost::asio::ip::udp::endpoint myBindAddress;
+    boost::asio::io_service myIoService;
+    std::unique_ptr<boost::asio::io_service::work> myWork;
+
+    // Only touched on the I/O thread once it's running.
+    std::unique_ptr<boost::asio::ip::udp::socket> mySocket;
+    std::vector<uint8_t> myReceiveBuffer;
+    boost::asio::ip::udp::endpoint myReceiveAddress;
+    // Bumped each Open() so receives for an old socket are ignored.
+    unsigned myGeneration;
+    bool myAddressIsIpv4;
+
+    // Set by the I/O thread when the socket opens, read by LocalAddress().
+    mutable std::mutex myLocalAddressLock;
+    boost::asio::ip::udp::endpoint myLocalAddress;
+
+    // I/O thread -> game thread.
+    SpscRing<NetworkPacket> myReceived;
+    // game thread -> I/O thread.
+    SpscRing<NetworkPacket> mySending;
+
+    std::atomic<bool> myDisabled;
+
+    // Set by Send() when it posts a drain, cleared by the I/O thread just
+    // before draining, so there's only ever one drain posted at a time.
+    std::atomic<bool> myDrainScheduled;
+    std::atomic<uint64_t> myReceiveDropped;
+    std::atomic<uint64_t> mySendDropped;
+
+    std::thread myThread;
+
+    std::vector<NetworkPacket> PrivateReceive() override;
+    void PrivateSend(std::vector<NetworkPacket> packets) override;
+    void PrivateReset() override;
+    void PrivateFlush() override;
+    void PrivateDisable() override;
+    bool PrivateIsDisabled() const override;
+
+    // Runs job on the I/O thread and waits for it to finish.
+    void RunAndWait(std::function<void()> job);
+
+    // I/O thread only, apart from the constructor.
+    void CacheLocalAddress();
+    void Open();
+    void Close();
+    void StartReceive();
+    void Received(unsigned generation, const boost::system::error_code& error, std::size_t size);
+    void DrainSends();
+};
+
+}}} // namespace
+
+#endif // NETWORKPROVIDERTHREADED_HPP
@@ -0,0 +1,819 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cerrno>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#else
+#include "Common/PrecompiledHeaders.hpp"
+#endif
+
+// Not in the precompiled headers, as they're linux only.
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+// Multishot recvmsg and buffer rings arrived in the same set of headers (6.0).
+#ifdef IORING_RECV_MULTISHOT
+#define HAS_IO_URING
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#endif
+
+#include "MakeUnique.hpp"
+#include "Logging.hpp"
+#include "NetworkPacket.hpp"
+#include "KernelTimestamp.hpp"
+#include "NetworkProviderSynchronous.hpp"
+#include "NetworkProviderUring.hpp"
+
+using boost::asio::ip::udp;
+using namespace GameInABox::Network;
+using namespace GameInABox::Network::Implementation;
+
+const std::size_t NetworkProviderUring::MaxDatagramSize;
+
+#ifdef HAS_IO_URING
+
+namespace
+{
+// Both must be powers of two.
+const unsigned Entries{256};
+const unsigned BufferCount{256};
+const uint16_t BufferGroup{0};
+
+// Sends are tagged SendTag + their slot.
+const uint64_t ReceiveTag{1};
+const uint64_t SendTag{2};
+
+// Leave a submission entry for rearming the receive.
+const std::size_t SendSlots{Entries - 1};
+
+// What the kernel writes at the start of each receive buffer.
+const std::size_t NameSize{sizeof(sockaddr_in6)};
+const std::size_t ControlSize{CMSG_SPACE(sizeof(timespec))};
+const std::size_t BufferSize{sizeof(io_uring_recvmsg_out) + NameSize + ControlSize + NetworkProviderUring::MaxDatagramSize};
+
+template<typename T>
+T* Offset(void* base, uint32_t offset)
+{
+    return reinterpret_cast<T*>(static_cast<uint8_t*>(base) + offset);
+}
+
+void* Map(int fd, std::size_t size, off_t offset)
+{
+    auto result = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+
+    return (result == MAP_FAILED) ? nullptr : result;
+}
+
+void Unmap(void* memory, std::size_t size)
+{
+    if (memory != nullptr)
+    {
+        munmap(memory, size);
+    }
+}
+}
+
+// The shared memory rings, mapped the same way liburing does it, but
+// without the dependency.
+struct NetworkProviderUring::Uring
+{
+    int ringFd{-1};
+    int socket{-1};
+
+    void* sqRing{nullptr};
+    std::size_t sqRingSize{0};
+    void* cqRing{nullptr};
+    std::size_t cqRingSize{0};
+    io_uring_sqe* sqes{nullptr};
+    std::size_t sqesSize{0};
+
+    unsigned* sqHead{nullptr};
+    unsigned* sqTail{nullptr};
+    unsigned sqMask{0};
+    unsigned* sqArray{nullptr};
+
+    unsigned* cqHead{nullptr};
+    unsigned* cqTail{nullptr};
+    unsigned cqMask{0};
+    io_uring_cqe* cqes{nullptr};
+
+    // Registered buffer ring, the kernel picks a buffer for each datagram.
+    io_uring_buf* bufferRing{nullptr};
+    std::size_t bufferRingSize{0};
+    uint16_t bufferTail{0};
+    std::vector<uint8_t> buffers;
+
+    // The multishot receive reads this for every datagram, so it has to live as long as we do.
+    msghdr receiveTemplate;
+    bool receiving{false};
+
+    // One per send in flight. The kernel reads the header, and the packet it
+    // points at, until the send completes, so a slot is only reused after
+    // Reap() has seen its completion.
+    std::vector<msghdr> sendHeaders;
+    std::vector<iovec> sendBuffers;
+    std::vector<NetworkPacket> sendPackets;
+    std::vector<uint16_t> freeSlots;
+
+    Uring() = default;
+    Uring(const Uring&) = delete;
+    Uring& operator=(const Uring&) = delete;
+
+    ~Uring()
+    {
+        // Closing the ring cancels everything and unregisters the buffers.
+        if (ringFd >= 0)
+        {
+            close(ringFd);
+        }
+
+        Unmap(bufferRing, bufferRingSize);
+        Unmap(sqes, sqesSize);
+
+        if (cqRing != sqRing)
+        {
+            Unmap(cqRing, cqRingSize);
+        }
+
+        Unmap(sqRing, sqRingSize);
+    }
+
+    static std::unique_ptr<Uring> Create(int socket)
+    {
+        auto result = make_unique<Uring>();
+
+        if (!result->Setup(socket))
+        {
+            return {};
+        }
+
+        return result;
+    }
+
+    bool Setup(int socketToUse)
+    {
+        socket = socketToUse;
+
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+
+        // Multishot receive can post a lot of completions between reaps.
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = Entries * 8;
+
+        ringFd = static_cast<int>(syscall(__NR_io_uring_setup, Entries, &params));
+
+        if (ringFd < 0)
+        {
+            Log(LogLevel::Informational, "io_uring_setup failed: (", errno, ") ", std::strerror(errno));
+            return false;
+        }
+
+        sqRingSize = params.sq_off.array + (params.sq_entries * sizeof(unsigned));
+        cqRingSize = params.cq_off.cqes + (params.cq_entries * sizeof(io_uring_cqe));
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            sqRingSize = std::max(sqRingSize, cqRingSize);
+            cqRingSize = sqRingSize;
+        }
+
+        sqRing = Map(ringFd, sqRingSize, IORING_OFF_SQ_RING);
+        cqRing = (params.features & IORING_FEAT_SINGLE_MMAP) ? sqRing : Map(ringFd, cqRingSize, IORING_OFF_CQ_RING);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(Map(ringFd, sqesSize, IORING_OFF_SQES));
+
+        if ((sqRing == nullptr) || (cqRing == nullptr) || (sqes == nullptr))
+        {
+            Log(LogLevel::Informational, "io_uring mmap failed: (", errno, ") ", std::strerror(errno));
+            return false;
+        }
+
+        sqHead = Offset<unsigned>(sqRing, params.sq_off.head);
+        sqTail = Offset<unsigned>(sqRing, params.sq_off.tail);
+        sqMask = *Offset<unsigned>(sqRing, params.sq_off.ring_mask);
+        sqArray = Offset<unsigned>(sqRing, params.sq_off.array);
+
+        cqHead = Offset<unsigned>(cqRing, params.cq_off.head);
+        cqTail = Offset<unsigned>(cqRing, params.cq_off.tail);
+        cqMask = *Offset<unsigned>(cqRing, params.cq_off.ring_mask);
+        cqes = Offset<io_uring_cqe>(cqRing, params.cq_off.cqes);
+
+        // The buffer ring needs to be page aligned, which mmap gives us.
+        bufferRingSize = BufferCount * sizeof(io_uring_buf);
+        bufferRing = static_cast<io_uring_buf*>(
+                    mmap(nullptr, bufferRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+
+        if (bufferRing == MAP_FAILED)
+        {
+            bufferRing = nullptr;
+            return false;
+        }
+
+        io_uring_buf_reg registration;
+        std::memset(&registration, 0, sizeof(registration));
+        registration.ring_addr = reinterpret_cast<uint64_t>(bufferRing);
+        registration.ring_entries = BufferCount;
+        registration.bgid = BufferGroup;
+
+        if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0)
+        {
+            Log(LogLevel::Informational, "io_uring buffer ring failed: (", errno, ") ", std::strerror(errno));
+            return false;
+        }
+
+        buffers.resize(BufferCount * BufferSize);
+
+        for (uint16_t i = 0; i < BufferCount; ++i)
+        {
+            Recycle(i);
+        }
+
+        std::memset(&receiveTemplate, 0, sizeof(receiveTemplate));
+        receiveTemplate.msg_namelen = NameSize;
+        receiveTemplate.msg_controllen = ControlSize;
+
+        int on{1};
+        setsockopt(socket, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+
+        sendHeaders.resize(SendSlots);
+        sendBuffers.resize(SendSlots);
+        sendPackets.resize(SendSlots);
+
+        for (std::size_t i = SendSlots; i > 0; --i)
+        {
+            freeSlots.push_back(static_cast<uint16_t>(i - 1));
+        }
+
+        // Older kernels reject the multishot flag straight away.
+        Receive();
+
+        if (Enter(1, 0) < 1)
+        {
+            return false;
+        }
+
+        auto head = *cqHead;
+
+        while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+        {
+            const auto& completion = cqes[head & cqMask];
+
+            if  (
+                    (completion.user_data == ReceiveTag) &&
+                    (!(completion.flags & IORING_CQE_F_MORE)) &&
+                    (completion.res == -EINVAL)
+                )
+            {
+                Log(LogLevel::Informational, "io_uring multishot recvmsg not supported.");
+                return false;
+            }
+
+            ++head;
+        }
+
+        return true;
+    }
+
+    // Gives a receive buffer back to the kernel.
+    void Recycle(uint16_t id)
+    {
+        auto& entry = bufferRing[bufferTail & (BufferCount - 1)];
+
+        // Can't assign the whole struct, the ring's tail lives in bufs[0].resv.
+        entry.addr = reinterpret_cast<uint64_t>(buffers.data() + (id * BufferSize));
+        entry.len = BufferSize;
+        entry.bid = id;
+
+        ++bufferTail;
+
+        __atomic_store_n(&bufferRing[0].resv, bufferTail, __ATOMIC_RELEASE);
+    }
+
+    // Queued, but not yet handed to the kernel.
+    unsigned Unsubmitted() const
+    {
+        return *sqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    }
+
+    std::size_t SendsInFlight() const
+    {
+        return SendSlots - freeSlots.size();
+    }
+
+    // Room for another send, still leaving an entry for the receive.
+    bool CanSend() const
+    {
+        return (!freeSlots.empty()) && (Unsubmitted() < SendSlots);
+    }
+
+    // Caller checks there's room, see CanSend().
+    io_uring_sqe& NextSqe(uint64_t tag)
+    {
+        auto tail = *sqTail;
+        auto index = tail & sqMask;
+        auto& result = sqes[index];
+
+        std::memset(&result, 0, sizeof(result));
+        result.user_data = tag;
+        sqArray[index] = index;
+
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+        return result;
+    }
+
+    void Receive()
+    {
+        auto& sqe = NextSqe(ReceiveTag);
+
+        sqe.opcode = IORING_OP_RECVMSG;
+        sqe.fd = socket;
+        sqe.addr = reinterpret_cast<uint64_t>(&receiveTemplate);
+        sqe.len = 1;
+        sqe.ioprio = IORING_RECV_MULTISHOT;
+        sqe.flags = IOSQE_BUFFER_SELECT;
+        sqe.buf_group = BufferGroup;
+
+        receiving = true;
+    }
+
+    // Keeps the packet until its completion is reaped.
+    void Send(NetworkPacket packet)
+    {
+        auto slot = freeSlots.back();
+        freeSlots.pop_back();
+
+        sendPackets[slot] = std::move(packet);
+
+        const auto& stored = sendPackets[slot];
+        auto& buffer = sendBuffers[slot];
+        auto& header = sendHeaders[slot];
+
+        buffer.iov_base = const_cast<uint8_t*>(stored.data.data());
+        buffer.iov_len = stored.data.size();
+
+        std::memset(&header, 0, sizeof(header));
+        header.msg_name = const_cast<void*>(static_cast<const void*>(stored.address.data()));
+        header.msg_namelen = static_cast<socklen_t>(stored.address.size());
+        header.msg_iov = &buffer;
+        header.msg_iovlen = 1;
+
+        auto& sqe = NextSqe(SendTag + slot);
+
+        sqe.opcode = IORING_OP_SENDMSG;
+        sqe.fd = socket;
+        sqe.addr = reinterpret_cast<uint64_t>(&header);
+        sqe.len = 1;
+    }
+
+    // Returns how many were submitted, or -1.
+    int Enter(unsigned toSubmit, unsigned waitFor)
+    {
+        long result;
+
+        do
+        {
+            result = syscall(
+                        __NR_io_uring_enter,
+                        ringFd,
+                        toSubmit,
+                        waitFor,
+                        (waitFor > 0) ? IORING_ENTER_GETEVENTS : 0,
+                        nullptr,
+                        0);
+        }
+        while ((result < 0) && (errno == EINTR));
+
+        if (result < 0)
+        {
+            Log(LogLevel::Informational, "io_uring_enter failed: (", errno, ") ", std::strerror(errno));
+        }
+
+        return static_cast<int>(result);
+    }
+
+    // Hands everything queued to the kernel, and waits for that many completions.
+    int Submit(unsigned waitFor)
+    {
+        return Enter(Unsubmitted(), waitFor);
+    }
+
+    // Appends received packets to result, returns how many sends completed.
+    std::size_t Reap(std::vector<NetworkPacket>& result)
+    {
+        std::size_t sendsDone{0};
+        auto clock = KernelTimestamp{};
+        auto head = *cqHead;
+        auto tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+
+        while (head != tail)
+        {
+            const auto& completion = cqes[head & cqMask];
+
+            if (completion.user_data >= SendTag)
+            {
+                freeSlots.push_back(static_cast<uint16_t>(completion.user_data - SendTag));
+                ++sendsDone;
+
+                if (completion.res < 0)
+                {
+                    Log(LogLevel::Informational, "Send Failed: (", -completion.res, ") ", std::strerror(-completion.res));
+                }
+            }
+            else if (completion.user_data == ReceiveTag)
+            {
+                if (completion.flags & IORING_CQE_F_BUFFER)
+                {
+                    auto id = static_cast<uint16_t>(completion.flags >> IORING_CQE_BUFFER_SHIFT);
+
+                    if (completion.res >= 0)
+                    {
+                        Received(buffers.data() + (id * BufferSize), static_cast<std::size_t>(completion.res), clock, result);
+                    }
+
+                    Recycle(id);
+                }
+
+                if (!(completion.flags & IORING_CQE_F_MORE))
+                {
+                    // Out of buffers (ENOBUFS) is expected under load, just rearm.
+                    if ((completion.res < 0) && (completion.res != -ENOBUFS))
+                    {
+                        Log(LogLevel::Informational, "Received Failed: (", -completion.res, ") ", std::strerror(-completion.res));
+                    }
+
+                    receiving = false;
+                }
+            }
+
+            ++head;
+        }
+
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+        return sendsDone;
+    }
+
+    void Received(
+            const uint8_t* buffer,
+            std::size_t size,
+            const KernelTimestamp& clock,
+            std::vector<NetworkPacket>& result)
+    {
+        if (size < (sizeof(io_uring_recvmsg_out) + NameSize + ControlSize))
+        {
+            return;
+        }
+
+        io_uring_recvmsg_out header;
+        std::memcpy(&header, buffer, sizeof(header));
+
+        if (header.flags & MSG_TRUNC)
+        {
+            Log(LogLevel::Informational, "Datagram bigger than MaxDatagramSize, dropped.");
+            return;
+        }
+
+        // The kernel reserves the template's name and control sizes, whatever it actually used.
+        auto name = buffer + sizeof(io_uring_recvmsg_out);
+        auto control = name + NameSize;
+        auto payload = control + ControlSize;
+
+        msghdr controlOnly;
+        std::memset(&controlOnly, 0, sizeof(controlOnly));
+        controlOnly.msg_control = const_cast<uint8_t*>(control);
+        controlOnly.msg_controllen = header.controllen;
+
+        udp::endpoint address;
+        auto nameLength = std::min<std::size_t>(header.namelen, address.capacity());
+
+        std::memcpy(address.data(), name, nameLength);
+        address.resize(nameLength);
+
+        result.emplace_back(std::vector<uint8_t>(payload, payload + header.payloadlen), address, clock.FromMessage(controlOnly));
+    }
+};
+
+#else
+
+struct NetworkProviderUring::Uring
+{
+    static std::unique_ptr<Uring> Create(int)
+    {
+        return {};
+    }
+
+    std::size_t Reap(std::vector<NetworkPacket>&)
+    {
+        return 0;
+    }
+
+    std::size_t SendsInFlight() const
+    {
+        return 0;
+    }
+
+    int Submit(unsigned)
+    {
+        return -1;
+    }
+};
+
+#endif
+
+NetworkProviderUring::NetworkProviderUring(boost::asio::ip::udp::endpoint bindAddress, Use use)
+    : INetworkProvider()
+    , myBindAddress(bindAddress)
+    , myIoService()
+    , mySocket()
+    , myAddressIsIpv4(myBindAddress.address().is_v4())
+    , myUring()
+    , myFallback()
+    , myReceived()
+{
+    if ((use == Use::Fallback) || (!Open()))
+    {
+        myFallback = make_unique<NetworkProviderSynchronous>(myBindAddress);
+    }
+}
+
+NetworkProviderUring::~NetworkProviderUring()
+{
+    // Let the sends finish, then kill the ring before the socket it's reading.
+    if (myUring)
+    {
+        Drain();
+    }
+
+    myUring.reset();
+}
+
+bool NetworkProviderUring::IsSupported()
+{
+#ifdef HAS_IO_URING
+    auto probe = ::socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (probe < 0)
+    {
+        return false;
+    }
+
+    auto result = static_cast<bool>(Uring::Create(probe));
+
+    close(probe);
+
+    return result;
+#else
+    return false;
+#endif
+}
+
+bool NetworkProviderUring::UsingUring() const
+{
+    return !myFallback;
+}
+
+boost::asio::ip::udp::endpoint NetworkProviderUring::LocalAddress() const
+{
+    if (myFallback)
+    {
+        return myFallback->LocalAddress();
+    }
+
+    boost::system::error_code error;
+
+    auto result = mySocket->local_endpoint(error);
+
+    if (error)
+    {
+        return myBindAddress;
+    }
+
+    return result;
+}
+
+bool NetworkProviderUring::Open()
+{
+    // Let bind errors throw, like NetworkProviderSynchronous.
+    auto socket = make_unique<udp::socket>(myIoService, myBindAddress);
+    auto uring = Uring::Create(socket->native_handle());
+
+    if (!uring)
+    {
+        return false;
+    }
+
+    mySocket = std::move(socket);
+    myUring = std::move(uring);
+
+    return true;
+}
+
+std::size_t NetworkProviderUring::Reap()
+{
+#ifdef HAS_IO_URING
+    auto result = myUring->Reap(myReceived);
+
+    if (!myUring->receiving && mySocket->is_open())
+    {
+        myUring->Receive();
+        myUring->Submit(0);
+    }
+
+    return result;
+#else
+    return myUring->Reap(myReceived);
+#endif
+}
+
+std::vector<NetworkPacket> NetworkProviderUring::PrivateReceive()
+{
+    if (myFallback)
+    {
+        return myFallback->Receive();
+    }
+
+    if (!myUring)
+    {
+        return {};
+    }
+
+    Reap();
+
+#ifdef HAS_IO_URING
+    // Completions normally turn up on their own, but if there's nothing
+    // there give the kernel a chance to run any it's sitting on.
+    if (myReceived.empty())
+    {
+        myUring->Enter(0, 0);
+        Reap();
+    }
+#endif
+
+    std::vector<NetworkPacket> result;
+    swap(result, myReceived);
+
+    return result;
+}
+
+void NetworkProviderUring::PrivateSend(std::vector<NetworkPacket> packets)
+{
+    if (myFallback)
+    {
+        myFallback->Send(std::move(packets));
+        return;
+    }
+
+#ifdef HAS_IO_URING
+    if (!myUring || packets.empty())
+    {
+        return;
+    }
+
+    // Frees the slots of any sends that have finished.
+    Reap();
+
+    for (auto& packet : packets)
+    {
+        if  (
+                (packet.data.empty()) ||
+                (packet.address.address().is_v4() != myAddressIsIpv4)
+            )
+        {
+            continue;
+        }
+
+        // Only blocks if every slot is still in flight.
+        while (!myUring->CanSend())
+        {
+            if (myUring->Submit(1) < 0)
+            {
+                return;
+            }
+
+            Reap();
+        }
+
+        myUring->Send(std::move(packet));
+    }
+
+    // Don't wait, the completions are picked up by later calls.
+    myUring->Submit(0);
+#endif
+}
+
+void NetworkProviderUring::PrivateReset()
+{
+    if (myFallback)
+    {
+        myFallback->Reset();
+        return;
+    }
+
+    PrivateDisable();
+
+    try
+    {
+        if (!Open())
+        {
+            Log(LogLevel::Warning, "Reset Failed: io_uring unavailable.");
+        }
+    }
+    catch (boost::system::system_error& socketError)
+    {
+        // IsDisabled() will return true if this didn't work, so just report why to debug.
+        Log(
+            LogLevel::Warning,
+            "Reset Failed: (",
+            socketError.code().value(),
+            ") ",
+            socketError.what());
+    }
+}
+
+void NetworkProviderUring::PrivateFlush()
+{
+    if (myFallback)
+    {
+        myFallback->Flush();
+        return;
+    }
+
+    if (myUring)
+    {
+        Drain();
+    }
+}
+
+void NetworkProviderUring::Drain()
+{
+    while (myUring->SendsInFlight() > 0)
+    {
+        if (myUring->Submit(1) < 0)
+        {
+            return;
+        }
+
+        Reap();
+    }
+}
+
+void NetworkProviderUring::PrivateDisable()
+{
+    if (myFallback)
+    {
+        myFallback->Disable();
+        return;
+    }
+
+    if (myUring)
+    {
+        Drain();
+    }
+
+    myUring.reset();
+    myReceived.clear();
+
+    if (mySocket)
+    {
+        mySocket->close();
+    }
+}
+
+bool NetworkProviderUring::PrivateIsDisabled() const
+{
+    if (myFallback)
+    {
+        return myFallback->IsDisabled();
+    }
+
+    return !myUring || !mySocket->is_open();
+}
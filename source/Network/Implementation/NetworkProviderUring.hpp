@@ -0,0 +1,114 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef NETWORKPROVIDERURING_HPP
+#define NETWORKPROVIDERURING_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <boost/asio.hpp>
+#endif
+
+#include "INetworkProvider.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+class NetworkProviderSynchronous;
+
+// linux io_uring provider. A single multishot recvmsg keeps receiving into a
+// ring of buffers registered with the kernel, so Receive() usually just reads
+// completions out of shared memory with no system call. Send() queues one
+// sendmsg per packet and submits them all with one io_uring_enter() without
+// waiting for them. Their completions are reaped by later calls, and Flush()
+// waits for any still in flight.
+//
+// Needs linux 6.0 or newer (multishot recvmsg and registered buffer rings).
+// If the kernel (or a seccomp filter) says no, it quietly does everything
+// through a NetworkProviderSynchronous instead. UsingUring() tells you which.
+class NetworkProviderUring final: public INetworkProvider
+{
+public:
+    enum class Use
+    {
+        Automatic,
+
+        // Skip io_uring, mainly for testing the fallback.
+        Fallback
+    };
+
+    static const std::size_t MaxDatagramSize = 9216;
+
+    explicit NetworkProviderUring(boost::asio::ip::udp::endpoint bindAddress)
+        : NetworkProviderUring(bindAddress, Use::Automatic)
+    {
+    }
+
+    NetworkProviderUring(boost::asio::ip::udp::endpoint bindAddress, Use use);
+    NetworkProviderUring()
+        : NetworkProviderUring(boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), 0))
+    {
+    }
+
+    ~NetworkProviderUring();
+
+    // Can this kernel do what we need? Creates and destroys a small ring to find out.
+    static bool IsSupported();
+
+    bool UsingUring() const;
+
+    boost::asio::ip::udp::endpoint LocalAddress() const;
+
+private:
+    struct Uring;
+
+    boost::asio::ip::udp::endpoint myBindAddress;
+    boost::asio::io_service myIoService;
+    std::unique_ptr<boost::asio::ip::udp::socket> mySocket;
+    bool myAddressIsIpv4;
+
+    // Exactly one of these is set, unless a Reset() failed.
+    std::unique_ptr<Uring> myUring;
+    std::unique_ptr<NetworkProviderSynchronous> myFallback;
+
+    // Received while reaping send completions, handed out next Receive().
+    std::vector<NetworkPacket> myReceived;
+
+    std::vector<NetworkPacket> PrivateReceive() override;
+    void PrivateSend(std::vector<NetworkPacket> packets) override;
+    void PrivateReset() override;
+    void PrivateFlush() override;
+    void PrivateDisable() override;
+    bool PrivateIsDisabled() const override;
+
+    // Returns false if io_uring isn't usable, mySocket is left alone.
+    bool Open();
+
+    // Moves completions into myReceived, returns how many sends completed.
+    std::size_t Reap();
+
+    // Waits for every send in flight to complete.
+    void Drain();
+};
+
+}}} // namespace
+
+#endif // NETWORKPROVIDERURING_HPP
@@ -40,6 +40,8 @@ class PacketFragmentManager
 public:
     // Returned array might not contain fragmented packets
     // if the passed PacketDelta is small enough.
+    // All but the last fragment are the same size, which is what lets
+    // NetworkProviderBatched send them as one UDP GSO train.
     static std::vector<std::vector<uint8_t>> FragmentPacket(PacketDelta toFragment);
 
     PacketFragmentManager();
@@ -0,0 +1,141 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#ifdef __linux__
+#include <climits>
+#include <ctime>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+#else
+#include "Common/PrecompiledHeaders.hpp"
+#endif
+
+#include "SharedMemoryRing.hpp"
+
+using namespace GameInABox::Network::Implementation;
+
+const std::size_t SharedMemoryRing::CellCount;
+const std::size_t SharedMemoryRing::CellSize;
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "Shared memory needs lock free atomics.");
+
+void SharedMemoryDoorbell::Reset()
+{
+    mySequence.store(0);
+    myWaiters.store(0);
+}
+
+void SharedMemoryDoorbell::Ring()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (myWaiters.load() > 0)
+    {
+        mySequence.fetch_add(1);
+
+#ifdef __linux__
+        // Not FUTEX_PRIVATE_FLAG, the waiter is in another process.
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&mySequence), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+    }
+}
+
+void SharedMemoryDoorbell::Sleep(uint32_t sequence, Milliseconds timeout)
+{
+#ifdef __linux__
+    timespec time;
+
+    time.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+    time.tv_nsec = static_cast<long>((timeout.count() % 1000) * 1000000);
+
+    // Returns straight away if mySequence has moved on since we looked.
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&mySequence), FUTEX_WAIT, sequence, &time, nullptr, 0);
+#else
+    // No futex, so poll. Only costs the waiter.
+    auto until = Clock::now() + timeout;
+
+    while ((mySequence.load() == sequence) && (Clock::now() < until))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+#endif
+}
+
+void SharedMemoryRing::Reset()
+{
+    myHead.store(0);
+    myTail.store(0);
+}
+
+bool SharedMemoryRing::TryPush(const uint8_t* data, std::size_t size)
+{
+    if (size > CellSize)
+    {
+        return false;
+    }
+
+    auto tail = myTail.load(std::memory_order_relaxed);
+
+    if ((tail - myHead.load(std::memory_order_acquire)) >= CellCount)
+    {
+        return false;
+    }
+
+    auto& cell = myCells[tail & (CellCount - 1)];
+
+    cell.size = static_cast<uint32_t>(size);
+    std::memcpy(cell.data, data, size);
+
+    myTail.store(tail + 1, std::memory_order_release);
+
+    return true;
+}
+
+bool SharedMemoryRing::TryPop(std::vector<uint8_t>& data)
+{
+    auto head = myHead.load(std::memory_order_relaxed);
+
+    if (head == myTail.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    const auto& cell = myCells[head & (CellCount - 1)];
+
+    // Don't trust the other process with our bounds.
+    auto size = std::min<std::size_t>(cell.size, CellSize);
+
+    data.assign(cell.data, cell.data + size);
+
+    myHead.store(head + 1, std::memory_order_release);
+
+    return true;
+}
+
+bool SharedMemoryRing::Empty() const
+{
+    return myHead.load(std::memory_order_acquire) == myTail.load(std::memory_order_acquire);
+}
@@ -0,0 +1,110 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef SHAREDMEMORYRING_HPP
+#define SHAREDMEMORYRING_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#endif
+
+#include "Units.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+// Wakes a thread in another process, via a futex on Linux. Ring() only does
+// a system call if someone is actually waiting, so a busy consumer that
+// polls costs the producer nothing.
+//
+// Lives in shared memory, so no pointers and no constructor beyond zeroing.
+class SharedMemoryDoorbell
+{
+public:
+    void Reset();
+
+    // Producer, after making whatever the consumer waits for true.
+    void Ring();
+
+    // Consumer. Returns when ready() is true, Ring() is called, or timeout.
+    // Can return early, so check again.
+    template<typename READY>
+    void Wait(READY ready, Milliseconds timeout)
+    {
+        myWaiters.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        auto sequence = mySequence.load();
+
+        if (!ready())
+        {
+            Sleep(sequence, timeout);
+        }
+
+        myWaiters.fetch_sub(1);
+    }
+
+private:
+    std::atomic<uint32_t> mySequence;
+    std::atomic<uint32_t> myWaiters;
+
+    void Sleep(uint32_t sequence, Milliseconds timeout);
+};
+
+// SpscRing for raw datagrams, laid out flat so it can sit in memory shared
+// between two processes. One process pushes and the other pops. Each cell
+// holds one datagram of up to CellSize bytes.
+//
+// Reset() is only safe when neither end is using it.
+class SharedMemoryRing
+{
+public:
+    static const std::size_t CellCount = 256;
+    static const std::size_t CellSize = 1500;
+
+    void Reset();
+
+    // Producer. Returns false if full, or if size > CellSize.
+    bool TryPush(const uint8_t* data, std::size_t size);
+
+    // Consumer. Returns false if empty.
+    bool TryPop(std::vector<uint8_t>& data);
+
+    bool Empty() const;
+
+private:
+    struct Cell
+    {
+        uint32_t size;
+        uint8_t data[CellSize];
+    };
+
+    static_assert((CellCount & (CellCount - 1)) == 0, "CellCount must be a power of 2.");
+
+    // 32 bit so they're lock free, and so address free, everywhere.
+    alignas(64) std::atomic<uint32_t> myHead;
+    alignas(64) std::atomic<uint32_t> myTail;
+    alignas(64) Cell myCells[CellCount];
+};
+
+}}} // namespace
+
+#endif // SHAREDMEMORYRING_HPP
@@ -0,0 +1,123 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef SPSCRING_HPP
+#define SPSCRING_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#endif
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+// Bounded, lock free, single producer single consumer queue.
+// Exactly one thread may call TryPush() and exactly one (other) thread may
+// call TryPop(). Size() can be called from anywhere, but is only a guess
+// if the other thread is busy.
+//
+// Capacity is rounded up to a power of two. Head and tail only ever grow,
+// so full and empty are told apart without wasting a slot.
+template<typename T>
+class SpscRing
+{
+public:
+    explicit SpscRing(std::size_t capacity)
+        : myMask(RoundUp(capacity) - 1)
+        , mySlots(myMask + 1)
+        , myHead(0)
+        , myTail(0)
+    {
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer only. Returns false, leaving item alone, if full.
+    bool TryPush(T&& item)
+    {
+        auto tail = myTail.load(std::memory_order_relaxed);
+
+        if ((tail - myHead.load(std::memory_order_acquire)) > myMask)
+        {
+            return false;
+        }
+
+        mySlots[tail & myMask] = std::move(item);
+        myTail.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Consumer only. Returns false if empty.
+    bool TryPop(T& item)
+    {
+        auto head = myHead.load(std::memory_order_relaxed);
+
+        if (head == myTail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        item = std::move(mySlots[head & myMask]);
+        myHead.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    std::size_t Size() const
+    {
+        auto head = myHead.load(std::memory_order_acquire);
+        auto tail = myTail.load(std::memory_order_acquire);
+
+        return static_cast<std::size_t>(tail - head);
+    }
+
+    std::size_t Capacity() const
+    {
+        return myMask + 1;
+    }
+
+private:
+    static std::size_t RoundUp(std::size_t capacity)
+    {
+        std::size_t result{1};
+
+        while (result < capacity)
+        {
+            result <<= 1;
+        }
+
+        return result;
+    }
+
+    const std::size_t myMask;
+    std::vector<T> mySlots;
+
+    // Keep the two ends on separate cache lines, otherwise the threads
+    // fight over the line even when they aren't touching the same slot.
+    alignas(64) std::atomic<std::size_t> myHead;
+    alignas(64) std::atomic<std::size_t> myTail;
+};
+
+}}} // namespace
+
+#endif // SPSCRING_HPP
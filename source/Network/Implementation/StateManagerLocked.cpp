@@ -0,0 +1,142 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef USING_PRECOMPILED_HEADERS
+#else
+#include "Common/PrecompiledHeaders.hpp"
+#endif
+
+#include "StateManagerLocked.hpp"
+
+using namespace GameInABox::Network;
+using namespace GameInABox::Network::Implementation;
+
+using Lock = std::lock_guard<std::mutex>;
+
+StateManagerLocked::StateManagerLocked(IStateManager& toWrap)
+    : IStateManager()
+    , myWrapped(toWrap)
+    , myLock()
+{
+}
+
+std::array<uint64_t, 256> StateManagerLocked::PrivateGetHuffmanFrequencies() const
+{
+    Lock lock(myLock);
+    return myWrapped.GetHuffmanFrequencies();
+}
+
+std::vector<uint8_t> StateManagerLocked::PrivateStateInfo(const boost::optional<ClientHandle>& client) const
+{
+    Lock lock(myLock);
+    return myWrapped.StateInfo(client);
+}
+
+boost::optional<ClientHandle> StateManagerLocked::PrivateConnect(
+        std::vector<uint8_t> connectData,
+        std::string& failReason)
+{
+    Lock lock(myLock);
+    return myWrapped.Connect(std::move(connectData), failReason);
+}
+
+void StateManagerLocked::PrivateDisconnect(ClientHandle playerToDisconnect)
+{
+    Lock lock(myLock);
+    myWrapped.Disconnect(playerToDisconnect);
+}
+
+bool StateManagerLocked::PrivateIsConnected(ClientHandle client) const
+{
+    Lock lock(myLock);
+    return myWrapped.IsConnected(client);
+}
+
+bool StateManagerLocked::PrivateCanReceive(boost::optional<ClientHandle> client, std::size_t bytes)
+{
+    Lock lock(myLock);
+    return myWrapped.CanReceive(client, bytes);
+}
+
+bool StateManagerLocked::PrivateCanSend(boost::optional<ClientHandle> client, std::size_t bytes)
+{
+    Lock lock(myLock);
+    return myWrapped.CanSend(client, bytes);
+}
+
+Delta StateManagerLocked::PrivateDeltaCreate(
+        ClientHandle client,
+        boost::optional<Sequence> lastAcked) const
+{
+    Lock lock(myLock);
+    return myWrapped.DeltaCreate(client, lastAcked);
+}
+
+Sequence StateManagerLocked::PrivateDeltaParse(
+        ClientHandle client,
+        const Delta& payload)
+{
+    Lock lock(myLock);
+    return myWrapped.DeltaParse(client, payload);
+}
+
+DeltaView StateManagerLocked::PrivateDeltaCreateInto(
+        ClientHandle client,
+        boost::optional<Sequence> lastAcked,
+        std::vector<uint8_t>& buffer) const
+{
+    Lock lock(myLock);
+    return myWrapped.DeltaCreate(client, lastAcked, buffer);
+}
+
+Sequence StateManagerLocked::PrivateDeltaParseView(
+        ClientHandle client,
+        const DeltaView& payload)
+{
+    Lock lock(myLock);
+    return myWrapped.DeltaParse(client, payload);
+}
+
+void StateManagerLocked::PrivateDeltaCreateAll(
+        std::vector<DeltaRequest>& requests,
+        std::vector<std::vector<uint8_t>>& buffers) const
+{
+    // One lock for the whole batch, not one per client.
+    Lock lock(myLock);
+    myWrapped.DeltaCreateAll(requests, buffers);
+}
+
+void StateManagerLocked::PrivateDeltaParseAll(std::vector<DeltaReceived>& received)
+{
+    Lock lock(myLock);
+    myWrapped.DeltaParseAll(received);
+}
+
+bool StateManagerLocked::PrivateAccountPerTick() const
+{
+    Lock lock(myLock);
+    return myWrapped.AccountPerTick();
+}
+
+void StateManagerLocked::PrivateTraffic(const std::vector<TrafficTotal>& totals)
+{
+    Lock lock(myLock);
+    myWrapped.Traffic(totals);
+}
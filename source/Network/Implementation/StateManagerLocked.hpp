@@ -0,0 +1,89 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef STATEMANAGERLOCKED_HPP
+#define STATEMANAGERLOCKED_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <mutex>
+#endif
+
+#include "IStateManager.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+// Makes any IStateManager safe to call from several threads by taking a
+// lock around every call. Used so the shards of a sharded server can share
+// the one game state. Simple rather than fast, all the shards will queue
+// behind a slow DeltaCreate().
+class StateManagerLocked final : public IStateManager
+{
+public:
+    explicit StateManagerLocked(IStateManager& toWrap);
+    ~StateManagerLocked() = default;
+
+private:
+    IStateManager& myWrapped;
+    mutable std::mutex myLock;
+
+    std::array<uint64_t, 256> PrivateGetHuffmanFrequencies() const override;
+
+    std::vector<uint8_t> PrivateStateInfo(const boost::optional<ClientHandle>& client) const override;
+
+    boost::optional<ClientHandle> PrivateConnect(
+            std::vector<uint8_t> connectData,
+            std::string& failReason) override;
+
+    void PrivateDisconnect(ClientHandle playerToDisconnect) override;
+    bool PrivateIsConnected(ClientHandle client) const override;
+
+    bool PrivateCanReceive(boost::optional<ClientHandle> client, std::size_t bytes) override;
+    bool PrivateCanSend(boost::optional<ClientHandle> client, std::size_t bytes) override;
+
+    Delta PrivateDeltaCreate(
+            ClientHandle client,
+            boost::optional<Sequence> lastAcked) const override;
+
+    Sequence PrivateDeltaParse(
+            ClientHandle client,
+            const Delta& payload) override;
+
+    DeltaView PrivateDeltaCreateInto(
+            ClientHandle client,
+            boost::optional<Sequence> lastAcked,
+            std::vector<uint8_t>& buffer) const override;
+
+    Sequence PrivateDeltaParseView(
+            ClientHandle client,
+            const DeltaView& payload) override;
+
+    void PrivateDeltaCreateAll(
+            std::vector<DeltaRequest>& requests,
+            std::vector<std::vector<uint8_t>>& buffers) const override;
+
+    void PrivateDeltaParseAll(std::vector<DeltaReceived>& received) override;
+
+    bool PrivateAccountPerTick() const override;
+    void PrivateTraffic(const std::vector<TrafficTotal>& totals) override;
+};
+
+}}} // namespace
+
+#endif // STATEMANAGERLOCKED_HPP
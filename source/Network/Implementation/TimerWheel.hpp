@@ -0,0 +1,255 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef TIMERWHEEL_HPP
+#define TIMERWHEEL_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#endif
+
+#include "Units.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+// Hierarchical timer wheel (Varghese & Lauck, as used by the linux kernel).
+// Scheduling and cancelling are O(1), advancing is O(1) per resolution tick
+// plus the odd cascade, so idle timers cost nothing per game tick.
+//
+// Each key has at most one deadline. Scheduling a key that already has an
+// earlier deadline keeps the earlier one, so timers can fire early. Callers
+// are expected to check the real deadline when a key fires and reschedule.
+// This means a busy connection doesn't have to touch the wheel for every packet.
+template<typename KEY, typename HASH = std::hash<KEY>>
+class TimerWheel
+{
+public:
+    TimerWheel(Milliseconds resolution, OClock start)
+        : myResolution(resolution.count() > 0 ? resolution : Milliseconds{1})
+        , myStart(start)
+        , myTick(0)
+        , myWheels()
+        , myDue()
+        , myDeadlines()
+    {
+    }
+
+    // OClock::max() cancels. Anything in the past fires on the next Advance().
+    void Schedule(const KEY& key, OClock when)
+    {
+        if (when == OClock::max())
+        {
+            Cancel(key);
+            return;
+        }
+
+        auto found = myDeadlines.find(key);
+
+        if (found != end(myDeadlines))
+        {
+            if (found->second <= when)
+            {
+                return;
+            }
+
+            found->second = when;
+        }
+        else
+        {
+            myDeadlines.emplace(key, when);
+        }
+
+        Insert(Entry{key, when});
+    }
+
+    void Cancel(const KEY& key)
+    {
+        // Entries left in the wheel are ignored when they expire.
+        myDeadlines.erase(key);
+    }
+
+    // Returns every key whose deadline is <= now.
+    std::vector<KEY> Advance(OClock now)
+    {
+        std::vector<KEY> result{};
+
+        auto target = TickFloor(now);
+
+        if (myDeadlines.empty())
+        {
+            // Nothing to do, don't bother stepping.
+            if (target > myTick)
+            {
+                myTick = target;
+            }
+
+            for (auto& wheel : myWheels)
+            {
+                for (auto& slot : wheel)
+                {
+                    slot.clear();
+                }
+            }
+
+            myDue.clear();
+
+            return result;
+        }
+
+        while (myTick < target)
+        {
+            ++myTick;
+
+            // Move the next block of each level down when the level below wraps.
+            for (std::size_t level = 1; level < Levels; ++level)
+            {
+                if ((myTick & ((uint64_t{1} << (SlotBits * level)) - 1)) != 0)
+                {
+                    break;
+                }
+
+                auto& slot = myWheels[level][Index(myTick, level)];
+                auto cascade = std::move(slot);
+                slot.clear();
+
+                for (auto& entry : cascade)
+                {
+                    Insert(std::move(entry));
+                }
+            }
+
+            auto& slot = myWheels[0][Index(myTick, 0)];
+            myDue.insert(end(myDue), begin(slot), end(slot));
+            slot.clear();
+        }
+
+        for (auto& entry : myDue)
+        {
+            auto found = myDeadlines.find(entry.key);
+
+            // Stale entries (rescheduled or cancelled) don't match.
+            if ((found != end(myDeadlines)) && (found->second == entry.when))
+            {
+                result.push_back(entry.key);
+                myDeadlines.erase(found);
+            }
+        }
+
+        myDue.clear();
+
+        return result;
+    }
+
+    std::size_t Size() const
+    {
+        return myDeadlines.size();
+    }
+
+private:
+    static const std::size_t SlotBits = 6;
+    static const std::size_t Slots = 1 << SlotBits;
+    static const std::size_t Levels = 4;
+
+    struct Entry
+    {
+        KEY key;
+        OClock when;
+    };
+
+    using Slot = std::vector<Entry>;
+
+    Milliseconds myResolution;
+    OClock myStart;
+    uint64_t myTick;
+
+    std::array<std::array<Slot, Slots>, Levels> myWheels;
+    std::vector<Entry> myDue;
+    std::unordered_map<KEY, OClock, HASH> myDeadlines;
+
+    uint64_t TickFloor(OClock when) const
+    {
+        if (when <= myStart)
+        {
+            return 0;
+        }
+
+        return static_cast<uint64_t>((when - myStart) / myResolution);
+    }
+
+    uint64_t TickCeiling(OClock when) const
+    {
+        if (when <= myStart)
+        {
+            return 0;
+        }
+
+        auto since = when - myStart;
+        auto ticks = static_cast<uint64_t>(since / myResolution);
+
+        if ((since % myResolution) != Clock::duration::zero())
+        {
+            ++ticks;
+        }
+
+        return ticks;
+    }
+
+    static std::size_t Index(uint64_t tick, std::size_t level)
+    {
+        return static_cast<std::size_t>((tick >> (SlotBits * level)) & (Slots - 1));
+    }
+
+    void Insert(Entry entry)
+    {
+        // Don't fire early because of rounding.
+        auto expires = TickCeiling(entry.when);
+
+        if (expires <= myTick)
+        {
+            myDue.push_back(std::move(entry));
+            return;
+        }
+
+        auto delta = expires - myTick;
+        std::size_t level = 0;
+
+        while ((level < (Levels - 1)) && (delta >= (uint64_t{1} << (SlotBits * (level + 1)))))
+        {
+            ++level;
+        }
+
+        // Too far in the future, park it in the furthest slot.
+        // It gets parked again when that slot cascades.
+        if (delta >= (uint64_t{1} << (SlotBits * Levels)))
+        {
+            expires = myTick + (uint64_t{1} << (SlotBits * Levels)) - 1;
+        }
+
+        myWheels[level][Index(expires, level)].push_back(std::move(entry));
+    }
+};
+
+}}} // namespace
+
+#endif // TIMERWHEEL_HPP
@@ -0,0 +1,103 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <algorithm>
+#else
+#include "Common/PrecompiledHeaders.hpp"
+#endif
+
+#include "TokenBucket.hpp"
+
+using namespace std::chrono;
+using namespace GameInABox::Network::Implementation;
+
+TokenBucket::TokenBucket()
+    : TokenBucket(BandwidthLimit{0, 0}, OClock{})
+{
+}
+
+TokenBucket::TokenBucket(BandwidthLimit limit, OClock now)
+    : myLimit(limit)
+    , myStart(now)
+    , myLastRefill(now)
+    , myTokens(limit.burstInBytes)
+    , myBytesTaken(0)
+{
+}
+
+bool TokenBucket::CanTake(std::size_t bytes, OClock now)
+{
+    if (!IsLimited())
+    {
+        return true;
+    }
+
+    Refill(now);
+
+    // Oversized requests wait for a full bucket, then go into debt.
+    auto needed = std::min(static_cast<double>(bytes), static_cast<double>(myLimit.burstInBytes));
+
+    return myTokens >= needed;
+}
+
+void TokenBucket::Take(std::size_t bytes)
+{
+    myBytesTaken += bytes;
+
+    if (IsLimited())
+    {
+        myTokens -= static_cast<double>(bytes);
+    }
+}
+
+float TokenBucket::Utilisation(OClock now) const
+{
+    if (!IsLimited())
+    {
+        return 0.0f;
+    }
+
+    // Count the initial burst as allowed bytes, otherwise a fresh
+    // connection would report > 100%.
+    auto seconds = duration_cast<duration<double>>(now - myStart).count();
+    auto allowed = myLimit.burstInBytes + (seconds * myLimit.bytesPerSecond);
+
+    if (allowed <= 0)
+    {
+        return 0.0f;
+    }
+
+    return static_cast<float>(myBytesTaken / allowed);
+}
+
+void TokenBucket::Refill(OClock now)
+{
+    if (now > myLastRefill)
+    {
+        auto seconds = duration_cast<duration<double>>(now - myLastRefill).count();
+
+        myTokens = std::min(
+                myTokens + (seconds * myLimit.bytesPerSecond),
+                static_cast<double>(myLimit.burstInBytes));
+
+        myLastRefill = now;
+    }
+}
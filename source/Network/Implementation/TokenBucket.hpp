@@ -0,0 +1,67 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef TOKENBUCKET_HPP
+#define TOKENBUCKET_HPP
+
+#ifndef USING_PRECOMPILED_HEADERS
+#include <cstdint>
+#include <cstddef>
+#endif
+
+#include "Units.hpp"
+#include "Bandwidth.hpp"
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+// Token bucket rate limiter, one token == one byte.
+// Made to decide on whole snapshots, so a request is all or nothing.
+// A request bigger than the burst size is allowed once the bucket is full,
+// the bucket then goes into debt until it has refilled. Otherwise big
+// snapshots would never get sent.
+class TokenBucket
+{
+public:
+    // No limit.
+    TokenBucket();
+    TokenBucket(BandwidthLimit limit, OClock now);
+
+    bool CanTake(std::size_t bytes, OClock now);
+    void Take(std::size_t bytes);
+
+    bool IsLimited() const { return myLimit.bytesPerSecond > 0; }
+    uint64_t BytesTaken() const { return myBytesTaken; }
+
+    // BytesTaken() / bytes allowed since construction, 0 if not limited.
+    float Utilisation(OClock now) const;
+
+private:
+    BandwidthLimit myLimit;
+    OClock myStart;
+    OClock myLastRefill;
+    double myTokens;
+    uint64_t myBytesTaken;
+
+    void Refill(OClock now);
+};
+
+}}} // namespace
+
+#endif // TOKENBUCKET_HPP
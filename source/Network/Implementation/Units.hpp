@@ -23,6 +23,7 @@
 
 #ifndef USING_PRECOMPILED_HEADERS
 #include <chrono>
+#include <functional>
 #endif
 
 namespace GameInABox { namespace Network { namespace Implementation {
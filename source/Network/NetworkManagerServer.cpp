@@ -30,6 +30,23 @@
 using namespace GameInABox::Network;
 using namespace GameInABox::Network::Implementation;
 
+namespace
+{
+LatencySummary Summarise(const LatencyHistogram& histogram)
+{
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+
+    return
+    {
+        histogram.Count(),
+        duration_cast<microseconds>(histogram.Percentile(0.5f)),
+        duration_cast<microseconds>(histogram.Percentile(0.99f)),
+        duration_cast<microseconds>(histogram.Maximum())
+    };
+}
+}
+
 NetworkManagerServer::NetworkManagerServer(
         INetworkProvider& network,
         IStateManager& stateManager)
@@ -42,6 +59,69 @@ NetworkManagerServer::~NetworkManagerServer()
 {
 }
 
+void NetworkManagerServer::SetBandwidthLimit(BandwidthLimit limit)
+{
+    myGuts->SetBandwidthLimit(limit);
+}
+
+std::vector<BandwidthUtilisation> NetworkManagerServer::Utilisation() const
+{
+    return myGuts->Utilisation();
+}
+
+void NetworkManagerServer::SetSendPacing(SendPacing pacing)
+{
+    myGuts->SetSendPacing(pacing);
+}
+
+void NetworkManagerServer::SetReceiveBudget(ReceiveBudget budget)
+{
+    myGuts->SetReceiveBudget(budget);
+}
+
+ReceiveShedding NetworkManagerServer::Shedding() const
+{
+    return myGuts->Shedding();
+}
+
+void NetworkManagerServer::SetCongestionSettings(CongestionSettings settings)
+{
+    myGuts->SetCongestionSettings(settings);
+}
+
+std::vector<CongestionState> NetworkManagerServer::Congestion() const
+{
+    return myGuts->Congestion();
+}
+
+DeltaCacheMetrics NetworkManagerServer::DeltaCache() const
+{
+    auto metrics = myGuts->DeltaCacheMetrics();
+
+    return
+    {
+        metrics.hits,
+        metrics.misses,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(metrics.timeEncoding),
+        std::chrono::duration_cast<std::chrono::nanoseconds>(metrics.timeSaved)
+    };
+}
+
+PipelineLatencySummary NetworkManagerServer::ReceiveLatency() const
+{
+    const auto& latency = myGuts->ReceiveLatency();
+
+    return
+    {
+        Summarise(latency.queued),
+        Summarise(latency.provider),
+        Summarise(latency.process),
+        Summarise(latency.decode),
+        Summarise(latency.parse),
+        Summarise(latency.endToEnd)
+    };
+}
+
 void NetworkManagerServer::PrivateProcessIncomming()
 {
     myGuts->ProcessIncomming();
@@ -0,0 +1,89 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef USING_PRECOMPILED_HEADERS
+#else
+#include "Common/PrecompiledHeaders.hpp"
+#endif
+
+#include "Implementation/MakeUnique.hpp"
+#include "Implementation/NetworkManagerServerShardedGuts.hpp"
+#include "NetworkManagerServerSharded.hpp"
+
+using namespace GameInABox::Network;
+using namespace GameInABox::Network::Implementation;
+
+NetworkManagerServerSharded::NetworkManagerServerSharded(
+        boost::asio::ip::udp::endpoint bindAddress,
+        std::size_t shardCount,
+        IStateManager& stateManager)
+    : INetworkManager()
+    , myGuts(make_unique<NetworkManagerServerShardedGuts>(bindAddress, shardCount, stateManager))
+{
+}
+
+NetworkManagerServerSharded::~NetworkManagerServerSharded()
+{
+}
+
+void NetworkManagerServerSharded::SetBandwidthLimit(BandwidthLimit limit)
+{
+    myGuts->SetBandwidthLimit(limit);
+}
+
+std::vector<BandwidthUtilisation> NetworkManagerServerSharded::Utilisation() const
+{
+    return myGuts->Utilisation();
+}
+
+void NetworkManagerServerSharded::SetSendPacing(SendPacing pacing)
+{
+    myGuts->SetSendPacing(pacing);
+}
+
+void NetworkManagerServerSharded::SetReceiveBudget(ReceiveBudget budget)
+{
+    myGuts->SetReceiveBudget(budget);
+}
+
+ReceiveShedding NetworkManagerServerSharded::Shedding() const
+{
+    return myGuts->Shedding();
+}
+
+void NetworkManagerServerSharded::SetCongestionSettings(CongestionSettings settings)
+{
+    myGuts->SetCongestionSettings(settings);
+}
+
+std::vector<CongestionState> NetworkManagerServerSharded::Congestion() const
+{
+    return myGuts->Congestion();
+}
+
+void NetworkManagerServerSharded::PrivateProcessIncomming()
+{
+    myGuts->ProcessIncomming();
+}
+
+void NetworkManagerServerSharded::PrivateSendState()
+{
+    myGuts->SendState();
+}
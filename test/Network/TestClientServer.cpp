@@ -19,12 +19,18 @@
 */
 
 #include <gmock/gmock.h>
+#include <algorithm>
 #include <chrono>
+#include <memory>
 #include <string>
 
+#include <NetworkManagerServer.hpp>
 #include <Implementation/NetworkManagerClientGuts.hpp>
 #include <Implementation/NetworkManagerServerGuts.hpp>
 #include <Implementation/NetworkProviderInMemory.hpp>
+#include <Implementation/PacketChallenge.hpp>
+#include <Implementation/PacketDelta.hpp>
+#include <Implementation/Packets.hpp>
 #include "MockINetworkProvider.hpp"
 #include "MockIStateManager.hpp"
 
@@ -59,6 +65,138 @@ Sequence DeltaParse(
     return payload.to;
 }
 
+// Uses the buffer versions, so the network shouldn't need a Delta per call.
+class StateManagerBuffered : public NiceMock<MockIStateManager>
+{
+public:
+    StateManagerBuffered()
+        : created(0)
+        , parsed(0)
+        , reused(0)
+        , parsedBytes(0)
+    {
+    }
+
+    int created;
+    int parsed;
+    int reused;
+    std::size_t parsedBytes;
+
+private:
+    DeltaView PrivateDeltaCreateInto(
+            ClientHandle client,
+            boost::optional<Sequence> lastAcked,
+            std::vector<uint8_t>& buffer) const override
+    {
+        // Qualified, otherwise we get IStateManager::DeltaCreate().
+        auto self = const_cast<StateManagerBuffered*>(this);
+        auto delta = Implementation::DeltaCreate(client, lastAcked);
+
+        ++self->created;
+        if (buffer.capacity() >= 64)
+        {
+            ++self->reused;
+        }
+
+        buffer.assign(64, 0x55);
+
+        return {delta.base, delta.to, buffer.data(), buffer.size()};
+    }
+
+    Sequence PrivateDeltaParseView(
+            ClientHandle,
+            const DeltaView& payload) override
+    {
+        ++parsed;
+        parsedBytes += payload.size;
+
+        return payload.to;
+    }
+};
+
+// Only does things a tick at a time.
+class StateManagerBatched : public NiceMock<MockIStateManager>
+{
+public:
+    StateManagerBatched()
+        : createCalls(0)
+        , created(0)
+        , parseCalls(0)
+        , parsed(0)
+        , createMost(0)
+        , parseMost(0)
+        , trafficCalls(0)
+        , received(0)
+        , sent(0)
+        , handshakeReceived(0)
+    {
+    }
+
+    int createCalls;
+    int created;
+    int parseCalls;
+    int parsed;
+    std::size_t createMost;
+    std::size_t parseMost;
+    int trafficCalls;
+    uint64_t received;
+    uint64_t sent;
+    uint64_t handshakeReceived;
+
+private:
+    void PrivateDeltaCreateAll(
+            std::vector<DeltaRequest>& requests,
+            std::vector<std::vector<uint8_t>>& buffers) const override
+    {
+        auto self = const_cast<StateManagerBatched*>(this);
+
+        ++self->createCalls;
+        self->createMost = std::max(self->createMost, requests.size());
+
+        for (std::size_t i = 0; i < requests.size(); ++i)
+        {
+            auto delta = Implementation::DeltaCreate(requests[i].client, requests[i].lastAcked);
+
+            buffers[i].assign(32, 0x7F);
+            requests[i].result = {delta.base, delta.to, buffers[i].data(), buffers[i].size()};
+            ++self->created;
+        }
+    }
+
+    void PrivateDeltaParseAll(std::vector<DeltaReceived>& deltas) override
+    {
+        ++parseCalls;
+        parseMost = std::max(parseMost, deltas.size());
+
+        for (auto& delta : deltas)
+        {
+            delta.acked = delta.payload.to;
+            ++parsed;
+        }
+    }
+
+    bool PrivateAccountPerTick() const override
+    {
+        return true;
+    }
+
+    void PrivateTraffic(const std::vector<TrafficTotal>& totals) override
+    {
+        ++trafficCalls;
+
+        for (const auto& total : totals)
+        {
+            received += total.bytesReceived;
+            sent += total.bytesSent;
+
+            if (!total.client)
+            {
+                handshakeReceived += total.packetsReceived;
+            }
+        }
+    }
+};
+
 // Class definition!
 class TestClientServer : public ::testing::Test
 {
@@ -202,9 +340,93 @@ TEST_F(TestClientServer, OneConnection)
     EXPECT_FALSE(client.HasFailed());
 }
 
+TEST_F(TestClientServer, ReceiveLatency)
+{
+    for (auto mock : {&stateMockClient, &stateMockServer})
+    {
+        SetupDefaultMock(*mock);
+    }
+
+    NetworkManagerServerGuts server{theNetwork, stateMockServer};
+    NetworkManagerClientGuts client{theNetwork, stateMockClient};
+
+    auto addressServer = udp::endpoint{address_v4(1l), 13444};
+    auto addressClient = udp::endpoint{address_v4(2l), 4444};
+
+    theNetwork.RunAs(addressClient);
+    client.Connect(addressServer);
+
+    const int ticks = 20;
+
+    for (int count = 0; count < ticks; ++count)
+    {
+        theNetwork.RunAs(addressServer);
+        server.ProcessIncomming();
+        server.SendState();
+
+        theNetwork.RunAs(addressClient);
+        client.ProcessIncomming();
+        client.SendState();
+    }
+
+    EXPECT_TRUE(client.IsConnected());
+
+    const auto& latency = server.ReceiveLatency();
+
+    EXPECT_EQ(ticks, latency.provider.Count());
+    EXPECT_GT(latency.process.Count(), 0);
+    EXPECT_GT(latency.parse.Count(), 0);
+    EXPECT_EQ(latency.parse.Count(), latency.decode.Count());
+
+    // The in memory provider doesn't stamp packets.
+    EXPECT_EQ(0, latency.queued.Count());
+    EXPECT_EQ(0, latency.endToEnd.Count());
+}
+
 // ///////////////////
 // Simulated Time
 // ///////////////////
+TEST_F(TestClientServer, PublicServerMetrics)
+{
+    for (auto mock : {&stateMockClient, &stateMockServer})
+    {
+        SetupDefaultMock(*mock);
+    }
+
+    NetworkManagerServer server{theNetwork, stateMockServer};
+    NetworkManagerClientGuts client{theNetwork, stateMockClient};
+
+    auto addressServer = udp::endpoint{address_v4(1l), 13444};
+    auto addressClient = udp::endpoint{address_v4(2l), 4444};
+
+    theNetwork.RunAs(addressClient);
+    client.Connect(addressServer);
+
+    for (int count = 0; count < 20; ++count)
+    {
+        theNetwork.RunAs(addressServer);
+        server.ProcessIncomming();
+        server.SendState();
+
+        theNetwork.RunAs(addressClient);
+        client.ProcessIncomming();
+        client.SendState();
+    }
+
+    ASSERT_TRUE(client.IsConnected());
+
+    auto cache = server.DeltaCache();
+
+    EXPECT_GT(cache.hits + cache.misses, 0);
+
+    auto latency = server.ReceiveLatency();
+
+    EXPECT_EQ(20, latency.provider.count);
+    EXPECT_GT(latency.process.count, 0);
+    EXPECT_GT(latency.parse.count, 0);
+    EXPECT_LE(latency.parse.median, latency.parse.percentile99);
+}
+
 TEST_F(TestClientServer, ClientTimeout)
 {
     OClock testTime{Clock::now()};
@@ -421,7 +643,7 @@ TEST_F(TestClientServer, NoSend)
     bool keepGoing = true;
 
     // Timeouts on this layer only work with the handshake part.
-    // Once connected it never times out.
+    // Once connected it only times out when idle.
     ON_CALL(stateMockClient, PrivateCanSend( ::testing::_, ::testing::_))
             .WillByDefault(Return(bool(false)));
 
@@ -458,6 +680,841 @@ TEST_F(TestClientServer, NoSend)
     EXPECT_NE(std::string::npos, client.FailReason().find("imeout"));
 }
 
-}}} // namespace
+TEST_F(TestClientServer, BandwidthLimit)
+{
+    OClock testTime{Clock::now()};
+
+    for (auto mock : {&stateMockClient, &stateMockServer})
+    {
+        SetupDefaultMock(*mock);
+    }
+
+    NetworkManagerServerGuts server{theNetwork, stateMockServer, [&testTime] () -> OClock { return testTime; }};
+    NetworkManagerClientGuts client{theNetwork, stateMockClient, [&testTime] () -> OClock { return testTime; }};
+
+    // Enough for roughly one tiny snapshot a second.
+    server.SetBandwidthLimit({10, 10});
+
+    auto addressServer = udp::endpoint{address_v4(1l), 13444};
+    auto addressClient = udp::endpoint{address_v4(2l), 4444};
+
+    theNetwork.RunAs(addressClient);
+    client.Connect(addressServer);
+
+    for (int count = 0; count < 100; ++count)
+    {
+        testTime += std::chrono::milliseconds(50);
+
+        theNetwork.RunAs(addressServer);
+        server.ProcessIncomming();
+        server.SendState();
+
+        theNetwork.RunAs(addressClient);
+        client.ProcessIncomming();
+        client.SendState();
+    }
+
+    EXPECT_TRUE(client.IsConnected());
+
+    auto utilisation = server.Utilisation();
+
+    ASSERT_EQ(1, utilisation.size());
+    EXPECT_EQ(42, utilisation[0].client.Value());
+    EXPECT_GT(utilisation[0].snapshotsSent, 0);
+    EXPECT_GT(utilisation[0].snapshotsDropped, utilisation[0].snapshotsSent);
+    EXPECT_GT(utilisation[0].utilisation0to1, 0.0f);
+    EXPECT_LE(utilisation[0].utilisation0to1, 1.0f);
+}
+
+TEST_F(TestClientServer, SendPacing)
+{
+    OClock testTime{Clock::now()};
+
+    for (auto mock : {&stateMockClient, &stateMockServer})
+    {
+        SetupDefaultMock(*mock);
+    }
+
+    // Big enough to need a few fragments.
+    ON_CALL(stateMockServer, PrivateDeltaCreate( ::testing::_, ::testing::_))
+            .WillByDefault(Invoke([] (ClientHandle client, boost::optional<Sequence> lastAcked) -> Delta
+    {
+        auto result = DeltaCreate(client, lastAcked);
+        result.deltaPayload = Bytes(4000, 0x55);
+        return result;
+    }));
+
+    int parsed = 0;
+    ON_CALL(stateMockClient, PrivateDeltaParse( ::testing::_, ::testing::_))
+            .WillByDefault(Invoke([&parsed] (ClientHandle client, const Delta& payload) -> Sequence
+    {
+        ++parsed;
+        return DeltaParse(client, payload);
+    }));
+
+    NetworkManagerServerGuts server{theNetwork, stateMockServer, [&testTime] () -> OClock { return testTime; }};
+    NetworkManagerClientGuts client{theNetwork, stateMockClient, [&testTime] () -> OClock { return testTime; }};
+
+    // Two groups, one fragment per call.
+    server.SetSendPacing({2, 1});
+
+    auto addressServer = udp::endpoint{address_v4(1l), 13444};
+    auto addressClient = udp::endpoint{address_v4(2l), 4444};
+
+    theNetwork.RunAs(addressClient);
+    client.Connect(addressServer);
+
+    const int ticks = 200;
+
+    for (int count = 0; count < ticks; ++count)
+    {
+        testTime += std::chrono::milliseconds(25);
+
+        theNetwork.RunAs(addressServer);
+        server.ProcessIncomming();
+        server.SendState();
+
+        theNetwork.RunAs(addressClient);
+        client.ProcessIncomming();
+        client.SendState();
+    }
+
+    EXPECT_TRUE(client.IsConnected());
+
+    // Only every other call is this client's turn, and the fragments trickle
+    // out one per call, so it can't get a snapshot every call.
+    EXPECT_GT(parsed, 0);
+    EXPECT_LE(parsed, ticks / 2);
+
+    EXPECT_EQ(ticks, server.SendStateLatency().Count());
+}
+
+TEST_F(TestClientServer, CongestionInterval)
+{
+    OClock testTime{Clock::now()};
+
+    // Default is a fixed interval, adaptive backs off under loss and recovers.
+    for (auto adaptive : {false, true})
+    {
+        NiceMock<MockIStateManager> stateServer;
+        NiceMock<MockIStateManager> stateClient;
+
+        SetupDefaultMock(stateServer);
+        SetupDefaultMock(stateClient);
+
+        // The client loses every other packet once lossy, so half the
+        // snapshots never get acked.
+        bool lossy = false;
+        unsigned received = 0;
+
+        ON_CALL(stateClient, PrivateCanReceive( ::testing::_, ::testing::_))
+                .WillByDefault(Invoke([&lossy, &received] (boost::optional<ClientHandle>, std::size_t) -> bool
+        {
+            return (!lossy) || ((++received % 2) == 0);
+        }));
 
+        // A new snapshot every time, so a lost one isn't just sent again.
+        uint16_t snapshot = 0;
 
+        ON_CALL(stateServer, PrivateDeltaCreate( ::testing::_, ::testing::_))
+                .WillByDefault(Invoke([&snapshot] (ClientHandle, boost::optional<Sequence> lastAcked) -> Delta
+        {
+            ++snapshot;
+            return {lastAcked ? *lastAcked : Sequence(snapshot), Sequence(snapshot), {}};
+        }));
+
+        NetworkProviderInMemory network([&testTime] () -> OClock { return testTime; });
+        NetworkManagerServerGuts server{network, stateServer, [&testTime] () -> OClock { return testTime; }};
+        NetworkManagerClientGuts client{network, stateClient, [&testTime] () -> OClock { return testTime; }};
+
+        if (adaptive)
+        {
+            server.SetCongestionSettings(CongestionControl::AdaptiveSettings());
+        }
+
+        auto addressServer = udp::endpoint{address_v4(1l), 13444};
+        auto addressClient = udp::endpoint{address_v4(2l), 4444};
+
+        network.RunAs(addressClient);
+        client.Connect(addressServer);
+
+        auto run = [&] (int ticks)
+        {
+            for (int count = 0; count < ticks; ++count)
+            {
+                testTime += std::chrono::milliseconds(50);
+
+                network.RunAs(addressServer);
+                server.ProcessIncomming();
+                server.SendState();
+
+                network.RunAs(addressClient);
+                client.ProcessIncomming();
+                client.SendState();
+            }
+        };
+
+        run(20);
+
+        ASSERT_TRUE(client.IsConnected());
+        ASSERT_EQ(1, server.Congestion().size());
+        EXPECT_EQ(1, server.Congestion()[0].interval);
+
+        lossy = true;
+        run(300);
+
+        ASSERT_TRUE(client.IsConnected());
+        ASSERT_EQ(1, server.Congestion().size());
+        EXPECT_GT(server.Congestion()[0].loss0to1, 0.25f);
+
+        if (adaptive)
+        {
+            EXPECT_GT(server.Congestion()[0].interval, 1);
+        }
+        else
+        {
+            EXPECT_EQ(1, server.Congestion()[0].interval);
+        }
+
+        lossy = false;
+        run(3000);
+
+        ASSERT_TRUE(client.IsConnected());
+        ASSERT_EQ(1, server.Congestion().size());
+        EXPECT_EQ(1, server.Congestion()[0].interval);
+    }
+}
+
+TEST_F(TestClientServer, LinkProfiles)
+{
+    using Link = NetworkProviderInMemory::LinkSettings;
+
+    struct Profile
+    {
+        std::string name;
+        Link up;
+        Link down;
+    };
+
+    // Rough shapes of real links, seeded so CI gets the same answer every run.
+    auto profiles = std::vector<Profile>
+    {
+        {
+            "Broadband",
+            Link{125000, 0, 0, Link::Jitter::Normal, Milliseconds{2}, 1},
+            Link{1250000, 0, 0, Link::Jitter::Normal, Milliseconds{2}, 2}
+        },
+        {
+            "Mobile",
+            Link{8000, 8, 0, Link::Jitter::Exponential, Milliseconds{30}, 3},
+            Link{32000, 16, 0, Link::Jitter::Exponential, Milliseconds{30}, 4}
+        },
+        {
+            "Wifi",
+            Link{50000, 32, 0.05f, Link::Jitter::Uniform, Milliseconds{15}, 5},
+            Link{50000, 32, 0.05f, Link::Jitter::Uniform, Milliseconds{15}, 6}
+        },
+    };
+
+    for (const auto& profile : profiles)
+    {
+        OClock testTime{Clock::now()};
+        NetworkProviderInMemory network([&testTime] () -> OClock { return testTime; });
+
+        NiceMock<MockIStateManager> stateServer;
+        NiceMock<MockIStateManager> stateClient;
+
+        SetupDefaultMock(stateServer);
+        SetupDefaultMock(stateClient);
+
+        ON_CALL(stateServer, PrivateDeltaCreate( ::testing::_, ::testing::_))
+                .WillByDefault(Invoke([] (ClientHandle client, boost::optional<Sequence> lastAcked) -> Delta
+        {
+            auto result = DeltaCreate(client, lastAcked);
+            result.deltaPayload = Bytes(200, 0x55);
+            return result;
+        }));
+
+        int parsed = 0;
+        ON_CALL(stateClient, PrivateDeltaParse( ::testing::_, ::testing::_))
+                .WillByDefault(Invoke([&parsed] (ClientHandle client, const Delta& payload) -> Sequence
+        {
+            ++parsed;
+            return DeltaParse(client, payload);
+        }));
+
+        NetworkManagerServerGuts server{network, stateServer, [&testTime] () -> OClock { return testTime; }};
+        NetworkManagerClientGuts client{network, stateClient, [&testTime] () -> OClock { return testTime; }};
+
+        auto addressServer = udp::endpoint{address_v4(1l), 13444};
+        auto addressClient = udp::endpoint{address_v4(2l), 4444};
+
+        network.SetLink(addressClient, profile.up, profile.down);
+
+        network.RunAs(addressClient);
+        client.Connect(addressServer);
+
+        const int ticks = 200;
+
+        for (int count = 0; count < ticks; ++count)
+        {
+            testTime += std::chrono::milliseconds(50);
+
+            network.RunAs(addressServer);
+            server.ProcessIncomming();
+            server.SendState();
+
+            network.RunAs(addressClient);
+            client.ProcessIncomming();
+            client.SendState();
+        }
+
+        auto counters = network.Counters(addressClient);
+        auto seconds = ticks * 50 / 1000;
+
+        ::testing::Test::RecordProperty(
+                (profile.name + "SnapshotPercent").c_str(),
+                (100 * parsed) / ticks);
+        ::testing::Test::RecordProperty(
+                (profile.name + "DownBytesPerSecond").c_str(),
+                static_cast<int>(counters.bytesReceived / seconds));
+
+        EXPECT_TRUE(client.IsConnected()) << profile.name;
+        EXPECT_GT(parsed, 0) << profile.name;
+        EXPECT_GT(counters.packetsReceived, 0) << profile.name;
+        EXPECT_GT(counters.packetsSent, 0) << profile.name;
+    }
+}
+
+TEST_F(TestClientServer, ChallengeFloodAllocatesNothing)
+{
+    SetupDefaultMock(stateMockServer);
+
+    NetworkManagerServerGuts server{theNetwork, stateMockServer};
+
+    auto addressServer = udp::endpoint{address_v4(1l), 13444};
+
+    for (unsigned flooder = 0; flooder < 1000; ++flooder)
+    {
+        theNetwork.RunAs(udp::endpoint{address_v4(100 + flooder), 5000});
+        theNetwork.Send({{PacketChallenge().data, addressServer}});
+    }
+
+    theNetwork.RunAs(addressServer);
+    server.ProcessIncomming();
+
+    EXPECT_EQ(0, server.ConnectionCount());
+
+    // But they all got a key.
+    theNetwork.RunAs(udp::endpoint{address_v4(100), 5000});
+    auto responses = theNetwork.Receive();
+
+    ASSERT_EQ(1, responses.size());
+    EXPECT_TRUE(PacketChallengeResponse(responses[0].data).IsValid());
+}
+
+TEST_F(TestClientServer, SharedCookieSecret)
+{
+    SetupDefaultMock(stateMockServer);
+
+    // Two servers behind one port, the challenge goes to one and the connect to the other.
+    auto secret = GetNetworkKeyRandom();
+
+    NetworkManagerServerGuts challenged{theNetwork, stateMockServer, Clock::now, secret};
+    NetworkManagerServerGuts connected{theNetwork, stateMockServer, Clock::now, secret};
+    NetworkManagerServerGuts stranger{theNetwork, stateMockServer};
+
+    auto addressServer = udp::endpoint{address_v4(1l), 13444};
+    auto addressClient = udp::endpoint{address_v4(2l), 4444};
+
+    theNetwork.RunAs(addressClient);
+    theNetwork.Send({{PacketChallenge().data, addressServer}});
+    theNetwork.RunAs(addressServer);
+    challenged.ProcessIncomming();
+    theNetwork.RunAs(addressClient);
+
+    auto responses = theNetwork.Receive();
+
+    ASSERT_EQ(1, responses.size());
+
+    auto key = PacketChallengeResponse(responses[0].data).Key();
+
+    auto connectTo = [&] (NetworkManagerServerGuts& server)
+    {
+        theNetwork.RunAs(addressClient);
+        theNetwork.Send({{PacketConnect(key).data, addressServer}});
+        theNetwork.RunAs(addressServer);
+        server.ProcessIncomming();
+
+        return server.ConnectionCount();
+    };
+
+    EXPECT_EQ(0, connectTo(stranger));
+    EXPECT_EQ(1, connectTo(connected));
+}
+
+TEST_F(TestClientServer, ConnectNeedsAFreshKey)
+{
+    OClock testTime{Clock::now()};
+
+    SetupDefaultMock(stateMockServer);
+
+    NetworkManagerServerGuts server{theNetwork, stateMockServer, [&testTime] () -> OClock { return testTime; }};
+
+    auto addressServer = udp::endpoint{address_v4(1l), 13444};
+    auto addressClient = udp::endpoint{address_v4(2l), 4444};
+
+    auto connectWith = [&] (NetworkKey key, udp::endpoint from)
+    {
+        theNetwork.RunAs(from);
+        theNetwork.Send({{PacketConnect(key).data, addressServer}});
+
+        theNetwork.RunAs(addressServer);
+        server.ProcessIncomming();
+    };
+
+    // Get a real key.
+    theNetwork.RunAs(addressClient);
+    theNetwork.Send({{PacketChallenge().data, addressServer}});
+    theNetwork.RunAs(addressServer);
+    server.ProcessIncomming();
+    theNetwork.RunAs(addressClient);
+
+    auto responses = theNetwork.Receive();
+
+    ASSERT_EQ(1, responses.size());
+
+    auto key = PacketChallengeResponse(responses[0].data).Key();
+
+    // Forged.
+    connectWith(GetNetworkKeyRandom(), addressClient);
+    EXPECT_EQ(0, server.ConnectionCount());
+
+    // Someone else's.
+    connectWith(key, udp::endpoint{address_v4(3l), 4444});
+    EXPECT_EQ(0, server.ConnectionCount());
+
+    // Stale.
+    testTime += HandshakeCookie::Period() * 2;
+    connectWith(key, addressClient);
+    EXPECT_EQ(0, server.ConnectionCount());
+
+    // Fresh.
+    theNetwork.RunAs(addressClient);
+    theNetwork.Receive();
+    theNetwork.Send({{PacketChallenge().data, addressServer}});
+    theNetwork.RunAs(addressServer);
+    server.ProcessIncomming();
+    theNetwork.RunAs(addressClient);
+
+    responses = theNetwork.Receive();
+
+    ASSERT_EQ(1, responses.size());
+
+    connectWith(PacketChallengeResponse(responses[0].data).Key(), addressClient);
+    EXPECT_EQ(1, server.ConnectionCount());
+}
+
+TEST_F(TestClientServer, ReceiveBudgetConnectedFirst)
+{
+    OClock testTime{Clock::now()};
+
+    for (auto mock : {&stateMockClient, &stateMockServer})
+    {
+        SetupDefaultMock(*mock);
+    }
+
+    NetworkManagerServerGuts server{theNetwork, stateMockServer, [&testTime] () -> OClock { return testTime; }};
+    NetworkManagerClientGuts client{theNetwork, stateMockClient, [&testTime] () -> OClock { return testTime; }};
+
+    auto addressServer = udp::endpoint{address_v4(1l), 13444};
+    auto addressClient = udp::endpoint{address_v4(2l), 4444};
+
+    theNetwork.RunAs(addressClient);
+    client.Connect(addressServer);
+
+    auto tick = [&] ()
+    {
+        testTime += std::chrono::milliseconds(50);
+
+        theNetwork.RunAs(addressServer);
+        server.ProcessIncomming();
+        server.SendState();
+
+        theNetwork.RunAs(addressClient);
+        client.ProcessIncomming();
+        client.SendState();
+    };
+
+    for (int count = 0; count < 10; ++count)
+    {
+        tick();
+    }
+
+    ASSERT_TRUE(client.IsConnected());
+
+    // Only room for the client's packets, the flood doesn't get a look in.
+    server.SetReceiveBudget({2, std::chrono::microseconds{0}, 0});
+
+    for (int count = 0; count < 50; ++count)
+    {
+        for (unsigned flooder = 0; flooder < 20; ++flooder)
+        {
+            theNetwork.RunAs(udp::endpoint{address_v4(100 + flooder), 5000});
+            theNetwork.Send({{PacketChallenge().data, addressServer}});
+        }
+
+        tick();
+    }
+
+    EXPECT_TRUE(client.IsConnected());
+
+    auto shedding = server.Shedding();
+
+    EXPECT_EQ(0, shedding.connectedDropped);
+    EXPECT_GE(shedding.handshakeDropped, 50 * 19);
+    EXPECT_EQ(0, shedding.backlog);
+}
+
+TEST_F(TestClientServer, ReceiveBudgetUnknownDeltasLast)
+{
+    OClock testTime{Clock::now()};
+
+    for (auto mock : {&stateMockClient, &stateMockServer})
+    {
+        SetupDefaultMock(*mock);
+    }
+
+    int parsed = 0;
+    ON_CALL(stateMockServer, PrivateDeltaParse( ::testing::_, ::testing::_))
+            .WillByDefault(Invoke([&parsed] (ClientHandle client, const Delta& payload) -> Sequence
+    {
+        ++parsed;
+        return DeltaParse(client, payload);
+    }));
+
+    NetworkManagerServerGuts server{theNetwork, stateMockServer, [&testTime] () -> OClock { return testTime; }};
+    NetworkManagerClientGuts client{theNetwork, stateMockClient, [&testTime] () -> OClock { return testTime; }};
+
+    auto addressServer = udp::endpoint{address_v4(1l), 13444};
+    auto addressClient = udp::endpoint{address_v4(2l), 4444};
+
+    theNetwork.RunAs(addressClient);
+    client.Connect(addressServer);
+
+    auto tick = [&] ()
+    {
+        testTime += std::chrono::milliseconds(50);
+
+        theNetwork.RunAs(addressServer);
+        server.ProcessIncomming();
+        server.SendState();
+
+        theNetwork.RunAs(addressClient);
+        client.ProcessIncomming();
+        client.SendState();
+    };
+
+    for (int count = 0; count < 10; ++count)
+    {
+        tick();
+    }
+
+    ASSERT_TRUE(client.IsConnected());
+
+    server.SetReceiveBudget({2, std::chrono::microseconds{0}, 0});
+
+    auto parsedBefore = parsed;
+
+    // Delta shaped packets from addresses the server has never seen.
+    for (int count = 0; count < 50; ++count)
+    {
+        for (unsigned flooder = 0; flooder < 20; ++flooder)
+        {
+            auto spoofed = PacketDelta{Sequence(0), Sequence(1), 32, uint16_t(flooder), {1, 2, 3, 4}};
+
+            theNetwork.RunAs(udp::endpoint{address_v4(100 + flooder), 5000});
+            theNetwork.Send({{spoofed.data, addressServer}});
+        }
+
+        tick();
+    }
+
+    EXPECT_TRUE(client.IsConnected());
+    EXPECT_GE(parsed - parsedBefore, 45);
+
+    auto shedding = server.Shedding();
+
+    EXPECT_EQ(0, shedding.connectedDropped);
+    EXPECT_GE(shedding.unknownDropped, 50 * 19);
+    EXPECT_EQ(0, shedding.backlog);
+}
+
+TEST_F(TestClientServer, ReceiveBudgetBacklogDropsOldest)
+{
+    SetupDefaultMock(stateMockServer);
+
+    NetworkManagerServerGuts server{theNetwork, stateMockServer};
+
+    auto addressServer = udp::endpoint{address_v4(1l), 13444};
+
+    server.SetReceiveBudget({1, std::chrono::microseconds{0}, 2});
+
+    for (unsigned flooder = 0; flooder < 5; ++flooder)
+    {
+        theNetwork.RunAs(udp::endpoint{address_v4(100 + flooder), 5000});
+        theNetwork.Send({{PacketChallenge().data, addressServer}});
+    }
+
+    theNetwork.RunAs(addressServer);
+    server.ProcessIncomming();
+
+    // 5 in, 1 processed, 2 kept, the 2 oldest dropped.
+    auto shedding = server.Shedding();
+
+    EXPECT_EQ(2, shedding.handshakeDropped);
+    EXPECT_EQ(2, shedding.deferred);
+    EXPECT_EQ(2, shedding.backlog);
+
+    server.ProcessIncomming();
+    server.ProcessIncomming();
+
+    shedding = server.Shedding();
+
+    EXPECT_EQ(2, shedding.handshakeDropped);
+    EXPECT_EQ(3, shedding.deferred);
+    EXPECT_EQ(0, shedding.backlog);
+}
+
+TEST_F(TestClientServer, ReceiveBudgetTime)
+{
+    SetupDefaultMock(stateMockServer);
+
+    // Each look at the clock costs a millisecond.
+    OClock testTime{Clock::now()};
+    NetworkManagerServerGuts server{theNetwork, stateMockServer, [&testTime] () -> OClock
+    {
+        testTime += std::chrono::milliseconds(1);
+        return testTime;
+    }};
+
+    auto addressServer = udp::endpoint{address_v4(1l), 13444};
+
+    server.SetReceiveBudget({0, std::chrono::microseconds{500}, 100});
+
+    for (unsigned flooder = 0; flooder < 20; ++flooder)
+    {
+        theNetwork.RunAs(udp::endpoint{address_v4(100 + flooder), 5000});
+        theNetwork.Send({{PacketChallenge().data, addressServer}});
+    }
+
+    theNetwork.RunAs(addressServer);
+    server.ProcessIncomming();
+
+    // Always does one, so it makes progress.
+    EXPECT_EQ(19, server.Shedding().backlog);
+
+    // Taking the budget off does the rest.
+    server.SetReceiveBudget({0, std::chrono::microseconds{0}, 0});
+    server.ProcessIncomming();
+
+    EXPECT_EQ(0, server.Shedding().backlog);
+    EXPECT_EQ(0, server.Shedding().handshakeDropped);
+}
+
+TEST_F(TestClientServer, DeltaBuffersReused)
+{
+    StateManagerBuffered stateServer;
+    StateManagerBuffered stateClient;
+
+    for (auto mock : {&stateClient, &stateServer})
+    {
+        SetupDefaultMock(*mock);
+
+        // The Delta returning versions should never be used.
+        EXPECT_CALL(*mock, PrivateDeltaCreate( ::testing::_, ::testing::_)).Times(0);
+        EXPECT_CALL(*mock, PrivateDeltaParse( ::testing::_, ::testing::_)).Times(0);
+    }
+
+    NetworkManagerServerGuts server{theNetwork, stateServer};
+    NetworkManagerClientGuts client{theNetwork, stateClient};
+
+    auto addressServer = udp::endpoint{address_v4(1l), 13444};
+    auto addressClient = udp::endpoint{address_v4(2l), 4444};
+
+    theNetwork.RunAs(addressClient);
+    client.Connect(addressServer);
+
+    for (int count = 0; count < 100; ++count)
+    {
+        theNetwork.RunAs(addressServer);
+        server.ProcessIncomming();
+        server.SendState();
+
+        theNetwork.RunAs(addressClient);
+        client.ProcessIncomming();
+        client.SendState();
+    }
+
+    EXPECT_TRUE(client.IsConnected());
+
+    for (auto state : {&stateClient, &stateServer})
+    {
+        EXPECT_GT(state->created, 1);
+        EXPECT_GT(state->parsed, 0);
+        // Huffman can decode a few bytes of padding, so at least.
+        EXPECT_LE(64 * state->parsed, state->parsedBytes);
+
+        // Only the first call should need to allocate.
+        EXPECT_EQ(state->created - 1, state->reused);
+    }
+}
+
+TEST_F(TestClientServer, DeltaBuffersDefault)
+{
+    for (auto mock : {&stateMockClient, &stateMockServer})
+    {
+        SetupDefaultMock(*mock);
+    }
+
+    // State managers that only know about Delta still work.
+    ON_CALL(stateMockServer, PrivateDeltaCreate( ::testing::_, ::testing::_))
+            .WillByDefault(Invoke([] (ClientHandle client, boost::optional<Sequence> lastAcked) -> Delta
+    {
+        auto result = DeltaCreate(client, lastAcked);
+        result.deltaPayload = Bytes(100, 0x7F);
+        return result;
+    }));
+
+    Bytes lastParsed;
+    ON_CALL(stateMockClient, PrivateDeltaParse( ::testing::_, ::testing::_))
+            .WillByDefault(Invoke([&lastParsed] (ClientHandle client, const Delta& payload) -> Sequence
+    {
+        lastParsed = payload.deltaPayload;
+        return DeltaParse(client, payload);
+    }));
+
+    NetworkManagerServerGuts server{theNetwork, stateMockServer};
+    NetworkManagerClientGuts client{theNetwork, stateMockClient};
+
+    auto addressServer = udp::endpoint{address_v4(1l), 13444};
+    auto addressClient = udp::endpoint{address_v4(2l), 4444};
+
+    theNetwork.RunAs(addressClient);
+    client.Connect(addressServer);
+
+    for (int count = 0; count < 100; ++count)
+    {
+        theNetwork.RunAs(addressServer);
+        server.ProcessIncomming();
+        server.SendState();
+
+        theNetwork.RunAs(addressClient);
+        client.ProcessIncomming();
+        client.SendState();
+    }
+
+    EXPECT_TRUE(client.IsConnected());
+    EXPECT_EQ(Bytes(100, 0x7F), lastParsed);
+}
+
+TEST_F(TestClientServer, BatchedStateManager)
+{
+    StateManagerBatched stateServer;
+
+    SetupDefaultMock(stateServer);
+    SetupDefaultMock(stateMockClient);
+
+    // Every client gets its own handle.
+    uint32_t nextHandle = 42;
+
+    ON_CALL(stateServer, PrivateConnect( ::testing::_, ::testing::_))
+            .WillByDefault(Invoke([&nextHandle] (std::vector<uint8_t>, std::string&) -> boost::optional<ClientHandle>
+    {
+        return ClientHandle{nextHandle++};
+    }));
+
+    // None of the per client or per packet versions should be used.
+    EXPECT_CALL(stateServer, PrivateDeltaCreate( ::testing::_, ::testing::_)).Times(0);
+    EXPECT_CALL(stateServer, PrivateDeltaParse( ::testing::_, ::testing::_)).Times(0);
+    EXPECT_CALL(stateServer, PrivateCanSend( ::testing::_, ::testing::_)).Times(0);
+    EXPECT_CALL(stateServer, PrivateCanReceive( ::testing::_, ::testing::_)).Times(0);
+
+    NetworkManagerServerGuts server{theNetwork, stateServer};
+
+    auto addressServer = udp::endpoint{address_v4(1l), 13444};
+
+    const std::size_t clientCount = 4;
+    std::vector<std::unique_ptr<NetworkManagerClientGuts>> clients;
+    std::vector<udp::endpoint> addressClients;
+
+    auto tick = [&] ()
+    {
+        theNetwork.RunAs(addressServer);
+        server.ProcessIncomming();
+        server.SendState();
+
+        for (std::size_t i = 0; i < clients.size(); ++i)
+        {
+            theNetwork.RunAs(addressClients[i]);
+            clients[i]->ProcessIncomming();
+            clients[i]->SendState();
+        }
+    };
+
+    // Connect resets the in memory network, so connect one at a time.
+    for (std::size_t i = 0; i < clientCount; ++i)
+    {
+        addressClients.emplace_back(address_v4(2l + i), 4444);
+        clients.emplace_back(new NetworkManagerClientGuts{theNetwork, stateMockClient});
+
+        theNetwork.RunAs(addressClients.back());
+        clients.back()->Connect(addressServer);
+
+        for (int count = 0; (count < 100) && (!clients.back()->IsConnected()); ++count)
+        {
+            tick();
+        }
+
+        ASSERT_TRUE(clients.back()->IsConnected());
+    }
+
+    ASSERT_EQ(clientCount, server.ConnectionCount());
+
+    // Handshakes are done, only count the steady state.
+    const int ticks = 100;
+
+    stateServer.createCalls = 0;
+    stateServer.created = 0;
+    stateServer.createMost = 0;
+    stateServer.parseCalls = 0;
+    stateServer.parsed = 0;
+    stateServer.parseMost = 0;
+    stateServer.trafficCalls = 0;
+
+    for (int count = 0; count < ticks; ++count)
+    {
+        tick();
+    }
+
+    for (const auto& client : clients)
+    {
+        EXPECT_TRUE(client->IsConnected());
+    }
+
+    // One call a tick, however many clients, and each call
+    // has every client in it.
+    EXPECT_EQ(ticks, stateServer.createCalls);
+    EXPECT_EQ(ticks * static_cast<int>(clientCount), stateServer.created);
+    EXPECT_EQ(clientCount, stateServer.createMost);
+    EXPECT_GT(stateServer.parsed, 0);
+    EXPECT_LE(stateServer.parseCalls, ticks);
+    EXPECT_EQ(clientCount, stateServer.parseMost);
+    EXPECT_LE(stateServer.trafficCalls, ticks);
+
+    EXPECT_GT(stateServer.received, 0);
+    EXPECT_GT(stateServer.sent, 0);
+    EXPECT_GT(stateServer.handshakeReceived, 0);
+}
+
+}}} // namespace
@@ -0,0 +1,150 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <Implementation/CongestionControl.hpp>
+#include <gmock/gmock.h>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+namespace
+{
+// Runs ticks, every sent snapshot is acked a tick later unless dropIfTrue says otherwise.
+template<typename DROP>
+void RunTicks(CongestionControl& toTest, OClock& now, uint16_t& sequence, unsigned ticks, DROP dropIfTrue)
+{
+    for (unsigned i = 0; i < ticks; ++i)
+    {
+        if (toTest.ShouldSend())
+        {
+            auto sent = Sequence(sequence++);
+
+            toTest.Sent(sent, now);
+
+            if (!dropIfTrue(sent))
+            {
+                toTest.Acked(sent, now + milliseconds(50));
+            }
+        }
+
+        now += milliseconds(50);
+    }
+}
+}
+
+TEST(TestCongestionControl, DefaultSendsEveryTick)
+{
+    CongestionControl toTest{};
+
+    for (int i = 0; i < 100; ++i)
+    {
+        EXPECT_TRUE(toTest.ShouldSend());
+    }
+
+    EXPECT_EQ(1, toTest.Interval());
+}
+
+TEST(TestCongestionControl, BacksOffUnderLossThenRecovers)
+{
+    CongestionControl toTest{CongestionSettings{1, 8, 0.25f, 0.05f}};
+    OClock now{};
+    uint16_t sequence{0};
+
+    // Lose every other snapshot.
+    RunTicks(toTest, now, sequence, 200, [](Sequence s) { return (s.Value() % 2) == 0; });
+
+    EXPECT_GT(toTest.Loss(), 0.25f);
+    EXPECT_EQ(8, toTest.Interval());
+
+    // Network gets better.
+    RunTicks(toTest, now, sequence, 2000, [](Sequence) { return false; });
+
+    EXPECT_LT(toTest.Loss(), 0.05f);
+    EXPECT_EQ(1, toTest.Interval());
+}
+
+TEST(TestCongestionControl, IntervalRespectsBounds)
+{
+    CongestionControl toTest{CongestionSettings{2, 4, 0.25f, 0.05f}};
+    OClock now{};
+    uint16_t sequence{0};
+
+    EXPECT_EQ(2, toTest.Interval());
+
+    RunTicks(toTest, now, sequence, 500, [](Sequence) { return true; });
+
+    EXPECT_EQ(4, toTest.Interval());
+
+    RunTicks(toTest, now, sequence, 5000, [](Sequence) { return false; });
+
+    EXPECT_EQ(2, toTest.Interval());
+}
+
+TEST(TestCongestionControl, InvalidBoundsAreFixed)
+{
+    CongestionControl toTest{CongestionSettings{0, 0, 0.25f, 0.05f}};
+
+    EXPECT_EQ(1, toTest.Interval());
+    EXPECT_TRUE(toTest.ShouldSend());
+    EXPECT_TRUE(toTest.ShouldSend());
+}
+
+TEST(TestCongestionControl, RoundTripTime)
+{
+    CongestionControl toTest{};
+    OClock now{};
+
+    toTest.Sent(Sequence(1), now);
+    toTest.Acked(Sequence(1), now + milliseconds(100));
+
+    EXPECT_EQ(100, toTest.RoundTripTime().count());
+    EXPECT_EQ(100, toTest.RoundTripTimeMinimum().count());
+
+    toTest.Sent(Sequence(2), now);
+    toTest.Acked(Sequence(2), now + milliseconds(20));
+
+    // (100 * 7 + 20) / 8
+    EXPECT_EQ(90, toTest.RoundTripTime().count());
+    EXPECT_EQ(20, toTest.RoundTripTimeMinimum().count());
+    EXPECT_EQ(0.0f, toTest.Loss());
+}
+
+TEST(TestCongestionControl, SkippedAcksCountAsLoss)
+{
+    CongestionControl toTest{};
+    OClock now{};
+
+    toTest.Sent(Sequence(1), now);
+    toTest.Acked(Sequence(1), now);
+    toTest.Sent(Sequence(2), now);
+    toTest.Sent(Sequence(3), now);
+    toTest.Acked(Sequence(3), now);
+
+    EXPECT_GT(toTest.Loss(), 0.0f);
+
+    // Old acks are ignored.
+    auto loss = toTest.Loss();
+    toTest.Acked(Sequence(2), now);
+    EXPECT_EQ(loss, toTest.Loss());
+}
+
+}}} // namespace
@@ -329,6 +329,64 @@ TEST_F(TestConnection, ClientServerConnectDisconnectFromServer)
     EXPECT_EQ(reason, toTestServer.FailReason());
 }
 
+TEST_F(TestConnection, NextTimeoutHandshake)
+{
+    OClock testTime{Clock::now()};
+    Connection toTest{stateMockNice, [&testTime] () -> OClock { return testTime; }};
+
+    EXPECT_EQ(OClock::max(), toTest.NextTimeout());
+
+    toTest.Start(Connection::Mode::Client);
+
+    // Send a challenge straight away.
+    EXPECT_LE(toTest.NextTimeout(), testTime);
+    EXPECT_NE(Bytes{}, toTest.Process({}));
+
+    // Then nothing until the retry.
+    auto next = toTest.NextTimeout();
+    EXPECT_GT(next, testTime);
+
+    testTime = next - std::chrono::milliseconds{1};
+    EXPECT_EQ(Bytes{}, toTest.Process({}));
+
+    testTime = next;
+    EXPECT_NE(Bytes{}, toTest.Process({}));
+}
+
+TEST_F(TestConnection, IdleTimeout)
+{
+    OClock testTime{Clock::now()};
+    Connection toTestClient{stateMockNice, [&testTime] () -> OClock { return testTime; }};
+    Connection toTestServer{stateMockNice, [&testTime] () -> OClock { return testTime; }};
+
+    toTestClient.Start(Connection::Mode::Client);
+    toTestServer.Start(Connection::Mode::Server);
+
+    ON_CALL(stateMockNice, PrivateConnect( ::testing::_, ::testing::_))
+            .WillByDefault(Return(boost::optional<ClientHandle>(42)));
+
+    ON_CALL(stateMockNice, PrivateStateInfo( ::testing::_ ))
+            .WillByDefault(Return(std::vector<uint8_t>()));
+
+    Cycle(toTestClient, toTestServer, testTime, 1000);
+    toTestServer.Process(PacketDelta{Sequence{0}, {}, 0, Bytes(42,0x20)}.data);
+
+    ASSERT_TRUE(toTestServer.IsConnected());
+
+    // Keep alive.
+    testTime = toTestServer.NextTimeout() - std::chrono::milliseconds{1};
+    toTestServer.Process(PacketDelta{Sequence{1}, {}, 0, Bytes(42,0x20)}.data);
+    EXPECT_EQ(Bytes{}, toTestServer.Process({}));
+    EXPECT_TRUE(toTestServer.IsConnected());
+
+    // Then nothing.
+    testTime = toTestServer.NextTimeout();
+    EXPECT_NE(Bytes{}, toTestServer.Process({}));
+    EXPECT_TRUE(toTestServer.HasFailed());
+    EXPECT_NE(std::string::npos, toTestServer.FailReason().find("Idle"));
+    EXPECT_EQ(OClock::max(), toTestServer.NextTimeout());
+}
+
 int Cycle(Connection& client, Connection& server, OClock &testTime, int countMax)
 {
     int count{0};
@@ -0,0 +1,110 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <Implementation/DeltaCache.hpp>
+#include <Implementation/Huffman.hpp>
+#include <gmock/gmock.h>
+
+using namespace std;
+using Bytes = std::vector<uint8_t>;
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+class TestDeltaCache : public ::testing::Test
+{
+public:
+    TestDeltaCache()
+        : compressor(Frequencies())
+    {
+    }
+
+    static std::array<uint64_t, 256> Frequencies()
+    {
+        std::array<uint64_t, 256> result;
+        result.fill(1);
+        result[0] = 10;
+
+        return result;
+    }
+
+    Huffman compressor;
+};
+
+TEST_F(TestDeltaCache, SameAsHuffman)
+{
+    DeltaCache toTest(compressor);
+    auto delta = Delta{Sequence{1}, Sequence{4}, Bytes{0,0,0,1,2,3,0,0}};
+
+    EXPECT_EQ(compressor.Encode(delta.deltaPayload), toTest.Encode(delta));
+    EXPECT_EQ(compressor.Encode(delta.deltaPayload), toTest.Encode(delta));
+}
+
+TEST_F(TestDeltaCache, HitsAndMisses)
+{
+    DeltaCache toTest(compressor);
+    auto delta = Delta{Sequence{1}, Sequence{4}, Bytes{0,0,0,1,2,3,0,0}};
+
+    for (int i = 0; i < 8; ++i)
+    {
+        toTest.Encode(delta);
+    }
+
+    auto metrics = toTest.GetMetrics();
+
+    EXPECT_EQ(1, metrics.misses);
+    EXPECT_EQ(7, metrics.hits);
+}
+
+TEST_F(TestDeltaCache, DifferentKeysMiss)
+{
+    DeltaCache toTest(compressor);
+    auto payload = Bytes{0,0,0,1,2,3,0,0};
+    auto other = Bytes{0,0,0,1,2,3,0,1};
+
+    toTest.Encode(Delta{Sequence{1}, Sequence{4}, payload});
+    toTest.Encode(Delta{Sequence{2}, Sequence{4}, payload});
+    toTest.Encode(Delta{Sequence{1}, Sequence{5}, payload});
+
+    // Same sequences, different content (clients might have different views).
+    EXPECT_EQ(compressor.Encode(other), toTest.Encode(Delta{Sequence{1}, Sequence{4}, other}));
+
+    auto metrics = toTest.GetMetrics();
+
+    EXPECT_EQ(4, metrics.misses);
+    EXPECT_EQ(0, metrics.hits);
+}
+
+TEST_F(TestDeltaCache, ClearEmptiesCacheNotMetrics)
+{
+    DeltaCache toTest(compressor);
+    auto delta = Delta{Sequence{1}, Sequence{4}, Bytes{0,0,0,1,2,3,0,0}};
+
+    toTest.Encode(delta);
+    toTest.Encode(delta);
+    toTest.Clear();
+    toTest.Encode(delta);
+
+    auto metrics = toTest.GetMetrics();
+
+    EXPECT_EQ(2, metrics.misses);
+    EXPECT_EQ(1, metrics.hits);
+}
+
+}}} // namespace
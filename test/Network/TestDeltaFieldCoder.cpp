@@ -0,0 +1,462 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <Implementation/DeltaFieldCoder.hpp>
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+struct FieldTester
+{
+    uint8_t small;
+    uint16_t medium;
+    uint32_t packed;
+    uint64_t large;
+    int32_t negative;
+    int64_t negativeLarge;
+    float real;
+    double precise;
+};
+
+typedef DeltaFieldCoder<
+        FieldTester,
+        DELTA_FIELD(FieldTester, small),
+        DELTA_FIELD(FieldTester, medium),
+        DELTA_FIELD_BITS(FieldTester, packed, 18),
+        DELTA_FIELD_BITS(FieldTester, large, 40),
+        DELTA_FIELD(FieldTester, negative),
+        DELTA_FIELD(FieldTester, negativeLarge),
+        DELTA_FIELD(FieldTester, real),
+        DELTA_FIELD(FieldTester, precise)> FieldTesterCoder;
+
+FieldTester Identity()
+{
+    return FieldTester{0, 0, 0, 0, 0, 0, 0.0f, 0.0};
+}
+
+FieldTester First()
+{
+    return FieldTester{
+        200,
+        60000,
+        0x3FFFF,
+        0xFF12345678ull,
+        -42,
+        std::numeric_limits<int64_t>::min(),
+        3.141f,
+        -2.718281828};
+}
+
+void ExpectSame(const FieldTester& expected, const FieldTester& actual)
+{
+    EXPECT_EQ(expected.small, actual.small);
+    EXPECT_EQ(expected.medium, actual.medium);
+    EXPECT_EQ(expected.packed, actual.packed);
+    EXPECT_EQ(expected.large, actual.large);
+    EXPECT_EQ(expected.negative, actual.negative);
+    EXPECT_EQ(expected.negativeLarge, actual.negativeLarge);
+    EXPECT_EQ(expected.real, actual.real);
+    EXPECT_EQ(expected.precise, actual.precise);
+}
+
+TEST(TestDeltaFieldCoder, Sizes)
+{
+    EXPECT_EQ(8, FieldTesterCoder::FieldCount());
+    EXPECT_EQ(8 + 8 + 16 + 18 + 40 + 32 + 64 + 32 + 64, FieldTesterCoder::MaximumBits());
+}
+
+TEST(TestDeltaFieldCoder, EncodeDecodeAgainstIdentity)
+{
+    FieldTesterCoder coder(Identity());
+    BitStream data(32);
+    FieldTester result = Identity();
+
+    EXPECT_FALSE(coder.DeltaEncode(nullptr, First(), data));
+    EXPECT_EQ(FieldTesterCoder::MaximumBits(), data.SizeInBits());
+
+    coder.DeltaDecode(nullptr, result, data);
+
+    ExpectSame(First(), result);
+}
+
+TEST(TestDeltaFieldCoder, NoChange)
+{
+    FieldTesterCoder coder(Identity());
+    BitStream data(32);
+    auto first = First();
+    FieldTester result = Identity();
+
+    EXPECT_TRUE(coder.DeltaEncode(&first, first, data));
+
+    // One bit per field.
+    EXPECT_EQ(FieldTesterCoder::FieldCount(), data.SizeInBits());
+
+    coder.DeltaDecode(&first, result, data);
+
+    ExpectSame(first, result);
+}
+
+TEST(TestDeltaFieldCoder, WireFormat)
+{
+    FieldTesterCoder coder(Identity());
+    BitStream data(32);
+    auto second = Identity();
+
+    second.packed = 0x2ABCD;
+    second.large = 0xAB00000001ull;
+
+    coder.DeltaEncode(nullptr, second, data);
+
+    EXPECT_TRUE(data.Pull1Bit());
+    EXPECT_TRUE(data.Pull1Bit());
+
+    EXPECT_FALSE(data.Pull1Bit());
+    EXPECT_EQ(0x2ABCDu, data.PullU32(18));
+
+    // Top 8 bits, then the bottom 32.
+    EXPECT_FALSE(data.Pull1Bit());
+    EXPECT_EQ(0xABu, data.PullU32(8));
+    EXPECT_EQ(1u, data.PullU32(32));
+
+    for (int i = 0; i < 4; ++i)
+    {
+        EXPECT_TRUE(data.Pull1Bit());
+    }
+}
+
+TEST(TestDeltaFieldCoder, Truncated)
+{
+    FieldTesterCoder coder(Identity());
+    BitStream data(32);
+    auto second = Identity();
+    FieldTester result = Identity();
+
+    // Only the bottom 18 bits make it.
+    second.packed = 0xFFFFFFFF;
+
+    coder.DeltaEncode(nullptr, second, data);
+    coder.DeltaDecode(nullptr, result, data);
+
+    EXPECT_EQ(0x3FFFFu, result.packed);
+}
+
+TEST(TestDeltaFieldCoder, NegativeZero)
+{
+    FieldTesterCoder coder(Identity());
+    BitStream data(32);
+    auto second = Identity();
+    FieldTester result = Identity();
+
+    // -0.0 == 0.0, but they're different bits, so it still gets sent.
+    second.real = -0.0f;
+
+    EXPECT_FALSE(coder.DeltaEncode(nullptr, second, data));
+
+    coder.DeltaDecode(nullptr, result, data);
+
+    EXPECT_TRUE(std::signbit(result.real));
+}
+
+TEST(TestDeltaFieldCoder, RandomStates)
+{
+    std::minstd_rand generator(1);
+    std::uniform_int_distribution<uint32_t> even;
+    std::uniform_int_distribution<uint32_t> even100(0, 99);
+    std::uniform_int_distribution<uint32_t> coin(0, 1);
+
+    FieldTesterCoder coder(Identity());
+    std::vector<FieldTester> states;
+
+    // Half the fields of neighbouring states are the same.
+    auto state = First();
+
+    for (int i = 0; i < 100; ++i)
+    {
+        if (coin(generator)) { state.small = static_cast<uint8_t>(even(generator)); }
+        if (coin(generator)) { state.medium = static_cast<uint16_t>(even(generator)); }
+        if (coin(generator)) { state.packed = even(generator) & 0x3FFFF; }
+        if (coin(generator)) { state.large = (uint64_t(even(generator) & 0xFF) << 32) | even(generator); }
+        if (coin(generator)) { state.negative = static_cast<int32_t>(even(generator)); }
+        if (coin(generator)) { state.negativeLarge = -static_cast<int64_t>(even(generator)) * 1000; }
+        if (coin(generator)) { state.real = float(even(generator)) / -37.0f; }
+        if (coin(generator)) { state.precise = double(even(generator)) / 37.0; }
+
+        states.push_back(state);
+    }
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        auto from = even100(generator);
+        auto to = even100(generator);
+        FieldTester result = Identity();
+        BitStream stream(32);
+
+        auto same = coder.DeltaEncode(&(states[from]), states[to], stream);
+        coder.DeltaDecode(&(states[from]), result, stream);
+
+        if (from == to)
+        {
+            EXPECT_TRUE(same);
+        }
+        ExpectSame(states[to], result);
+    }
+}
+
+TEST(TestDeltaFieldCoder, ChangedBytesMatchesScalar)
+{
+    std::minstd_rand generator(2);
+    std::uniform_int_distribution<uint32_t> even;
+
+    // Unaligned starts and odd lengths, to hit the tail loop.
+    std::vector<uint8_t> left(300);
+    std::vector<uint8_t> right(300);
+
+    for (std::size_t size = 1; size < 260; size += 7)
+    {
+        for (std::size_t start = 0; start < 4; ++start)
+        {
+            for (std::size_t i = 0; i < left.size(); ++i)
+            {
+                left[i] = static_cast<uint8_t>(even(generator));
+
+                // Mostly the same.
+                right[i] = ((even(generator) % 8) == 0) ? static_cast<uint8_t>(even(generator)) : left[i];
+            }
+
+            std::vector<uint64_t> expected((size + 63) / 64, 0);
+            std::vector<uint64_t> actual((size + 63) / 64, 0);
+
+            ChangedBytesScalar(&left[start], &right[start], size, expected.data());
+            ChangedBytes(&left[start], &right[start], size, actual.data());
+
+            EXPECT_EQ(expected, actual) << "size: " << size << " start: " << start;
+        }
+    }
+}
+
+TEST(TestDeltaFieldCoder, ChangedFields)
+{
+    FieldTesterCoder coder(Identity());
+    auto first = First();
+    auto second = first;
+
+    EXPECT_EQ(0u, coder.ChangedFields(first, second));
+
+    second.medium = 1;
+    second.large ^= 0x100000000ull;
+    second.precise = 1.0;
+
+    EXPECT_EQ((1u << 1) | (1u << 3) | (1u << 7), coder.ChangedFields(first, second));
+    EXPECT_EQ(0xFFu, coder.ChangedFields(Identity(), first));
+}
+
+struct Padded
+{
+    uint8_t flag;
+    // 3 bytes of padding
+    uint32_t value;
+    uint16_t other;
+    // 2 more
+};
+
+typedef DeltaFieldCoder<
+        Padded,
+        DELTA_FIELD(Padded, flag),
+        DELTA_FIELD(Padded, value),
+        DELTA_FIELD(Padded, other)> PaddedCoder;
+
+TEST(TestDeltaFieldCoder, ChangedFieldsIgnoresPadding)
+{
+    Padded left;
+    Padded right;
+
+    std::memset(&left, 0x00, sizeof(left));
+    std::memset(&right, 0xAA, sizeof(right));
+
+    left.flag = right.flag = 1;
+    left.value = right.value = 2;
+    left.other = right.other = 3;
+
+    PaddedCoder coder(left);
+
+    EXPECT_EQ(0u, coder.ChangedFields(left, right));
+}
+
+TEST(TestDeltaFieldCoder, MaskedWireFormat)
+{
+    FieldTesterCoder coder(Identity());
+    BitStream data(32);
+    auto second = Identity();
+
+    second.medium = 0x1234;
+    second.real = 1.0f;
+
+    EXPECT_FALSE(coder.DeltaEncodeMasked(nullptr, second, data));
+
+    // Same size as the interleaved version.
+    EXPECT_EQ(8 + 16 + 32, data.SizeInBits());
+
+    // Mask first, highest field first.
+    EXPECT_EQ((1u << 1) | (1u << 6), data.PullU32(8));
+    EXPECT_EQ(0x1234u, data.PullU32(16));
+    EXPECT_EQ(0x3F800000u, data.PullU32(32));
+}
+
+TEST(TestDeltaFieldCoder, MaskedRandomStates)
+{
+    std::minstd_rand generator(3);
+    std::uniform_int_distribution<uint32_t> even;
+    std::uniform_int_distribution<uint32_t> even100(0, 99);
+    std::uniform_int_distribution<uint32_t> coin(0, 3);
+
+    FieldTesterCoder coder(Identity());
+    std::vector<FieldTester> states;
+    auto state = First();
+
+    for (int i = 0; i < 100; ++i)
+    {
+        if (coin(generator) == 0) { state.small = static_cast<uint8_t>(even(generator)); }
+        if (coin(generator) == 0) { state.medium = static_cast<uint16_t>(even(generator)); }
+        if (coin(generator) == 0) { state.packed = even(generator) & 0x3FFFF; }
+        if (coin(generator) == 0) { state.large = (uint64_t(even(generator) & 0xFF) << 32) | even(generator); }
+        if (coin(generator) == 0) { state.negative = static_cast<int32_t>(even(generator)); }
+        if (coin(generator) == 0) { state.negativeLarge = -static_cast<int64_t>(even(generator)); }
+        if (coin(generator) == 0) { state.real = float(even(generator)) / 37.0f; }
+        if (coin(generator) == 0) { state.precise = double(even(generator)) / -37.0; }
+
+        states.push_back(state);
+    }
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        auto from = even100(generator);
+        auto to = even100(generator);
+        FieldTester result = Identity();
+        BitStream masked(32);
+        BitStream interleaved(32);
+
+        auto same = coder.DeltaEncodeMasked(&(states[from]), states[to], masked);
+
+        EXPECT_EQ(coder.DeltaEncode(&(states[from]), states[to], interleaved), same);
+        EXPECT_EQ(interleaved.SizeInBits(), masked.SizeInBits());
+
+        coder.DeltaDecodeMasked(&(states[from]), result, masked);
+
+        ExpectSame(states[to], result);
+    }
+}
+
+// A few hundred entities, only a few fields of a few entities move each tick.
+struct Entity
+{
+    float x, y, z;
+    float pitch, yaw, roll;
+    float vx, vy, vz;
+    uint32_t model;
+    uint32_t frame;
+    uint32_t effects;
+    uint16_t health;
+    uint16_t armour;
+    uint8_t weapon;
+    uint8_t team;
+};
+
+typedef DeltaFieldCoder<
+        Entity,
+        DELTA_FIELD(Entity, x), DELTA_FIELD(Entity, y), DELTA_FIELD(Entity, z),
+        DELTA_FIELD(Entity, pitch), DELTA_FIELD(Entity, yaw), DELTA_FIELD(Entity, roll),
+        DELTA_FIELD(Entity, vx), DELTA_FIELD(Entity, vy), DELTA_FIELD(Entity, vz),
+        DELTA_FIELD_BITS(Entity, model, 10),
+        DELTA_FIELD_BITS(Entity, frame, 8),
+        DELTA_FIELD_BITS(Entity, effects, 16),
+        DELTA_FIELD(Entity, health), DELTA_FIELD(Entity, armour),
+        DELTA_FIELD(Entity, weapon), DELTA_FIELD(Entity, team)> EntityCoder;
+
+TEST(TestDeltaFieldCoder, DISABLED_BenchmarkMostlyStatic)
+{
+    const int entities = 500;
+    const int ticks = 2000;
+
+    std::minstd_rand generator(4);
+    std::uniform_int_distribution<uint32_t> even;
+
+    std::vector<Entity> base(entities);
+    std::memset(base.data(), 0, sizeof(Entity) * base.size());
+
+    for (auto& entity : base)
+    {
+        entity.x = float(even(generator) % 4096);
+        entity.model = even(generator) % 1024;
+        entity.health = 100;
+    }
+
+    // 5% of entities move, the rest are exactly the same.
+    auto current = base;
+
+    for (int i = 0; i < entities; i += 20)
+    {
+        current[i].x += 1.0f;
+        current[i].yaw += 0.5f;
+        current[i].frame += 1;
+    }
+
+    EntityCoder coder(Entity{});
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t bits = 0;
+
+        for (int tick = 0; tick < ticks; ++tick)
+        {
+            BitStream out(entities * 4);
+
+            for (int i = 0; i < entities; ++i)
+            {
+                if (pass == 0)
+                {
+                    coder.DeltaEncode(&base[i], current[i], out);
+                }
+                else
+                {
+                    coder.DeltaEncodeMasked(&base[i], current[i], out);
+                }
+            }
+
+            bits += out.SizeInBits();
+        }
+
+        auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+
+        std::cout << (pass == 0 ? "Per field:   " : "Masked:      ")
+                  << static_cast<double>(took) / ticks / 1000.0 << "us per snapshot, "
+                  << bits / ticks / 8 << " bytes\n";
+    }
+}
+
+}}} // namespace
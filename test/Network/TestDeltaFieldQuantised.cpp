@@ -0,0 +1,342 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <Implementation/DeltaFieldQuantised.hpp>
+#include <gmock/gmock.h>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+struct Moving
+{
+    float x;
+    float y;
+    float z;
+    float rotation[4];
+    float facing[3];
+    int32_t score;
+    uint16_t ammo;
+};
+
+Moving Still()
+{
+    Moving result;
+
+    std::memset(&result, 0, sizeof(result));
+    result.rotation[3] = 1.0f;
+    result.facing[2] = 1.0f;
+
+    return result;
+}
+
+typedef DeltaFieldCoder<
+        Moving,
+        DELTA_FIELD(Moving, x),
+        DELTA_FIELD(Moving, y),
+        DELTA_FIELD(Moving, z),
+        DELTA_FIELD(Moving, score),
+        DELTA_FIELD(Moving, ammo)> RawCoder;
+
+// DeltaField doesn't do arrays, so rotation and facing as raw floats are
+// a changed bit each and then 32 bits a component.
+const uint64_t RawRotationAndFacingBits = 2 + (7 * 32);
+
+typedef DeltaFieldCoder<
+        Moving,
+        DELTA_FIELD_FIXED(Moving, x, -4096, 4096, 8),
+        DELTA_FIELD_FIXED(Moving, y, -4096, 4096, 8),
+        DELTA_FIELD_FIXED(Moving, z, -1024, 1024, 8),
+        DELTA_FIELD_QUATERNION(Moving, rotation, 10),
+        DELTA_FIELD_NORMAL(Moving, facing, 11),
+        DELTA_FIELD_VARINT(Moving, score),
+        DELTA_FIELD_VARINT(Moving, ammo)> QuantisedCoder;
+
+float QuaternionDot(const float* left, const float* right)
+{
+    return
+        (left[0] * right[0]) + (left[1] * right[1]) +
+        (left[2] * right[2]) + (left[3] * right[3]);
+}
+
+typedef DELTA_FIELD_FIXED(Moving, x, -4096, 4096, 8) FixedX;
+typedef DELTA_FIELD_FIXED(Moving, z, -1024, 1024, 8) FixedZ;
+typedef DELTA_FIELD_QUATERNION(Moving, rotation, 10) Rotation;
+typedef DELTA_FIELD_NORMAL(Moving, facing, 11) Facing;
+typedef DELTA_FIELD_VARINT(Moving, score) Score;
+typedef DELTA_FIELD_VARINT(Moving, ammo) Ammo;
+
+TEST(TestDeltaFieldQuantised, Sizes)
+{
+    EXPECT_EQ(17, FixedX::SentBits());
+    EXPECT_EQ(15, FixedZ::SentBits());
+    EXPECT_EQ(32, Rotation::SentBits());
+    EXPECT_EQ(22, Facing::SentBits());
+    EXPECT_EQ(40, Score::SentBits());
+    EXPECT_EQ(24, Ammo::SentBits());
+}
+
+TEST(TestDeltaFieldQuantised, ZigZag)
+{
+    EXPECT_EQ(0u, ZigZag(0));
+    EXPECT_EQ(1u, ZigZag(-1));
+    EXPECT_EQ(2u, ZigZag(1));
+    EXPECT_EQ(3u, ZigZag(-2));
+    EXPECT_EQ(~uint64_t(0), ZigZag(std::numeric_limits<int64_t>::min()));
+
+    for (int64_t value : {int64_t(0), int64_t(-1), int64_t(12345), int64_t(-99999),
+                          std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::min()})
+    {
+        EXPECT_EQ(value, UnZigZag(ZigZag(value)));
+    }
+}
+
+TEST(TestDeltaFieldQuantised, Varint)
+{
+    BitStream out(32);
+
+    PushVarint(out, 0);
+    PushVarint(out, 127);
+    PushVarint(out, 128);
+    PushVarint(out, ~uint64_t(0));
+
+    EXPECT_EQ((1 + 1 + 2 + 10) * 8, out.SizeInBits());
+
+    EXPECT_EQ(0u, PullVarint(out));
+    EXPECT_EQ(127u, PullVarint(out));
+    EXPECT_EQ(128u, PullVarint(out));
+    EXPECT_EQ(~uint64_t(0), PullVarint(out));
+}
+
+TEST(TestDeltaFieldQuantised, FixedClampsAndRounds)
+{
+    typedef FixedX Fixed;
+
+    EXPECT_EQ(0u, Fixed::Quantise(-5000.0f));
+    EXPECT_EQ(Fixed::Steps(), Fixed::Quantise(5000.0f));
+    EXPECT_EQ(0u, Fixed::Quantise(std::numeric_limits<float>::quiet_NaN()));
+
+    EXPECT_EQ(4096u * 8, Fixed::Quantise(0.0f));
+    EXPECT_EQ(4096u * 8 + 1, Fixed::Quantise(0.1f));
+    EXPECT_FLOAT_EQ(0.125f, Fixed::Dequantise(Fixed::Quantise(0.1f)));
+
+    // What the receiver has quantises to the same thing again.
+    std::minstd_rand generator(7);
+    std::uniform_real_distribution<float> anywhere(-4096.0f, 4096.0f);
+
+    for (int i = 0; i < 10000; ++i)
+    {
+        auto steps = Fixed::Quantise(anywhere(generator));
+
+        EXPECT_EQ(steps, Fixed::Quantise(Fixed::Dequantise(steps)));
+    }
+}
+
+TEST(TestDeltaFieldQuantised, Quaternion)
+{
+    std::minstd_rand generator(8);
+    std::normal_distribution<float> normal;
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        float q[4] = {normal(generator), normal(generator), normal(generator), normal(generator)};
+        float length = std::sqrt(QuaternionDot(q, q));
+
+        for (auto& component : q)
+        {
+            component /= length;
+        }
+
+        float result[4];
+        auto packed = QuantiseQuaternion(q, 10);
+
+        ASSERT_LT(packed, uint64_t(1) << 32);
+
+        DequantiseQuaternion(packed, 10, result);
+
+        // Same rotation (q == -q), to within about a degree.
+        EXPECT_GT(std::fabs(QuaternionDot(q, result)), 0.9999f);
+
+        // Sending what was received again doesn't drift.
+        float again[4];
+
+        DequantiseQuaternion(QuantiseQuaternion(result, 10), 10, again);
+
+        EXPECT_GT(std::fabs(QuaternionDot(result, again)), 0.99999f);
+    }
+
+    // Zero length is the identity.
+    float zero[4] = {0, 0, 0, 0};
+    float identity[4];
+
+    DequantiseQuaternion(QuantiseQuaternion(zero, 10), 10, identity);
+
+    EXPECT_NEAR(1.0f, identity[3], 0.00001f);
+}
+
+TEST(TestDeltaFieldQuantised, Normal)
+{
+    std::minstd_rand generator(9);
+    std::normal_distribution<float> normal;
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        float n[3] = {normal(generator), normal(generator), normal(generator)};
+        float length = std::sqrt((n[0] * n[0]) + (n[1] * n[1]) + (n[2] * n[2]));
+
+        for (auto& component : n)
+        {
+            component /= length;
+        }
+
+        float result[3];
+        auto packed = QuantiseNormal(n, 11);
+
+        DequantiseNormal(packed, 11, result);
+
+        float dot = (n[0] * result[0]) + (n[1] * result[1]) + (n[2] * result[2]);
+
+        EXPECT_GT(dot, 0.9999f);
+        EXPECT_NEAR(1.0f, (result[0] * result[0]) + (result[1] * result[1]) + (result[2] * result[2]), 0.0001f);
+
+        float again[3];
+
+        DequantiseNormal(QuantiseNormal(result, 11), 11, again);
+
+        EXPECT_GT((result[0] * again[0]) + (result[1] * again[1]) + (result[2] * again[2]), 0.99999f);
+    }
+}
+
+TEST(TestDeltaFieldQuantised, VarintDeltaWraps)
+{
+    QuantisedCoder coder(Still());
+    auto base = Still();
+    auto current = Still();
+    auto result = Still();
+    BitStream out(32);
+
+    base.score = std::numeric_limits<int32_t>::max();
+    current.score = std::numeric_limits<int32_t>::min();
+    base.ammo = 3;
+    current.ammo = 1;
+
+    coder.DeltaEncode(&base, current, out);
+
+    // 7 unchanged bits, 2 changed bits, +1 and -2 are a byte each.
+    EXPECT_EQ(7 + 8 + 8, out.SizeInBits());
+
+    coder.DeltaDecode(&base, result, out);
+
+    EXPECT_EQ(current.score, result.score);
+    EXPECT_EQ(current.ammo, result.ammo);
+}
+
+TEST(TestDeltaFieldQuantised, NoiseIsFree)
+{
+    QuantisedCoder coder(Still());
+    auto base = Still();
+    auto current = Still();
+    BitStream out(32);
+
+    base.x = 100.0f;
+    current.x = 100.01f;
+
+    EXPECT_TRUE(coder.DeltaEncode(&base, current, out));
+    EXPECT_EQ(QuantisedCoder::FieldCount(), out.SizeInBits());
+}
+
+TEST(TestDeltaFieldQuantised, RandomMovesMoreThanHalfSmaller)
+{
+    std::minstd_rand generator(10);
+    std::uniform_real_distribution<float> anywhere(-1000.0f, 1000.0f);
+    std::normal_distribution<float> normal;
+    std::uniform_int_distribution<int32_t> score(-5, 5);
+
+    RawCoder raw(Still());
+    QuantisedCoder quantised(Still());
+
+    uint64_t rawBits = 0;
+    uint64_t quantisedBits = 0;
+    auto previous = Still();
+    auto received = Still();
+
+    for (int i = 0; i < 500; ++i)
+    {
+        auto current = previous;
+
+        current.x = anywhere(generator);
+        current.y = anywhere(generator);
+        current.z = anywhere(generator);
+
+        for (auto& component : current.rotation) { component = normal(generator); }
+        for (auto& component : current.facing) { component = normal(generator); }
+
+        current.score += score(generator);
+        current.ammo = static_cast<uint16_t>(current.ammo + 1);
+
+        BitStream rawOut(64);
+        BitStream quantisedOut(64);
+
+        raw.DeltaEncode(&previous, current, rawOut);
+        quantised.DeltaEncode(&previous, current, quantisedOut);
+
+        rawBits += rawOut.SizeInBits() + RawRotationAndFacingBits;
+        quantisedBits += quantisedOut.SizeInBits();
+
+        auto result = Still();
+        quantised.DeltaDecode(&received, result, quantisedOut);
+
+        EXPECT_NEAR(current.x, result.x, 1.0f / 16);
+        EXPECT_NEAR(current.z, result.z, 1.0f / 16);
+        EXPECT_EQ(current.score, result.score);
+        EXPECT_EQ(current.ammo, result.ammo);
+
+        // The sender uses what it sent as the next base, like the real thing.
+        previous = current;
+        received = result;
+    }
+
+    EXPECT_LT(quantisedBits * 2, rawBits);
+}
+
+TEST(TestDeltaFieldQuantised, Masked)
+{
+    QuantisedCoder coder(Still());
+    auto base = Still();
+    auto current = Still();
+    auto result = Still();
+    BitStream out(32);
+
+    current.y = -12.5f;
+    current.score = -7;
+
+    EXPECT_FALSE(coder.DeltaEncodeMasked(&base, current, out));
+
+    coder.DeltaDecodeMasked(&base, result, out);
+
+    EXPECT_FLOAT_EQ(-12.5f, result.y);
+    EXPECT_EQ(-7, result.score);
+    EXPECT_FLOAT_EQ(1.0f, result.rotation[3]);
+}
+
+}}} // namespace
@@ -0,0 +1,303 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <Implementation/DeltaTable.hpp>
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+typedef DeltaTable<
+        DeltaColumn<float>,
+        DeltaColumn<uint32_t, 10>,
+        DeltaColumn<int16_t>,
+        DeltaColumn<uint64_t, 40>> Table;
+
+typedef DeltaTableCoder<
+        DeltaColumn<float>,
+        DeltaColumn<uint32_t, 10>,
+        DeltaColumn<int16_t>,
+        DeltaColumn<uint64_t, 40>> TableCoder;
+
+void ExpectSame(const Table& expected, const Table& actual)
+{
+    ASSERT_EQ(expected.Rows(), actual.Rows());
+
+    EXPECT_EQ(expected.Column<0>(), actual.Column<0>());
+    EXPECT_EQ(expected.Column<1>(), actual.Column<1>());
+    EXPECT_EQ(expected.Column<2>(), actual.Column<2>());
+    EXPECT_EQ(expected.Column<3>(), actual.Column<3>());
+}
+
+TEST(TestDeltaTable, Resize)
+{
+    Table table(3);
+
+    EXPECT_EQ(4, Table::ColumnCount());
+    EXPECT_EQ(3, table.Rows());
+    EXPECT_EQ(3, table.Column<0>().size());
+    EXPECT_EQ(3, table.Column<3>().size());
+
+    table.Column<2>()[2] = -5;
+    table.Resize(5);
+
+    EXPECT_EQ(5, table.Column<1>().size());
+    EXPECT_EQ(-5, table.Column<2>()[2]);
+    EXPECT_EQ(0, table.Column<2>()[4]);
+}
+
+TEST(TestDeltaTable, ChangedMasks)
+{
+    Table base(4);
+    Table current(4);
+    TableCoder coder;
+
+    current.Column<0>()[1] = 1.0f;
+    current.Column<3>()[1] = 7;
+    current.Column<2>()[3] = -1;
+
+    auto masks = coder.ChangedMasks(base, current);
+
+    ASSERT_EQ(4, masks.size());
+    EXPECT_EQ(0u, masks[0]);
+    EXPECT_EQ(0x9u, masks[1]);
+    EXPECT_EQ(0u, masks[2]);
+    EXPECT_EQ(0x4u, masks[3]);
+}
+
+TEST(TestDeltaTable, RowMismatch)
+{
+    Table base(4);
+    Table current(5);
+    TableCoder coder;
+    BitStream out(32);
+
+    EXPECT_THROW(coder.Encode(base, current, out), std::logic_error);
+}
+
+TEST(TestDeltaTable, WireFormat)
+{
+    Table base(3);
+    Table current(3);
+    TableCoder coder;
+    BitStream out(32);
+
+    current.Column<1>()[0] = 0x3FF;
+    current.Column<1>()[2] = 0x155;
+    current.Column<2>()[2] = -2;
+
+    EXPECT_EQ(2, coder.Encode(base, current, out));
+
+    // Masks
+    EXPECT_TRUE(out.Pull1Bit());
+    EXPECT_EQ(0x2u, out.PullU32(4));
+    EXPECT_FALSE(out.Pull1Bit());
+    EXPECT_TRUE(out.Pull1Bit());
+    EXPECT_EQ(0x6u, out.PullU32(4));
+
+    // Then column by column.
+    EXPECT_EQ(0x3FFu, out.PullU32(10));
+    EXPECT_EQ(0x155u, out.PullU32(10));
+    EXPECT_EQ(0xFFFEu, out.PullU32(16));
+
+    EXPECT_EQ(1 + 4 + 1 + 1 + 4 + 10 + 10 + 16, out.SizeInBits());
+}
+
+TEST(TestDeltaTable, StaticCostsOneBit)
+{
+    Table base(100);
+    TableCoder coder;
+    BitStream out(32);
+
+    base.Column<0>()[5] = 3.0f;
+
+    EXPECT_EQ(0, coder.Encode(base, base, out));
+    EXPECT_EQ(100, out.SizeInBits());
+}
+
+TEST(TestDeltaTable, RandomTables)
+{
+    std::minstd_rand generator(5);
+    std::uniform_int_distribution<uint32_t> even;
+    std::uniform_int_distribution<uint32_t> often(0, 3);
+
+    const std::size_t rows = 300;
+
+    for (int pass = 0; pass < 20; ++pass)
+    {
+        Table base(rows);
+        Table current(rows);
+        Table result;
+        TableCoder coder;
+
+        for (std::size_t i = 0; i < rows; ++i)
+        {
+            base.Column<0>()[i] = float(even(generator)) / 37.0f;
+            base.Column<1>()[i] = even(generator) & 0x3FF;
+            base.Column<2>()[i] = static_cast<int16_t>(even(generator));
+            base.Column<3>()[i] = (uint64_t(even(generator) & 0xFF) << 32) | even(generator);
+        }
+
+        current = base;
+
+        for (std::size_t i = 0; i < rows; ++i)
+        {
+            if (often(generator) == 0) { current.Column<0>()[i] = float(even(generator)); }
+            if (often(generator) == 0) { current.Column<1>()[i] = even(generator) & 0x3FF; }
+            if (often(generator) == 0) { current.Column<2>()[i] = static_cast<int16_t>(even(generator)); }
+            if (often(generator) == 0) { current.Column<3>()[i] = even(generator); }
+        }
+
+        BitStream out(rows);
+
+        coder.Encode(base, current, out);
+        coder.Decode(base, result, out);
+
+        ExpectSame(current, result);
+    }
+}
+
+// The same entities as a DeltaFieldCoder over structs, 5% of them moving.
+struct Entity
+{
+    float x, y, z;
+    float yaw;
+    uint32_t model;
+    uint32_t frame;
+    uint16_t health;
+    uint8_t weapon;
+};
+
+typedef DeltaFieldCoder<
+        Entity,
+        DELTA_FIELD(Entity, x), DELTA_FIELD(Entity, y), DELTA_FIELD(Entity, z),
+        DELTA_FIELD(Entity, yaw),
+        DELTA_FIELD_BITS(Entity, model, 10),
+        DELTA_FIELD_BITS(Entity, frame, 8),
+        DELTA_FIELD(Entity, health),
+        DELTA_FIELD(Entity, weapon)> EntityCoder;
+
+typedef DeltaTableCoder<
+        DeltaColumn<float>, DeltaColumn<float>, DeltaColumn<float>,
+        DeltaColumn<float>,
+        DeltaColumn<uint32_t, 10>,
+        DeltaColumn<uint32_t, 8>,
+        DeltaColumn<uint16_t>,
+        DeltaColumn<uint8_t>> EntityTableCoder;
+
+void Benchmark(std::size_t entities)
+{
+    const int ticks = 200000 / entities;
+
+    std::minstd_rand generator(6);
+    std::uniform_int_distribution<uint32_t> even;
+
+    std::vector<Entity> base(entities);
+    std::memset(base.data(), 0, sizeof(Entity) * base.size());
+
+    for (auto& entity : base)
+    {
+        entity.x = float(even(generator) % 4096);
+        entity.model = even(generator) % 1024;
+        entity.health = 100;
+    }
+
+    auto current = base;
+
+    for (std::size_t i = 0; i < entities; i += 20)
+    {
+        current[i].x += 1.0f;
+        current[i].yaw += 0.5f;
+        current[i].frame += 1;
+    }
+
+    EntityTableCoder::Table baseTable(entities);
+    EntityTableCoder::Table currentTable(entities);
+
+    auto fill = [] (const std::vector<Entity>& from, EntityTableCoder::Table& to)
+    {
+        for (std::size_t i = 0; i < from.size(); ++i)
+        {
+            to.Column<0>()[i] = from[i].x;
+            to.Column<1>()[i] = from[i].y;
+            to.Column<2>()[i] = from[i].z;
+            to.Column<3>()[i] = from[i].yaw;
+            to.Column<4>()[i] = from[i].model;
+            to.Column<5>()[i] = from[i].frame;
+            to.Column<6>()[i] = from[i].health;
+            to.Column<7>()[i] = from[i].weapon;
+        }
+    };
+
+    fill(base, baseTable);
+    fill(current, currentTable);
+
+    EntityCoder structs(Entity{});
+    EntityTableCoder table;
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t bits = 0;
+
+        for (int tick = 0; tick < ticks; ++tick)
+        {
+            BitStream out(static_cast<uint32_t>(entities));
+
+            if (pass == 0)
+            {
+                for (std::size_t i = 0; i < entities; ++i)
+                {
+                    structs.DeltaEncodeMasked(&base[i], current[i], out);
+                }
+            }
+            else
+            {
+                table.Encode(baseTable, currentTable, out);
+            }
+
+            bits += out.SizeInBits();
+        }
+
+        auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+
+        std::cout << entities << " entities, "
+                  << (pass == 0 ? "structs: " : "table:   ")
+                  << static_cast<double>(took) / ticks / 1000.0 << "us per snapshot, "
+                  << bits / ticks / 8 << " bytes\n";
+    }
+}
+
+TEST(TestDeltaTable, DISABLED_Benchmark1k)
+{
+    Benchmark(1000);
+}
+
+TEST(TestDeltaTable, DISABLED_Benchmark10k)
+{
+    Benchmark(10000);
+}
+
+}}} // namespace
@@ -0,0 +1,161 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <Implementation/HandshakeCookie.hpp>
+#include <gmock/gmock.h>
+
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+using boost::asio::ip::udp;
+using boost::asio::ip::address;
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+class TestHandshakeCookie : public ::testing::Test
+{
+public:
+    TestHandshakeCookie()
+        : secret(GetNetworkKeyNil())
+        , client(address::from_string("192.168.1.2"), 4000)
+        , now(hours(1))
+    {
+        secret.data[0] = 42;
+    }
+
+    NetworkKey secret;
+    udp::endpoint client;
+    OClock now;
+};
+
+TEST_F(TestHandshakeCookie, SameInputSameKey)
+{
+    HandshakeCookie toTest{secret};
+
+    auto key = toTest.Create(client, now);
+
+    EXPECT_EQ(key, toTest.Create(client, now));
+    EXPECT_NE(GetNetworkKeyNil(), key);
+    EXPECT_TRUE(toTest.IsValid(key, client, now));
+}
+
+TEST_F(TestHandshakeCookie, DifferentAddressDifferentKey)
+{
+    HandshakeCookie toTest{secret};
+
+    auto otherPort = udp::endpoint{client.address(), 4001};
+    auto otherAddress = udp::endpoint{address::from_string("192.168.1.3"), 4000};
+    auto ip6 = udp::endpoint{address::from_string("::1"), 4000};
+
+    auto key = toTest.Create(client, now);
+
+    EXPECT_NE(key, toTest.Create(otherPort, now));
+    EXPECT_NE(key, toTest.Create(otherAddress, now));
+    EXPECT_NE(key, toTest.Create(ip6, now));
+
+    EXPECT_FALSE(toTest.IsValid(key, otherPort, now));
+    EXPECT_FALSE(toTest.IsValid(key, otherAddress, now));
+}
+
+TEST_F(TestHandshakeCookie, DifferentSecretDifferentKey)
+{
+    HandshakeCookie toTest{secret};
+    HandshakeCookie other{GetNetworkKeyNil()};
+
+    auto key = toTest.Create(client, now);
+
+    EXPECT_NE(key, other.Create(client, now));
+    EXPECT_FALSE(other.IsValid(key, client, now));
+}
+
+TEST_F(TestHandshakeCookie, Expires)
+{
+    HandshakeCookie toTest{secret};
+
+    auto key = toTest.Create(client, now);
+
+    // Always valid for at least one period.
+    EXPECT_TRUE(toTest.IsValid(key, client, now + HandshakeCookie::Period() - milliseconds(1)));
+
+    // Never valid after two.
+    EXPECT_FALSE(toTest.IsValid(key, client, now + HandshakeCookie::Period() * 2));
+}
+
+namespace
+{
+std::string Hex(const std::array<uint8_t, 20>& digest)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string result;
+
+    for (auto byte : digest)
+    {
+        result.push_back(digits[byte >> 4]);
+        result.push_back(digits[byte & 0x0F]);
+    }
+
+    return result;
+}
+
+std::string HmacSha1Hex(const std::vector<uint8_t>& key, const std::string& message)
+{
+    return Hex(HmacSha1(
+            key.data(),
+            key.size(),
+            reinterpret_cast<const uint8_t*>(message.data()),
+            message.size()));
+}
+}
+
+// RFC 2202 test cases 1, 2, 6 and 7.
+TEST_F(TestHandshakeCookie, HmacSha1)
+{
+    EXPECT_EQ(
+            "b617318655057264e28bc0b6fb378c8ef146be00",
+            HmacSha1Hex(std::vector<uint8_t>(20, 0x0b), "Hi There"));
+
+    EXPECT_EQ(
+            "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79",
+            HmacSha1Hex({'J', 'e', 'f', 'e'}, "what do ya want for nothing?"));
+
+    EXPECT_EQ(
+            "aa4ae5e15272d00e95705637ce8a3b55ed402112",
+            HmacSha1Hex(
+                std::vector<uint8_t>(80, 0xaa),
+                "Test Using Larger Than Block-Size Key - Hash Key First"));
+
+    EXPECT_EQ(
+            "e8e99d0f45237d786d6bbaa7965c7808bbff1a91",
+            HmacSha1Hex(
+                std::vector<uint8_t>(80, 0xaa),
+                "Test Using Larger Than Block-Size Key and Larger Than One Block-Size Data"));
+}
+
+TEST_F(TestHandshakeCookie, RandomSecret)
+{
+    HandshakeCookie first{};
+    HandshakeCookie second{};
+
+    EXPECT_NE(first.Create(client, now), second.Create(client, now));
+}
+
+}}} // namespace
@@ -213,4 +213,36 @@ TEST_F(TestHuffman, TestBufferTwoBytes)
 }
 
 
+TEST_F(TestHuffman, TestBufferReused)
+{
+    array<uint64_t, 256> frequencies = {{0}};
+
+    for (const auto& buffer : myTestBuffers)
+    {
+        for (uint8_t item : buffer)
+        {
+            frequencies[item]++;
+        }
+    }
+
+    Huffman toTest(frequencies);
+
+    // Decode the biggest buffer first so the rest fit in its capacity.
+    vector<uint8_t> decoded;
+    auto biggest = myTestBuffers.back();
+
+    toTest.Decode(toTest.Encode(biggest), decoded);
+    EXPECT_EQ(biggest, decoded);
+
+    auto storage = decoded.data();
+
+    for (const auto& bufferToTest : myTestBuffers)
+    {
+        toTest.Decode(toTest.Encode(bufferToTest), decoded);
+
+        EXPECT_EQ(bufferToTest, decoded);
+        EXPECT_EQ(storage, decoded.data());
+    }
+}
+
 }}} // namespace
@@ -0,0 +1,307 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <Implementation/InterestGrid.hpp>
+#include <gmock/gmock.h>
+
+#include <random>
+#include <limits>
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+class TestInterestGrid : public ::testing::Test
+{
+public:
+    TestInterestGrid()
+        : grid(10.0f, 4)
+        , alice(1)
+        , bob(2)
+        , changes()
+    {
+        // A row of entities 5 units apart along x.
+        for (uint32_t i = 0; i < 20; ++i)
+        {
+            grid.Update(i, float(i) * 5.0f, 0.0f);
+        }
+    }
+
+    InterestGrid grid;
+    ClientHandle alice;
+    ClientHandle bob;
+    InterestChanges changes;
+};
+
+TEST_F(TestInterestGrid, NoViewNothingRelevant)
+{
+    std::vector<uint32_t> relevant{99};
+
+    grid.Relevant(alice, relevant);
+
+    EXPECT_TRUE(relevant.empty());
+}
+
+TEST_F(TestInterestGrid, Radius)
+{
+    std::vector<uint32_t> relevant;
+
+    grid.View(alice, 0.0f, 0.0f, 12.0f);
+    grid.Relevant(alice, relevant);
+
+    EXPECT_EQ(std::vector<uint32_t>({0, 1, 2}), relevant);
+
+    grid.View(bob, 50.0f, 3.0f, 5.0f);
+    grid.Relevant(bob, relevant);
+
+    EXPECT_EQ(std::vector<uint32_t>({10}), relevant);
+
+    // Bigger than the world.
+    grid.View(bob, 0.0f, 0.0f, 1000000.0f);
+    grid.Relevant(bob, relevant);
+
+    EXPECT_EQ(20, relevant.size());
+
+    // Covers every cell there is, shouldn't overflow and walk them all.
+    grid.View(bob, 0.0f, 0.0f, std::numeric_limits<float>::max());
+    grid.Relevant(bob, relevant);
+
+    EXPECT_EQ(20, relevant.size());
+}
+
+TEST_F(TestInterestGrid, NegativeCoordinates)
+{
+    std::vector<uint32_t> relevant;
+
+    grid.Update(100, -3.0f, -3.0f);
+    grid.Update(101, -13.0f, 0.0f);
+    grid.View(alice, -1.0f, -1.0f, 4.0f);
+    grid.Relevant(alice, relevant);
+
+    EXPECT_EQ(std::vector<uint32_t>({0, 100}), relevant);
+}
+
+TEST_F(TestInterestGrid, AlwaysRelevant)
+{
+    std::vector<uint32_t> relevant;
+
+    grid.Update(100, 10000.0f, 10000.0f, true);
+    grid.View(alice, 0.0f, 0.0f, 1.0f);
+    grid.Relevant(alice, relevant);
+
+    EXPECT_EQ(std::vector<uint32_t>({0, 100}), relevant);
+
+    // And back again.
+    grid.Update(100, 10000.0f, 10000.0f, false);
+    grid.Relevant(alice, relevant);
+
+    EXPECT_EQ(std::vector<uint32_t>({0}), relevant);
+}
+
+TEST_F(TestInterestGrid, MoveAndRemove)
+{
+    std::vector<uint32_t> relevant;
+
+    grid.View(alice, 0.0f, 0.0f, 1.0f);
+
+    grid.Update(19, 0.5f, 0.5f);
+    grid.Remove(0);
+    grid.Remove(12345);
+    grid.Relevant(alice, relevant);
+
+    EXPECT_EQ(std::vector<uint32_t>({19}), relevant);
+    EXPECT_EQ(19, grid.EntityCount());
+}
+
+TEST_F(TestInterestGrid, FirstSnapshotIsAllEntered)
+{
+    grid.View(alice, 0.0f, 0.0f, 12.0f);
+    grid.Changes(alice, Sequence(1), {}, changes);
+
+    EXPECT_EQ(std::vector<uint32_t>({0, 1, 2}), changes.entered);
+    EXPECT_TRUE(changes.updated.empty());
+    EXPECT_TRUE(changes.left.empty());
+    EXPECT_TRUE(changes.full);
+
+    grid.Changes(alice, Sequence(2), Sequence(1), changes);
+
+    EXPECT_FALSE(changes.full);
+}
+
+TEST_F(TestInterestGrid, EnterAndLeave)
+{
+    grid.View(alice, 0.0f, 0.0f, 12.0f);
+    grid.Changes(alice, Sequence(1), {}, changes);
+
+    grid.View(alice, 10.0f, 0.0f, 7.0f);
+    grid.Changes(alice, Sequence(2), Sequence(1), changes);
+
+    EXPECT_EQ(std::vector<uint32_t>({3}), changes.entered);
+    EXPECT_EQ(std::vector<uint32_t>({1, 2}), changes.updated);
+    EXPECT_EQ(std::vector<uint32_t>({0}), changes.left);
+}
+
+TEST_F(TestInterestGrid, AgainstAckedNotLastSent)
+{
+    grid.View(alice, 0.0f, 0.0f, 2.0f);
+    grid.Changes(alice, Sequence(1), {}, changes);
+
+    // 2 is sent with entity 1, but lost.
+    grid.View(alice, 5.0f, 0.0f, 2.0f);
+    grid.Changes(alice, Sequence(2), Sequence(1), changes);
+
+    EXPECT_EQ(std::vector<uint32_t>({1}), changes.entered);
+    EXPECT_EQ(std::vector<uint32_t>({0}), changes.left);
+
+    // Still only 1 acked, so entity 2 is new and 1 has to be sent in full again.
+    grid.View(alice, 10.0f, 0.0f, 6.0f);
+    grid.Changes(alice, Sequence(3), Sequence(1), changes);
+
+    EXPECT_EQ(std::vector<uint32_t>({1, 2, 3}), changes.entered);
+    EXPECT_TRUE(changes.updated.empty());
+    EXPECT_EQ(std::vector<uint32_t>({0}), changes.left);
+
+    // 3 got there.
+    grid.Changes(alice, Sequence(4), Sequence(3), changes);
+
+    EXPECT_TRUE(changes.entered.empty());
+    EXPECT_EQ(std::vector<uint32_t>({1, 2, 3}), changes.updated);
+    EXPECT_TRUE(changes.left.empty());
+}
+
+TEST_F(TestInterestGrid, RemovedAndReaddedIsBothLeftAndEntered)
+{
+    grid.View(alice, 0.0f, 0.0f, 2.0f);
+    grid.Changes(alice, Sequence(1), {}, changes);
+
+    grid.Remove(0);
+    grid.Update(0, 1.0f, 0.0f);
+    grid.Changes(alice, Sequence(2), Sequence(1), changes);
+
+    EXPECT_EQ(std::vector<uint32_t>({0}), changes.entered);
+    EXPECT_TRUE(changes.updated.empty());
+    EXPECT_EQ(std::vector<uint32_t>({0}), changes.left);
+}
+
+TEST_F(TestInterestGrid, TooOldIsAllEntered)
+{
+    grid.View(alice, 0.0f, 0.0f, 2.0f);
+
+    for (uint16_t i = 1; i < 10; ++i)
+    {
+        grid.Changes(alice, Sequence(i), Sequence(uint16_t(i - 1)), changes);
+    }
+
+    // History is 4, 5 has gone.
+    grid.Changes(alice, Sequence(10), Sequence(5), changes);
+
+    EXPECT_EQ(std::vector<uint32_t>({0}), changes.entered);
+    EXPECT_TRUE(changes.updated.empty());
+    EXPECT_TRUE(changes.full);
+
+    grid.Changes(alice, Sequence(11), Sequence(10), changes);
+
+    EXPECT_EQ(std::vector<uint32_t>({0}), changes.updated);
+    EXPECT_FALSE(changes.full);
+}
+
+TEST_F(TestInterestGrid, ClientsAreSeparate)
+{
+    grid.View(alice, 0.0f, 0.0f, 2.0f);
+    grid.View(bob, 95.0f, 0.0f, 2.0f);
+
+    grid.Changes(alice, Sequence(1), {}, changes);
+    grid.Changes(bob, Sequence(7), {}, changes);
+
+    EXPECT_EQ(std::vector<uint32_t>({19}), changes.entered);
+
+    grid.Changes(alice, Sequence(2), Sequence(1), changes);
+
+    EXPECT_EQ(std::vector<uint32_t>({0}), changes.updated);
+
+    // Forgets the history as well.
+    grid.Disconnect(alice);
+    grid.View(alice, 0.0f, 0.0f, 2.0f);
+    grid.Changes(alice, Sequence(3), Sequence(2), changes);
+
+    EXPECT_EQ(std::vector<uint32_t>({0}), changes.entered);
+}
+
+TEST(TestInterestGridBenchmark, DISABLED_Benchmark)
+{
+    static const uint32_t entities = 10000;
+    static const uint32_t clients = 64;
+    static const float world = 4096.0f;
+
+    InterestGrid grid(128.0f);
+    std::minstd_rand generator(1);
+    std::uniform_real_distribution<float> anywhere(0.0f, world);
+    std::uniform_real_distribution<float> step(-4.0f, 4.0f);
+
+    std::vector<float> x(entities);
+    std::vector<float> y(entities);
+
+    for (uint32_t i = 0; i < entities; ++i)
+    {
+        x[i] = anywhere(generator);
+        y[i] = anywhere(generator);
+        grid.Update(i, x[i], y[i], i < 8);
+    }
+
+    InterestChanges changes;
+    uint64_t sent = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (uint16_t tick = 1; tick <= 100; ++tick)
+    {
+        for (uint32_t i = 0; i < entities; ++i)
+        {
+            x[i] += step(generator);
+            y[i] += step(generator);
+            grid.Update(i, x[i], y[i], i < 8);
+        }
+
+        for (uint32_t client = 0; client < clients; ++client)
+        {
+            // Clients are riding on the first few entities.
+            grid.View(ClientHandle(client), x[client * 100], y[client * 100], 256.0f);
+            grid.Changes(
+                        ClientHandle(client),
+                        Sequence(tick),
+                        Sequence(uint16_t(tick - 1)),
+                        changes);
+
+            sent += changes.entered.size() + changes.updated.size();
+        }
+    }
+
+    auto took = std::chrono::high_resolution_clock::now() - start;
+
+    std::cout
+            << "100 ticks, " << entities << " entities, " << clients << " clients: "
+            << std::chrono::duration_cast<std::chrono::microseconds>(took).count() / 100
+            << "us a tick, "
+            << (sent / (100 * clients)) << " entities a client instead of "
+            << entities << ".\n";
+}
+
+}}} // namespace
@@ -0,0 +1,79 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <Implementation/LatencyHistogram.hpp>
+#include <gmock/gmock.h>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+TEST(TestLatencyHistogram, Empty)
+{
+    LatencyHistogram toTest{};
+
+    EXPECT_EQ(0, toTest.Count());
+    EXPECT_EQ(Clock::duration::zero(), toTest.Percentile(0.99f));
+}
+
+TEST(TestLatencyHistogram, Buckets)
+{
+    LatencyHistogram toTest{};
+
+    toTest.Add(nanoseconds(500));
+    toTest.Add(microseconds(1));
+    toTest.Add(microseconds(3));
+    toTest.Add(microseconds(1000));
+    toTest.Add(seconds(10));
+
+    EXPECT_EQ(5, toTest.Count());
+    EXPECT_EQ(1, toTest.Bucket(0));
+    EXPECT_EQ(1, toTest.Bucket(1));
+    EXPECT_EQ(1, toTest.Bucket(2));
+
+    // 512 <= 1000 < 1024
+    EXPECT_EQ(1, toTest.Bucket(10));
+    EXPECT_EQ(1, toTest.Bucket(LatencyHistogram::BucketCount - 1));
+
+    EXPECT_EQ(Clock::duration(seconds(10)), toTest.Maximum());
+}
+
+TEST(TestLatencyHistogram, Percentile)
+{
+    LatencyHistogram toTest{};
+
+    for (int i = 0; i < 99; ++i)
+    {
+        toTest.Add(microseconds(100));
+    }
+
+    toTest.Add(milliseconds(100));
+
+    // 100us is in the [64, 128) bucket.
+    EXPECT_EQ(Clock::duration(microseconds(128)), toTest.Percentile(0.5f));
+    EXPECT_EQ(Clock::duration(microseconds(128)), toTest.Percentile(0.99f));
+    EXPECT_GE(toTest.Percentile(1.0f), Clock::duration(milliseconds(100)));
+
+    toTest.Clear();
+    EXPECT_EQ(0, toTest.Count());
+}
+
+}}} // namespace
@@ -0,0 +1,296 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <gmock/gmock.h>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <stdexcept>
+#include <iostream>
+
+#include <Implementation/NetworkManagerClientGuts.hpp>
+#include <Implementation/NetworkManagerServerShardedGuts.hpp>
+#include <Implementation/NetworkProviderSynchronous.hpp>
+#include "MockIStateManager.hpp"
+
+using namespace std;
+using namespace boost::asio::ip;
+
+using ::testing::Return;
+using ::testing::Invoke;
+using ::testing::NiceMock;
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+namespace
+{
+Delta DeltaCreateSharded(
+        ClientHandle,
+        boost::optional<Sequence> lastAcked)
+{
+    if (lastAcked)
+    {
+        return {Sequence(lastAcked->Value() + 1), Sequence(lastAcked->Value() + 1), {1,2,3,4}};
+    }
+    else
+    {
+        return {Sequence{0},Sequence{0}, {1,2,3,4}};
+    }
+}
+
+Sequence DeltaParseSharded(
+        ClientHandle,
+        const Delta& payload)
+{
+    return payload.to;
+}
+
+void SetupMock(NiceMock<MockIStateManager>& mock)
+{
+    std::array<uint64_t, 256> frequencies;
+    frequencies.fill(1);
+
+    ON_CALL(mock, PrivateGetHuffmanFrequencies())
+            .WillByDefault(Return(frequencies));
+
+    ON_CALL(mock, PrivateConnect( ::testing::_, ::testing::_))
+            .WillByDefault(Return(boost::optional<ClientHandle>(42)));
+
+    ON_CALL(mock, PrivateStateInfo( ::testing::_ ))
+            .WillByDefault(Return(std::vector<uint8_t>()));
+
+    ON_CALL(mock, PrivateCanReceive( ::testing::_, ::testing::_))
+            .WillByDefault(Return(bool(true)));
+
+    ON_CALL(mock, PrivateCanSend( ::testing::_, ::testing::_))
+            .WillByDefault(Return(bool(true)));
+
+    ON_CALL(mock, PrivateIsConnected( ::testing::_ ))
+            .WillByDefault(Return(bool(true)));
+
+    ON_CALL(mock, PrivateDeltaCreate( ::testing::_, ::testing::_))
+            .WillByDefault(Invoke(DeltaCreateSharded));
+
+    ON_CALL(mock, PrivateDeltaParse( ::testing::_, ::testing::_))
+            .WillByDefault(Invoke(DeltaParseSharded));
+}
+}
+
+TEST(TestNetworkManagerServerSharded, CreateAndDestroy)
+{
+    NiceMock<MockIStateManager> stateServer;
+    SetupMock(stateServer);
+
+    NetworkManagerServerShardedGuts toTest{udp::endpoint(address::from_string("127.0.0.1"), 0), 3, stateServer};
+
+    EXPECT_EQ(3, toTest.ShardCount());
+    EXPECT_NE(0, toTest.LocalAddress().port());
+
+    // Nothing to do, but shouldn't hang.
+    toTest.ProcessIncomming();
+    toTest.SendState();
+}
+
+TEST(TestNetworkManagerServerSharded, ClientsConnect)
+{
+    const std::size_t clientCount = 4;
+
+    NiceMock<MockIStateManager> stateServer;
+    SetupMock(stateServer);
+
+    NetworkManagerServerShardedGuts server{udp::endpoint(address::from_string("127.0.0.1"), 0), 2, stateServer};
+
+    std::vector<std::unique_ptr<NiceMock<MockIStateManager>>> states{};
+    std::vector<std::unique_ptr<NetworkProviderSynchronous>> networks{};
+    std::vector<std::unique_ptr<NetworkManagerClientGuts>> clients{};
+
+    for (std::size_t i = 0; i < clientCount; ++i)
+    {
+        states.emplace_back(new NiceMock<MockIStateManager>());
+        SetupMock(*states.back());
+
+        networks.emplace_back(new NetworkProviderSynchronous(udp::endpoint(address::from_string("127.0.0.1"), 0)));
+        clients.emplace_back(new NetworkManagerClientGuts(*networks.back(), *states.back()));
+        clients.back()->Connect(server.LocalAddress());
+    }
+
+    for (int tick = 0; tick < 200; ++tick)
+    {
+        server.ProcessIncomming();
+        server.SendState();
+
+        for (auto& client : clients)
+        {
+            client->ProcessIncomming();
+            client->SendState();
+        }
+
+        if (server.Utilisation().size() == clientCount)
+        {
+            break;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    for (auto& client : clients)
+    {
+        EXPECT_TRUE(client->IsConnected());
+        EXPECT_FALSE(client->HasFailed());
+    }
+
+    EXPECT_EQ(clientCount, server.Utilisation().size());
+}
+
+TEST(TestNetworkManagerServerSharded, ShardExceptionReachesCaller)
+{
+    NiceMock<MockIStateManager> stateServer;
+    SetupMock(stateServer);
+
+    ON_CALL(stateServer, PrivateConnect( ::testing::_, ::testing::_))
+            .WillByDefault(Invoke([] (std::vector<uint8_t>, std::string&) -> boost::optional<ClientHandle>
+    {
+        throw std::logic_error("Game state exploded.");
+    }));
+
+    NetworkManagerServerShardedGuts server{udp::endpoint(address::from_string("127.0.0.1"), 0), 2, stateServer};
+
+    NiceMock<MockIStateManager> stateClient;
+    SetupMock(stateClient);
+
+    NetworkProviderSynchronous network{udp::endpoint(address::from_string("127.0.0.1"), 0)};
+    NetworkManagerClientGuts client{network, stateClient};
+
+    client.Connect(server.LocalAddress());
+
+    bool thrown{false};
+
+    for (int tick = 0; (tick < 200) && (!thrown); ++tick)
+    {
+        try
+        {
+            server.ProcessIncomming();
+        }
+        catch (std::logic_error&)
+        {
+            thrown = true;
+        }
+
+        server.SendState();
+        client.ProcessIncomming();
+        client.SendState();
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    EXPECT_TRUE(thrown);
+
+    // Threads are still there.
+    server.ProcessIncomming();
+    server.SendState();
+}
+
+namespace
+{
+void BenchmarkShards(std::size_t shardCount, std::size_t clientCount)
+{
+    static const auto runFor = std::chrono::seconds(2);
+
+    NiceMock<MockIStateManager> stateServer;
+    SetupMock(stateServer);
+
+    NetworkManagerServerShardedGuts server{udp::endpoint(address::from_string("127.0.0.1"), 0), shardCount, stateServer};
+
+    std::vector<std::unique_ptr<NiceMock<MockIStateManager>>> states{};
+    std::vector<std::unique_ptr<NetworkProviderSynchronous>> networks{};
+    std::vector<std::unique_ptr<NetworkManagerClientGuts>> clients{};
+
+    for (std::size_t i = 0; i < clientCount; ++i)
+    {
+        states.emplace_back(new NiceMock<MockIStateManager>());
+        SetupMock(*states.back());
+
+        networks.emplace_back(new NetworkProviderSynchronous(udp::endpoint(address::from_string("127.0.0.1"), 0)));
+        clients.emplace_back(new NetworkManagerClientGuts(*networks.back(), *states.back()));
+        clients.back()->Connect(server.LocalAddress());
+    }
+
+    auto Tick = [&server, &clients] ()
+    {
+        server.ProcessIncomming();
+        server.SendState();
+
+        for (auto& client : clients)
+        {
+            client->ProcessIncomming();
+            client->SendState();
+        }
+    };
+
+    for (int tick = 0; (tick < 200) && (server.Utilisation().size() < clientCount); ++tick)
+    {
+        Tick();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    std::size_t ticks{0};
+    std::chrono::steady_clock::duration inServer{};
+    auto start = std::chrono::steady_clock::now();
+
+    while ((std::chrono::steady_clock::now() - start) < runFor)
+    {
+        auto serverStart = std::chrono::steady_clock::now();
+
+        server.ProcessIncomming();
+        server.SendState();
+
+        inServer += std::chrono::steady_clock::now() - serverStart;
+
+        for (auto& client : clients)
+        {
+            client->ProcessIncomming();
+            client->SendState();
+        }
+
+        ++ticks;
+    }
+
+    auto serverMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(inServer).count();
+
+    std::cout
+            << shardCount << " shard(s), "
+            << server.Utilisation().size() << "/" << clientCount << " clients: "
+            << ticks << " ticks, "
+            << (ticks ? double(serverMicroseconds) / ticks : 0.0) << " us server/tick" << std::endl;
+}
+}
+
+// Not a unit test, run with --gtest_also_run_disabled_tests to compare.
+TEST(TestNetworkManagerServerSharded, DISABLED_BenchmarkLoopback)
+{
+    static const std::size_t shards[] = {1, 2, 4};
+
+    for (auto shardCount : shards)
+    {
+        BenchmarkShards(shardCount, 64);
+    }
+}
+
+}}} // namespace
@@ -0,0 +1,368 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <Implementation/NetworkProviderBatched.hpp>
+#include <Implementation/NetworkProviderSynchronous.hpp>
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <thread>
+#include <iostream>
+
+using namespace std;
+using namespace boost::asio::ip;
+using Bytes = std::vector<uint8_t>;
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+using Packets = std::vector<NetworkPacket>;
+
+class TestNetworkProviderBatched : public ::testing::Test
+{
+public:
+    TestNetworkProviderBatched()
+        : myIpv4loopback(address::from_string("127.0.0.1"))
+        , mySender(udp::endpoint(myIpv4loopback, 0))
+        , myListen(udp::endpoint(myIpv4loopback, 0))
+    {
+    }
+
+    address myIpv4loopback;
+    NetworkProviderBatched mySender;
+    NetworkProviderBatched myListen;
+};
+
+namespace
+{
+// Loopback doesn't drop unless the socket buffer fills, so keep each
+// burst small and drain it before sending the next one.
+template<class SEND, class RECEIVE>
+double PacketsPerSecond(SEND& sender, RECEIVE& listen, udp::endpoint to, std::size_t total)
+{
+    static const std::size_t burst{64};
+
+    auto packets = Packets{};
+    for (std::size_t i = 0; i < burst; ++i)
+    {
+        packets.emplace_back(Bytes(64, 42), to);
+    }
+
+    std::size_t received{0};
+    auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t sent = 0; sent < total; sent += burst)
+    {
+        sender.Send(packets);
+
+        std::size_t expected{received + burst};
+        for (int tries = 0; (received < expected) && (tries < 1000); ++tries)
+        {
+            received += listen.Receive().size();
+        }
+    }
+
+    auto took = std::chrono::duration_cast<std::chrono::duration<double>>(
+                std::chrono::steady_clock::now() - start);
+
+    return received / took.count();
+}
+}
+
+TEST_F(TestNetworkProviderBatched, IsValid)
+{
+    EXPECT_FALSE(mySender.IsDisabled());
+    EXPECT_NE(0, myListen.LocalAddress().port());
+}
+
+TEST_F(TestNetworkProviderBatched, DisableThenReset)
+{
+    auto bound = myListen.LocalAddress();
+
+    myListen.Disable();
+    EXPECT_TRUE(myListen.IsDisabled());
+
+    // no exceptions please.
+    myListen.Flush();
+    EXPECT_EQ(0, myListen.Receive().size());
+    myListen.Send({{Bytes(4,42), bound}});
+
+    myListen.Reset();
+    EXPECT_FALSE(myListen.IsDisabled());
+}
+
+TEST_F(TestNetworkProviderBatched, NotExpectingData)
+{
+    EXPECT_EQ(0, myListen.Receive().size());
+}
+
+TEST_F(TestNetworkProviderBatched, SendEmpty)
+{
+    mySender.Send({});
+    mySender.Send({{}});
+    mySender.Send({{{}, myListen.LocalAddress()}});
+
+    EXPECT_EQ(0, myListen.Receive().size());
+}
+
+TEST_F(TestNetworkProviderBatched, SendWrongAddressFamily)
+{
+    mySender.Send({{Bytes(4,42), udp::endpoint(address::from_string("::1"), 4444)}});
+
+    EXPECT_FALSE(mySender.IsDisabled());
+}
+
+TEST_F(TestNetworkProviderBatched, SendAndReceive)
+{
+    auto to = myListen.LocalAddress();
+
+    mySender.Send({{Bytes(4,42), to}, {Bytes{1,2,3}, to}});
+
+    auto result(myListen.Receive());
+
+    ASSERT_EQ(2, result.size());
+    EXPECT_EQ(Bytes(4,42), result[0].data);
+    EXPECT_EQ(Bytes({1,2,3}), result[1].data);
+    EXPECT_EQ(mySender.LocalAddress(), result[0].address);
+    EXPECT_EQ(mySender.LocalAddress(), result[1].address);
+}
+
+TEST_F(TestNetworkProviderBatched, KernelTimestamps)
+{
+    auto before = std::chrono::steady_clock::now();
+
+    mySender.Send({{Bytes(4,42), myListen.LocalAddress()}});
+
+    // Sit in the socket buffer for a bit.
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    auto after = std::chrono::steady_clock::now();
+    auto result(myListen.Receive());
+
+    ASSERT_EQ(1, result.size());
+
+    // Allow a little slop for converting from the real time clock.
+    EXPECT_LE(before - std::chrono::milliseconds(5), result[0].received);
+    EXPECT_GT(after - std::chrono::milliseconds(10), result[0].received);
+}
+
+TEST_F(TestNetworkProviderBatched, MoreThanOneBatch)
+{
+    auto to = myListen.LocalAddress();
+    auto toSend = Packets{};
+
+    for (std::size_t i = 0; i < (NetworkProviderBatched::BatchSize * 2) + 3; ++i)
+    {
+        toSend.emplace_back(Bytes(8, static_cast<uint8_t>(i)), to);
+    }
+
+    mySender.Send(toSend);
+
+    auto result(myListen.Receive());
+
+    ASSERT_EQ(toSend.size(), result.size());
+
+    for (std::size_t i = 0; i < result.size(); ++i)
+    {
+        EXPECT_EQ(toSend[i].data, result[i].data);
+    }
+}
+
+TEST_F(TestNetworkProviderBatched, LargeDatagram)
+{
+    auto to = myListen.LocalAddress();
+
+    mySender.Send({{Bytes(NetworkProviderBatched::MaxDatagramSize, 7), to}});
+
+    auto result(myListen.Receive());
+
+    ASSERT_EQ(1, result.size());
+    EXPECT_EQ(NetworkProviderBatched::MaxDatagramSize, result[0].data.size());
+}
+
+TEST_F(TestNetworkProviderBatched, TalksToSynchronous)
+{
+    NetworkProviderSynchronous other(udp::endpoint(myIpv4loopback, 0));
+
+    other.Send({{Bytes(4,42), myListen.LocalAddress()}});
+    auto result(myListen.Receive());
+
+    ASSERT_EQ(1, result.size());
+    EXPECT_EQ(other.LocalAddress(), result[0].address);
+
+    myListen.Send({{Bytes(4,43), other.LocalAddress()}});
+    result = other.Receive();
+
+    ASSERT_EQ(1, result.size());
+    EXPECT_EQ(Bytes(4,43), result[0].data);
+}
+
+TEST_F(TestNetworkProviderBatched, OffloadNone)
+{
+    NetworkProviderBatched toTest(
+            udp::endpoint(myIpv4loopback, 0),
+            NetworkProviderBatched::Offload::None);
+
+    EXPECT_FALSE(toTest.UsingSegmentationOffload());
+    EXPECT_FALSE(toTest.UsingReceiveOffload());
+}
+
+TEST_F(TestNetworkProviderBatched, FragmentTrainToSynchronous)
+{
+    // Without GRO on the other end the kernel splits the train for us.
+    NetworkProviderSynchronous other(udp::endpoint(myIpv4loopback, 0));
+    auto to = other.LocalAddress();
+
+    auto toSend = Packets{};
+    for (int i = 0; i < 9; ++i)
+    {
+        toSend.emplace_back(Bytes(1200, static_cast<uint8_t>(i)), to);
+    }
+
+    toSend.emplace_back(Bytes(100, 42), to);
+    toSend.emplace_back(Bytes(1200, 43), myListen.LocalAddress());
+
+    mySender.Send(toSend);
+
+    auto result(other.Receive());
+
+    ASSERT_EQ(10, result.size());
+    for (std::size_t i = 0; i < result.size(); ++i)
+    {
+        EXPECT_EQ(toSend[i].data, result[i].data);
+        EXPECT_EQ(mySender.LocalAddress(), result[i].address);
+    }
+
+    result = myListen.Receive();
+    ASSERT_EQ(1, result.size());
+    EXPECT_EQ(Bytes(1200, 43), result[0].data);
+}
+
+TEST_F(TestNetworkProviderBatched, FragmentTrains)
+{
+    auto to = myListen.LocalAddress();
+
+    // Several trains, some longer than MaxSegments, with odd sized ones in between.
+    auto toSend = Packets{};
+    for (int i = 0; i < 150; ++i)
+    {
+        auto size = ((i % 50) == 49) ? 7 : 1000;
+        toSend.emplace_back(Bytes(size, static_cast<uint8_t>(i)), to);
+    }
+
+    mySender.Send(toSend);
+
+    auto result(myListen.Receive());
+
+    ASSERT_EQ(toSend.size(), result.size());
+    for (std::size_t i = 0; i < result.size(); ++i)
+    {
+        EXPECT_EQ(toSend[i].data, result[i].data);
+        EXPECT_EQ(mySender.LocalAddress(), result[i].address);
+    }
+}
+
+// Not a unit test, run with --gtest_also_run_disabled_tests to compare.
+TEST_F(TestNetworkProviderBatched, DISABLED_BenchmarkLoopback)
+{
+    static const std::size_t total{200000};
+
+    NetworkProviderSynchronous synchronousSender(udp::endpoint(myIpv4loopback, 0));
+    NetworkProviderSynchronous synchronousListen(udp::endpoint(myIpv4loopback, 0));
+
+    auto synchronous = PacketsPerSecond(
+                synchronousSender,
+                synchronousListen,
+                synchronousListen.LocalAddress(),
+                total);
+
+    auto batched = PacketsPerSecond(
+                mySender,
+                myListen,
+                myListen.LocalAddress(),
+                total);
+
+    std::cout
+            << "Synchronous: " << synchronous << " packets/s" << std::endl
+            << "Batched:     " << batched << " packets/s" << std::endl;
+
+    EXPECT_LT(0, batched);
+}
+
+// Not a unit test. A big snapshot to each of 32 clients, as fragment trains.
+TEST_F(TestNetworkProviderBatched, DISABLED_BenchmarkFragmentTrains)
+{
+    static const std::size_t clients{32};
+    static const std::size_t fragments{8};
+    static const int rounds{2000};
+
+    auto Run = [this] (NetworkProviderBatched::Offload offload) -> double
+    {
+        NetworkProviderBatched sender(udp::endpoint(myIpv4loopback, 0), offload);
+
+        auto listeners = std::vector<std::unique_ptr<NetworkProviderBatched>>{};
+        auto toSend = Packets{};
+
+        for (std::size_t client = 0; client < clients; ++client)
+        {
+            listeners.emplace_back(new NetworkProviderBatched(udp::endpoint(myIpv4loopback, 0), offload));
+
+            for (std::size_t i = 0; i < fragments; ++i)
+            {
+                toSend.emplace_back(Bytes(1400, 42), listeners.back()->LocalAddress());
+            }
+        }
+
+        std::size_t received{0};
+        auto start = std::clock();
+
+        for (int round = 0; round < rounds; ++round)
+        {
+            sender.Send(toSend);
+
+            for (auto& listener : listeners)
+            {
+                received += listener->Receive().size();
+            }
+        }
+
+        auto cpu = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+        EXPECT_EQ(toSend.size() * rounds, received);
+
+        return (cpu * 1000000000.0) / received;
+    };
+
+    NetworkProviderBatched probe;
+
+    std::cout
+            << "GSO: " << probe.UsingSegmentationOffload()
+            << " GRO: " << probe.UsingReceiveOffload() << std::endl;
+
+    auto none = Run(NetworkProviderBatched::Offload::None);
+    auto offload = Run(NetworkProviderBatched::Offload::Automatic);
+
+    std::cout
+            << "No offload: " << none << " ns CPU/fragment" << std::endl
+            << "Offload:    " << offload << " ns CPU/fragment" << std::endl;
+}
+
+}}} // namespace
@@ -0,0 +1,277 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <Implementation/NetworkProviderCapture.hpp>
+#include <Implementation/NetworkProviderInMemory.hpp>
+#include <gmock/gmock.h>
+
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace boost::asio::ip;
+using Bytes = std::vector<uint8_t>;
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+using Packets = std::vector<NetworkPacket>;
+
+class TestNetworkProviderCapture : public ::testing::Test
+{
+public:
+    TestNetworkProviderCapture()
+        : testTime(Clock::now())
+        , network([this] () -> OClock { return testTime; })
+        , addressServer(address_v4(1l), 13444)
+        , addressClient(address_v4(2l), 4444)
+    {}
+
+    OClock testTime;
+    NetworkProviderInMemory network;
+    udp::endpoint addressServer;
+    udp::endpoint addressClient;
+};
+
+TEST_F(TestNetworkProviderCapture, PassesThrough)
+{
+    std::stringstream file;
+    NetworkProviderCapture capture(network, file, {}, [this] () -> OClock { return testTime; });
+
+    network.RunAs(addressServer);
+    capture.Send({{Bytes{1,2,3}, addressClient}});
+
+    network.RunAs(addressClient);
+    auto result = capture.Receive();
+
+    ASSERT_EQ(1, result.size());
+    EXPECT_EQ(Bytes({1,2,3}), result[0].data);
+    EXPECT_EQ(addressServer, result[0].address);
+    EXPECT_EQ(2, capture.RecordsWritten());
+
+    capture.Disable();
+    EXPECT_TRUE(network.IsDisabled());
+    EXPECT_TRUE(capture.IsDisabled());
+}
+
+TEST_F(TestNetworkProviderCapture, RoundTrip)
+{
+    std::stringstream file;
+    NetworkProviderCapture capture(network, file, {}, [this] () -> OClock { return testTime; });
+
+    auto addressClient6 = udp::endpoint{address_v6::loopback(), 5555};
+
+    network.RunAs(addressServer);
+    capture.Send({{Bytes{1,2,3}, addressClient}, {Bytes{}, addressClient6}});
+
+    testTime += Milliseconds{25};
+
+    network.RunAs(addressClient);
+    capture.Receive();
+    capture.Flush();
+
+    auto records = NetworkProviderCapture::Load(file);
+
+    ASSERT_EQ(3, records.size());
+
+    EXPECT_FALSE(records[0].incoming);
+    EXPECT_EQ(addressClient, records[0].packet.address);
+    EXPECT_EQ(Bytes({1,2,3}), records[0].packet.data);
+
+    EXPECT_FALSE(records[1].incoming);
+    EXPECT_EQ(addressClient6, records[1].packet.address);
+    EXPECT_TRUE(records[1].packet.data.empty());
+
+    EXPECT_TRUE(records[2].incoming);
+    EXPECT_EQ(addressServer, records[2].packet.address);
+    EXPECT_EQ(Bytes({1,2,3}), records[2].packet.data);
+
+    EXPECT_EQ(records[0].nanoseconds, records[1].nanoseconds);
+    EXPECT_EQ(25000000, records[2].nanoseconds - records[0].nanoseconds);
+}
+
+TEST_F(TestNetworkProviderCapture, LocalAddress)
+{
+    std::stringstream file;
+    auto local = udp::endpoint{address_v4::loopback(), 1234};
+    NetworkProviderCapture capture(network, file, local, [this] () -> OClock { return testTime; });
+
+    network.RunAs(addressServer);
+    capture.Send({{Bytes{9}, addressClient}});
+
+    // Wrong local address means everything looks like it's going out.
+    file.seekg(0);
+    auto wrong = NetworkProviderCapture::Load(file, {});
+    file.clear();
+    file.seekg(0);
+    auto right = NetworkProviderCapture::Load(file, local);
+
+    ASSERT_EQ(1, right.size());
+    EXPECT_FALSE(right[0].incoming);
+    EXPECT_EQ(addressClient, right[0].packet.address);
+
+    ASSERT_EQ(1, wrong.size());
+    EXPECT_FALSE(wrong[0].incoming);
+}
+
+TEST_F(TestNetworkProviderCapture, PcapFormat)
+{
+    std::stringstream file;
+    NetworkProviderCapture capture(network, file, {}, [this] () -> OClock { return testTime; });
+
+    network.RunAs(addressServer);
+    capture.Send({{Bytes{1,2,3,4,5}, addressClient}});
+
+    auto bytes = file.str();
+    auto data = reinterpret_cast<const uint8_t*>(bytes.data());
+
+    // 24 byte file header, 16 byte record header, 20 byte IP, 8 byte UDP, payload.
+    ASSERT_EQ(24 + 16 + 20 + 8 + 5, bytes.size());
+
+    uint32_t magic;
+    uint32_t linkType;
+
+    std::memcpy(&magic, data, 4);
+    std::memcpy(&linkType, data + 20, 4);
+
+    EXPECT_EQ(0xA1B23C4D, magic);
+    EXPECT_EQ(101, linkType);
+
+    // A valid IP header checksum sums to 0xFFFF.
+    auto ip = data + 40;
+    uint32_t sum = 0;
+
+    for (int i = 0; i < 20; i += 2)
+    {
+        sum += (ip[i] << 8) | ip[i + 1];
+    }
+
+    while (sum >> 16)
+    {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+
+    EXPECT_EQ(0x45, ip[0]);
+    EXPECT_EQ(17, ip[9]);
+    EXPECT_EQ(0xFFFF, sum);
+}
+
+TEST_F(TestNetworkProviderCapture, NotPcap)
+{
+    std::stringstream empty;
+    std::stringstream garbage(std::string(100, 'x'));
+
+    EXPECT_THROW(NetworkProviderCapture::Load(empty), std::logic_error);
+    EXPECT_THROW(NetworkProviderCapture::Load(garbage), std::logic_error);
+}
+
+TEST_F(TestNetworkProviderCapture, Truncated)
+{
+    std::stringstream file;
+    NetworkProviderCapture capture(network, file, {}, [this] () -> OClock { return testTime; });
+
+    network.RunAs(addressServer);
+    capture.Send({{Bytes{1}, addressClient}, {Bytes{2}, addressClient}});
+
+    auto bytes = file.str();
+    std::stringstream cut(bytes.substr(0, bytes.size() - 3));
+
+    auto records = NetworkProviderCapture::Load(cut);
+
+    ASSERT_EQ(1, records.size());
+    EXPECT_EQ(Bytes({1}), records[0].packet.data);
+}
+
+TEST_F(TestNetworkProviderCapture, TooBigNotWritten)
+{
+    std::stringstream file;
+    NetworkProviderCapture capture(network, file, {}, [this] () -> OClock { return testTime; });
+
+    network.RunAs(addressServer);
+    capture.Send({{Bytes(70000, 1), addressClient}, {Bytes{2}, addressClient}});
+
+    EXPECT_EQ(1, capture.RecordsWritten());
+    EXPECT_EQ(1, capture.RecordsSkipped());
+
+    auto records = NetworkProviderCapture::Load(file);
+
+    ASSERT_EQ(1, records.size());
+    EXPECT_EQ(Bytes({2}), records[0].packet.data);
+}
+
+TEST_F(TestNetworkProviderCapture, LargestIp6FitsSnapLength)
+{
+    std::stringstream file;
+    NetworkProviderCapture capture(network, file, {}, [this] () -> OClock { return testTime; });
+
+    auto addressClient6 = udp::endpoint{address_v6::loopback(), 5555};
+
+    // 65535 snap length - 40 byte IP - 8 byte UDP.
+    network.RunAs(addressServer);
+    capture.Send({{Bytes(65487, 1), addressClient6}, {Bytes(65488, 2), addressClient6}});
+
+    EXPECT_EQ(1, capture.RecordsWritten());
+    EXPECT_EQ(1, capture.RecordsSkipped());
+
+    auto records = NetworkProviderCapture::Load(file);
+
+    ASSERT_EQ(1, records.size());
+    EXPECT_EQ(addressClient6, records[0].packet.address);
+    EXPECT_EQ(Bytes(65487, 1), records[0].packet.data);
+}
+
+// A file header from a real capture, followed by a hand made record.
+std::string WithRecord(const std::string& capture, uint32_t size, const Bytes& datagram)
+{
+    std::string result = capture.substr(0, 24);
+    uint32_t header[4] = {0, 0, size, size};
+
+    result.append(reinterpret_cast<const char*>(header), sizeof(header));
+    result.append(datagram.begin(), datagram.end());
+
+    return result;
+}
+
+TEST_F(TestNetworkProviderCapture, ShortIpHeaderIgnored)
+{
+    std::stringstream file;
+    NetworkProviderCapture capture(network, file, {}, [this] () -> OClock { return testTime; });
+
+    // IHL of 0 and 1, which would put the UDP header inside the IP one.
+    std::stringstream zero(WithRecord(file.str(), 9, Bytes{0x40, 0, 0, 0, 0, 0, 0, 0, 0}));
+    std::stringstream one(WithRecord(file.str(), 12, Bytes{0x41, 0, 0, 0, 0, 0, 0, 0, 0, 17, 0, 0}));
+
+    EXPECT_TRUE(NetworkProviderCapture::Load(zero).empty());
+    EXPECT_TRUE(NetworkProviderCapture::Load(one).empty());
+}
+
+TEST_F(TestNetworkProviderCapture, HugeRecord)
+{
+    std::stringstream file;
+    NetworkProviderCapture capture(network, file, {}, [this] () -> OClock { return testTime; });
+
+    std::stringstream huge(WithRecord(file.str(), 0xFFFFFFF0, Bytes{0x45}));
+    std::stringstream overSnap(WithRecord(file.str(), 65536, Bytes{0x45}));
+
+    EXPECT_THROW(NetworkProviderCapture::Load(huge), std::logic_error);
+    EXPECT_THROW(NetworkProviderCapture::Load(overSnap), std::logic_error);
+}
+
+}}} // namespace
@@ -193,4 +193,318 @@ TEST_F(TestNetworkProviderInMemory, LatencyOutOfOrder)
     EXPECT_FALSE(inOrder);
 }
 
+TEST_F(TestNetworkProviderInMemory, OutOfOrderPerDestination)
+{
+    // Always reorder, so the result is predictable.
+    NetworkProviderInMemory::RandomSettings settings{
+                [] () { return 0.0f; },
+                {},
+                Milliseconds{0},
+                0,
+                0,
+                1.0};
+
+    NetworkProviderInMemory buffer(settings, Clock::now);
+
+    auto addressServer = udp::endpoint{address_v4(1l), 13444};
+    auto addressA = udp::endpoint{address_v4(2l), 4444};
+    auto addressB = udp::endpoint{address_v4(3l), 4444};
+
+    buffer.RunAs(addressServer);
+
+    // The last packet to each destination swaps with that destination's
+    // next one out. So 2 swaps with 1, but 10 has nothing to swap with.
+    buffer.Send({{Bytes{1}, addressA}, {Bytes{2}, addressA}, {Bytes{10}, addressB}});
+
+    // 4 swaps with 2, 11 with 10.
+    buffer.Send({{Bytes{3}, addressA}, {Bytes{4}, addressA}, {Bytes{11}, addressB}});
+
+    buffer.RunAs(addressA);
+    auto result = buffer.Receive();
+
+    ASSERT_EQ(4, result.size());
+    EXPECT_EQ(Bytes{4}, result[0].data);
+    EXPECT_EQ(Bytes{1}, result[1].data);
+    EXPECT_EQ(Bytes{3}, result[2].data);
+    EXPECT_EQ(Bytes{2}, result[3].data);
+    EXPECT_EQ(addressServer, result[0].address);
+
+    buffer.RunAs(addressB);
+    result = buffer.Receive();
+
+    ASSERT_EQ(2, result.size());
+    EXPECT_EQ(Bytes{11}, result[0].data);
+    EXPECT_EQ(Bytes{10}, result[1].data);
+}
+
+TEST_F(TestNetworkProviderInMemory, ManyEndpoints)
+{
+    static const int clients = 1024;
+    static const int ticks = 50;
+
+    OClock testTime{Clock::now()};
+
+    NetworkProviderInMemory::RandomSettings settings{
+                std::bind(myRandom0To1, myRandomEngine),
+                std::bind(myLatency, myRandomEngine),
+                Milliseconds{100},
+                0,
+                0,
+                0.1f};
+
+    NetworkProviderInMemory buffer(settings, [&testTime] () -> OClock { return testTime; });
+
+    auto addressServer = udp::endpoint{address_v4(1l), 13444};
+    auto toClients = Packets{};
+
+    for (int i = 0; i < clients; ++i)
+    {
+        toClients.emplace_back(Bytes{}, udp::endpoint{address_v4(10 + i), 4444});
+    }
+
+    std::vector<int> received(clients, 0);
+    std::size_t serverReceived{0};
+
+    for (int tick = 0; tick < ticks; ++tick)
+    {
+        for (auto& packet : toClients)
+        {
+            packet.data = Bytes{static_cast<uint8_t>(tick)};
+        }
+
+        buffer.RunAs(addressServer);
+        serverReceived += buffer.Receive().size();
+        buffer.Send(toClients);
+
+        for (int i = 0; i < clients; ++i)
+        {
+            buffer.RunAs(toClients[i].address);
+
+            received[i] += buffer.Receive().size();
+
+            buffer.Send({{Bytes{1}, addressServer}});
+        }
+
+        testTime += std::chrono::milliseconds(50);
+    }
+
+    // Flush the rest.
+    testTime += std::chrono::seconds(10);
+
+    buffer.RunAs(addressServer);
+    serverReceived += buffer.Receive().size();
+    EXPECT_EQ(clients * ticks, serverReceived);
+
+    for (int i = 0; i < clients; ++i)
+    {
+        buffer.RunAs(toClients[i].address);
+        received[i] += buffer.Receive().size();
+
+        EXPECT_EQ(ticks, received[i]);
+    }
+}
+
+namespace
+{
+using Link = NetworkProviderInMemory::LinkSettings;
+
+Link Unlimited()
+{
+    return Link{0, 0, 0, Link::Jitter::None, Milliseconds{0}, 0};
+}
+
+Packets Lots(std::size_t count, std::size_t size, udp::endpoint to)
+{
+    Packets result;
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        result.emplace_back(Bytes(size, static_cast<uint8_t>(i)), to);
+    }
+
+    return result;
+}
+}
+
+TEST_F(TestNetworkProviderInMemory, LinkBandwidthCap)
+{
+    OClock testTime{Clock::now()};
+    NetworkProviderInMemory buffer([&testTime] () -> OClock { return testTime; });
+
+    auto addressServer = udp::endpoint{address_v4(1l), 13444};
+    auto addressClient = udp::endpoint{address_v4(2l), 4444};
+
+    // 100 byte packets at 10,000 bytes a second is 10ms each.
+    auto up = Unlimited();
+    up.bytesPerSecond = 10000;
+
+    buffer.SetLink(addressServer, up, Unlimited());
+
+    buffer.RunAs(addressServer);
+    buffer.Send(Lots(5, 100, addressClient));
+
+    buffer.RunAs(addressClient);
+
+    std::vector<std::size_t> arrived;
+
+    for (int tick = 0; tick < 6; ++tick)
+    {
+        arrived.push_back(buffer.Receive().size());
+        testTime += Milliseconds{10};
+    }
+
+    EXPECT_EQ(std::vector<std::size_t>({0, 1, 1, 1, 1, 1}), arrived);
+
+    auto counters = buffer.Counters(addressServer);
+
+    EXPECT_EQ(5, counters.packetsSent);
+    EXPECT_EQ(500, counters.bytesSent);
+    EXPECT_EQ(0, counters.packetsDropped);
+}
+
+TEST_F(TestNetworkProviderInMemory, LinkQueueLimit)
+{
+    OClock testTime{Clock::now()};
+    NetworkProviderInMemory buffer([&testTime] () -> OClock { return testTime; });
+
+    auto addressServer = udp::endpoint{address_v4(1l), 13444};
+    auto addressClient = udp::endpoint{address_v4(2l), 4444};
+
+    // Bottleneck on the client's download this time.
+    auto down = Unlimited();
+    down.bytesPerSecond = 10000;
+    down.queueLimit = 3;
+
+    buffer.SetLink(addressClient, Unlimited(), down);
+
+    buffer.RunAs(addressServer);
+    buffer.Send(Lots(10, 100, addressClient));
+
+    testTime += Milliseconds{1000};
+
+    buffer.RunAs(addressClient);
+    auto result = buffer.Receive();
+
+    ASSERT_EQ(3, result.size());
+    EXPECT_EQ(0, result[0].data[0]);
+    EXPECT_EQ(2, result[2].data[0]);
+
+    auto counters = buffer.Counters(addressClient);
+
+    EXPECT_EQ(7, counters.packetsDropped);
+    EXPECT_EQ(3, counters.packetsReceived);
+    EXPECT_EQ(300, counters.bytesReceived);
+
+    // Queue has drained, so there's room again.
+    buffer.RunAs(addressServer);
+    buffer.Send(Lots(3, 100, addressClient));
+
+    testTime += Milliseconds{1000};
+
+    buffer.RunAs(addressClient);
+    EXPECT_EQ(3, buffer.Receive().size());
+}
+
+TEST_F(TestNetworkProviderInMemory, LinkDuplication)
+{
+    NetworkProviderInMemory buffer{};
+
+    auto addressServer = udp::endpoint{address_v4(1l), 13444};
+    auto addressClient = udp::endpoint{address_v4(2l), 4444};
+
+    auto up = Unlimited();
+    up.duplicateChance0to1 = 1.0f;
+
+    buffer.SetLink(addressServer, up, Unlimited());
+
+    buffer.RunAs(addressServer);
+    buffer.Send(Lots(4, 10, addressClient));
+
+    buffer.RunAs(addressClient);
+    auto result = buffer.Receive();
+
+    ASSERT_EQ(8, result.size());
+
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        EXPECT_EQ(i, result[i * 2].data[0]);
+        EXPECT_EQ(i, result[i * 2 + 1].data[0]);
+    }
+
+    EXPECT_EQ(4, buffer.Counters(addressServer).packetsDuplicated);
+}
+
+TEST_F(TestNetworkProviderInMemory, LinkAsymmetric)
+{
+    OClock testTime{Clock::now()};
+    NetworkProviderInMemory buffer([&testTime] () -> OClock { return testTime; });
+
+    auto addressServer = udp::endpoint{address_v4(1l), 13444};
+    auto addressClient = udp::endpoint{address_v4(2l), 4444};
+
+    // Like ADSL, slow up, fast down.
+    auto up = Unlimited();
+    auto down = Unlimited();
+    up.bytesPerSecond = 1000;
+    down.bytesPerSecond = 100000;
+
+    buffer.SetLink(addressClient, up, down);
+
+    buffer.RunAs(addressServer);
+    buffer.Send(Lots(1, 100, addressClient));
+    buffer.RunAs(addressClient);
+    buffer.Send(Lots(1, 100, addressServer));
+
+    testTime += Milliseconds{1};
+
+    buffer.RunAs(addressClient);
+    EXPECT_EQ(1, buffer.Receive().size());
+    buffer.RunAs(addressServer);
+    EXPECT_EQ(0, buffer.Receive().size());
+
+    testTime += Milliseconds{99};
+
+    EXPECT_EQ(1, buffer.Receive().size());
+}
+
+TEST_F(TestNetworkProviderInMemory, LinkSeededIsRepeatable)
+{
+    auto run = [] () -> std::vector<Clock::duration>
+    {
+        OClock start{Clock::now()};
+        OClock testTime{start};
+        NetworkProviderInMemory buffer([&testTime] () -> OClock { return testTime; });
+
+        auto addressServer = udp::endpoint{address_v4(1l), 13444};
+        auto addressClient = udp::endpoint{address_v4(2l), 4444};
+
+        auto down = Link{0, 0, 0.2f, Link::Jitter::Exponential, Milliseconds{20}, 1234};
+
+        buffer.SetLink(addressClient, Unlimited(), down);
+
+        buffer.RunAs(addressServer);
+        buffer.Send(Lots(100, 10, addressClient));
+
+        buffer.RunAs(addressClient);
+
+        std::vector<Clock::duration> arrivals;
+
+        for (int tick = 0; tick < 500; ++tick)
+        {
+            for (const auto& packet : buffer.Receive())
+            {
+                arrivals.push_back(testTime - start + Milliseconds{packet.data[0]});
+            }
+
+            testTime += Milliseconds{1};
+        }
+
+        EXPECT_LT(100, arrivals.size());
+
+        return arrivals;
+    };
+
+    EXPECT_EQ(run(), run());
+}
+
 }}} // namespace
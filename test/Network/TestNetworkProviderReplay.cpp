@@ -0,0 +1,150 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <Implementation/NetworkProviderReplay.hpp>
+#include <Implementation/NetworkProviderInMemory.hpp>
+#include <gmock/gmock.h>
+
+#include <sstream>
+
+using namespace std;
+using namespace boost::asio::ip;
+using Bytes = std::vector<uint8_t>;
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+using Packets = std::vector<NetworkPacket>;
+
+class TestNetworkProviderReplay : public ::testing::Test
+{
+public:
+    TestNetworkProviderReplay()
+        : testTime(Clock::now())
+        , file()
+        , addressServer(address_v4(1l), 13444)
+        , addressClient(address_v4(2l), 4444)
+    {
+        // Client gets a packet at 0ms, two at 100ms and one at 200ms,
+        // and sends one back each time.
+        NetworkProviderInMemory network([this] () -> OClock { return testTime; });
+        NetworkProviderCapture capture(network, file, {}, [this] () -> OClock { return testTime; });
+
+        const std::vector<std::vector<uint8_t>> ticks = {{0}, {1, 2}, {3}};
+
+        for (const auto& tick : ticks)
+        {
+            network.RunAs(addressServer);
+
+            Packets toSend;
+            for (auto id : tick)
+            {
+                toSend.emplace_back(Bytes{id}, addressClient);
+            }
+
+            network.Send(toSend);
+
+            network.RunAs(addressClient);
+            capture.Receive();
+            capture.Send({{Bytes{0xFF}, addressServer}});
+
+            testTime += Milliseconds{100};
+        }
+    }
+
+    OClock testTime;
+    std::stringstream file;
+    udp::endpoint addressServer;
+    udp::endpoint addressClient;
+};
+
+TEST_F(TestNetworkProviderReplay, OriginalSpeed)
+{
+    NetworkProviderReplay replay(file, 1.0f, {}, [this] () -> OClock { return testTime; });
+
+    EXPECT_EQ(4, replay.PacketsTotal());
+
+    auto first = replay.Receive();
+
+    ASSERT_EQ(1, first.size());
+    EXPECT_EQ(Bytes({0}), first[0].data);
+    EXPECT_EQ(addressServer, first[0].address);
+    EXPECT_EQ(testTime, first[0].received);
+
+    testTime += Milliseconds{99};
+    EXPECT_EQ(0, replay.Receive().size());
+
+    testTime += Milliseconds{1};
+    auto second = replay.Receive();
+
+    ASSERT_EQ(2, second.size());
+    EXPECT_EQ(Bytes({1}), second[0].data);
+    EXPECT_EQ(Bytes({2}), second[1].data);
+
+    EXPECT_FALSE(replay.Finished());
+    testTime += Milliseconds{100};
+    EXPECT_EQ(1, replay.Receive().size());
+    EXPECT_TRUE(replay.Finished());
+}
+
+TEST_F(TestNetworkProviderReplay, Accelerated)
+{
+    NetworkProviderReplay replay(file, 10.0f, {}, [this] () -> OClock { return testTime; });
+
+    EXPECT_EQ(1, replay.Receive().size());
+
+    testTime += Milliseconds{10};
+    EXPECT_EQ(2, replay.Receive().size());
+
+    testTime += Milliseconds{10};
+    EXPECT_EQ(1, replay.Receive().size());
+}
+
+TEST_F(TestNetworkProviderReplay, AsFastAsPossible)
+{
+    NetworkProviderReplay replay(file, 0, {}, [this] () -> OClock { return testTime; });
+
+    EXPECT_EQ(1, replay.Receive().size());
+    EXPECT_EQ(2, replay.Receive().size());
+    EXPECT_EQ(1, replay.Receive().size());
+    EXPECT_EQ(0, replay.Receive().size());
+    EXPECT_TRUE(replay.Finished());
+
+    replay.Reset();
+
+    EXPECT_FALSE(replay.Finished());
+    EXPECT_EQ(1, replay.Receive().size());
+}
+
+TEST_F(TestNetworkProviderReplay, SendsAreCounted)
+{
+    NetworkProviderReplay replay(file, 0, {}, [this] () -> OClock { return testTime; });
+
+    replay.Send({{Bytes{1}, addressServer}, {Bytes{2}, addressServer}});
+    EXPECT_EQ(2, replay.PacketsSent());
+
+    replay.Disable();
+    EXPECT_TRUE(replay.IsDisabled());
+
+    replay.Send({{Bytes{1}, addressServer}});
+    EXPECT_EQ(2, replay.PacketsSent());
+    EXPECT_EQ(0, replay.Receive().size());
+}
+
+}}} // namespace
@@ -0,0 +1,416 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <Implementation/NetworkProviderSharedMemoryServer.hpp>
+#include <Implementation/NetworkProviderSharedMemoryClient.hpp>
+#include <Implementation/NetworkProviderInMemory.hpp>
+#include <Implementation/NetworkProviderSynchronous.hpp>
+#include <gmock/gmock.h>
+
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <boost/interprocess/exceptions.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+
+using namespace std;
+using namespace boost::asio::ip;
+using Bytes = std::vector<uint8_t>;
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+using Packets = std::vector<NetworkPacket>;
+using Server = NetworkProviderSharedMemoryServer;
+using Client = NetworkProviderSharedMemoryClient;
+
+namespace
+{
+// Keeps what it was sent, so we can see if the buffers were copied.
+class ProviderRecording final : public INetworkProvider
+{
+public:
+    Packets sent;
+
+private:
+    Packets PrivateReceive() override { return {}; }
+    void PrivateSend(Packets packets) override { sent = std::move(packets); }
+    void PrivateReset() override {}
+    void PrivateFlush() override {}
+    void PrivateDisable() override {}
+    bool PrivateIsDisabled() const override { return false; }
+};
+}
+
+class TestNetworkProviderSharedMemory : public ::testing::Test
+{
+public:
+    TestNetworkProviderSharedMemory()
+        : name("GameInABoxTestSharedMemory")
+        , network()
+        , addressServer(address_v4(1l), 13444)
+        , addressRemote(address_v4(2l), 4444)
+    {
+        // In case a crashed run left it behind.
+        Server::Remove(name);
+    }
+
+    std::string name;
+    NetworkProviderInMemory network;
+    udp::endpoint addressServer;
+    udp::endpoint addressRemote;
+};
+
+TEST_F(TestNetworkProviderSharedMemory, Addresses)
+{
+    EXPECT_TRUE(Server::ServerAddress().address().is_v6());
+    EXPECT_FALSE(Server::SlotFor(Server::ServerAddress()));
+    EXPECT_FALSE(Server::SlotFor(addressRemote));
+
+    for (std::size_t i : {0, 1, 100})
+    {
+        for (uint32_t generation : {0u, 1u, 0xFFFFFFFFu})
+        {
+            auto slot = Server::SlotFor(Server::AddressFor(i, generation));
+
+            ASSERT_TRUE(slot);
+            EXPECT_EQ(i, *slot);
+        }
+    }
+
+    EXPECT_NE(Server::AddressFor(0, 0), Server::AddressFor(0, 1));
+}
+
+TEST_F(TestNetworkProviderSharedMemory, RoundTrip)
+{
+    Server server(network, name, 2);
+    Client client(name);
+
+    EXPECT_EQ(0, client.SlotIndex());
+    EXPECT_EQ(1, server.GetMetrics().clients);
+
+    client.Send({{Bytes{1,2,3}, Server::ServerAddress()}, {Bytes{}, Server::ServerAddress()}});
+
+    network.RunAs(addressServer);
+    auto atServer = server.Receive();
+
+    ASSERT_EQ(2, atServer.size());
+    EXPECT_EQ(Bytes({1,2,3}), atServer[0].data);
+    EXPECT_EQ(Server::AddressFor(0), atServer[0].address);
+    EXPECT_NE(OClock{}, atServer[0].received);
+    EXPECT_TRUE(atServer[1].data.empty());
+
+    server.Send({{Bytes{4,5}, atServer[0].address}});
+
+    auto atClient = client.Receive();
+
+    ASSERT_EQ(1, atClient.size());
+    EXPECT_EQ(Bytes({4,5}), atClient[0].data);
+    EXPECT_EQ(Server::ServerAddress(), atClient[0].address);
+
+    EXPECT_EQ(0, client.Receive().size());
+    EXPECT_EQ(0, server.Receive().size());
+}
+
+TEST_F(TestNetworkProviderSharedMemory, NextToUdp)
+{
+    Server server(network, name, 2);
+    Client client(name);
+
+    // A remote client over the normal provider.
+    network.RunAs(addressRemote);
+    network.Send({{Bytes{1}, addressServer}});
+
+    client.Send({{Bytes{2}, Server::ServerAddress()}});
+
+    network.RunAs(addressServer);
+    auto atServer = server.Receive();
+
+    ASSERT_EQ(2, atServer.size());
+    EXPECT_EQ(addressRemote, atServer[0].address);
+    EXPECT_EQ(Server::AddressFor(0), atServer[1].address);
+
+    server.Send({{Bytes{3}, addressRemote}, {Bytes{4}, Server::AddressFor(0)}});
+
+    auto atClient = client.Receive();
+
+    ASSERT_EQ(1, atClient.size());
+    EXPECT_EQ(Bytes({4}), atClient[0].data);
+
+    network.RunAs(addressRemote);
+    auto atRemote = network.Receive();
+
+    ASSERT_EQ(1, atRemote.size());
+    EXPECT_EQ(Bytes({3}), atRemote[0].data);
+}
+
+TEST_F(TestNetworkProviderSharedMemory, NetworkPacketsNotCopied)
+{
+    ProviderRecording wrapped;
+    Server server(wrapped, name, 1);
+    Client client(name);
+
+    Packets toSend;
+    toSend.emplace_back(Bytes{1}, addressRemote);
+    toSend.emplace_back(Bytes{2}, Server::AddressFor(0));
+    toSend.emplace_back(Bytes{3}, addressServer);
+
+    std::vector<const uint8_t*> buffers{toSend[0].data.data(), toSend[2].data.data()};
+
+    server.Send(std::move(toSend));
+
+    ASSERT_EQ(2, wrapped.sent.size());
+    EXPECT_EQ(buffers[0], wrapped.sent[0].data.data());
+    EXPECT_EQ(buffers[1], wrapped.sent[1].data.data());
+    EXPECT_EQ(addressRemote, wrapped.sent[0].address);
+    EXPECT_EQ(addressServer, wrapped.sent[1].address);
+
+    auto atClient = client.Receive();
+
+    ASSERT_EQ(1, atClient.size());
+    EXPECT_EQ(Bytes({2}), atClient[0].data);
+}
+
+TEST_F(TestNetworkProviderSharedMemory, NoServer)
+{
+    EXPECT_THROW(Client("GameInABoxTestNoSuchServer"), boost::interprocess::interprocess_exception);
+}
+
+TEST_F(TestNetworkProviderSharedMemory, Full)
+{
+    Server server(network, name, 2);
+    Client first(name);
+
+    {
+        Client second(name);
+
+        EXPECT_EQ(1, second.SlotIndex());
+        EXPECT_EQ(2, server.GetMetrics().clients);
+        EXPECT_THROW(Client{name}, std::runtime_error);
+    }
+
+    // Slot is freed once the server notices.
+    server.Receive();
+    EXPECT_EQ(1, server.GetMetrics().clients);
+
+    Client third(name);
+    EXPECT_EQ(1, third.SlotIndex());
+}
+
+TEST_F(TestNetworkProviderSharedMemory, ReclaimedSlotNewAddress)
+{
+    Server server(network, name, 1);
+    udp::endpoint old;
+
+    {
+        Client first(name);
+
+        first.Send({{Bytes{1}, Server::ServerAddress()}});
+
+        auto atServer = server.Receive();
+
+        ASSERT_EQ(1, atServer.size());
+        old = atServer[0].address;
+    }
+
+    // Frees the slot.
+    server.Receive();
+
+    Client second(name);
+    EXPECT_EQ(0, second.SlotIndex());
+
+    second.Send({{Bytes{2}, Server::ServerAddress()}});
+
+    auto atServer = server.Receive();
+
+    ASSERT_EQ(1, atServer.size());
+    EXPECT_NE(old, atServer[0].address);
+
+    // Anything left for the old client goes nowhere.
+    server.Send({{Bytes{3}, old}, {Bytes{4}, atServer[0].address}});
+
+    auto atClient = second.Receive();
+
+    ASSERT_EQ(1, atClient.size());
+    EXPECT_EQ(Bytes({4}), atClient[0].data);
+}
+
+TEST_F(TestNetworkProviderSharedMemory, ExistingSegment)
+{
+    {
+        Server server(network, name, 1);
+
+        EXPECT_THROW(Server(network, name, 1), boost::interprocess::interprocess_exception);
+
+        // Still works.
+        Client client(name);
+        EXPECT_EQ(1, server.GetMetrics().clients);
+    }
+
+    // Left by a crash.
+    {
+        boost::interprocess::shared_memory_object stale(
+                boost::interprocess::create_only,
+                name.c_str(),
+                boost::interprocess::read_write);
+    }
+
+    EXPECT_THROW(Server(network, name, 1), boost::interprocess::interprocess_exception);
+    EXPECT_TRUE(Server::Remove(name));
+
+    Server server(network, name, 1);
+    Client client(name);
+    EXPECT_EQ(1, server.GetMetrics().clients);
+}
+
+TEST_F(TestNetworkProviderSharedMemory, Dropped)
+{
+    Server server(network, name, 1);
+    Client client(name);
+
+    Packets lots(SharedMemoryRing::CellCount + 10, NetworkPacket{Bytes{1}, Server::AddressFor(0)});
+
+    // Bigger than a cell, and to a slot that doesn't exist.
+    lots.emplace_back(Bytes(SharedMemoryRing::CellSize + 1), Server::AddressFor(0));
+    lots.emplace_back(Bytes{1}, Server::AddressFor(5));
+
+    server.Send(lots);
+
+    EXPECT_EQ(11, server.GetMetrics().dropped);
+    EXPECT_EQ(SharedMemoryRing::CellCount, client.Receive().size());
+
+    client.Send(lots);
+    EXPECT_EQ(12, client.Dropped());
+}
+
+TEST_F(TestNetworkProviderSharedMemory, Wait)
+{
+    Server server(network, name, 1);
+    Client client(name);
+
+    std::thread serverThread([&server]
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        server.Send({{Bytes{42}, Server::AddressFor(0)}});
+    });
+
+    auto start = Clock::now();
+    Packets result;
+
+    while (result.empty() && (Clock::now() - start < std::chrono::seconds(5)))
+    {
+        client.Wait(Milliseconds{5000});
+        result = client.Receive();
+    }
+
+    serverThread.join();
+
+    ASSERT_EQ(1, result.size());
+    EXPECT_EQ(Bytes({42}), result[0].data);
+    EXPECT_LT(Clock::now() - start, std::chrono::seconds(2));
+}
+
+TEST_F(TestNetworkProviderSharedMemory, DisableReset)
+{
+    Server server(network, name, 1);
+    Client client(name);
+
+    server.Disable();
+    EXPECT_TRUE(server.IsDisabled());
+
+    client.Send({{Bytes{1}, Server::ServerAddress()}});
+    EXPECT_EQ(0, server.Receive().size());
+
+    server.Reset();
+    EXPECT_FALSE(server.IsDisabled());
+    EXPECT_EQ(1, server.Receive().size());
+
+    client.Disable();
+    server.Send({{Bytes{1}, Server::AddressFor(0)}});
+    EXPECT_EQ(0, client.Receive().size());
+
+    // Reset forgets anything that was waiting.
+    client.Reset();
+    EXPECT_EQ(0, client.Receive().size());
+}
+
+// Ping pong between two threads, shared memory vs UDP loopback.
+TEST_F(TestNetworkProviderSharedMemory, DISABLED_BenchmarkPingPong)
+{
+    const int count = 100000;
+
+    auto run = [count] (INetworkProvider& serverEnd, INetworkProvider& clientEnd, udp::endpoint to) -> double
+    {
+        std::atomic<bool> done(false);
+
+        std::thread echo([&]
+        {
+            while (!done)
+            {
+                auto packets = serverEnd.Receive();
+
+                if (!packets.empty())
+                {
+                    serverEnd.Send(packets);
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        auto start = Clock::now();
+
+        for (int i = 0; i < count; ++i)
+        {
+            clientEnd.Send({{Bytes(64, 1), to}});
+
+            while (clientEnd.Receive().empty())
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+
+        done = true;
+        echo.join();
+
+        return static_cast<double>(took) / count;
+    };
+
+    {
+        Server server(network, name, 1);
+        Client client(name);
+
+        std::cout << "Shared memory round trip: " << run(server, client, Server::ServerAddress()) << "ns\n";
+    }
+
+    {
+        NetworkProviderSynchronous serverEnd(udp::endpoint(address_v4::loopback(), 0));
+        NetworkProviderSynchronous clientEnd(udp::endpoint(address_v4::loopback(), 0));
+
+        std::cout << "UDP loopback round trip:  "
+                  << run(serverEnd, clientEnd, serverEnd.LocalAddress()) << "ns\n";
+    }
+}
+
+}}} // namespace
@@ -21,6 +21,9 @@
 #include <Implementation/NetworkProviderSynchronous.hpp>
 #include <gmock/gmock.h>
 
+#include <chrono>
+#include <thread>
+
 using namespace std;
 using namespace boost::asio::ip;
 using Bytes = std::vector<uint8_t>;
@@ -160,8 +163,32 @@ TEST_F(TestNetworkProviderSynchronous, Ip4SendPacketLoopbackAndReceive4Bytes)
 
     ASSERT_EQ(1, result.size());
     EXPECT_EQ(Bytes(4,42), result[0].data);
+
+#ifdef __linux__
+    EXPECT_NE(std::chrono::steady_clock::time_point{}, result[0].received);
+#else
+    // No kernel timestamp, so it's left unset.
+    EXPECT_EQ(std::chrono::steady_clock::time_point{}, result[0].received);
+#endif
 }
 
+#ifdef __linux__
+TEST_F(TestNetworkProviderSynchronous, Ip4ReceivedIsWhenTheKernelGotIt)
+{
+    NetworkProviderSynchronous listen(udp::endpoint(myIpv4loopback, 0));
+
+    myIpv4.Send({{Bytes(4,42), listen.LocalAddress()}});
+
+    // Sits in the socket buffer for a while before we read it.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    auto result(listen.Receive());
+
+    ASSERT_EQ(1, result.size());
+    EXPECT_LE(result[0].received, std::chrono::steady_clock::now() - std::chrono::milliseconds(40));
+}
+#endif
+
 TEST_F(TestNetworkProviderSynchronous, Ip4SendPacketLoopbackAndReceive4BytesMultiple)
 {
     Packets toSend;
@@ -179,4 +206,118 @@ TEST_F(TestNetworkProviderSynchronous, Ip4SendPacketLoopbackAndReceive4BytesMult
     EXPECT_EQ(Bytes(4,42), result[0].data);
 }
 
+
+TEST_F(TestNetworkProviderSynchronous, Ip4ExclusiveBindTwiceFails)
+{
+    NetworkProviderSynchronous first(udp::endpoint(myIpv4loopback, 0));
+
+    ASSERT_THROW(
+        NetworkProviderSynchronous second(first.LocalAddress()),
+        boost::system::system_error);
+}
+
+TEST_F(TestNetworkProviderSynchronous, Ip4SharePort)
+{
+    NetworkProviderSynchronous first(
+            udp::endpoint(myIpv4loopback, 0),
+            NetworkProviderSynchronous::Bind::SharePort);
+
+    auto bound = first.LocalAddress();
+    EXPECT_NE(0, bound.port());
+
+    NetworkProviderSynchronous second(bound, NetworkProviderSynchronous::Bind::SharePort);
+    EXPECT_FALSE(second.IsDisabled());
+    EXPECT_EQ(bound, second.LocalAddress());
+
+    // Still works after a reset.
+    second.Reset();
+    EXPECT_FALSE(second.IsDisabled());
+
+    // One of them gets it.
+    myIpv4.Send({{Bytes(4,42), bound}});
+
+    auto result(first.Receive());
+    auto resultSecond(second.Receive());
+    result.insert(end(result), begin(resultSecond), end(resultSecond));
+
+    ASSERT_EQ(1, result.size());
+    EXPECT_EQ(Bytes(4,42), result[0].data);
+}
+
+TEST_F(TestNetworkProviderSynchronous, DualStackBindsIp6)
+{
+    NetworkProviderSynchronous dual(udp::endpoint(udp::v4(), 0), NetworkProviderSynchronous::Bind::Exclusive, NetworkProviderSynchronous::Stack::DualStack);
+
+    EXPECT_FALSE(dual.IsDisabled());
+    EXPECT_TRUE(dual.LocalAddress().address().is_v6());
+    EXPECT_NE(0, dual.LocalAddress().port());
+
+    dual.Reset();
+    EXPECT_FALSE(dual.IsDisabled());
+}
+
+TEST_F(TestNetworkProviderSynchronous, DualStackBothFamilies)
+{
+    NetworkProviderSynchronous dual(udp::endpoint(udp::v6(), 0), NetworkProviderSynchronous::Bind::Exclusive, NetworkProviderSynchronous::Stack::DualStack);
+
+    auto port = dual.LocalAddress().port();
+    auto ip4Address = udp::endpoint(myIpv4loopback, myIpv4.LocalAddress().port());
+    auto ip6Address = udp::endpoint(address_v6::loopback(), myIpv6.LocalAddress().port());
+
+    myIpv4.Send({{Bytes{4}, udp::endpoint(myIpv4loopback, port)}});
+    myIpv6.Send({{Bytes{6}, udp::endpoint(address_v6::loopback(), port)}});
+
+    Packets result;
+
+    for (int i = 0; (i < 100) && (result.size() < 2); ++i)
+    {
+        auto more = dual.Receive();
+        result.insert(end(result), begin(more), end(more));
+    }
+
+    ASSERT_EQ(2, result.size());
+
+    for (const auto& packet : result)
+    {
+        if (packet.data[0] == 4)
+        {
+            // Not ::ffff:127.0.0.1, so it matches what an IPv4 socket would give.
+            EXPECT_EQ(ip4Address, packet.address);
+        }
+        else
+        {
+            EXPECT_EQ(ip6Address, packet.address);
+        }
+    }
+
+    // And back again, both from the one socket.
+    dual.Send({{Bytes{40}, ip4Address}, {Bytes{60}, ip6Address}});
+
+    Packets ip4Result;
+    Packets ip6Result;
+
+    for (int i = 0; (i < 100) && (ip4Result.empty() || ip6Result.empty()); ++i)
+    {
+        auto more4 = myIpv4.Receive();
+        auto more6 = myIpv6.Receive();
+        ip4Result.insert(end(ip4Result), begin(more4), end(more4));
+        ip6Result.insert(end(ip6Result), begin(more6), end(more6));
+    }
+
+    ASSERT_EQ(1, ip4Result.size());
+    ASSERT_EQ(1, ip6Result.size());
+    EXPECT_EQ(Bytes{40}, ip4Result[0].data);
+    EXPECT_EQ(Bytes{60}, ip6Result[0].data);
+}
+
+TEST_F(TestNetworkProviderSynchronous, SingleStackIgnoresOtherFamily)
+{
+    auto ip4Address = udp::endpoint(myIpv4loopback, myIpv4.LocalAddress().port());
+
+    // Without dual stack an IPv6 socket silently drops IPv4 sends.
+    myIpv6.Send({{Bytes{1}, ip4Address}});
+
+    EXPECT_EQ(0, myIpv4.Receive().size());
+}
+
 }}} // namespace
@@ -0,0 +1,211 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <Implementation/NetworkProviderThreaded.hpp>
+#include <Implementation/NetworkProviderSynchronous.hpp>
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <thread>
+
+using namespace std;
+using namespace boost::asio::ip;
+using Bytes = std::vector<uint8_t>;
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+using Packets = std::vector<NetworkPacket>;
+
+class TestNetworkProviderThreaded : public ::testing::Test
+{
+public:
+    TestNetworkProviderThreaded()
+        : myIpv4loopback(address::from_string("127.0.0.1"))
+        , myOther(udp::endpoint(myIpv4loopback, 0))
+    {
+    }
+
+    // Receives happen on another thread, so give them a moment.
+    template<class PROVIDER>
+    Packets ReceiveAtLeast(PROVIDER& provider, std::size_t count)
+    {
+        Packets result;
+
+        for (int tries = 0; (result.size() < count) && (tries < 1000); ++tries)
+        {
+            auto more = provider.Receive();
+            result.insert(end(result), begin(more), end(more));
+
+            if (result.size() < count)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        return result;
+    }
+
+    address myIpv4loopback;
+    NetworkProviderSynchronous myOther;
+};
+
+TEST_F(TestNetworkProviderThreaded, IsValid)
+{
+    NetworkProviderThreaded toTest(udp::endpoint(myIpv4loopback, 0));
+
+    EXPECT_FALSE(toTest.IsDisabled());
+    EXPECT_NE(0, toTest.LocalAddress().port());
+    EXPECT_EQ(0, toTest.Receive().size());
+}
+
+TEST_F(TestNetworkProviderThreaded, BindFailureThrows)
+{
+    NetworkProviderThreaded first(udp::endpoint(myIpv4loopback, 0));
+
+    ASSERT_THROW(
+        NetworkProviderThreaded second(first.LocalAddress()),
+        boost::system::system_error);
+}
+
+TEST_F(TestNetworkProviderThreaded, FlushIsABarrier)
+{
+    NetworkProviderThreaded toTest(udp::endpoint(myIpv4loopback, 0));
+
+    toTest.Send({{Bytes(4,42), myOther.LocalAddress()}, {Bytes(4,43), myOther.LocalAddress()}});
+    toTest.Flush();
+
+    // Loopback sends are delivered by the time send_to returns.
+    auto result(myOther.Receive());
+
+    ASSERT_EQ(2, result.size());
+    EXPECT_EQ(Bytes(4,42), result[0].data);
+    EXPECT_EQ(Bytes(4,43), result[1].data);
+    EXPECT_EQ(toTest.LocalAddress(), result[0].address);
+    EXPECT_EQ(0, toTest.GetMetrics().sendDepth);
+}
+
+TEST_F(TestNetworkProviderThreaded, SendsWithoutFlush)
+{
+    NetworkProviderThreaded toTest(udp::endpoint(myIpv4loopback, 0));
+
+    // One at a time, so most find a drain already posted and don't post
+    // another. None of them should be left behind.
+    for (int i = 0; i < 100; ++i)
+    {
+        toTest.Send({{Bytes(4, static_cast<uint8_t>(i)), myOther.LocalAddress()}});
+    }
+
+    auto result(ReceiveAtLeast(myOther, 100));
+
+    ASSERT_EQ(100, result.size());
+    for (std::size_t i = 0; i < result.size(); ++i)
+    {
+        EXPECT_EQ(Bytes(4, static_cast<uint8_t>(i)), result[i].data);
+    }
+
+    EXPECT_EQ(0, toTest.GetMetrics().sendDepth);
+}
+
+TEST_F(TestNetworkProviderThreaded, Receive)
+{
+    NetworkProviderThreaded toTest(udp::endpoint(myIpv4loopback, 0));
+
+    myOther.Send({{Bytes(4,42), toTest.LocalAddress()}, {Bytes{1,2,3}, toTest.LocalAddress()}});
+
+    auto result(ReceiveAtLeast(toTest, 2));
+
+    ASSERT_EQ(2, result.size());
+    EXPECT_EQ(Bytes(4,42), result[0].data);
+    EXPECT_EQ(Bytes({1,2,3}), result[1].data);
+    EXPECT_EQ(myOther.LocalAddress(), result[0].address);
+}
+
+TEST_F(TestNetworkProviderThreaded, ReceiveQueueFullDrops)
+{
+    NetworkProviderThreaded toTest(udp::endpoint(myIpv4loopback, 0), 2);
+
+    Packets toSend;
+    for (int i = 0; i < 10; ++i)
+    {
+        toSend.emplace_back(Bytes(4, static_cast<uint8_t>(i)), toTest.LocalAddress());
+    }
+
+    myOther.Send(toSend);
+
+    for (int tries = 0; (toTest.GetMetrics().receiveDropped < 8) && (tries < 1000); ++tries)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    auto metrics = toTest.GetMetrics();
+
+    EXPECT_EQ(2, metrics.receiveDepth);
+    EXPECT_EQ(8, metrics.receiveDropped);
+
+    // The oldest ones are kept.
+    auto result(toTest.Receive());
+
+    ASSERT_EQ(2, result.size());
+    EXPECT_EQ(Bytes(4,0), result[0].data);
+    EXPECT_EQ(Bytes(4,1), result[1].data);
+    EXPECT_EQ(0, toTest.GetMetrics().receiveDepth);
+}
+
+TEST_F(TestNetworkProviderThreaded, WrongAddressFamilyIgnored)
+{
+    NetworkProviderThreaded toTest(udp::endpoint(myIpv4loopback, 0));
+
+    toTest.Send({{Bytes(4,42), udp::endpoint(address::from_string("::1"), 4444)}});
+    toTest.Flush();
+
+    EXPECT_EQ(0, toTest.GetMetrics().sendDropped);
+    EXPECT_FALSE(toTest.IsDisabled());
+}
+
+TEST_F(TestNetworkProviderThreaded, DisableThenReset)
+{
+    NetworkProviderThreaded toTest(udp::endpoint(myIpv4loopback, 0));
+    auto bound = toTest.LocalAddress();
+
+    myOther.Send({{Bytes(4,42), bound}});
+    ReceiveAtLeast(toTest, 1);
+
+    toTest.Disable();
+    EXPECT_TRUE(toTest.IsDisabled());
+
+    // no exceptions please.
+    toTest.Flush();
+    toTest.Send({{Bytes(4,42), myOther.LocalAddress()}});
+    toTest.Flush();
+    EXPECT_EQ(0, toTest.Receive().size());
+    EXPECT_EQ(0, myOther.Receive().size());
+
+    toTest.Reset();
+    EXPECT_FALSE(toTest.IsDisabled());
+
+    // Receiving again. Bound to port 0, so we get a new one.
+    myOther.Send({{Bytes(4,44), toTest.LocalAddress()}});
+    auto result(ReceiveAtLeast(toTest, 1));
+
+    ASSERT_EQ(1, result.size());
+    EXPECT_EQ(Bytes(4,44), result[0].data);
+}
+
+}}} // namespace
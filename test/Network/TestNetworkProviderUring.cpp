@@ -0,0 +1,298 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <Implementation/NetworkProviderUring.hpp>
+#include <Implementation/NetworkProviderBatched.hpp>
+#include <Implementation/NetworkProviderThreaded.hpp>
+#include <Implementation/NetworkProviderSynchronous.hpp>
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <ctime>
+#include <thread>
+#include <iostream>
+
+using namespace std;
+using namespace boost::asio::ip;
+using Bytes = std::vector<uint8_t>;
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+using Packets = std::vector<NetworkPacket>;
+
+class TestNetworkProviderUring : public ::testing::Test
+{
+public:
+    TestNetworkProviderUring()
+        : myIpv4loopback(address::from_string("127.0.0.1"))
+        , myOther(udp::endpoint(myIpv4loopback, 0))
+    {
+    }
+
+    address myIpv4loopback;
+    NetworkProviderSynchronous myOther;
+
+    // Has to work either way, so run everything with and without io_uring.
+    void SendAndReceive(NetworkProviderUring::Use use)
+    {
+        NetworkProviderUring toTest(udp::endpoint(myIpv4loopback, 0), use);
+
+        EXPECT_FALSE(toTest.IsDisabled());
+
+        auto to = toTest.LocalAddress();
+        EXPECT_NE(0, to.port());
+
+        auto toSend = Packets{};
+        for (int i = 0; i < 200; ++i)
+        {
+            toSend.emplace_back(Bytes(8, static_cast<uint8_t>(i)), to);
+        }
+
+        myOther.Send(toSend);
+        auto result(toTest.Receive());
+
+        ASSERT_EQ(toSend.size(), result.size());
+        for (std::size_t i = 0; i < result.size(); ++i)
+        {
+            EXPECT_EQ(toSend[i].data, result[i].data);
+            EXPECT_EQ(myOther.LocalAddress(), result[i].address);
+            EXPECT_NE(std::chrono::steady_clock::time_point{}, result[i].received);
+        }
+
+        toTest.Send({{Bytes(4,42), myOther.LocalAddress()}, {Bytes(4,43), myOther.LocalAddress()}});
+        toTest.Flush();
+        result = myOther.Receive();
+
+        ASSERT_EQ(2, result.size());
+        EXPECT_EQ(Bytes(4,42), result[0].data);
+        EXPECT_EQ(to, result[0].address);
+    }
+
+    // More sends than there are slots, so slots have to be reused.
+    void SendWithoutFlush(NetworkProviderUring::Use use)
+    {
+        NetworkProviderUring toTest(udp::endpoint(myIpv4loopback, 0), use);
+
+        auto result = Packets{};
+
+        for (int round = 0; round < 4; ++round)
+        {
+            auto toSend = Packets{};
+            for (int i = 0; i < 150; ++i)
+            {
+                toSend.emplace_back(Bytes(8, static_cast<uint8_t>(round)), myOther.LocalAddress());
+                toSend.back().data[0] = static_cast<uint8_t>(i);
+            }
+
+            toTest.Send(toSend);
+
+            auto got = myOther.Receive();
+            result.insert(end(result), begin(got), end(got));
+        }
+
+        toTest.Flush();
+
+        auto got = myOther.Receive();
+        result.insert(end(result), begin(got), end(got));
+
+        ASSERT_EQ(600, result.size());
+        for (std::size_t i = 0; i < result.size(); ++i)
+        {
+            auto expected = Bytes(8, static_cast<uint8_t>(i / 150));
+            expected[0] = static_cast<uint8_t>(i % 150);
+
+            EXPECT_EQ(expected, result[i].data);
+        }
+    }
+
+    void DisableThenReset(NetworkProviderUring::Use use)
+    {
+        NetworkProviderUring toTest(udp::endpoint(myIpv4loopback, 0), use);
+
+        myOther.Send({{Bytes(4,42), toTest.LocalAddress()}});
+
+        toTest.Disable();
+        EXPECT_TRUE(toTest.IsDisabled());
+
+        // no exceptions please.
+        toTest.Flush();
+        toTest.Send({{Bytes(4,42), myOther.LocalAddress()}});
+        EXPECT_EQ(0, toTest.Receive().size());
+        EXPECT_EQ(0, myOther.Receive().size());
+
+        toTest.Reset();
+        EXPECT_FALSE(toTest.IsDisabled());
+
+        myOther.Send({{Bytes(4,44), toTest.LocalAddress()}});
+        auto result(toTest.Receive());
+
+        ASSERT_EQ(1, result.size());
+        EXPECT_EQ(Bytes(4,44), result[0].data);
+    }
+};
+
+TEST_F(TestNetworkProviderUring, UsesUringIfSupported)
+{
+    NetworkProviderUring toTest(udp::endpoint(myIpv4loopback, 0));
+
+    EXPECT_EQ(NetworkProviderUring::IsSupported(), toTest.UsingUring());
+}
+
+TEST_F(TestNetworkProviderUring, Fallback)
+{
+    NetworkProviderUring toTest(udp::endpoint(myIpv4loopback, 0), NetworkProviderUring::Use::Fallback);
+
+    EXPECT_FALSE(toTest.UsingUring());
+}
+
+TEST_F(TestNetworkProviderUring, BindFailureThrows)
+{
+    ASSERT_THROW(
+        NetworkProviderUring second(myOther.LocalAddress()),
+        boost::system::system_error);
+}
+
+TEST_F(TestNetworkProviderUring, NotExpectingData)
+{
+    NetworkProviderUring toTest(udp::endpoint(myIpv4loopback, 0));
+
+    EXPECT_EQ(0, toTest.Receive().size());
+}
+
+TEST_F(TestNetworkProviderUring, SendEmpty)
+{
+    NetworkProviderUring toTest(udp::endpoint(myIpv4loopback, 0));
+
+    toTest.Send({});
+    toTest.Send({{}});
+    toTest.Send({{Bytes(4,42), udp::endpoint(address::from_string("::1"), 4444)}});
+
+    EXPECT_FALSE(toTest.IsDisabled());
+}
+
+TEST_F(TestNetworkProviderUring, SendAndReceive)
+{
+    SendAndReceive(NetworkProviderUring::Use::Automatic);
+}
+
+TEST_F(TestNetworkProviderUring, SendAndReceiveFallback)
+{
+    SendAndReceive(NetworkProviderUring::Use::Fallback);
+}
+
+TEST_F(TestNetworkProviderUring, SendWithoutFlush)
+{
+    SendWithoutFlush(NetworkProviderUring::Use::Automatic);
+}
+
+TEST_F(TestNetworkProviderUring, SendWithoutFlushFallback)
+{
+    SendWithoutFlush(NetworkProviderUring::Use::Fallback);
+}
+
+TEST_F(TestNetworkProviderUring, DisableThenReset)
+{
+    DisableThenReset(NetworkProviderUring::Use::Automatic);
+}
+
+TEST_F(TestNetworkProviderUring, DisableThenResetFallback)
+{
+    DisableThenReset(NetworkProviderUring::Use::Fallback);
+}
+
+namespace
+{
+struct Result
+{
+    double packetsPerSecond;
+    double cpuMicrosecondsPerPacket;
+};
+
+// Sends at a fixed rate for a while, in bursts every millisecond like a busy
+// server would, and measures what made it through and the CPU it cost.
+template<class SEND, class RECEIVE>
+Result Paced(SEND& sender, RECEIVE& listen, udp::endpoint to, std::size_t rate)
+{
+    static const auto runFor = std::chrono::milliseconds(500);
+
+    auto burst = std::max<std::size_t>(1, rate / 1000);
+    auto packets = Packets(burst, NetworkPacket(Bytes(64, 42), to));
+
+    std::size_t received{0};
+    auto cpuStart = std::clock();
+    auto start = std::chrono::steady_clock::now();
+    auto next = start;
+
+    while ((std::chrono::steady_clock::now() - start) < runFor)
+    {
+        sender.Send(packets);
+        received += listen.Receive().size();
+
+        next += std::chrono::milliseconds(1);
+        std::this_thread::sleep_until(next);
+    }
+
+    // Anything still in flight.
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    received += listen.Receive().size();
+
+    auto took = std::chrono::duration_cast<std::chrono::duration<double>>(
+                std::chrono::steady_clock::now() - start);
+    auto cpu = double(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+    return
+    {
+        received / took.count(),
+        received ? (cpu * 1000000.0) / received : 0.0
+    };
+}
+
+template<class PROVIDER>
+void Benchmark(const char* name, address loopback)
+{
+    static const std::size_t rates[] = {10000, 50000, 100000, 250000, 500000};
+
+    PROVIDER sender(udp::endpoint(loopback, 0));
+    PROVIDER listen(udp::endpoint(loopback, 0));
+
+    for (auto rate : rates)
+    {
+        auto result = Paced(sender, listen, listen.LocalAddress(), rate);
+
+        std::cout
+                << name << " @ " << rate << "/s: "
+                << result.packetsPerSecond << " packets/s, "
+                << result.cpuMicrosecondsPerPacket << " us CPU/packet" << std::endl;
+    }
+}
+}
+
+// Not a unit test, run with --gtest_also_run_disabled_tests to compare.
+TEST_F(TestNetworkProviderUring, DISABLED_BenchmarkLoopback)
+{
+    std::cout << "io_uring supported: " << NetworkProviderUring::IsSupported() << std::endl;
+
+    Benchmark<NetworkProviderSynchronous>("Synchronous", myIpv4loopback);
+    Benchmark<NetworkProviderBatched>("Batched    ", myIpv4loopback);
+    Benchmark<NetworkProviderThreaded>("Threaded   ", myIpv4loopback);
+    Benchmark<NetworkProviderUring>("Uring      ", myIpv4loopback);
+}
+
+}}} // namespace
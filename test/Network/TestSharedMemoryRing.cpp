@@ -0,0 +1,162 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+
+    This file is part of Game-in-a-box
+
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <Implementation/SharedMemoryRing.hpp>
+#include <gmock/gmock.h>
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <thread>
+
+using Bytes = std::vector<uint8_t>;
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+class TestSharedMemoryRing : public ::testing::Test
+{
+public:
+    TestSharedMemoryRing()
+        : storage(sizeof(SharedMemoryRing) + alignof(SharedMemoryRing))
+        , ring(nullptr)
+        , bell(new SharedMemoryDoorbell())
+    {
+        // Too big for the stack, and C++11 new doesn't do 64 byte alignment.
+        auto address = reinterpret_cast<std::uintptr_t>(storage.data());
+        auto aligned = (address + alignof(SharedMemoryRing) - 1) & ~(std::uintptr_t(alignof(SharedMemoryRing)) - 1);
+
+        ring = new (reinterpret_cast<void*>(aligned)) SharedMemoryRing;
+        ring->Reset();
+        bell->Reset();
+    }
+
+    std::vector<uint8_t> storage;
+    SharedMemoryRing* ring;
+    std::unique_ptr<SharedMemoryDoorbell> bell;
+};
+
+TEST_F(TestSharedMemoryRing, Empty)
+{
+    Bytes result;
+
+    EXPECT_TRUE(ring->Empty());
+    EXPECT_FALSE(ring->TryPop(result));
+}
+
+TEST_F(TestSharedMemoryRing, PushPop)
+{
+    Bytes in{1,2,3,4};
+    Bytes empty{};
+    Bytes result;
+
+    EXPECT_TRUE(ring->TryPush(in.data(), in.size()));
+    EXPECT_TRUE(ring->TryPush(empty.data(), empty.size()));
+    EXPECT_FALSE(ring->Empty());
+
+    ASSERT_TRUE(ring->TryPop(result));
+    EXPECT_EQ(in, result);
+
+    ASSERT_TRUE(ring->TryPop(result));
+    EXPECT_TRUE(result.empty());
+
+    EXPECT_TRUE(ring->Empty());
+}
+
+TEST_F(TestSharedMemoryRing, TooBig)
+{
+    Bytes fits(SharedMemoryRing::CellSize, 7);
+    Bytes tooBig(SharedMemoryRing::CellSize + 1, 7);
+
+    EXPECT_TRUE(ring->TryPush(fits.data(), fits.size()));
+    EXPECT_FALSE(ring->TryPush(tooBig.data(), tooBig.size()));
+}
+
+TEST_F(TestSharedMemoryRing, FullAndWrap)
+{
+    Bytes result;
+
+    for (int round = 0; round < 3; ++round)
+    {
+        for (std::size_t i = 0; i < SharedMemoryRing::CellCount; ++i)
+        {
+            auto value = static_cast<uint8_t>(i);
+            ASSERT_TRUE(ring->TryPush(&value, 1));
+        }
+
+        uint8_t extra = 0;
+        EXPECT_FALSE(ring->TryPush(&extra, 1));
+
+        for (std::size_t i = 0; i < SharedMemoryRing::CellCount; ++i)
+        {
+            ASSERT_TRUE(ring->TryPop(result));
+            EXPECT_EQ(Bytes{static_cast<uint8_t>(i)}, result);
+        }
+
+        EXPECT_TRUE(ring->Empty());
+    }
+}
+
+TEST_F(TestSharedMemoryRing, DoorbellReady)
+{
+    auto start = Clock::now();
+
+    bell->Wait([] { return true; }, Milliseconds{1000});
+
+    EXPECT_LT(Clock::now() - start, std::chrono::milliseconds(500));
+}
+
+TEST_F(TestSharedMemoryRing, DoorbellTimeout)
+{
+    auto start = Clock::now();
+
+    bell->Wait([] { return false; }, Milliseconds{20});
+
+    EXPECT_GE(Clock::now() - start, std::chrono::milliseconds(15));
+}
+
+TEST_F(TestSharedMemoryRing, DoorbellWakes)
+{
+    std::atomic<bool> ready(false);
+
+    std::thread producer([this, &ready]
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+        uint8_t value = 42;
+        ring->TryPush(&value, 1);
+        ready = true;
+        bell->Ring();
+    });
+
+    auto start = Clock::now();
+
+    while (ring->Empty() && (Clock::now() - start < std::chrono::seconds(5)))
+    {
+        bell->Wait([this] { return !ring->Empty(); }, Milliseconds{5000});
+    }
+
+    producer.join();
+
+    EXPECT_TRUE(ready);
+    EXPECT_FALSE(ring->Empty());
+    EXPECT_LT(Clock::now() - start, std::chrono::seconds(2));
+}
+
+}}} // namespace
@@ -0,0 +1,126 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <Implementation/SpscRing.hpp>
+#include <gmock/gmock.h>
+
+#include <thread>
+
+using namespace std;
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+TEST(TestSpscRing, RoundsUpCapacity)
+{
+    EXPECT_EQ(1, SpscRing<int>(0).Capacity());
+    EXPECT_EQ(4, SpscRing<int>(3).Capacity());
+    EXPECT_EQ(8, SpscRing<int>(8).Capacity());
+}
+
+TEST(TestSpscRing, Empty)
+{
+    SpscRing<int> toTest(4);
+    int result{42};
+
+    EXPECT_EQ(0, toTest.Size());
+    EXPECT_FALSE(toTest.TryPop(result));
+    EXPECT_EQ(42, result);
+}
+
+TEST(TestSpscRing, Fifo)
+{
+    SpscRing<int> toTest(4);
+    int result{0};
+
+    EXPECT_TRUE(toTest.TryPush(1));
+    EXPECT_TRUE(toTest.TryPush(2));
+    EXPECT_EQ(2, toTest.Size());
+
+    EXPECT_TRUE(toTest.TryPop(result));
+    EXPECT_EQ(1, result);
+    EXPECT_TRUE(toTest.TryPop(result));
+    EXPECT_EQ(2, result);
+    EXPECT_FALSE(toTest.TryPop(result));
+}
+
+TEST(TestSpscRing, Full)
+{
+    SpscRing<int> toTest(2);
+    int result{0};
+
+    EXPECT_TRUE(toTest.TryPush(1));
+    EXPECT_TRUE(toTest.TryPush(2));
+    EXPECT_FALSE(toTest.TryPush(3));
+    EXPECT_EQ(2, toTest.Size());
+
+    // Making room lets the next one in, wrapping around.
+    EXPECT_TRUE(toTest.TryPop(result));
+    EXPECT_TRUE(toTest.TryPush(3));
+
+    EXPECT_TRUE(toTest.TryPop(result));
+    EXPECT_EQ(2, result);
+    EXPECT_TRUE(toTest.TryPop(result));
+    EXPECT_EQ(3, result);
+}
+
+TEST(TestSpscRing, TwoThreads)
+{
+    static const int count{100000};
+
+    SpscRing<int> toTest(16);
+
+    std::thread producer([&toTest]
+    {
+        for (int i = 0; i < count;)
+        {
+            if (toTest.TryPush(int{i}))
+            {
+                ++i;
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    int expected{0};
+    int result{0};
+
+    while (expected < count)
+    {
+        if (toTest.TryPop(result))
+        {
+            // Stop at the first one out of order, don't spam failures.
+            ASSERT_EQ(expected, result);
+            ++expected;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    producer.join();
+
+    EXPECT_EQ(0, toTest.Size());
+}
+
+}}} // namespace
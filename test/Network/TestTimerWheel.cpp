@@ -0,0 +1,153 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <algorithm>
+#include <Implementation/TimerWheel.hpp>
+#include <gmock/gmock.h>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+class TestTimerWheel : public ::testing::Test
+{
+public:
+    TestTimerWheel()
+        : start(Clock::now())
+        , toTest(Milliseconds{10}, start)
+    {
+    }
+
+    OClock start;
+    TimerWheel<int> toTest;
+};
+
+TEST_F(TestTimerWheel, Empty)
+{
+    EXPECT_EQ(0, toTest.Size());
+    EXPECT_TRUE(toTest.Advance(start + hours(1)).empty());
+}
+
+TEST_F(TestTimerWheel, FiresOnTime)
+{
+    toTest.Schedule(1, start + milliseconds(25));
+
+    EXPECT_TRUE(toTest.Advance(start + milliseconds(20)).empty());
+    EXPECT_EQ(1, toTest.Size());
+
+    // Never early.
+    EXPECT_TRUE(toTest.Advance(start + milliseconds(29)).empty());
+    EXPECT_EQ(vector<int>({1}), toTest.Advance(start + milliseconds(30)));
+    EXPECT_EQ(0, toTest.Size());
+
+    // Only once.
+    EXPECT_TRUE(toTest.Advance(start + milliseconds(100)).empty());
+}
+
+TEST_F(TestTimerWheel, PastFiresNextAdvance)
+{
+    toTest.Schedule(1, OClock::min());
+    toTest.Schedule(2, start - seconds(1));
+
+    auto fired = toTest.Advance(start);
+    sort(begin(fired), end(fired));
+
+    EXPECT_EQ(vector<int>({1, 2}), fired);
+}
+
+TEST_F(TestTimerWheel, Cancel)
+{
+    toTest.Schedule(1, start + milliseconds(50));
+    toTest.Cancel(1);
+
+    EXPECT_TRUE(toTest.Advance(start + seconds(1)).empty());
+
+    toTest.Schedule(1, start + milliseconds(2000));
+    toTest.Schedule(1, OClock::max());
+
+    EXPECT_TRUE(toTest.Advance(start + seconds(10)).empty());
+}
+
+TEST_F(TestTimerWheel, EarliestDeadlineWins)
+{
+    toTest.Schedule(1, start + milliseconds(500));
+    toTest.Schedule(1, start + milliseconds(100));
+    toTest.Schedule(1, start + milliseconds(800));
+
+    EXPECT_EQ(1, toTest.Size());
+    EXPECT_TRUE(toTest.Advance(start + milliseconds(90)).empty());
+    EXPECT_EQ(vector<int>({1}), toTest.Advance(start + milliseconds(100)));
+
+    // The stale 500ms entry is ignored.
+    EXPECT_TRUE(toTest.Advance(start + seconds(1)).empty());
+}
+
+TEST_F(TestTimerWheel, Cascades)
+{
+    // Hit every level, stepping like a game loop.
+    vector<milliseconds> deadlines{
+            milliseconds(5),
+            milliseconds(700),
+            milliseconds(45000),
+            milliseconds(3000000),
+            hours(60)};
+
+    for (std::size_t i = 0; i < deadlines.size(); ++i)
+    {
+        toTest.Schedule(static_cast<int>(i), start + deadlines[i]);
+    }
+
+    vector<int> fired{};
+    vector<OClock> firedAt{};
+    auto now = start;
+
+    while ((fired.size() < deadlines.size()) && (now < (start + hours(100))))
+    {
+        now += milliseconds(50);
+
+        for (auto key : toTest.Advance(now))
+        {
+            fired.push_back(key);
+            firedAt.push_back(now);
+        }
+    }
+
+    ASSERT_EQ(deadlines.size(), fired.size());
+
+    for (std::size_t i = 0; i < fired.size(); ++i)
+    {
+        auto deadline = start + deadlines[fired[i]];
+
+        EXPECT_GE(firedAt[i], deadline);
+        EXPECT_LT(firedAt[i], deadline + milliseconds(60));
+    }
+}
+
+TEST_F(TestTimerWheel, BigJump)
+{
+    toTest.Schedule(1, start + seconds(5));
+    toTest.Schedule(2, start + seconds(50));
+
+    EXPECT_EQ(vector<int>({1}), toTest.Advance(start + seconds(10)));
+    EXPECT_EQ(vector<int>({2}), toTest.Advance(start + seconds(60)));
+}
+
+}}} // namespace
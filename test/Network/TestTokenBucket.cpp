@@ -0,0 +1,105 @@
+/*
+    Game-in-a-box. Simple First Person Shooter Network Game.
+    Copyright (C) 2012-2013 Richard Maxwell <jodi.the.tigger@gmail.com>
+    
+    This file is part of Game-in-a-box
+    
+    Game-in-a-box is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+    
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <Implementation/TokenBucket.hpp>
+#include <gmock/gmock.h>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace GameInABox { namespace Network { namespace Implementation {
+
+TEST(TestTokenBucket, UnlimitedAlwaysSends)
+{
+    TokenBucket toTest{};
+    OClock now{};
+
+    for (int i = 0; i < 100; ++i)
+    {
+        ASSERT_TRUE(toTest.CanTake(100000, now));
+        toTest.Take(100000);
+    }
+
+    EXPECT_EQ(100 * 100000, toTest.BytesTaken());
+    EXPECT_FALSE(toTest.IsLimited());
+    EXPECT_EQ(0.0f, toTest.Utilisation(now));
+}
+
+TEST(TestTokenBucket, BurstThenWait)
+{
+    OClock now{};
+    TokenBucket toTest{BandwidthLimit{1000, 500}, now};
+
+    ASSERT_TRUE(toTest.CanTake(300, now));
+    toTest.Take(300);
+
+    // Not enough for a whole second snapshot, don't send part of one.
+    EXPECT_FALSE(toTest.CanTake(300, now));
+    EXPECT_TRUE(toTest.CanTake(200, now));
+
+    // 100ms == 100 bytes.
+    now += milliseconds(100);
+    EXPECT_TRUE(toTest.CanTake(300, now));
+}
+
+TEST(TestTokenBucket, BurstIsCapped)
+{
+    OClock now{};
+    TokenBucket toTest{BandwidthLimit{1000, 500}, now};
+
+    toTest.Take(500);
+
+    // Idle for ages, only get the burst back.
+    now += seconds(60);
+    ASSERT_TRUE(toTest.CanTake(500, now));
+    toTest.Take(500);
+    EXPECT_FALSE(toTest.CanTake(1, now));
+}
+
+TEST(TestTokenBucket, OversizedSnapshotGoesIntoDebt)
+{
+    OClock now{};
+    TokenBucket toTest{BandwidthLimit{1000, 500}, now};
+
+    // Bigger than the burst, allowed as the bucket is full.
+    ASSERT_TRUE(toTest.CanTake(1500, now));
+    toTest.Take(1500);
+
+    // Need to pay back 1000 bytes before the bucket is useful again.
+    now += milliseconds(1000);
+    EXPECT_FALSE(toTest.CanTake(1, now));
+
+    now += milliseconds(100);
+    EXPECT_TRUE(toTest.CanTake(100, now));
+}
+
+TEST(TestTokenBucket, Utilisation)
+{
+    OClock now{};
+    TokenBucket toTest{BandwidthLimit{1000, 1000}, now};
+
+    // 1000 burst + 1000 over a second = 2000 allowed.
+    now += seconds(1);
+    toTest.Take(1000);
+
+    EXPECT_FLOAT_EQ(0.5f, toTest.Utilisation(now));
+}
+
+}}} // namespace
@@ -20,8 +20,11 @@
 
 #include <DeltaCoder.hpp>
 #include <DeltaMapItem.hpp>
+#include <Implementation/DeltaFieldCoder.hpp>
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <iostream>
 #include <string>
 #include <vector>
 #include <memory>
@@ -215,4 +218,96 @@ TEST_F(TestDeltaCoder, RandomStates)
     }
 }
 
+// Same fields and wire format (no research flags) as the network library's
+// DeltaFieldCoder, to see what the compile time field list buys.
+TEST_F(TestDeltaCoder, DISABLED_BenchmarkAgainstDeltaFieldCoder)
+{
+    typedef std::chrono::steady_clock Clock;
+    typedef GameInABox::Network::Implementation::DeltaFieldCoder<
+            DeltaTester,
+            DELTA_FIELD_BITS(DeltaTester, first, 8),
+            DELTA_FIELD_BITS(DeltaTester, second, 18),
+            DELTA_FIELD(DeltaTester, waitWhat)> FieldCoder;
+
+    const int count = 1000000;
+
+    minstd_rand generator(1);
+    uniform_int_distribution<uint32_t> even;
+    vector<DeltaTester> states;
+
+    for (int i = 0; i < 256; i++)
+    {
+        states.push_back(DeltaTester(
+            uint32_t(even(generator) & 0xFF),
+            (i & 1) ? states.back().second : uint32_t(even(generator) & 0x3FFFF),
+            (i & 2) ? states.back().waitWhat : float(even(generator)) / 37.0f));
+    }
+
+    DeltaCoder<DeltaTester> runtime(myMap, myIdentity, false, false);
+    FieldCoder compiled(myIdentity);
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        BitStream out(count);
+
+        auto start = Clock::now();
+
+        for (int i = 0; i < count; ++i)
+        {
+            if (pass == 0)
+            {
+                runtime.DeltaEncode(&states[i & 0xFF], states[(i + 1) & 0xFF], out);
+            }
+            else
+            {
+                compiled.DeltaEncode(&states[i & 0xFF], states[(i + 1) & 0xFF], out);
+            }
+        }
+
+        auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+
+        std::cout << (pass == 0 ? "DeltaCoder encode:      " : "DeltaFieldCoder encode: ")
+                  << static_cast<double>(took) / count << "ns per object\n";
+    }
+
+    // Decode what the field coder just wrote, both formats are the same.
+    {
+        BitStream stream(count);
+
+        for (int i = 0; i < count; ++i)
+        {
+            compiled.DeltaEncode(&states[i & 0xFF], states[(i + 1) & 0xFF], stream);
+        }
+
+        auto buffer = stream.TakeBuffer();
+
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            BitStream in(buffer);
+            DeltaTester result;
+
+            auto start = Clock::now();
+
+            for (int i = 0; i < count; ++i)
+            {
+                if (pass == 0)
+                {
+                    runtime.DeltaDecode(&states[i & 0xFF], result, in);
+                }
+                else
+                {
+                    compiled.DeltaDecode(&states[i & 0xFF], result, in);
+                }
+            }
+
+            auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+
+            EXPECT_EQ(states[count & 0xFF].first, result.first);
+
+            std::cout << (pass == 0 ? "DeltaCoder decode:      " : "DeltaFieldCoder decode: ")
+                      << static_cast<double>(took) / count << "ns per object\n";
+        }
+    }
+}
+
 }} // namespace